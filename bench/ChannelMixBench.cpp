@@ -0,0 +1,46 @@
+// Channel mixer throughput per layout, in frames per second.
+#include "ChannelMixer.h"
+#include <benchmark/benchmark.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+    const unsigned int PacketFrames = 480;
+
+    // Args: input channels, output channels
+    void BM_ChannelMix(benchmark::State& state)
+    {
+        const unsigned int inputChannels = (unsigned int)state.range(0);
+        const unsigned int outputChannels = (unsigned int)state.range(1);
+
+        // A non-identity matrix so 2->2 is not a passthrough copy
+        ChannelMatrix matrix = ChannelMatrix::createDefault(inputChannels, outputChannels);
+        for (size_t g = 0; g < matrix.gains.size(); g++)
+            matrix.gains[g] = matrix.gains[g] * 0.9f + 0.05f;
+
+        ChannelMixer mixer;
+        mixer.Configure(matrix);
+
+        std::vector<float> input(PacketFrames * inputChannels);
+        for (size_t i = 0; i < input.size(); i++)
+            input[i] = (float)(i % 97) / 97.0f - 0.5f;
+        std::vector<float> output(PacketFrames * outputChannels);
+
+        for (auto _ : state)
+        {
+            mixer.Process(input.data(), output.data(), PacketFrames);
+            benchmark::ClobberMemory();
+        }
+
+        state.counters["frames/s"] = benchmark::Counter((double)state.iterations() * PacketFrames, benchmark::Counter::kIsRate);
+        std::string kernel;
+        for (const wchar_t* name = mixer.GetKernelName(); *name; name++)
+            kernel += (char)*name;
+        state.SetLabel(kernel);
+    }
+
+    BENCHMARK(BM_ChannelMix)->ArgNames({ "in", "out" })
+        ->Args({ 1, 2 })->Args({ 2, 1 })->Args({ 2, 2 })->Args({ 4, 1 })->Args({ 8, 1 })
+        ->Args({ 4, 2 })->Args({ 6, 2 })->Args({ 2, 6 });
+}
@@ -0,0 +1,147 @@
+// Per-channel noise suppression from 1 to 16 channels: every channel's instance in turn on one
+// thread, against PerChannelNoiseProcessor spreading them over its worker pool. Uses RNNoise when
+// it is built in, otherwise a stand-in with comparable per-frame cost.
+#include "PerChannelNoiseProcessor.h"
+#include "RNNoiseProcessor.h"
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    const unsigned int PacketFrames = 480;
+    const unsigned int SampleRate = 48000;
+
+    // RNNoise stand-in: 480-sample frames through a 22-band biquad filter bank with an envelope
+    // follower per band, roughly the arithmetic of RNNoise's band analysis and gains
+    class FilterBankDenoiser : public INoiseProcessor
+    {
+    public:
+        static const unsigned int FrameSize = 480;
+        static const unsigned int Bands = 22;
+
+        FilterBankDenoiser() : m_state(Bands * 4, 0.0f), m_envelope(Bands, 0.0f) {}
+
+        bool Initialize(unsigned int, unsigned int channels) override { return channels == 1; }
+
+        void Process(float* audioData, unsigned int frameCount, unsigned int) override
+        {
+            for (unsigned int start = 0; start + FrameSize <= frameCount; start += FrameSize)
+                ProcessFrame(audioData + start);
+        }
+
+        const wchar_t* GetName() const override { return L"FilterBank"; }
+        unsigned int GetRequiredFrameSize() const override { return FrameSize; }
+        unsigned int GetRequiredSampleRate() const override { return SampleRate; }
+        void SetDiagnosticCallback(std::function<void(const std::wstring&)>) override {}
+
+    private:
+        void ProcessFrame(float* frame)
+        {
+            float mixed[FrameSize] = {};
+            for (unsigned int band = 0; band < Bands; band++)
+            {
+                float* z = &m_state[band * 4];
+                const float a1 = -1.9f + 0.05f * band / Bands;
+                const float a2 = 0.95f;
+                float envelope = m_envelope[band];
+                for (unsigned int i = 0; i < FrameSize; i++)
+                {
+                    float y = 0.02f * (frame[i] - z[1]) - a1 * z[2] - a2 * z[3];
+                    z[1] = z[0];
+                    z[0] = frame[i];
+                    z[3] = z[2];
+                    z[2] = y;
+                    envelope += 0.01f * (std::fabs(y) - envelope);
+                    mixed[i] += y * envelope / (envelope + 0.001f);
+                }
+                m_envelope[band] = envelope;
+            }
+            for (unsigned int i = 0; i < FrameSize; i++)
+                frame[i] = mixed[i];
+        }
+
+        std::vector<float> m_state;
+        std::vector<float> m_envelope;
+    };
+
+    std::unique_ptr<INoiseProcessor> CreateDenoiser()
+    {
+#ifdef HAVE_RNNOISE
+        return std::make_unique<RNNoiseProcessor>(RNNoiseConfig());
+#else
+        return std::make_unique<FilterBankDenoiser>();
+#endif
+    }
+
+    std::vector<float> MakeNoisyInput(unsigned int channels)
+    {
+        std::vector<float> input(PacketFrames * channels);
+        unsigned int seed = 1;
+        for (unsigned int i = 0; i < PacketFrames; i++)
+        {
+            for (unsigned int ch = 0; ch < channels; ch++)
+            {
+                seed = seed * 1664525u + 1013904223u;
+                float noise = ((seed >> 9) / 8388608.0f - 1.0f) * 0.05f;
+                input[i * channels + ch] = 0.3f * std::sin(0.02f * i * (ch + 1)) + noise;
+            }
+        }
+        return input;
+    }
+
+    // Args: channels. Each channel's instance runs in turn on the benchmark thread.
+    void BM_DenoiseChannelsSerial(benchmark::State& state)
+    {
+        const unsigned int channels = (unsigned int)state.range(0);
+        std::vector<std::unique_ptr<INoiseProcessor>> processors;
+        BufferArena arena;
+        for (unsigned int ch = 0; ch < channels; ch++)
+        {
+            processors.push_back(CreateDenoiser());
+            processors.back()->Initialize(SampleRate, 1);
+            processors.back()->ReserveBuffers(arena, PacketFrames);
+        }
+        arena.Allocate();
+
+        std::vector<float> input = MakeNoisyInput(channels);
+        std::vector<float> planes(input.size());
+        for (auto _ : state)
+        {
+            for (unsigned int ch = 0; ch < channels; ch++)
+            {
+                float* plane = planes.data() + ch * PacketFrames;
+                for (unsigned int i = 0; i < PacketFrames; i++)
+                    plane[i] = input[i * channels + ch];
+                processors[ch]->Process(plane, PacketFrames, 1);
+            }
+            benchmark::ClobberMemory();
+        }
+        state.counters["frames/s"] = benchmark::Counter((double)state.iterations() * PacketFrames, benchmark::Counter::kIsRate);
+    }
+
+    // Args: channels. PerChannelNoiseProcessor as the engine runs it (parallel above two channels).
+    void BM_DenoiseChannelsParallel(benchmark::State& state)
+    {
+        const unsigned int channels = (unsigned int)state.range(0);
+        PerChannelNoiseProcessor processor(&CreateDenoiser);
+        BufferArena arena;
+        processor.Initialize(SampleRate, channels);
+        processor.ReserveBuffers(arena, PacketFrames);
+        arena.Allocate();
+
+        std::vector<float> input = MakeNoisyInput(channels);
+        std::vector<float> block(input.size());
+        for (auto _ : state)
+        {
+            std::copy(input.begin(), input.end(), block.begin());
+            processor.Process(block.data(), PacketFrames, channels);
+            benchmark::ClobberMemory();
+        }
+        state.counters["frames/s"] = benchmark::Counter((double)state.iterations() * PacketFrames, benchmark::Counter::kIsRate);
+        state.counters["threads"] = processor.GetWorkerCount() + 1;
+    }
+
+    BENCHMARK(BM_DenoiseChannelsSerial)->ArgName("ch")->RangeMultiplier(2)->Range(1, 16)->UseRealTime();
+    BENCHMARK(BM_DenoiseChannelsParallel)->ArgName("ch")->RangeMultiplier(2)->Range(1, 16)->UseRealTime();
+}
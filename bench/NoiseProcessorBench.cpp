@@ -0,0 +1,133 @@
+// RNNoiseProcessor and SpeexProcessor as the engine calls them, at capture callback sizes from
+// 64 to 2048 frames and 1, 2 and 6 channels (downmixed to the mono instance), in frames per
+// second; and what NoiseSuppress adds on top: the disabled call, the direct path and the
+// 44.1 kHz resampling bridge. Each is skipped when its library is not built in.
+#include "NoiseSuppress.h"
+#include "RNNoiseProcessor.h"
+#include "SpeexProcessor.h"
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+namespace
+{
+    const unsigned int SampleRate = 48000;
+
+    // Speech-band tone over white noise, interleaved, at normalized float scale
+    std::vector<float> MakeNoisySpeech(unsigned int frames, unsigned int channels, unsigned int rate)
+    {
+        std::vector<float> signal(frames * channels);
+        unsigned int seed = 1;
+        for (unsigned int i = 0; i < frames; i++)
+        {
+            for (unsigned int ch = 0; ch < channels; ch++)
+            {
+                seed = seed * 1664525u + 1013904223u;
+                float noise = ((seed >> 9) / 8388608.0f - 1.0f) * 0.03f;
+                signal[i * channels + ch] = 0.25f * std::sin(2.0f * 3.14159265f * 220.0f * i / rate + ch) + noise;
+            }
+        }
+        return signal;
+    }
+
+    // Runs processor over one callback of frames x channels at a time, refilled from a second of
+    // input so the noise estimate sees a steady signal rather than the same packet over and over
+    void RunProcessor(benchmark::State& state, INoiseProcessor& processor)
+    {
+        const unsigned int frames = (unsigned int)state.range(0);
+        const unsigned int channels = (unsigned int)state.range(1);
+        if (!processor.Initialize(SampleRate, channels))
+        {
+            state.SkipWithError("processor not built in");
+            return;
+        }
+
+        BufferArena arena;
+        processor.SetCallFrameCount(frames);
+        processor.ReserveBuffers(arena, frames);
+        arena.Allocate();
+
+        const unsigned int sourceFrames = SampleRate / frames * frames;
+        std::vector<float> source = MakeNoisySpeech(sourceFrames, channels, SampleRate);
+        std::vector<float> block(frames * channels);
+        unsigned int position = 0;
+        for (auto _ : state)
+        {
+            std::copy(source.begin() + position * channels, source.begin() + (position + frames) * channels, block.begin());
+            processor.Process(block.data(), frames, channels);
+            benchmark::ClobberMemory();
+            position = (position + frames) % sourceFrames;
+        }
+
+        state.counters["frames/s"] = benchmark::Counter((double)state.iterations() * frames, benchmark::Counter::kIsRate);
+        state.counters["latency_ms"] = processor.GetLatencyFrames() * 1000.0 / SampleRate;
+    }
+
+    // Args: callback frames, channels
+    void BM_RNNoiseProcess(benchmark::State& state)
+    {
+        RNNoiseProcessor processor;
+        RunProcessor(state, processor);
+    }
+
+    // Args: callback frames, channels
+    void BM_SpeexProcess(benchmark::State& state)
+    {
+        SpeexProcessor processor;
+        RunProcessor(state, processor);
+    }
+
+    void ProcessorArguments(benchmark::internal::Benchmark* benchmark)
+    {
+        benchmark->ArgNames({ "frames", "ch" });
+        for (int channels : { 1, 2, 6 })
+        {
+            for (int frames : { 64, 128, 256, 480, 512, 1024, 2048 })
+                benchmark->Args({ frames, channels });
+        }
+    }
+
+    // Args: noise reduction type, device rate. 480-frame stereo packets through NoiseSuppress;
+    // against BM_*Process at 480 frames this is the wrapper's cost, at 44.1 kHz the bridge's.
+    void BM_NoiseSuppress(benchmark::State& state)
+    {
+        const NoiseReductionType type = (NoiseReductionType)state.range(0);
+        const unsigned int rate = (unsigned int)state.range(1);
+        const unsigned int channels = 2;
+        const unsigned int frames = rate * NoiseSuppress::FrameMs / 1000;
+
+        NoiseSuppress noiseSuppress;
+        if (!noiseSuppress.Initialize(NoiseReductionConfig(type), rate, channels))
+        {
+            state.SkipWithError("processor not built in");
+            return;
+        }
+
+        BufferArena arena;
+        noiseSuppress.SetCallFrameCount(frames);
+        noiseSuppress.ReserveBuffers(arena, frames);
+        arena.Allocate();
+
+        std::vector<float> source = MakeNoisySpeech(frames, channels, rate);
+        std::vector<float> block(source.size());
+        for (auto _ : state)
+        {
+            std::copy(source.begin(), source.end(), block.begin());
+            noiseSuppress.Process(block.data(), frames, channels);
+            benchmark::ClobberMemory();
+        }
+
+        state.counters["frames/s"] = benchmark::Counter((double)state.iterations() * frames, benchmark::Counter::kIsRate);
+        state.SetLabel(type == NoiseReductionType::Off ? "off" : noiseSuppress.IsResampling() ? "bridged" : "direct");
+    }
+
+    BENCHMARK(BM_RNNoiseProcess)->Apply(ProcessorArguments);
+    BENCHMARK(BM_SpeexProcess)->Apply(ProcessorArguments);
+    BENCHMARK(BM_NoiseSuppress)->ArgNames({ "type", "rate" })
+        ->Args({ (int)NoiseReductionType::Off, 48000 })
+        ->Args({ (int)NoiseReductionType::RNNoise, 48000 })
+        ->Args({ (int)NoiseReductionType::RNNoise, 44100 })
+        ->Args({ (int)NoiseReductionType::Speex, 48000 })
+        ->Args({ (int)NoiseReductionType::Speex, 44100 });
+}
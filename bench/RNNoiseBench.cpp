@@ -0,0 +1,65 @@
+// RNNoise network cost in 10 ms frames per second, labelled with the kernels RNNoise dispatched to.
+// To compare instruction sets, build with -DAUDIOROUTER_RNNOISE_X86_RTCD=ON and
+// -DAUDIOROUTER_RNNOISE_MAX_ISA=C, SSE4_1 and AVX2.
+#include "RNNoiseProcessor.h"
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#ifdef HAVE_RNNOISE
+#include "rnnoise.h"
+#endif
+
+namespace
+{
+#ifdef HAVE_RNNOISE
+    const unsigned int FrameSize = 480;
+
+    std::string GetKernelLabel()
+    {
+        std::wstring name = RNNoiseProcessor::GetKernelName();
+        return std::string(name.begin(), name.end());
+    }
+
+    // Speech-band tone over white noise at 16-bit scale, which is what rnnoise_process_frame expects
+    std::vector<float> MakeNoisySpeech(unsigned int frames)
+    {
+        std::vector<float> signal(frames);
+        unsigned int seed = 1;
+        for (unsigned int i = 0; i < frames; i++)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            float noise = ((seed >> 9) / 8388608.0f - 1.0f) * 1000.0f;
+            signal[i] = 8000.0f * std::sin(2.0f * 3.14159265f * 220.0f * i / 48000.0f) + noise;
+        }
+        return signal;
+    }
+#endif
+
+    void BM_RNNoiseFrame(benchmark::State& state)
+    {
+#ifdef HAVE_RNNOISE
+        DenoiseState* denoiser = rnnoise_create(nullptr);
+        const unsigned int frames = 100;
+        std::vector<float> input = MakeNoisySpeech(frames * FrameSize);
+        float output[FrameSize];
+
+        unsigned int frame = 0;
+        for (auto _ : state)
+        {
+            benchmark::DoNotOptimize(rnnoise_process_frame(denoiser, output, input.data() + frame * FrameSize));
+            benchmark::ClobberMemory();
+            frame = (frame + 1) % frames;
+        }
+        rnnoise_destroy(denoiser);
+
+        state.SetLabel(GetKernelLabel());
+        state.counters["frames/s"] = benchmark::Counter((double)state.iterations(), benchmark::Counter::kIsRate);
+#else
+        state.SkipWithError("RNNoise not built in");
+#endif
+    }
+
+    BENCHMARK(BM_RNNoiseFrame);
+}
@@ -0,0 +1,115 @@
+// Resampler throughput per quality tier, in frames per second of input.
+#include "Resampler.h"
+#include "ResamplerKernels.h"
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace
+{
+    const unsigned int PacketFrames = 480;
+
+    // Names are ASCII, so a plain narrowing copy is enough for benchmark labels
+    std::string Narrow(const wchar_t* text)
+    {
+        std::string result;
+        for (; *text; text++)
+            result += (char)*text;
+        return result;
+    }
+
+    std::vector<float> MakeSignal(unsigned int frames, unsigned int channels, unsigned int rate)
+    {
+        std::vector<float> signal(frames * channels);
+        for (unsigned int i = 0; i < frames; i++)
+        {
+            for (unsigned int ch = 0; ch < channels; ch++)
+            {
+                signal[i * channels + ch] = 0.5f * (float)std::sin(2.0 * 3.14159265358979 * 997.0 * i / rate + ch);
+            }
+        }
+        return signal;
+    }
+
+    // Args: quality, input rate, output rate, channels, drift ppm (0 = fixed ratio)
+    void BM_Resampler(benchmark::State& state)
+    {
+        const ResamplerQuality quality = (ResamplerQuality)state.range(0);
+        const unsigned int inputRate = (unsigned int)state.range(1);
+        const unsigned int outputRate = (unsigned int)state.range(2);
+        const unsigned int channels = (unsigned int)state.range(3);
+        const double ppm = (double)state.range(4);
+
+        Resampler resampler;
+        resampler.Configure(inputRate, outputRate, channels, true, quality);
+        resampler.SetRatioAdjustment(ppm);
+
+        std::vector<float> input = MakeSignal(PacketFrames, channels, inputRate);
+        std::vector<float> output(resampler.GetMaxOutputFrames(PacketFrames) * channels);
+
+        for (auto _ : state)
+        {
+            unsigned int produced = resampler.Process(input.data(), PacketFrames, output.data());
+            benchmark::DoNotOptimize(produced);
+            benchmark::ClobberMemory();
+        }
+
+        state.counters["frames/s"] = benchmark::Counter((double)state.iterations() * PacketFrames, benchmark::Counter::kIsRate);
+        state.SetLabel(Narrow(Resampler::GetQualityName(resampler.GetQuality())));
+    }
+
+    void ResamplerArguments(benchmark::internal::Benchmark* benchmark)
+    {
+        benchmark->ArgNames({ "quality", "in", "out", "ch", "ppm" });
+        for (int quality = (int)ResamplerQuality::Linear; quality <= (int)ResamplerQuality::Speex; quality++)
+        {
+            benchmark->Args({ quality, 44100, 48000, 2, 0 });    // Exact rational phases
+            benchmark->Args({ quality, 44100, 48000, 2, 25 });   // Interpolated phases (drift trimmed)
+            benchmark->Args({ quality, 48000, 48000, 2, 25 });   // Drift compensation only
+            benchmark->Args({ quality, 48000, 16000, 1, 0 });    // Downsampling (stretched filter)
+        }
+    }
+
+    BENCHMARK(BM_Resampler)->Apply(ResamplerArguments);
+
+    // Raw dot product kernels, per instruction set. Args: taps
+    template <ResamplerKernels::DotProductFn Kernel>
+    void BM_DotProduct(benchmark::State& state)
+    {
+        const unsigned int taps = (unsigned int)state.range(0);
+        std::vector<float> samples = MakeSignal(taps + 8, 1, 48000);
+        std::vector<float> coefficients(taps + 8);
+        float* aligned = coefficients.data();
+        while (((uintptr_t)aligned & 31) != 0)
+            aligned++;
+        for (unsigned int k = 0; k < taps; k++)
+            aligned[k] = 1.0f / (k + 1);
+
+        for (auto _ : state)
+        {
+            benchmark::DoNotOptimize(Kernel(samples.data() + 1, aligned, taps));
+        }
+        state.counters["taps/s"] = benchmark::Counter((double)state.iterations() * taps, benchmark::Counter::kIsRate);
+    }
+
+    BENCHMARK_TEMPLATE(BM_DotProduct, ResamplerKernels::DotProductScalar)->Arg(16)->Arg(32)->Arg(64);
+#ifdef AUDIOROUTER_X86
+    BENCHMARK_TEMPLATE(BM_DotProduct, ResamplerKernels::DotProductSse)->Arg(16)->Arg(32)->Arg(64);
+#endif
+#ifdef AUDIOROUTER_HAVE_AVX2
+    void BM_DotProductAvx2(benchmark::State& state)
+    {
+        if (!GetCpuFeatures().hasAvx2 || !GetCpuFeatures().hasFma)
+        {
+            state.SkipWithError("AVX2/FMA not supported on this CPU");
+            return;
+        }
+        BM_DotProduct<ResamplerKernels::DotProductAvx2>(state);
+    }
+    BENCHMARK(BM_DotProductAvx2)->Arg(16)->Arg(32)->Arg(64);
+#endif
+}
+
+BENCHMARK_MAIN();
@@ -0,0 +1,100 @@
+// Sample format conversion throughput per kernel, in samples per second.
+#include "SampleConvertKernels.h"
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    // One 10 ms stereo packet at 48 kHz
+    const size_t PacketSamples = 960;
+
+    std::vector<float> MakeFloatSignal()
+    {
+        std::vector<float> signal(PacketSamples);
+        for (size_t i = 0; i < PacketSamples; i++)
+        {
+            // Slightly over full scale so the saturating path is exercised too
+            signal[i] = 1.1f * (float)std::sin(2.0 * 3.14159265358979 * 997.0 * i / 48000.0);
+        }
+        return signal;
+    }
+
+    bool Supported(benchmark::State& state, bool needsAvx2)
+    {
+        if (needsAvx2 && !GetCpuFeatures().hasAvx2)
+        {
+            state.SkipWithError("AVX2 not supported on this CPU");
+            return false;
+        }
+        return true;
+    }
+
+    // Device format -> float. BytesPerSample sizes the (arbitrary) source data.
+    template <SampleConvertKernels::ToFloatFn Kernel, int BytesPerSample, bool NeedsAvx2>
+    void BM_ConvertToFloat(benchmark::State& state)
+    {
+        if (!Supported(state, NeedsAvx2))
+            return;
+
+        std::vector<unsigned char> input(PacketSamples * BytesPerSample);
+        for (size_t i = 0; i < input.size(); i++)
+            input[i] = (unsigned char)(i * 97 + 13);
+        std::vector<float> output(PacketSamples);
+
+        for (auto _ : state)
+        {
+            Kernel(input.data(), output.data(), PacketSamples);
+            benchmark::ClobberMemory();
+        }
+        state.counters["samples/s"] = benchmark::Counter((double)state.iterations() * PacketSamples, benchmark::Counter::kIsRate);
+    }
+
+    // Float -> device format. Arg: 1 = TPDF dither
+    template <SampleConvertKernels::FromFloatFn Kernel, int BytesPerSample, bool NeedsAvx2>
+    void BM_ConvertFromFloat(benchmark::State& state)
+    {
+        if (!Supported(state, NeedsAvx2))
+            return;
+
+        std::vector<float> input = MakeFloatSignal();
+        std::vector<unsigned char> output(PacketSamples * BytesPerSample);
+        SampleConvertKernels::DitherState dither;
+        SampleConvertKernels::InitializeDither(dither, 1);
+        SampleConvertKernels::DitherState* ditherState = state.range(0) ? &dither : nullptr;
+
+        for (auto _ : state)
+        {
+            Kernel(input.data(), output.data(), PacketSamples, ditherState);
+            benchmark::ClobberMemory();
+        }
+        state.counters["samples/s"] = benchmark::Counter((double)state.iterations() * PacketSamples, benchmark::Counter::kIsRate);
+    }
+
+    using namespace SampleConvertKernels;
+
+    BENCHMARK_TEMPLATE(BM_ConvertToFloat, Pcm16ToFloatScalar, 2, false);
+    BENCHMARK_TEMPLATE(BM_ConvertToFloat, Pcm24ToFloatScalar, 3, false);
+    BENCHMARK_TEMPLATE(BM_ConvertToFloat, Pcm32ToFloatScalar, 4, false);
+    BENCHMARK_TEMPLATE(BM_ConvertFromFloat, FloatToPcm16Scalar, 2, false)->Arg(0)->Arg(1);
+    BENCHMARK_TEMPLATE(BM_ConvertFromFloat, FloatToPcm24Scalar, 3, false)->Arg(0)->Arg(1);
+    BENCHMARK_TEMPLATE(BM_ConvertFromFloat, FloatToPcm32Scalar, 4, false)->Arg(0);
+
+#ifdef AUDIOROUTER_X86
+    BENCHMARK_TEMPLATE(BM_ConvertToFloat, Pcm16ToFloatSse2, 2, false);
+    BENCHMARK_TEMPLATE(BM_ConvertToFloat, Pcm24ToFloatSse2, 3, false);
+    BENCHMARK_TEMPLATE(BM_ConvertToFloat, Pcm32ToFloatSse2, 4, false);
+    BENCHMARK_TEMPLATE(BM_ConvertFromFloat, FloatToPcm16Sse2, 2, false)->Arg(0)->Arg(1);
+    BENCHMARK_TEMPLATE(BM_ConvertFromFloat, FloatToPcm24Sse2, 3, false)->Arg(0)->Arg(1);
+    BENCHMARK_TEMPLATE(BM_ConvertFromFloat, FloatToPcm32Sse2, 4, false)->Arg(0);
+#endif
+
+#ifdef AUDIOROUTER_HAVE_AVX2
+    BENCHMARK_TEMPLATE(BM_ConvertToFloat, Pcm16ToFloatAvx2, 2, true);
+    BENCHMARK_TEMPLATE(BM_ConvertToFloat, Pcm24ToFloatAvx2, 3, true);
+    BENCHMARK_TEMPLATE(BM_ConvertToFloat, Pcm32ToFloatAvx2, 4, true);
+    BENCHMARK_TEMPLATE(BM_ConvertFromFloat, FloatToPcm16Avx2, 2, true)->Arg(0)->Arg(1);
+    BENCHMARK_TEMPLATE(BM_ConvertFromFloat, FloatToPcm24Avx2, 3, true)->Arg(0)->Arg(1);
+    BENCHMARK_TEMPLATE(BM_ConvertFromFloat, FloatToPcm32Avx2, 4, true)->Arg(0);
+#endif
+}
@@ -0,0 +1,103 @@
+// WSOLA time stretcher cost per playback speed, in frames per second of input.
+#include "TimeStretcher.h"
+#include "TimeStretchKernels.h"
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    const unsigned int PacketFrames = 480;
+    const unsigned int SampleRate = 48000;
+
+    // Voiced-speech stand-in: harmonics of a slowly gliding ~140 Hz pitch with a syllable-rate
+    // envelope, so the similarity search has real pitch periods to find. A few seconds long and
+    // played in a loop.
+    std::vector<float> MakeVoice(unsigned int frames, unsigned int channels)
+    {
+        const double pi = 3.14159265358979;
+        std::vector<float> voice(frames * channels);
+        double phase = 0.0;
+        for (unsigned int i = 0; i < frames; i++)
+        {
+            double t = (double)i / SampleRate;
+            phase += 2.0 * pi * (140.0 + 20.0 * std::sin(2.0 * pi * 0.7 * t)) / SampleRate;
+            double sample = 0.0;
+            for (unsigned int harmonic = 1; harmonic <= 12; harmonic++)
+                sample += std::sin(harmonic * phase) / harmonic;
+            sample *= 0.2 * (0.6 + 0.4 * std::sin(2.0 * pi * 4.0 * t));
+            for (unsigned int ch = 0; ch < channels; ch++)
+                voice[i * channels + ch] = (float)sample;
+        }
+        return voice;
+    }
+
+    // Args: speed in percent, channels
+    void BM_TimeStretch(benchmark::State& state)
+    {
+        const double speed = state.range(0) / 100.0;
+        const unsigned int channels = (unsigned int)state.range(1);
+
+        TimeStretcher stretcher;
+        BufferArena arena;
+        stretcher.Configure(SampleRate, channels);
+        stretcher.ReserveBuffers(arena, PacketFrames);
+        arena.Allocate();
+        stretcher.SetSpeed(speed);
+
+        const unsigned int packets = 4 * SampleRate / PacketFrames;
+        std::vector<float> voice = MakeVoice(packets * PacketFrames, channels);
+        std::vector<float> output(stretcher.GetMaxOutputFrames(PacketFrames) * channels);
+
+        unsigned int packet = 0;
+        for (auto _ : state)
+        {
+            unsigned int produced = stretcher.Process(voice.data() + (size_t)packet * PacketFrames * channels, PacketFrames, output.data());
+            benchmark::DoNotOptimize(produced);
+            benchmark::ClobberMemory();
+            packet = (packet + 1) % packets;
+        }
+
+        state.counters["frames/s"] = benchmark::Counter((double)state.iterations() * PacketFrames, benchmark::Counter::kIsRate);
+    }
+
+    BENCHMARK(BM_TimeStretch)
+        ->ArgNames({ "speed%", "ch" })
+        ->Args({ 100, 1 })      // Steady state: copies only
+        ->Args({ 105, 1 })      // Catching up
+        ->Args({ 96, 1 })       // Refilling
+        ->Args({ 105, 2 });
+
+    // Raw similarity kernels, per instruction set. Args: samples correlated (a 5 ms hop at 48 kHz, mono and stereo)
+    template <TimeStretchKernels::CorrelateFn Kernel>
+    void BM_Correlate(benchmark::State& state)
+    {
+        const unsigned int count = (unsigned int)state.range(0);
+        std::vector<float> signal = MakeVoice(2 * count, 1);
+
+        for (auto _ : state)
+        {
+            float energy = 0.0f;
+            benchmark::DoNotOptimize(Kernel(signal.data(), signal.data() + count / 3 + 1, count, &energy));
+            benchmark::DoNotOptimize(energy);
+        }
+        state.counters["samples/s"] = benchmark::Counter((double)state.iterations() * count, benchmark::Counter::kIsRate);
+    }
+
+    BENCHMARK_TEMPLATE(BM_Correlate, TimeStretchKernels::CorrelateScalar)->Arg(240)->Arg(480);
+#ifdef AUDIOROUTER_X86
+    BENCHMARK_TEMPLATE(BM_Correlate, TimeStretchKernels::CorrelateSse)->Arg(240)->Arg(480);
+#endif
+#ifdef AUDIOROUTER_HAVE_AVX2
+    void BM_CorrelateAvx2(benchmark::State& state)
+    {
+        if (!GetCpuFeatures().hasAvx2 || !GetCpuFeatures().hasFma)
+        {
+            state.SkipWithError("AVX2/FMA not supported on this CPU");
+            return;
+        }
+        BM_Correlate<TimeStretchKernels::CorrelateAvx2>(state);
+    }
+    BENCHMARK(BM_CorrelateAvx2)->Arg(240)->Arg(480);
+#endif
+}
@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+"""Compare two audiorouter_bench JSON results and flag regressions.
+
+    audiorouter_bench --benchmark_out=current.json --benchmark_out_format=json
+    compare_bench.py baseline.json current.json [--threshold 10]
+
+Benchmarks are matched by name. With --benchmark_repetitions the median of the
+repetitions is compared, otherwise the single run. A benchmark regresses when its
+time per iteration grew by more than the threshold (percent). Skipped benchmarks
+and ones present on only one side are listed but never fail the comparison.
+Exits with 1 when anything regressed, 0 otherwise.
+"""
+
+import argparse
+import json
+import statistics
+import sys
+
+
+def load_times(path, field):
+    """Time per iteration in nanoseconds, by benchmark name; None for skipped runs."""
+    with open(path) as f:
+        data = json.load(f)
+
+    scale = {"ns": 1.0, "us": 1e3, "ms": 1e6, "s": 1e9}
+    runs = {}
+    for entry in data.get("benchmarks", []):
+        # Aggregates (mean, median, stddev) are recomputed from the repetitions
+        if entry.get("run_type") == "aggregate":
+            continue
+        name = entry.get("run_name", entry["name"])
+        if entry.get("error_occurred"):
+            runs.setdefault(name, None)
+            continue
+        time = entry[field] * scale[entry.get("time_unit", "ns")]
+        if runs.get(name) is None:
+            runs[name] = []
+        runs[name].append(time)
+
+    return {name: (statistics.median(times) if times else None) for name, times in runs.items()}
+
+
+def format_time(ns):
+    for unit, scale in (("s", 1e9), ("ms", 1e6), ("us", 1e3)):
+        if ns >= scale:
+            return "%.3g %s" % (ns / scale, unit)
+    return "%.3g ns" % ns
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Flag benchmark regressions against a stored baseline.")
+    parser.add_argument("baseline", help="JSON output of the reference run")
+    parser.add_argument("current", help="JSON output of the run to check")
+    parser.add_argument("--threshold", type=float, default=10.0,
+                        help="slowdown in percent that counts as a regression (default 10)")
+    parser.add_argument("--cpu-time", action="store_true",
+                        help="compare CPU time instead of real time")
+    args = parser.parse_args()
+
+    field = "cpu_time" if args.cpu_time else "real_time"
+    baseline = load_times(args.baseline, field)
+    current = load_times(args.current, field)
+
+    regressions = 0
+    width = max((len(name) for name in current), default=0)
+    for name in current:
+        old = baseline.get(name)
+        new = current[name]
+        if new is None or old is None:
+            status = "skipped" if new is None or name in baseline else "new"
+            print("%-*s  %s" % (width, name, status))
+            continue
+
+        change = (new - old) / old * 100.0 if old > 0 else 0.0
+        flag = ""
+        if change > args.threshold:
+            flag = "  REGRESSION"
+            regressions += 1
+        elif change < -args.threshold:
+            flag = "  faster"
+        print("%-*s  %10s -> %10s  %+7.1f%%%s" % (width, name, format_time(old), format_time(new), change, flag))
+
+    for name in baseline:
+        if name not in current:
+            print("%-*s  missing" % (width, name))
+
+    if regressions:
+        print("\n%d benchmark(s) slower than the baseline by more than %g%%" % (regressions, args.threshold))
+        return 1
+    print("\nNo regressions beyond %g%%" % args.threshold)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,42 @@
+/* speex_preprocess_float.c - Float-in/float-out build of the SpeexDSP preprocessor
+ *
+ * With FLOATING_POINT the preprocessor works in float internally and only converts at its
+ * edges: 16-bit input is widened to float and the output rounded and clamped back to 16 bits.
+ * Compiling preprocess.c again with its sample type mapped to float and that final conversion
+ * removed gives the same algorithm without the round trip. Its public functions are renamed
+ * so both builds link into one library.
+ */
+
+#include "config.h"
+
+#ifndef FLOATING_POINT
+#error "The float preprocessor needs SpeexDSP built with FLOATING_POINT"
+#endif
+
+/* Pull in the shared headers before remapping the sample type, so their typedefs are untouched */
+#include "speexdsp_types.h"
+#include "arch.h"
+
+/* Output stays float: no rounding or clamping to 16 bits */
+#undef WORD2INT
+#define WORD2INT(x) (x)
+
+#define spx_int16_t float
+
+#define speex_preprocess_state_init speex_preprocess_float_state_init
+#define speex_preprocess_state_destroy speex_preprocess_float_state_destroy
+#define speex_preprocess_run speex_preprocess_float_run
+#define speex_preprocess speex_preprocess_float
+#define speex_preprocess_estimate_update speex_preprocess_float_estimate_update
+#define speex_preprocess_ctl speex_preprocess_float_ctl
+
+#include "preprocess.c"
+
+/* The remapping only holds if preprocess.c leaves it alone. Should it define its own WORD2INT
+ * (or undo the sample type), fail the build instead of quietly producing the 16-bit output:
+ * the float WORD2INT passes an out-of-range sample through as an integer constant expression,
+ * while any clamping or rounding version either changes the value or is not constant at all. */
+#if !defined(spx_int16_t) || !defined(WORD2INT)
+#error "preprocess.c undid the float sample remapping"
+#endif
+typedef char speex_preprocess_float_output_unclamped[(int)WORD2INT(40000.0f) == 40000 ? 1 : -1];
@@ -0,0 +1,31 @@
+/* speex_preprocess_float.h - Float-in/float-out SpeexDSP preprocessor
+ *
+ * The same preprocessor as speex_preprocess.h, built a second time from preprocess.c (see
+ * speex_preprocess_float.c) so that frames are passed as float instead of 16-bit integers.
+ * Samples are at 16-bit scale (-32768 to 32767) as the library expects, but output is neither
+ * rounded nor clamped. States from this API only work with its own functions.
+ */
+
+#ifndef SPEEX_PREPROCESS_FLOAT_H
+#define SPEEX_PREPROCESS_FLOAT_H
+
+#include <speex/speex_preprocess.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+SpeexPreprocessState *speex_preprocess_float_state_init(int frame_size, int sampling_rate);
+void speex_preprocess_float_state_destroy(SpeexPreprocessState *st);
+
+/* Preprocess a frame in place; returns the VAD decision like speex_preprocess_run() */
+int speex_preprocess_float_run(SpeexPreprocessState *st, float *x);
+
+/* Same requests as speex_preprocess_ctl() */
+int speex_preprocess_float_ctl(SpeexPreprocessState *st, int request, void *ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SPEEX_PREPROCESS_FLOAT_H */
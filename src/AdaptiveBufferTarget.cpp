@@ -0,0 +1,92 @@
+#include "AdaptiveBufferTarget.h"
+
+namespace
+{
+    // Each underrun raises the target by half, and by at least this much
+    const double GrowFactor = 1.5;
+    const double MinGrowSeconds = 0.002;
+
+    // Clean stream time before the target starts to decay, and how fast it then decays. At
+    // 0.1 ms per second the drift controller follows with about 100 ppm of ratio trim.
+    const double StableSeconds = 30.0;
+    const double ShrinkSecondsPerSecond = 0.0001;
+
+    // The floor after an underrun: a quarter above the level that ran dry, and at least this
+    // much, until this long after it
+    const double FloorMargin = 0.25;
+    const double MinFloorMarginSeconds = 0.002;
+    const double FloorHoldSeconds = 300.0;
+}
+
+AdaptiveBufferTarget::AdaptiveBufferTarget()
+    : m_sampleRate(48000)
+    , m_minFrames(0)
+    , m_maxFrames(0)
+{
+    Reset();
+}
+
+void AdaptiveBufferTarget::Configure(unsigned int sampleRate, unsigned int minFrames, unsigned int maxFrames)
+{
+    m_sampleRate = sampleRate > 0 ? sampleRate : 48000;
+    m_minFrames = minFrames;
+    m_maxFrames = maxFrames > minFrames ? maxFrames : minFrames;
+    Reset();
+}
+
+void AdaptiveBufferTarget::Reset()
+{
+    m_targetFrames = (double)m_minFrames;
+    m_stableSeconds = 0.0;
+    m_starvedFrames = 0.0;
+    m_floorFrames = 0.0;
+    m_isFloorKept = false;
+}
+
+double AdaptiveBufferTarget::GetFloor() const
+{
+    double floor = (m_isFloorKept || m_stableSeconds < FloorHoldSeconds) ? m_floorFrames : m_starvedFrames;
+    if (floor < m_minFrames)
+        floor = (double)m_minFrames;
+    return floor < m_maxFrames ? floor : (double)m_maxFrames;
+}
+
+bool AdaptiveBufferTarget::IsAtMax() const
+{
+    return m_starvedFrames > 0.0 && m_targetFrames >= m_maxFrames && m_stableSeconds < StableSeconds;
+}
+
+void AdaptiveBufferTarget::OnUnderrun()
+{
+    // Running dry again without having got past the last floor: that level is not enough
+    if (m_starvedFrames > 0.0 && m_targetFrames < m_floorFrames)
+        m_isFloorKept = true;
+
+    double margin = m_targetFrames * FloorMargin;
+    double minMargin = MinFloorMarginSeconds * m_sampleRate;
+    m_starvedFrames = m_targetFrames;
+    m_floorFrames = m_targetFrames + (margin > minMargin ? margin : minMargin);
+
+    double grown = m_targetFrames * GrowFactor;
+    double minGrown = m_targetFrames + MinGrowSeconds * m_sampleRate;
+    m_targetFrames = grown > minGrown ? grown : minGrown;
+    if (m_targetFrames > m_maxFrames)
+        m_targetFrames = (double)m_maxFrames;
+    m_stableSeconds = 0.0;
+}
+
+void AdaptiveBufferTarget::Update(unsigned int elapsedFrames)
+{
+    const double dt = (double)elapsedFrames / (double)m_sampleRate;
+    m_stableSeconds += dt;
+    if (m_stableSeconds < StableSeconds)
+        return;
+
+    const double floor = GetFloor();
+    if (m_targetFrames <= floor)
+        return;
+
+    m_targetFrames -= ShrinkSecondsPerSecond * dt * m_sampleRate;
+    if (m_targetFrames < floor)
+        m_targetFrames = floor;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+// Buffer level (frames between capture and the speaker) that the engine aims for, adapted to how
+// much scheduling jitter the machine actually shows.
+//
+// Starts at the lowest level that can work and grows quickly each time the render device runs
+// dry. After a long enough stretch without trouble it decays slowly back towards the minimum,
+// so latency settles at about the lowest level the system sustains. The decay is slow enough
+// for the drift controller to follow by trimming the resampling ratio inaudibly.
+//
+// The decay stops at a floor learned from the last underrun: the level that ran dry plus a
+// margin for some minutes, and never below that level itself afterwards. An underrun at about
+// that level again means it cannot be sustained, and the floor with its margin is kept.
+class AdaptiveBufferTarget
+{
+public:
+    AdaptiveBufferTarget();
+
+    // sampleRate: rate the level is measured at (output rate)
+    // minFrames/maxFrames: bounds of the target; it starts at minFrames
+    void Configure(unsigned int sampleRate, unsigned int minFrames, unsigned int maxFrames);
+
+    // Back to the minimum (start of a new stream)
+    void Reset();
+
+    // The render device ran dry: raise the target
+    void OnUnderrun();
+
+    // elapsedFrames (at sampleRate) of stream time passed
+    void Update(unsigned int elapsedFrames);
+
+    unsigned int GetTargetFrames() const { return (unsigned int)(m_targetFrames + 0.5); }
+
+    // Lowest level the target may decay to now
+    unsigned int GetFloorFrames() const { return (unsigned int)(GetFloor() + 0.5); }
+
+    // The target is as high as it goes and the render device still ran dry lately: the level is
+    // bounded by the queue limit and the underruns rather than held where it is aimed
+    bool IsAtMax() const;
+
+private:
+    double GetFloor() const;
+
+    unsigned int m_sampleRate;
+    unsigned int m_minFrames;
+    unsigned int m_maxFrames;
+
+    double m_targetFrames;
+    double m_stableSeconds;     // Stream time since the last underrun
+    double m_starvedFrames;     // Target when the render device last ran dry (0 = never)
+    double m_floorFrames;       // m_starvedFrames plus the margin
+    bool m_isFloorKept;         // The floor's margin no longer expires
+};
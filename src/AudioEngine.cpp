@@ -1,32 +1,66 @@
 #include "AudioEngine.h"
-#include <avrt.h>
-#include <mmreg.h>
-#include <ks.h>
-#include <ksmedia.h>
+#include "RealtimeCheck.h"
+#include "ThreadPriority.h"
 #include <sstream>
 #include <iomanip>
+#include <chrono>
+#include <cstring>
 
-#pragma comment(lib, "avrt.lib")
+namespace
+{
+    // How often the diagnostics thread collects records from the audio threads
+    const unsigned int DiagnosticsPollMs = 50;
+
+    // Glitches are reported at most this often; a trace is written this long after one so it
+    // also shows how the stream recovered, and at most MaxGlitchTraces times per stream
+    const long long GlitchReportIntervalNs = 1000000000LL;
+    const long long GlitchTraceDelayNs = 500000000LL;
+    const unsigned int MaxGlitchTraces = 10;
+
+    long long SteadyNowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Log files are plain ASCII; anything else is replaced
+    std::string ToLogText(const std::wstring& text)
+    {
+        std::string narrow(text.size(), '?');
+        for (size_t i = 0; i < text.size(); i++)
+        {
+            if (text[i] > 0 && text[i] < 0x80)
+                narrow[i] = (char)text[i];
+        }
+        return narrow;
+    }
+}
+
+#ifdef _WIN32
+#include "WasapiBackend.h"
+#endif
 
 AudioEngine::AudioEngine()
-    : m_pInputDevice(nullptr)
-    , m_pOutputDevice(nullptr)
-    , m_pInputClient(nullptr)
-    , m_pOutputClient(nullptr)
-    , m_pCaptureClient(nullptr)
-    , m_pRenderClient(nullptr)
-    , m_noiseSuppressor(nullptr)
-    , m_hThread(NULL)
-    , m_hStopEvent(NULL)
+    : m_noiseSuppressor(nullptr)
+    , m_noiseSuppressionRate(0)
+    , m_maxQueuedFrames(0)
+    , m_lastGlitchNs(0)
+    , m_glitchTraceDueNs(0)
+    , m_glitchTraceCount(0)
+    , m_renderDrainTime(0)
+    , m_driftPpm(0.0)
+    , m_bufferLevelMs(0.0)
+    , m_bufferTargetFrames(0)
+    , m_seenStarvations(0)
+    , m_renderStarved(false)
+    , m_catchUpEpisodeSeconds(0.0)
     , m_isRunning(false)
-    , m_pInputFormat(nullptr)
-    , m_pOutputFormat(nullptr)
-    , m_inputBufferFrameCount(0)
-    , m_outputBufferFrameCount(0)
-    , m_hInputEvent(NULL)
-    , m_hOutputEvent(NULL)
-    , m_inputIsFloatFormat(false)
-    , m_outputIsFloatFormat(false)
+    , m_stopDiagnostics(false)
+    , m_streamStartNs(0)
+    , m_queueOverflowing(false)
+    , m_overflowFrames(0)
+    , m_droppedFrames(0)
+    , m_diagnosticFile(nullptr)
 {
     m_noiseSuppressor = new NoiseSuppress();
 }
@@ -35,18 +69,23 @@ AudioEngine::~AudioEngine()
 {
     Stop();
     delete m_noiseSuppressor;
+    if (m_diagnosticFile)
+        std::fclose(m_diagnosticFile);
 }
 
+#ifdef _WIN32
 bool AudioEngine::Start(const std::wstring& inputDeviceId, const std::wstring& outputDeviceId, const NoiseReductionConfig& noiseConfig)
 {
     if (m_isRunning)
         return false;
 
-    m_noiseConfig = noiseConfig;
+    auto reportStatus = [this](const std::wstring& msg) { ReportStatus(msg); };
 
     // Initialize devices
     ReportStatus(L"Initializing input device...");
-    if (!InitializeDevice(inputDeviceId, true, &m_pInputDevice, &m_pInputClient))
+    std::unique_ptr<WasapiCaptureBackend> capture(new WasapiCaptureBackend());
+    capture->SetDiagnosticCallback(reportStatus);
+    if (!capture->Open(inputDeviceId, noiseConfig.isEnabled() ? NoiseSuppress::FrameMs : 0))
     {
         ReportStatus(L"ERROR: Failed to initialize input device");
         return false;
@@ -54,78 +93,82 @@ bool AudioEngine::Start(const std::wstring& inputDeviceId, const std::wstring& o
     ReportStatus(L"Input device initialized successfully");
 
     ReportStatus(L"Initializing output device...");
-    if (!InitializeDevice(outputDeviceId, false, &m_pOutputDevice, &m_pOutputClient))
+    std::unique_ptr<WasapiRenderBackend> render(new WasapiRenderBackend());
+    render->SetDiagnosticCallback(reportStatus);
+    if (!render->Open(outputDeviceId))
     {
         ReportStatus(L"ERROR: Failed to initialize output device");
-        Stop();
         return false;
     }
     ReportStatus(L"Output device initialized successfully");
 
-    // Get capture client
-    ReportStatus(L"Getting capture client...");
-    HRESULT hr = m_pInputClient->GetService(__uuidof(IAudioCaptureClient), (void**)&m_pCaptureClient);
-    if (FAILED(hr))
-    {
-        std::wostringstream msg;
-        msg << L"ERROR: Failed to get capture client (HRESULT: 0x" << std::hex << hr << L")";
-        ReportStatus(msg.str());
-        Stop();
+    return Start(std::move(capture), std::move(render), noiseConfig);
+}
+#endif
+
+bool AudioEngine::Start(std::unique_ptr<IAudioCaptureBackend> capture, std::unique_ptr<IAudioRenderBackend> render, const NoiseReductionConfig& noiseConfig)
+{
+    if (m_isRunning || !capture || !render)
         return false;
-    }
 
-    // Get render client
-    ReportStatus(L"Getting render client...");
-    hr = m_pOutputClient->GetService(__uuidof(IAudioRenderClient), (void**)&m_pRenderClient);
-    if (FAILED(hr))
+    m_noiseConfig = noiseConfig;
+    m_capture = std::move(capture);
+    m_render = std::move(render);
+
+    if (!m_options.diagnosticLogPath.empty())
     {
-        std::wostringstream msg;
-        msg << L"ERROR: Failed to get render client (HRESULT: 0x" << std::hex << hr << L")";
-        ReportStatus(msg.str());
-        Stop();
-        return false;
+        std::lock_guard<std::mutex> lock(m_statusMutex);
+        if (m_diagnosticFile)
+            std::fclose(m_diagnosticFile);
+        m_diagnosticFile = std::fopen(m_options.diagnosticLogPath.c_str(), "a");
     }
 
+    auto reportStatus = [this](const std::wstring& msg) { ReportStatus(msg); };
+    m_capture->SetDiagnosticCallback(reportStatus);
+    m_render->SetDiagnosticCallback(reportStatus);
+
+    const AudioFormat& inputFormat = m_capture->GetFormat();
+    const AudioFormat& outputFormat = m_render->GetFormat();
+
     // Report audio format diagnostics
     std::wostringstream formatInfo;
     formatInfo << L"Input Format: ";
-    formatInfo << (m_inputIsFloatFormat ? L"Float32" : L"PCM16");
-    formatInfo << L" | " << m_pInputFormat->nSamplesPerSec << L" Hz";
-    formatInfo << L" | " << m_pInputFormat->nChannels << L" ch";
-    formatInfo << L" | " << m_pInputFormat->wBitsPerSample << L" bit";
+    formatInfo << AudioFormat::getSampleFormatName(inputFormat.sampleFormat);
+    formatInfo << L" | " << inputFormat.sampleRate << L" Hz";
+    formatInfo << L" | " << inputFormat.channels << L" ch";
+    formatInfo << L" | " << inputFormat.getBytesPerSample() * 8 << L" bit";
     ReportStatus(formatInfo.str());
 
     std::wostringstream outputFormatInfo;
     outputFormatInfo << L"Output Format: ";
-    outputFormatInfo << (m_outputIsFloatFormat ? L"Float32" : L"PCM16");
-    outputFormatInfo << L" | " << m_pOutputFormat->nSamplesPerSec << L" Hz";
-    outputFormatInfo << L" | " << m_pOutputFormat->nChannels << L" ch";
-    outputFormatInfo << L" | " << m_pOutputFormat->wBitsPerSample << L" bit";
+    outputFormatInfo << AudioFormat::getSampleFormatName(outputFormat.sampleFormat);
+    outputFormatInfo << L" | " << outputFormat.sampleRate << L" Hz";
+    outputFormatInfo << L" | " << outputFormat.channels << L" ch";
+    outputFormatInfo << L" | " << outputFormat.getBytesPerSample() * 8 << L" bit";
     ReportStatus(outputFormatInfo.str());
 
     // Check for format mismatches that need conversion
-    if (m_pInputFormat->nSamplesPerSec != m_pOutputFormat->nSamplesPerSec)
+    if (inputFormat.sampleRate != outputFormat.sampleRate)
     {
         std::wostringstream warning;
-        warning << L"WARNING: Sample rate mismatch! Input=" << m_pInputFormat->nSamplesPerSec
-                << L"Hz, Output=" << m_pOutputFormat->nSamplesPerSec << L"Hz";
+        warning << L"WARNING: Sample rate mismatch! Input=" << inputFormat.sampleRate
+                << L"Hz, Output=" << outputFormat.sampleRate << L"Hz";
         ReportStatus(warning.str());
         ReportStatus(L"Sample rate conversion will be applied (may affect quality)");
     }
 
-    if (m_pInputFormat->nChannels != m_pOutputFormat->nChannels)
+    if (inputFormat.channels != outputFormat.channels)
     {
         std::wostringstream warning;
-        warning << L"WARNING: Channel count mismatch! Input=" << m_pInputFormat->nChannels
-                << L"ch, Output=" << m_pOutputFormat->nChannels << L"ch";
+        warning << L"WARNING: Channel count mismatch! Input=" << inputFormat.channels
+                << L"ch, Output=" << outputFormat.channels << L"ch";
         ReportStatus(warning.str());
     }
 
     // Initialize noise suppression
     // Set up diagnostic callback for NoiseSuppress
-    m_noiseSuppressor->SetDiagnosticCallback([this](const std::wstring& msg) {
-        ReportStatus(msg);
-    });
+    m_noiseSuppressor->SetDiagnosticCallback(reportStatus);
+    m_noiseSuppressor->SetDiagnosticLog(&m_diagnosticLog);
 
     if (m_noiseConfig.isEnabled())
     {
@@ -133,7 +176,7 @@ bool AudioEngine::Start(const std::wstring& inputDeviceId, const std::wstring& o
         msg << L"Initializing noise reduction: " << NoiseReductionConfig::getTypeName(m_noiseConfig.type);
         ReportStatus(msg.str());
 
-        if (!m_noiseSuppressor->Initialize(m_noiseConfig, m_pInputFormat->nSamplesPerSec, m_pInputFormat->nChannels))
+        if (!m_noiseSuppressor->Initialize(m_noiseConfig, inputFormat.sampleRate, inputFormat.channels))
         {
             std::wostringstream errMsg;
             errMsg << L"ERROR: Failed to initialize " << NoiseReductionConfig::getTypeName(m_noiseConfig.type)
@@ -141,34 +184,244 @@ bool AudioEngine::Start(const std::wstring& inputDeviceId, const std::wstring& o
             ReportStatus(errMsg.str());
             // Continue anyway - audio routing will still work
         }
+        else
+        {
+            // Capture packets arrive one device period at a time
+            m_noiseSuppressor->SetCallFrameCount(m_capture->GetPeriodFrameCount());
+        }
     }
     else
     {
         ReportStatus(L"Noise suppression disabled");
     }
 
-    // Create stop event
-    m_hStopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    // Set up the processing chain
+    m_pipeline.SetDiagnosticCallback(reportStatus);
+    m_pipeline.SetStats(&m_stats);
+    if (!m_pipeline.Configure(inputFormat, outputFormat, m_noiseConfig.isEnabled() ? m_noiseSuppressor : nullptr,
+                              m_options.driftCompensation, m_options.resamplerQuality, m_options.dither,
+                              BuildChannelMatrix(inputFormat.channels, outputFormat.channels), m_options.catchUpMs > 0))
+    {
+        ReportStatus(L"ERROR: Unsupported device format");
+        m_capture.reset();
+        m_render.reset();
+        return false;
+    }
+
+    // Carve every buffer the real-time path uses out of one block, sized for the largest packet
+    // the capture device can deliver, so processing never allocates
+    m_bufferArena.Clear();
+    m_pipeline.ReserveBuffers(m_bufferArena, m_capture->GetBufferFrameCount());
+    m_bufferArena.Reserve(m_captureStaging, (size_t)m_capture->GetBufferFrameCount() * inputFormat.getBlockAlign());
+    if (!m_bufferArena.Allocate())
+    {
+        ReportStatus(L"ERROR: Failed to allocate processing buffers");
+        m_capture.reset();
+        m_render.reset();
+        return false;
+    }
+    {
+        std::wostringstream msg;
+        msg << L"Processing buffers: " << (m_bufferArena.GetSize() + 1023) / 1024 << L" KB in "
+            << m_bufferArena.GetBufferCount() << L" buffers";
+        if (IsRealtimeAllocationCheckEnabled())
+            msg << L" (real-time allocation check enabled)";
+        ReportStatus(msg.str());
+    }
+
+    const SampleConverter& inputConverter = m_pipeline.GetInputConverter();
+    const SampleConverter& outputConverter = m_pipeline.GetOutputConverter();
+    {
+        std::wostringstream msg;
+        msg << L"Sample conversion: " << AudioFormat::getSampleFormatName(inputFormat.sampleFormat)
+            << L" (" << inputConverter.GetKernelName() << L") -> "
+            << AudioFormat::getSampleFormatName(outputFormat.sampleFormat)
+            << L" (" << outputConverter.GetKernelName() << (outputConverter.IsDithering() ? L", TPDF dither)" : L")");
+        ReportStatus(msg.str());
+    }
+
+    const ChannelMixer& channelMixer = m_pipeline.GetChannelMixer();
+    if (!channelMixer.IsPassthrough())
+    {
+        std::wostringstream msg;
+        msg << L"Channel mix: " << inputFormat.channels << L" -> " << outputFormat.channels
+            << L" (" << channelMixer.GetKernelName() << L" kernel)";
+        ReportStatus(msg.str());
+    }
+
+    const Resampler& resampler = m_pipeline.GetResampler();
+    if (!resampler.IsPassthrough())
+    {
+        std::wostringstream msg;
+        msg << L"Resampler: " << Resampler::GetQualityName(resampler.GetQuality())
+            << L" (" << std::fixed << std::setprecision(2)
+            << resampler.GetLatencyFrames() * 1000.0 / outputFormat.sampleRate << L" ms latency)";
+        ReportStatus(msg.str());
+    }
+
+    if (m_noiseConfig.isEnabled() && m_noiseSuppressor->IsInitialized())
+    {
+        std::wostringstream msg;
+        msg << NoiseReductionConfig::getTypeName(m_noiseConfig.type) << L" latency: " << std::fixed << std::setprecision(2)
+            << m_noiseSuppressor->GetLatencyFrames() * 1000.0 / inputFormat.sampleRate << L" ms";
+        unsigned int alignedFrames = m_noiseSuppressor->GetAlignedCallFrameCount();
+        unsigned int periodFrames = m_capture->GetPeriodFrameCount();
+        if (alignedFrames > 0 && periodFrames % alignedFrames != 0)
+        {
+            msg << L" (includes frame buffering: the " << periodFrames << L"-frame input period is not a multiple of "
+                << alignedFrames << L" frames)";
+        }
+        ReportStatus(msg.str());
+    }
+
+    if (m_pipeline.IsTimeStretching())
+    {
+        std::wostringstream msg;
+        msg << L"Latency catch-up: time stretching when the buffer is " << m_options.catchUpMs
+            << L" ms over its target or running low (" << std::fixed << std::setprecision(2)
+            << m_pipeline.GetTimeStretcher().GetLatencyFrames() * 1000.0 / outputFormat.sampleRate << L" ms latency)";
+        ReportStatus(msg.str());
+    }
+
+    if (CanRenderDirect())
+    {
+        ReportStatus(m_pipeline.IsRawCopy() ? L"Fast path: packets are copied unchanged to the output device"
+                                            : L"Fast path: packets are processed in place in the output buffer");
+    }
+    else if (!m_options.splitThreads && m_options.driftCompensation && inputFormat.sampleRate == outputFormat.sampleRate &&
+             channelMixer.IsPassthrough() && !m_pipeline.IsTimeStretching() &&
+             (outputFormat.isFloat() || (inputFormat == outputFormat && !m_noiseConfig.isEnabled())))
+    {
+        // Everything else would allow the fast path, but the ratio is trimmed by a few ppm once
+        // drift is measured, so the resampler runs even at equal rates
+        ReportStatus(L"Fast path off: drift compensation keeps the resampler running at equal rates "
+                     L"(turn drift compensation off to copy packets straight to the output device)");
+    }
+
+    // Size the capture->render queue from the configured buffering
+    m_maxQueuedFrames = (unsigned int)((unsigned long long)m_options.maxBufferMs * outputFormat.sampleRate / 1000);
+    if (m_maxQueuedFrames < m_render->GetPeriodFrameCount())
+        m_maxQueuedFrames = m_render->GetPeriodFrameCount();
+    m_ringBuffer.Reset(m_maxQueuedFrames, outputFormat.channels);
+
+    // Drift compensation holds the total buffered audio (queue + render buffer) at a steady level
+    unsigned int targetFrames = (unsigned int)((unsigned long long)m_options.targetBufferMs * outputFormat.sampleRate / 1000);
+    if (m_options.adaptiveBuffer)
+    {
+        // Start from the least that can work (a render period plus a capture packet) and let
+        // underruns push the target up towards the queue limit. It stays a render period plus a
+        // packet short of it, or the level cannot be held there without the queue dropping.
+        const unsigned int packetFrames =
+            (unsigned int)((unsigned long long)m_capture->GetPeriodFrameCount() * outputFormat.sampleRate / inputFormat.sampleRate);
+        if (targetFrames == 0)
+            targetFrames = m_render->GetPeriodFrameCount() + packetFrames;
+        unsigned int maxTargetFrames = targetFrames;
+        if (m_maxQueuedFrames > maxTargetFrames + m_render->GetPeriodFrameCount() + packetFrames)
+            maxTargetFrames = m_maxQueuedFrames - m_render->GetPeriodFrameCount() - packetFrames;
+        m_bufferTarget.Configure(outputFormat.sampleRate, targetFrames, maxTargetFrames);
+        targetFrames = m_bufferTarget.GetTargetFrames();
+        m_bufferTargetFrames = targetFrames;
+    }
+    else
+    {
+        m_bufferTargetFrames = 0;
+    }
+    m_driftController.Configure(outputFormat.sampleRate, targetFrames);
+    m_driftPpm = 0.0;
+    m_bufferLevelMs = 0.0;
+    m_seenStarvations = 0;
+    m_renderStarved = false;
+    m_catchUp.Configure(outputFormat.sampleRate,
+                        (unsigned int)((unsigned long long)m_options.catchUpMs * outputFormat.sampleRate / 1000));
+    m_catchUpEpisodeSeconds = 0.0;
+    if (m_options.driftCompensation)
+        ReportStatus(L"Clock drift compensation enabled");
+    if (m_options.adaptiveBuffer)
+    {
+        std::wostringstream msg;
+        msg << L"Adaptive buffering: target starts at " << std::fixed << std::setprecision(1)
+            << targetFrames * 1000.0 / outputFormat.sampleRate << L" ms";
+        ReportStatus(msg.str());
+    }
 
     // Pre-fill output buffer with silence to prevent initial underruns
-    UINT32 bufferFrameCount = 0;
-    m_pOutputClient->GetBufferSize(&bufferFrameCount);
-    BYTE* pRenderData = nullptr;
-    hr = m_pRenderClient->GetBuffer(bufferFrameCount, &pRenderData);
-    if (SUCCEEDED(hr))
+    unsigned int bufferFrameCount = m_render->GetBufferFrameCount();
+    unsigned int prefillFrames = bufferFrameCount;
+    if (CanRenderDirect())
+    {
+        // Leave room for one capture packet, or every packet would queue behind a full render
+        // buffer and the direct path would never be taken (keep at least a render period)
+        unsigned int packetFrames = m_capture->GetPeriodFrameCount();
+        if (bufferFrameCount >= packetFrames + m_render->GetPeriodFrameCount())
+            prefillFrames -= packetFrames;
+    }
+
+    m_renderPhase.Reset(m_render->GetPeriodFrameCount());
+    void* pRenderData = nullptr;
+    if (m_render->GetBuffer(prefillFrames, &pRenderData))
     {
         // Fill with silence
-        memset(pRenderData, 0, bufferFrameCount * m_pOutputFormat->nBlockAlign);
-        m_pRenderClient->ReleaseBuffer(bufferFrameCount, 0);
+        m_pipeline.WriteSilence(pRenderData, prefillFrames);
+        m_render->ReleaseBuffer(prefillFrames, 0);
+        PublishRenderLevel(0, prefillFrames);
+    }
+    else
+    {
+        prefillFrames = 0;
     }
 
+    m_latency = AudioEngineLatency();
+    m_latency.capturePeriodMs = m_capture->GetPeriodFrameCount() * 1000.0 / inputFormat.sampleRate;
+    m_latency.renderPeriodMs = m_render->GetPeriodFrameCount() * 1000.0 / outputFormat.sampleRate;
+    m_latency.prefillMs = prefillFrames * 1000.0 / outputFormat.sampleRate;
+    m_noiseSuppressionRate = 0;
+    if (m_noiseConfig.isEnabled() && m_noiseSuppressor->IsInitialized())
+    {
+        m_noiseSuppressionRate = inputFormat.sampleRate;
+        m_latency.noiseSuppressionMs = m_noiseSuppressor->GetLatencyFrames() * 1000.0 / inputFormat.sampleRate;
+    }
+    if (!resampler.IsPassthrough())
+        m_latency.resamplerMs = resampler.GetLatencyFrames() * 1000.0 / outputFormat.sampleRate;
+    if (m_pipeline.IsTimeStretching())
+        m_latency.timeStretchMs = m_pipeline.GetTimeStretcher().GetLatencyFrames() * 1000.0 / outputFormat.sampleRate;
+
     // Start audio clients
-    m_pInputClient->Start();
-    m_pOutputClient->Start();
+    if (!m_capture->Start() || !m_render->Start())
+    {
+        ReportStatus(L"ERROR: Failed to start audio devices");
+        m_capture->Stop();
+        m_render->Stop();
+        m_capture.reset();
+        m_render.reset();
+        return false;
+    }
 
-    // Create audio thread
+    // Records the audio threads log are reported from here on
+    m_streamStartNs = SteadyNowNs();
+    m_queueOverflowing = false;
+    m_overflowFrames = 0;
+    m_droppedFrames = 0;
+    m_stats.Reset();
+    m_stats.SetBufferTarget(m_bufferTargetFrames * 1000.0 / outputFormat.sampleRate);
+    m_flightRecorder.Reset();
+    m_lastGlitchNs = 0;
+    m_glitchTraceDueNs = 0;
+    m_glitchTraceCount = 0;
+    m_stopDiagnostics = false;
+    m_diagnosticsThread = std::thread(&AudioEngine::DiagnosticsThread, this);
+
+    // Create audio thread(s)
     m_isRunning = true;
-    m_hThread = CreateThread(NULL, 0, AudioThreadProc, this, 0, NULL);
+    if (m_options.splitThreads)
+    {
+        ReportStatus(L"Capture and render running on separate threads");
+        m_thread = std::thread(&AudioEngine::CaptureThread, this);
+        m_renderThread = std::thread(&AudioEngine::RenderThread, this);
+    }
+    else
+    {
+        m_thread = std::thread(&AudioEngine::AudioThread, this);
+    }
 
     return true;
 }
@@ -180,459 +433,679 @@ void AudioEngine::Stop()
 
     m_isRunning = false;
 
-    // Signal stop event
-    if (m_hStopEvent)
+    // Wake the audio thread(s) and wait for them
+    if (m_capture)
+        m_capture->Interrupt();
+    if (m_render)
+        m_render->Interrupt();
+    if (m_thread.joinable())
+        m_thread.join();
+    if (m_renderThread.joinable())
+        m_renderThread.join();
+
+    // Report whatever the audio threads logged last
+    StopDiagnosticsThread();
+    ReportStats();
+
+    // Stop and release devices
+    if (m_capture)
     {
-        SetEvent(m_hStopEvent);
-        WaitForSingleObject(m_hThread, INFINITE);
-        CloseHandle(m_hThread);
-        CloseHandle(m_hStopEvent);
-        m_hThread = NULL;
-        m_hStopEvent = NULL;
+        m_capture->Stop();
+        m_capture.reset();
     }
 
-    // Close event handles
-    if (m_hInputEvent)
+    if (m_render)
     {
-        CloseHandle(m_hInputEvent);
-        m_hInputEvent = NULL;
+        m_render->Stop();
+        m_render.reset();
     }
+}
 
-    if (m_hOutputEvent)
-    {
-        CloseHandle(m_hOutputEvent);
-        m_hOutputEvent = NULL;
-    }
+AudioEngineLatency AudioEngine::GetLatency() const
+{
+    AudioEngineLatency latency = m_latency;
+    if (m_noiseSuppressionRate > 0)
+        latency.noiseSuppressionMs = m_noiseSuppressor->GetLatencyFrames() * 1000.0 / m_noiseSuppressionRate;
+    return latency;
+}
 
-    // Stop audio clients
-    if (m_pInputClient)
+void AudioEngine::AudioThread()
+{
+    // Set thread priority
+    ScopedAudioThreadPriority priority;
+
+    while (m_isRunning)
     {
-        m_pInputClient->Stop();
-        m_pInputClient->Release();
-        m_pInputClient = nullptr;
+        // Wait for input data or stop request (event-driven, efficient)
+        BackendWaitResult waitResult = m_capture->WaitForEvent(1000);
+
+        if (waitResult == BackendWaitResult::Interrupted) // Stop requested
+            break;
+
+        if (waitResult != BackendWaitResult::Ready) // Not input event
+            continue;
+
+        ScopedRealtimeSection realtime;
+        CallbackRecord record = BeginCallback(CallbackThread::Audio);
+        ProcessCapturePackets(record);
+
+        // Hand the render device whatever it can take now instead of all-or-nothing per packet
+        ServiceRender(record);
+        EndCallback(record);
     }
+}
 
-    if (m_pOutputClient)
+void AudioEngine::CaptureThread()
+{
+    // Set thread priority
+    ScopedAudioThreadPriority priority;
+
+    while (m_isRunning)
     {
-        m_pOutputClient->Stop();
-        m_pOutputClient->Release();
-        m_pOutputClient = nullptr;
+        BackendWaitResult waitResult = m_capture->WaitForEvent(1000);
+
+        if (waitResult == BackendWaitResult::Interrupted) // Stop requested
+            break;
+
+        if (waitResult != BackendWaitResult::Ready)
+            continue;
+
+        ScopedRealtimeSection realtime;
+        CallbackRecord record = BeginCallback(CallbackThread::Capture);
+        ProcessCapturePackets(record);
+        EndCallback(record);
     }
+}
 
-    // Release clients
-    if (m_pCaptureClient)
+void AudioEngine::RenderThread()
+{
+    // Set thread priority
+    ScopedAudioThreadPriority priority;
+
+    while (m_isRunning)
     {
-        m_pCaptureClient->Release();
-        m_pCaptureClient = nullptr;
+        // The render event fires once per device period, when buffer space has been freed
+        BackendWaitResult waitResult = m_render->WaitForEvent(1000);
+
+        if (waitResult == BackendWaitResult::Interrupted) // Stop requested
+            break;
+
+        if (waitResult != BackendWaitResult::Ready)
+            continue;
+
+        // Fill exactly the space the device reports from whatever capture has queued
+        ScopedRealtimeSection realtime;
+        CallbackRecord record = BeginCallback(CallbackThread::Render);
+        ServiceRender(record);
+        EndCallback(record);
     }
+}
 
-    if (m_pRenderClient)
+void AudioEngine::ProcessCapturePackets(CallbackRecord& record)
+{
+    // Drain every packet the device holds: a thread that woke late would otherwise leave the
+    // backlog in the capture buffer as permanent extra latency. The first packet (usually the
+    // only one) is processed straight from the device buffer; any that follow are gathered into
+    // one block first, so the chain runs at most twice per wake-up however long the backlog.
+    const unsigned int blockAlign = m_capture->GetFormat().getBlockAlign();
+    const unsigned int stagingFrames = (unsigned int)(m_captureStaging.size() / blockAlign);
+    const unsigned int maxDrainFrames = 2 * m_capture->GetBufferFrameCount();
+    unsigned int stagedFrames = 0;
+    unsigned int processedFrames = 0;
+    unsigned long long droppedBefore = m_droppedFrames;
+
+    // Bounded so a device that keeps producing cannot hold the thread here forever
+    while (record.framesCaptured < maxDrainFrames)
     {
-        m_pRenderClient->Release();
-        m_pRenderClient = nullptr;
+        const void* pData = nullptr;
+        unsigned int numFramesAvailable = 0;
+        unsigned int flags = 0;
+        if (!m_capture->GetBuffer(&pData, &numFramesAvailable, &flags) || numFramesAvailable == 0)
+            break;
+
+        record.packetsCaptured++;
+        record.framesCaptured += numFramesAvailable;
+        if (flags & AudioBufferFlag_Discontinuity)
+        {
+            m_diagnosticLog.Push(DiagnosticCode::CaptureDiscontinuity, numFramesAvailable);
+            record.flags |= CallbackFlag_CaptureDiscontinuity;
+        }
+
+        // Silent packets still go through the pipeline (as null input, or zeros when staged)
+        // to keep timing intact
+        const bool silent = (flags & AudioBufferFlag_Silent) != 0;
+        if (record.packetsCaptured == 1)
+        {
+            processedFrames += ProcessCaptured(silent ? nullptr : pData, numFramesAvailable, record);
+        }
+        else
+        {
+            if (stagedFrames + numFramesAvailable > stagingFrames)
+            {
+                processedFrames += ProcessCaptured(m_captureStaging.data(), stagedFrames, record);
+                stagedFrames = 0;
+            }
+
+            unsigned char* pStage = m_captureStaging.data() + (size_t)stagedFrames * blockAlign;
+            if (silent)
+                std::memset(pStage, 0, (size_t)numFramesAvailable * blockAlign);
+            else
+                std::memcpy(pStage, pData, (size_t)numFramesAvailable * blockAlign);
+            stagedFrames += numFramesAvailable;
+        }
+        m_capture->ReleaseBuffer(numFramesAvailable);
+
+        // Asked only with no packet held, as in the documented WASAPI capture loop
+        unsigned int nextFrames = 0;
+        if (!m_capture->GetNextPacketSize(&nextFrames) || nextFrames == 0)
+            break;
     }
 
-    // Release devices
-    if (m_pInputDevice)
+    if (stagedFrames > 0)
+        processedFrames += ProcessCaptured(m_captureStaging.data(), stagedFrames, record);
+
+    if (record.packetsCaptured == 0)
     {
-        m_pInputDevice->Release();
-        m_pInputDevice = nullptr;
+        // No data available yet, continue waiting
+        return;
     }
+    m_stats.RecordCaptureWake(record.packetsCaptured);
 
-    if (m_pOutputDevice)
+    record.framesDropped = (uint32_t)(m_droppedFrames - droppedBefore);
+    if (record.framesDropped > 0)
+        record.flags |= CallbackFlag_FramesDropped;
+
+    UpdateDriftCompensation(processedFrames);
+}
+
+unsigned int AudioEngine::ProcessCaptured(const void* input, unsigned int frameCount, CallbackRecord& record)
+{
+    unsigned int processedFrames = 0;
+    if (!CanRenderDirect() || !RenderDirect(input, frameCount, &processedFrames, record))
     {
-        m_pOutputDevice->Release();
-        m_pOutputDevice = nullptr;
+        processedFrames = ProcessIntoQueue(input, frameCount);
     }
+    return processedFrames;
+}
+
+CallbackRecord AudioEngine::BeginCallback(CallbackThread thread) const
+{
+    CallbackRecord record = {};
+    record.thread = (uint32_t)thread;
+    record.wakeNs = ProcessingStats::Now();
+    return record;
+}
+
+void AudioEngine::EndCallback(CallbackRecord& record)
+{
+    record.endNs = ProcessingStats::Now();
+    int64_t busyNs = record.endNs - record.wakeNs;
+    m_stats.RecordStage(ProcessingStage::Callback, busyNs);
 
-    // Free wave formats
-    if (m_pInputFormat)
+    // DSP load: processing time against the audio one captured packet covers
+    if (record.framesCaptured > 0)
+        m_stats.RecordLoad(busyNs, record.framesCaptured * 1e9 / m_capture->GetFormat().sampleRate);
+    else
+        m_stats.AddBusyTime(busyNs);
+
+    // In split mode output conversion runs on the render thread and everything else on capture
+    for (unsigned int stage = 0; stage < CallbackRecord::StageCount; stage++)
     {
-        CoTaskMemFree(m_pInputFormat);
-        m_pInputFormat = nullptr;
+        bool renderStage = stage == (unsigned int)ProcessingStage::OutputConversion;
+        if (record.thread == (uint32_t)CallbackThread::Audio || renderStage == (record.thread == (uint32_t)CallbackThread::Render))
+            record.stageNs[stage] = (uint32_t)m_stats.TakeCallbackStageTime((ProcessingStage)stage);
     }
+    record.queuedFrames = (uint32_t)m_ringBuffer.GetReadAvailable();
+    m_flightRecorder.Record(record);
 
-    if (m_pOutputFormat)
+    if (record.flags != 0)
     {
-        CoTaskMemFree(m_pOutputFormat);
-        m_pOutputFormat = nullptr;
+        long long lastGlitchNs = m_lastGlitchNs.load(std::memory_order_relaxed);
+        if (record.wakeNs - lastGlitchNs >= GlitchReportIntervalNs &&
+            m_lastGlitchNs.compare_exchange_strong(lastGlitchNs, record.wakeNs, std::memory_order_relaxed))
+        {
+            double args[] = { (double)record.thread, (double)record.flags, (double)record.framesDropped };
+            m_diagnosticLog.Push(DiagnosticCode::Glitch, args, 3);
+        }
     }
 }
 
-bool AudioEngine::InitializeDevice(const std::wstring& deviceId, bool isInput, IMMDevice** ppDevice, IAudioClient** ppAudioClient)
+void AudioEngine::UpdateDriftCompensation(unsigned int frameCount)
 {
-    // Create device enumerator
-    IMMDeviceEnumerator* pEnumerator = nullptr;
-    HRESULT hr = CoCreateInstance(
-        __uuidof(MMDeviceEnumerator),
-        NULL,
-        CLSCTX_ALL,
-        __uuidof(IMMDeviceEnumerator),
-        (void**)&pEnumerator
-    );
+    const unsigned int sampleRate = m_render->GetFormat().sampleRate;
+
+    // The render level was published when render was last serviced; project it to now so the
+    // measurement does not depend on how the capture and render periods happen to line up
+    long long now = m_render->GetClockNs();
+    long long remainingNs = m_renderDrainTime.load(std::memory_order_relaxed) - now;
+    unsigned int renderFrames = remainingNs > 0 ? (unsigned int)(remainingNs * sampleRate / 1000000000LL) : 0;
 
-    if (FAILED(hr))
+    // Everything between this packet and the speaker: the queue plus what the render device holds
+    unsigned int bufferedFrames = (unsigned int)m_ringBuffer.GetReadAvailable() + renderFrames;
+
+    if (m_options.adaptiveBuffer)
+        UpdateBufferTarget(frameCount);
+
+    if (m_pipeline.IsTimeStretching())
+        UpdateCatchUp(bufferedFrames, frameCount);
+
+    if (m_options.driftCompensation)
     {
-        ReportStatus(L"ERROR: Failed to create device enumerator");
-        return false;
+        // Keep what moves the level other than clock drift out of the drift estimate: the time
+        // stretching, the queue dropping audio, and a target stuck at its cap, where the level
+        // is bounded by the queue rather than held by the loop
+        m_driftController.SetIntegralHeld(m_catchUp.IsActive() || m_queueOverflowing ||
+                                          (m_options.adaptiveBuffer && m_bufferTarget.IsAtMax()));
+        m_pipeline.SetRateAdjustment(m_driftController.Update(bufferedFrames, frameCount));
+        m_driftPpm.store(m_driftController.GetDriftPpm(), std::memory_order_relaxed);
+        m_bufferLevelMs.store(m_driftController.GetAverageFill() * 1000.0 / sampleRate, std::memory_order_relaxed);
+    }
+    else
+    {
+        m_bufferLevelMs.store(bufferedFrames * 1000.0 / sampleRate, std::memory_order_relaxed);
     }
+}
 
-    // Get device
-    if (deviceId == L"DEFAULT")
+void AudioEngine::UpdateBufferTarget(unsigned int frameCount)
+{
+    uint64_t starvations = m_stats.GetRenderStarvations();
+    if (starvations != m_seenStarvations)
     {
-        // Use system default device
-        hr = pEnumerator->GetDefaultAudioEndpoint(
-            isInput ? eCapture : eRender,
-            eConsole,
-            ppDevice
-        );
+        // However many underruns happened since the last packet, they are one episode
+        m_seenStarvations = starvations;
+        m_bufferTarget.OnUnderrun();
     }
     else
     {
-        // Use specific device ID
-        hr = pEnumerator->GetDevice(deviceId.c_str(), ppDevice);
+        m_bufferTarget.Update(frameCount);
     }
-    pEnumerator->Release();
 
-    if (FAILED(hr))
+    unsigned int targetFrames = m_bufferTarget.GetTargetFrames();
+    if (targetFrames == m_bufferTargetFrames.load(std::memory_order_relaxed))
+        return;
+
+    m_bufferTargetFrames.store(targetFrames, std::memory_order_relaxed);
+    m_driftController.SetTargetFill(targetFrames);
+    m_stats.SetBufferTarget(targetFrames * 1000.0 / m_render->GetFormat().sampleRate);
+}
+
+void AudioEngine::UpdateCatchUp(unsigned int bufferedFrames, unsigned int frameCount)
+{
+    // Catch up on the level drift compensation holds (the adaptive or configured target; the
+    // measured level once locked). Stays idle while that is not known yet.
+    const unsigned int sampleRate = m_render->GetFormat().sampleRate;
+    // Nor before drift compensation has settled: until then the level is still on its way to
+    // the target, and stretching would throw away audio the drift loop is about to even out.
+    const bool isSettled = !m_options.driftCompensation || m_driftController.IsLocked();
+    const double targetFrames = isSettled ? m_driftController.GetTargetFill() : 0.0;
+    const bool wasActive = m_catchUp.IsActive();
+    const double speed = m_catchUp.Update(bufferedFrames, targetFrames, frameCount);
+    m_pipeline.SetPlaybackSpeed(speed);
+
+    if (m_catchUp.IsActive())
     {
-        std::wostringstream msg;
-        msg << L"ERROR: Failed to get device (HRESULT: 0x" << std::hex << hr << L")";
-        ReportStatus(msg.str());
+        double seconds = (double)frameCount / sampleRate;
+        m_catchUpEpisodeSeconds += seconds;
+        m_stats.AddCatchUpTime(seconds);
+        if (!wasActive)
+        {
+            double args[] = { speed, m_catchUp.GetAverageFill() * 1000.0 / sampleRate, targetFrames * 1000.0 / sampleRate };
+            m_diagnosticLog.Push(DiagnosticCode::CatchUpStarted, args, 3);
+            m_stats.CountCatchUpEpisode();
+        }
+    }
+    else if (wasActive)
+    {
+        m_diagnosticLog.Push(DiagnosticCode::CatchUpEnded, m_catchUpEpisodeSeconds);
+        m_catchUpEpisodeSeconds = 0.0;
+    }
+}
+
+bool AudioEngine::IsRenderDry(unsigned int paddingFrames)
+{
+    // With no play position to tell, an empty buffer is taken as a dry one
+    if (paddingFrames > 0)
         return false;
+    uint64_t playedFrames = 0;
+    return !m_render->GetPlayedFrames(&playedFrames) || m_renderPhase.HasRunDry(playedFrames);
+}
+
+void AudioEngine::PublishRenderLevel(unsigned int paddingFrames, unsigned int writtenFrames)
+{
+    // A device that takes a period at a time only drops its padding at period boundaries, while
+    // its audio drains steadily. Left in, that step slides through the period as the capture and
+    // render periods beat (in single-thread mode the level is taken at capture events), which
+    // the drift controller would read as drift.
+    unsigned int levelFrames = paddingFrames + writtenFrames;
+    uint64_t playedFrames = 0;
+    if (m_render->GetPlayedFrames(&playedFrames))
+    {
+        unsigned int periodPlayed = m_renderPhase.Update(paddingFrames, levelFrames, playedFrames);
+        levelFrames -= periodPlayed < paddingFrames ? periodPlayed : paddingFrames;
     }
 
-    // Activate audio client
-    hr = (*ppDevice)->Activate(__uuidof(IAudioClient), CLSCTX_ALL, NULL, (void**)ppAudioClient);
-    if (FAILED(hr))
+    long long now = m_render->GetClockNs();
+    long long drainNs = (long long)levelFrames * 1000000000LL / m_render->GetFormat().sampleRate;
+    m_renderDrainTime.store(now + drainNs, std::memory_order_relaxed);
+}
+
+ChannelMatrix AudioEngine::BuildChannelMatrix(unsigned int inputChannels, unsigned int outputChannels)
+{
+    if (!m_options.channelMatrix.empty())
     {
+        if (m_options.channelMatrix.size() == (size_t)inputChannels * outputChannels)
+        {
+            ChannelMatrix matrix(inputChannels, outputChannels);
+            matrix.gains = m_options.channelMatrix;
+            return matrix;
+        }
+
         std::wostringstream msg;
-        msg << L"ERROR: Failed to activate audio client (HRESULT: 0x" << std::hex << hr << L")";
+        msg << L"WARNING: Channel matrix has " << m_options.channelMatrix.size() << L" gains, devices need "
+            << outputChannels << L" x " << inputChannels << L" - using the default mapping";
         ReportStatus(msg.str());
-        return false;
     }
 
-    // Get mix format - use whatever WASAPI provides
-    WAVEFORMATEX* pWaveFormat = nullptr;
-    hr = (*ppAudioClient)->GetMixFormat(&pWaveFormat);
-    if (FAILED(hr))
+    if (m_options.inputChannel >= 0)
     {
+        if ((unsigned int)m_options.inputChannel < inputChannels)
+        {
+            std::wostringstream msg;
+            msg << L"Using input channel " << m_options.inputChannel + 1 << L" of " << inputChannels;
+            ReportStatus(msg.str());
+            return ChannelMatrix::createPickInput(inputChannels, outputChannels, (unsigned int)m_options.inputChannel);
+        }
+
         std::wostringstream msg;
-        msg << L"ERROR: Failed to get mix format (HRESULT: 0x" << std::hex << hr << L")";
+        msg << L"WARNING: Input channel " << m_options.inputChannel + 1 << L" not available (device has "
+            << inputChannels << L") - using all channels";
         ReportStatus(msg.str());
+    }
+
+    return ChannelMatrix();
+}
+
+unsigned int AudioEngine::ProcessIntoQueue(const void* input, unsigned int frameCount)
+{
+    // Process straight into the ring when the whole worst-case output fits in one
+    // contiguous span and within the buffering limit (almost always)
+    const unsigned int maxFrames = m_pipeline.GetMaxOutputFrames(frameCount);
+    const float* pProcessed = nullptr;
+    SpscRingBuffer::Span first, second;
+    if (GetQueueRoom() >= maxFrames && m_ringBuffer.GetWriteSpans(maxFrames, &first, &second) == maxFrames &&
+        first.frames == maxFrames)
+    {
+        unsigned int processedFrames = m_pipeline.Process(input, frameCount, &pProcessed, first.data);
+        m_ringBuffer.CommitWrite(processedFrames);
+        TrackQueueOverflow(0);
+        return processedFrames;
+    }
+
+    // Queue nearly full or the write position about to wrap: stage, then copy what fits
+    unsigned int processedFrames = m_pipeline.Process(input, frameCount, &pProcessed);
+    QueueFrames(pProcessed, processedFrames);
+    return processedFrames;
+}
+
+bool AudioEngine::CanRenderDirect() const
+{
+    // Single-thread mode only (the render side is serviced from the same thread), and only for
+    // pipelines that produce the render format in place: an identical format with no
+    // processing (one copy), or float output with at most in-place processing
+    return !m_options.splitThreads &&
+           (m_pipeline.IsRawCopy() || (m_pipeline.IsFrameLayoutPreserved() && m_render->GetFormat().isFloat()));
+}
+
+bool AudioEngine::RenderDirect(const void* input, unsigned int frameCount, unsigned int* processedFrames, CallbackRecord& record)
+{
+    // Only valid while nothing is queued ahead of this packet
+    if (m_ringBuffer.GetReadAvailable() != 0)
+        return false;
+
+    unsigned int numFramesPadding = 0;
+    if (!m_render->GetCurrentPadding(&numFramesPadding) ||
+        m_render->GetBufferFrameCount() - numFramesPadding < frameCount)
+    {
         return false;
     }
 
-    // Store format for this specific device
-    WAVEFORMATEX** ppStoredFormat = isInput ? &m_pInputFormat : &m_pOutputFormat;
-    bool* pIsFloatFormat = isInput ? &m_inputIsFloatFormat : &m_outputIsFloatFormat;
+    // A device that ran dry is re-primed by ServiceRender(), through the queue
+    if (IsRenderDry(numFramesPadding))
+        return false;
+    record.renderPadding = numFramesPadding;
 
-    *ppStoredFormat = pWaveFormat;
+    void* pRenderData = nullptr;
+    if (!m_render->GetBuffer(frameCount, &pRenderData))
+        return false;
 
-    // Detect if format is float or PCM for this device
-    if (pWaveFormat->wFormatTag == WAVE_FORMAT_IEEE_FLOAT)
+    if (m_pipeline.IsRawCopy())
     {
-        *pIsFloatFormat = true;
+        m_pipeline.CopyRaw(input, pRenderData, frameCount);
     }
-    else if (pWaveFormat->wFormatTag == WAVE_FORMAT_PCM)
+    else
     {
-        *pIsFloatFormat = false;
+        const float* pProcessed = nullptr;
+        m_pipeline.Process(input, frameCount, &pProcessed, (float*)pRenderData);
     }
-    else if (pWaveFormat->wFormatTag == WAVE_FORMAT_EXTENSIBLE)
+    m_render->ReleaseBuffer(frameCount, 0);
+
+    PublishRenderLevel(numFramesPadding, frameCount);
+    record.framesRendered += frameCount;
+    *processedFrames = frameCount;
+    return true;
+}
+
+void AudioEngine::QueueFrames(const float* frames, unsigned int frameCount)
+{
+    // Frames beyond the buffering limit are dropped to keep latency bounded
+    unsigned int room = GetQueueRoom();
+    unsigned int written = frameCount < room ? frameCount : room;
+    m_ringBuffer.Write(frames, written);
+    TrackQueueOverflow(frameCount - written);
+}
+
+void AudioEngine::TrackQueueOverflow(unsigned int droppedFrames)
+{
+    if (droppedFrames > 0)
     {
-        // Check the SubFormat GUID for float vs PCM
-        WAVEFORMATEXTENSIBLE* pWaveFormatEx = (WAVEFORMATEXTENSIBLE*)pWaveFormat;
-        if (pWaveFormatEx->SubFormat == KSDATAFORMAT_SUBTYPE_IEEE_FLOAT)
-        {
-            *pIsFloatFormat = true;
-        }
-        else
+        if (!m_queueOverflowing)
         {
-            *pIsFloatFormat = false;
+            m_diagnosticLog.Push(DiagnosticCode::QueueOverflowStarted, (double)m_ringBuffer.GetReadAvailable());
+            m_queueOverflowing = true;
+            m_overflowFrames = 0;
         }
+        m_overflowFrames += droppedFrames;
+        m_droppedFrames += droppedFrames;
+        m_stats.AddDroppedFrames(droppedFrames);
     }
-    else
+    else if (m_queueOverflowing)
     {
-        *pIsFloatFormat = false; // Default to PCM
+        m_diagnosticLog.Push(DiagnosticCode::QueueOverflowEnded, (double)m_overflowFrames);
+        m_queueOverflowing = false;
     }
+}
+
+unsigned int AudioEngine::GetQueueRoom() const
+{
+    unsigned int queued = (unsigned int)m_ringBuffer.GetReadAvailable();
+    return queued < m_maxQueuedFrames ? m_maxQueuedFrames - queued : 0;
+}
 
-    // Create event for event-driven mode
-    HANDLE* pEvent = isInput ? &m_hInputEvent : &m_hOutputEvent;
-    *pEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
-    if (!*pEvent)
+void AudioEngine::ServiceRender(CallbackRecord& record)
+{
+    // Check how much space is available in output buffer
+    unsigned int numFramesPadding = 0;
+    if (!m_render->GetCurrentPadding(&numFramesPadding))
+        return;
+
+    // After a direct render this callback already saw the level the device was left at
+    const bool isDry = IsRenderDry(numFramesPadding);
+    if (record.framesRendered == 0)
     {
-        ReportStatus(L"ERROR: Failed to create event handle");
-        return false;
+        record.renderPadding = numFramesPadding;
+        if (isDry)
+            record.flags |= CallbackFlag_RenderStarved;
     }
 
-    // Initialize audio client with event-driven mode and smaller buffer (10ms for low latency)
-    REFERENCE_TIME hnsRequestedDuration = 100000; // 10ms for low latency
-    DWORD streamFlags = AUDCLNT_STREAMFLAGS_EVENTCALLBACK;
-
-    hr = (*ppAudioClient)->Initialize(
-        AUDCLNT_SHAREMODE_SHARED,
-        streamFlags,
-        hnsRequestedDuration,
-        0,
-        pWaveFormat,  // Use THIS device's native format
-        NULL
-    );
+    unsigned int numFramesAvailableInOutput = m_render->GetBufferFrameCount() - numFramesPadding;
+    unsigned int queuedFrames = (unsigned int)m_ringBuffer.GetReadAvailable();
+    unsigned int numFramesToWrite = queuedFrames < numFramesAvailableInOutput ? queuedFrames : numFramesAvailableInOutput;
 
-    if (FAILED(hr))
+    // A dry device has been playing silence. Count it (once until it is fed again) and put silence
+    // ahead of the queued audio up to the buffer target, so the next late packet does not starve it.
+    unsigned int silenceFrames = 0;
+    if (isDry)
     {
-        std::wostringstream msg;
-        msg << L"ERROR: Failed to initialize audio client (HRESULT: 0x" << std::hex << hr << L")";
-        ReportStatus(msg.str());
+        unsigned int targetFrames = m_bufferTargetFrames.load(std::memory_order_relaxed);
+        if (targetFrames > queuedFrames)
+        {
+            silenceFrames = targetFrames - queuedFrames;
+            if (silenceFrames > numFramesAvailableInOutput - numFramesToWrite)
+                silenceFrames = numFramesAvailableInOutput - numFramesToWrite;
+        }
+        if (!m_renderStarved)
+            m_stats.AddRenderStarvation();
+        m_stats.AddInsertedSilence(silenceFrames);
+    }
+    m_renderStarved = isDry && silenceFrames + numFramesToWrite == 0;
 
-        // Common error codes
-        if (hr == AUDCLNT_E_UNSUPPORTED_FORMAT)
-            ReportStatus(L"  Reason: Unsupported format");
-        else if (hr == AUDCLNT_E_ALREADY_INITIALIZED)
-            ReportStatus(L"  Reason: Already initialized");
-        else if (hr == E_INVALIDARG)
-            ReportStatus(L"  Reason: Invalid argument");
+    // Publish the render buffer level (after this write) for drift compensation
+    PublishRenderLevel(numFramesPadding, silenceFrames + numFramesToWrite);
 
-        CloseHandle(*pEvent);
-        *pEvent = NULL;
-        return false;
-    }
+    if (silenceFrames + numFramesToWrite == 0)
+        return;
+
+    void* pRenderData = nullptr;
+    if (!m_render->GetBuffer(silenceFrames + numFramesToWrite, &pRenderData))
+        return;
 
-    // Set event handle for event-driven mode
-    hr = (*ppAudioClient)->SetEventHandle(*pEvent);
-    if (FAILED(hr))
+    const unsigned int blockAlign = m_render->GetFormat().getBlockAlign();
+    if (silenceFrames > 0)
     {
-        std::wostringstream msg;
-        msg << L"ERROR: Failed to set event handle (HRESULT: 0x" << std::hex << hr << L")";
-        ReportStatus(msg.str());
-        CloseHandle(*pEvent);
-        *pEvent = NULL;
-        return false;
+        m_pipeline.WriteSilence(pRenderData, silenceFrames);
+        pRenderData = (unsigned char*)pRenderData + silenceFrames * blockAlign;
     }
 
-    // Get buffer size
-    UINT32* pBufferFrameCount = isInput ? &m_inputBufferFrameCount : &m_outputBufferFrameCount;
-    (*ppAudioClient)->GetBufferSize(pBufferFrameCount);
+    // The queued region may wrap, so convert it in up to two pieces
+    SpscRingBuffer::Span first, second;
+    m_ringBuffer.GetReadSpans(numFramesToWrite, &first, &second);
+    if (first.frames > 0)
+        m_pipeline.ConvertOutput(first.data, pRenderData, (unsigned int)first.frames);
+    if (second.frames > 0)
+    {
+        unsigned char* pSecond = (unsigned char*)pRenderData + first.frames * blockAlign;
+        m_pipeline.ConvertOutput(second.data, pSecond, (unsigned int)second.frames);
+    }
+    m_ringBuffer.CommitRead(numFramesToWrite);
 
-    return true;
+    m_render->ReleaseBuffer(silenceFrames + numFramesToWrite, 0);
+    record.framesRendered += silenceFrames + numFramesToWrite;
 }
 
-DWORD WINAPI AudioEngine::AudioThreadProc(LPVOID lpParameter)
+void AudioEngine::DiagnosticsThread()
 {
-    AudioEngine* pThis = (AudioEngine*)lpParameter;
-    pThis->AudioThread();
-    return 0;
+    const long long statsIntervalNs = m_options.statsReportSeconds * 1000000000LL;
+    long long nextStatsNs = m_streamStartNs + statsIntervalNs;
+
+    std::unique_lock<std::mutex> lock(m_diagnosticsMutex);
+    while (!m_stopDiagnostics)
+    {
+        // Polled rather than signalled, so the audio threads never touch the mutex
+        m_diagnosticsWake.wait_for(lock, std::chrono::milliseconds(DiagnosticsPollMs));
+        lock.unlock();
+        DrainDiagnostics();
+        long long now = SteadyNowNs();
+        if (statsIntervalNs > 0 && now >= nextStatsNs)
+        {
+            ReportStats();
+            nextStatsNs += statsIntervalNs;
+        }
+        if (m_glitchTraceDueNs != 0 && now >= m_glitchTraceDueNs)
+            WriteGlitchTrace();
+        lock.lock();
+    }
+    lock.unlock();
+    DrainDiagnostics();
+    if (m_glitchTraceDueNs != 0)
+        WriteGlitchTrace();
 }
 
-void AudioEngine::AudioThread()
+void AudioEngine::DrainDiagnostics()
 {
-    // Set thread priority
-    DWORD taskIndex = 0;
-    HANDLE hTask = AvSetMmThreadCharacteristics(L"Pro Audio", &taskIndex);
-
-    // Prepare event array for waiting
-    HANDLE waitArray[2] = { m_hStopEvent, m_hInputEvent };
-    const DWORD numEvents = 2;
-
-    while (m_isRunning)
+    DiagnosticRecord record;
+    while (m_diagnosticLog.Pop(&record))
     {
-        // Wait for input data or stop event (event-driven, efficient)
-        DWORD waitResult = WaitForMultipleObjects(numEvents, waitArray, FALSE, 1000);
-
-        if (waitResult == WAIT_OBJECT_0) // Stop event
-            break;
+        std::wostringstream msg;
+        msg << L"[" << std::fixed << std::setprecision(3) << (record.timestampNs - m_streamStartNs) / 1e9 << L" s] "
+            << DiagnosticLog::Format(record);
+        ReportStatus(msg.str());
 
-        if (waitResult != WAIT_OBJECT_0 + 1) // Not input event
-            continue;
+        if (record.code == DiagnosticCode::Glitch && !m_options.glitchTracePath.empty() &&
+            m_glitchTraceDueNs == 0 && m_glitchTraceCount < MaxGlitchTraces)
+        {
+            m_glitchTraceDueNs = record.timestampNs + GlitchTraceDelayNs;
+        }
+    }
 
-        // Get captured data
-        BYTE* pData = nullptr;
-        UINT32 numFramesAvailable = 0;
-        DWORD flags = 0;
+    unsigned long long dropped = m_diagnosticLog.TakeDroppedCount();
+    if (dropped > 0)
+    {
+        std::wostringstream msg;
+        msg << L"WARNING: " << dropped << L" diagnostic messages lost (log full)";
+        ReportStatus(msg.str());
+    }
+}
 
-        HRESULT hr = m_pCaptureClient->GetBuffer(&pData, &numFramesAvailable, &flags, NULL, NULL);
+void AudioEngine::ReportStats()
+{
+    ProcessingStatsSnapshot snapshot = m_stats.GetSnapshot();
+    if (snapshot.stages[(int)ProcessingStage::Callback].count == 0)
+        return;
 
-        if (SUCCEEDED(hr) && numFramesAvailable > 0)
-        {
-            // Calculate how many output frames we'll produce
-            double sampleRateRatio = (double)m_pOutputFormat->nSamplesPerSec / (double)m_pInputFormat->nSamplesPerSec;
-            UINT32 numOutputFrames = (UINT32)(numFramesAvailable * sampleRateRatio);
+    ReportStatus(L"Processing stats:\r\n" + ProcessingStats::FormatSnapshot(snapshot));
+}
 
-            // Check how much space is available in output buffer
-            BYTE* pRenderData = nullptr;
-            UINT32 numFramesPadding = 0;
-            m_pOutputClient->GetCurrentPadding(&numFramesPadding);
+void AudioEngine::WriteGlitchTrace()
+{
+    m_glitchTraceDueNs = 0;
+    m_glitchTraceCount++;
 
-            UINT32 numFramesAvailableInOutput = m_outputBufferFrameCount - numFramesPadding;
+    std::string path = m_options.glitchTracePath + "-" + std::to_string(m_glitchTraceCount) + ".json";
+    std::wostringstream msg;
+    if (WriteTrace(path))
+        msg << L"Glitch trace written to " << std::wstring(path.begin(), path.end());
+    else
+        msg << L"WARNING: Could not write glitch trace " << std::wstring(path.begin(), path.end());
+    ReportStatus(msg.str());
+}
 
-            // Only write if there's enough space to avoid buffer overflow
-            if (numFramesAvailableInOutput >= numOutputFrames)
-            {
-                hr = m_pRenderClient->GetBuffer(numOutputFrames, &pRenderData);
-                if (SUCCEEDED(hr))
-                {
-                    // Process audio data
-                    if (flags & AUDCLNT_BUFFERFLAGS_SILENT || !pData)
-                    {
-                        // Fill with silence
-                        memset(pRenderData, 0, numOutputFrames * m_pOutputFormat->nBlockAlign);
-                    }
-                    else
-                    {
-                        // Step 1: Convert input to normalized float (interleaved)
-                        unsigned int inputSamples = numFramesAvailable * m_pInputFormat->nChannels;
-                        if (m_conversionBuffer.size() < inputSamples)
-                        {
-                            m_conversionBuffer.resize(inputSamples);
-                        }
-
-                        if (m_inputIsFloatFormat)
-                        {
-                            std::memcpy(m_conversionBuffer.data(), pData, inputSamples * sizeof(float));
-                        }
-                        else
-                        {
-                            int16_t* pInputSamples = (int16_t*)pData;
-                            for (unsigned int i = 0; i < inputSamples; i++)
-                            {
-                                m_conversionBuffer[i] = pInputSamples[i] / 32768.0f;
-                            }
-                        }
-
-                        // Step 2: Apply noise suppression (if enabled, works on input format)
-                        if (m_noiseConfig.isEnabled() && m_noiseSuppressor->IsInitialized())
-                        {
-                            static bool firstProcess = true;
-                            if (firstProcess)
-                            {
-                                std::wostringstream msg;
-                                msg << L"Applying " << NoiseReductionConfig::getTypeName(m_noiseConfig.type) << L" noise suppression...";
-                                ReportStatus(msg.str());
-                                firstProcess = false;
-                            }
-                            m_noiseSuppressor->Process(m_conversionBuffer.data(), numFramesAvailable, m_pInputFormat->nChannels);
-                        }
-
-                        // Step 3: Convert channels if needed
-                        unsigned int outputFrames = numFramesAvailable;
-                        float* pProcessedAudio = m_conversionBuffer.data();
-
-                        if (m_pInputFormat->nChannels != m_pOutputFormat->nChannels)
-                        {
-                            // Need channel conversion - use resample buffer as temp
-                            unsigned int convertedSamples = numFramesAvailable * m_pOutputFormat->nChannels;
-                            if (m_resampleBuffer.size() < convertedSamples)
-                            {
-                                m_resampleBuffer.resize(convertedSamples);
-                            }
-
-                            if (m_pInputFormat->nChannels == 1 && m_pOutputFormat->nChannels == 2)
-                            {
-                                // Mono to stereo: duplicate
-                                for (unsigned int i = 0; i < numFramesAvailable; i++)
-                                {
-                                    m_resampleBuffer[i * 2] = m_conversionBuffer[i];
-                                    m_resampleBuffer[i * 2 + 1] = m_conversionBuffer[i];
-                                }
-                            }
-                            else if (m_pInputFormat->nChannels == 2 && m_pOutputFormat->nChannels == 1)
-                            {
-                                // Stereo to mono: average
-                                for (unsigned int i = 0; i < numFramesAvailable; i++)
-                                {
-                                    m_resampleBuffer[i] = (m_conversionBuffer[i * 2] + m_conversionBuffer[i * 2 + 1]) * 0.5f;
-                                }
-                            }
-                            pProcessedAudio = m_resampleBuffer.data();
-                        }
-
-                        // Step 4: Convert sample rate if needed
-                        if (m_pInputFormat->nSamplesPerSec != m_pOutputFormat->nSamplesPerSec)
-                        {
-                            // Calculate output frame count based on sample rate ratio
-                            double ratio = (double)m_pOutputFormat->nSamplesPerSec / (double)m_pInputFormat->nSamplesPerSec;
-                            outputFrames = (unsigned int)(numFramesAvailable * ratio);
-
-                            // Simple linear interpolation resampling
-                            unsigned int tempSize = outputFrames * m_pOutputFormat->nChannels;
-                            if (m_resampleBuffer.size() < tempSize * 2) // Extra space
-                            {
-                                m_resampleBuffer.resize(tempSize * 2);
-                            }
-
-                            for (unsigned int i = 0; i < outputFrames; i++)
-                            {
-                                double srcPos = i / ratio;
-                                unsigned int srcIndex = (unsigned int)srcPos;
-                                double frac = srcPos - srcIndex;
-
-                                if (srcIndex + 1 < numFramesAvailable)
-                                {
-                                    for (unsigned int ch = 0; ch < m_pOutputFormat->nChannels; ch++)
-                                    {
-                                        float sample1 = pProcessedAudio[srcIndex * m_pOutputFormat->nChannels + ch];
-                                        float sample2 = pProcessedAudio[(srcIndex + 1) * m_pOutputFormat->nChannels + ch];
-                                        m_resampleBuffer[i * m_pOutputFormat->nChannels + ch] =
-                                            sample1 + (sample2 - sample1) * (float)frac;
-                                    }
-                                }
-                                else
-                                {
-                                    for (unsigned int ch = 0; ch < m_pOutputFormat->nChannels; ch++)
-                                    {
-                                        m_resampleBuffer[i * m_pOutputFormat->nChannels + ch] =
-                                            pProcessedAudio[srcIndex * m_pOutputFormat->nChannels + ch];
-                                    }
-                                }
-                            }
-                            pProcessedAudio = m_resampleBuffer.data();
-                        }
-
-                        // Step 5: Convert to output format
-                        unsigned int outputSamples = outputFrames * m_pOutputFormat->nChannels;
-                        if (m_outputIsFloatFormat)
-                        {
-                            std::memcpy(pRenderData, pProcessedAudio, outputSamples * sizeof(float));
-                        }
-                        else
-                        {
-                            int16_t* pOutputSamples = (int16_t*)pRenderData;
-                            for (unsigned int i = 0; i < outputSamples; i++)
-                            {
-                                float sample = pProcessedAudio[i] * 32768.0f;
-                                if (sample > 32767.0f) sample = 32767.0f;
-                                if (sample < -32768.0f) sample = -32768.0f;
-                                pOutputSamples[i] = (int16_t)sample;
-                            }
-                        }
-                    }
-
-                    m_pRenderClient->ReleaseBuffer(numOutputFrames, 0);
-                }
-            }
-            else
-            {
-                // Output buffer is full, we need to drop frames to avoid accumulating latency
-                // This should rarely happen with proper buffer sizing
-            }
+void AudioEngine::StopDiagnosticsThread()
+{
+    if (!m_diagnosticsThread.joinable())
+        return;
 
-            m_pCaptureClient->ReleaseBuffer(numFramesAvailable);
-        }
-        else if (hr == AUDCLNT_S_BUFFER_EMPTY)
-        {
-            // No data available yet, continue waiting
-            continue;
-        }
+    {
+        std::lock_guard<std::mutex> lock(m_diagnosticsMutex);
+        m_stopDiagnostics = true;
     }
-
-    // Restore thread characteristics
-    if (hTask)
-        AvRevertMmThreadCharacteristics(hTask);
+    m_diagnosticsWake.notify_one();
+    m_diagnosticsThread.join();
 }
 
 void AudioEngine::ReportStatus(const std::wstring& status)
 {
+    // Start()/Stop() and the diagnostics thread may report at the same time
+    std::lock_guard<std::mutex> lock(m_statusMutex);
+
     if (m_statusCallback)
     {
         m_statusCallback(status);
     }
+
+    if (m_diagnosticFile)
+    {
+        std::fputs(ToLogText(status).c_str(), m_diagnosticFile);
+        std::fputc('\n', m_diagnosticFile);
+        std::fflush(m_diagnosticFile);
+    }
 }
@@ -1,62 +1,244 @@
 #pragma once
 
-#include <windows.h>
-#include <audioclient.h>
-#include <mmdeviceapi.h>
 #include <string>
 #include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
 #include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <cstdio>
+#include "IAudioBackend.h"
+#include "AdaptiveBufferTarget.h"
+#include "CatchUpController.h"
+#include "AudioPipeline.h"
+#include "BufferArena.h"
+#include "DiagnosticLog.h"
+#include "SpscRingBuffer.h"
+#include "DriftController.h"
+#include "FlightRecorder.h"
+#include "ProcessingStats.h"
+#include "RenderPeriodPhase.h"
 #include "NoiseSuppress.h"
 #include "NoiseReductionTypes.h"
 
+// Tunables for the routing engine
+struct AudioEngineOptions
+{
+    unsigned int maxBufferMs = 50;    // Most audio queued between capture and render; newer frames beyond this are dropped
+    bool splitThreads = false;        // Run capture and render on their own threads, each woken by its own device event
+    bool driftCompensation = true;    // Steer the resampling ratio to hold the buffer level when device clocks differ
+                                      // (keeps the resampler running at equal rates, so the single-thread fast path
+                                      // that copies or processes packets in the output buffer needs it off)
+    unsigned int targetBufferMs = 0;  // Buffer level drift compensation holds (0 = the level measured after start-up);
+                                      // with adaptiveBuffer, the lowest level the target may shrink to
+    bool adaptiveBuffer = true;       // Raise the buffer target after render underruns and lower it while stable
+    unsigned int catchUpMs = 0;       // Time-stretch (speech) to close buffer level excess beyond this many ms over the
+                                      // target, and shortfalls below it, instead of dropping (0 = off)
+    ResamplerQuality resamplerQuality = ResamplerQuality::Medium;   // Sample rate conversion algorithm
+    bool dither = false;              // TPDF dither when rendering to 16 or 24-bit PCM devices
+    int inputChannel = -1;            // Route only this (zero-based) input channel to every output channel (-1 = all)
+    std::vector<float> channelMatrix; // Output-by-input gains, row per output channel (empty = default mapping)
+    std::string diagnosticLogPath;    // Also append every diagnostic message to this file (empty = status callback only)
+    unsigned int statsReportSeconds = 0; // Report the processing stats this often while running (0 = only at stop)
+    std::string glitchTracePath;      // Write the flight recorder to <path>-<n>.json after each glitch (empty = off)
+
+    AudioEngineOptions() = default;
+};
+
+// Fixed delays a stream adds between the capture and render devices, as set up by Start(), in ms.
+// The rest of the end-to-end latency is the audio buffered between them (GetBufferLevelMs()).
+struct AudioEngineLatency
+{
+    double capturePeriodMs = 0.0;     // Capture device period (packet size)
+    double renderPeriodMs = 0.0;      // Render device period
+    double prefillMs = 0.0;           // Silence written to the render buffer before starting
+    double noiseSuppressionMs = 0.0;  // Noise suppressor: its own delay, frame buffering and rate bridge
+    double resamplerMs = 0.0;         // Input to output rate conversion filter
+    double timeStretchMs = 0.0;       // Latency catch-up time stretcher (0 when off)
+
+    // What the stream adds on top of the buffer level: the render period being played out and
+    // the processing chain
+    double GetAddedMs() const { return renderPeriodMs + noiseSuppressionMs + resamplerMs + timeStretchMs; }
+};
+
 class AudioEngine
 {
 public:
     AudioEngine();
     ~AudioEngine();
 
+#ifdef _WIN32
+    // Route between two WASAPI endpoints ("DEFAULT" = system default device)
     bool Start(const std::wstring& inputDeviceId, const std::wstring& outputDeviceId, const NoiseReductionConfig& noiseConfig);
+#endif
+
+    // Route between any pair of backends. The engine takes ownership of both.
+    bool Start(std::unique_ptr<IAudioCaptureBackend> capture, std::unique_ptr<IAudioRenderBackend> render, const NoiseReductionConfig& noiseConfig);
     void Stop();
     bool IsRunning() const { return m_isRunning; }
 
-    // Set callback for status updates
+    // Set engine options (takes effect on the next Start)
+    void SetOptions(const AudioEngineOptions& options) { m_options = options; }
+    const AudioEngineOptions& GetOptions() const { return m_options; }
+
+    // Measured clock drift between the devices in ppm (positive = input clock faster than output).
+    // Safe to call from any thread while running.
+    double GetDriftPpm() const { return m_driftPpm.load(std::memory_order_relaxed); }
+
+    // Smoothed audio buffered between capture and the speaker (queue + render device buffer), in ms
+    double GetBufferLevelMs() const { return m_bufferLevelMs.load(std::memory_order_relaxed); }
+
+    // Delays of the running (or last) stream. The noise suppressor's is read live: capture
+    // packets of an unexpected size can add to it while running.
+    AudioEngineLatency GetLatency() const;
+
+    // Per-stage timing percentiles, DSP load, drop/underrun counters and the buffer target of the
+    // running (or last) stream. Safe to call from any thread.
+    ProcessingStatsSnapshot GetStats() const { return m_stats.GetSnapshot(); }
+
+    // Write the last few thousand callbacks as Chrome trace-event JSON (open in Perfetto or
+    // chrome://tracing). Safe to call from any thread, while running or after Stop().
+    bool WriteTrace(const std::string& path) const { return m_flightRecorder.WriteChromeTrace(path, m_streamStartNs); }
+
+    // Set callback for status updates. Called from the thread calling Start()/Stop() and, while
+    // running, from the engine's diagnostics thread - never from the audio threads.
     void SetStatusCallback(std::function<void(const std::wstring&)> callback) { m_statusCallback = callback; }
 
 private:
-    bool InitializeDevice(const std::wstring& deviceId, bool isInput, IMMDevice** ppDevice, IAudioClient** ppAudioClient);
-    static DWORD WINAPI AudioThreadProc(LPVOID lpParameter);
+    // Single-thread mode: capture events drive both capture and render
     void AudioThread();
 
-    IMMDevice* m_pInputDevice;
-    IMMDevice* m_pOutputDevice;
-    IAudioClient* m_pInputClient;
-    IAudioClient* m_pOutputClient;
-    IAudioCaptureClient* m_pCaptureClient;
-    IAudioRenderClient* m_pRenderClient;
+    // Split mode: each side runs on its own thread and device event
+    void CaptureThread();
+    void RenderThread();
+
+    // Service one capture event: drain every captured packet into the ring buffer (producer side)
+    void ProcessCapturePackets(CallbackRecord& record);
+
+    // Process a block of captured frames, straight into the render buffer when possible.
+    // Returns the frames produced.
+    unsigned int ProcessCaptured(const void* input, unsigned int frameCount, CallbackRecord& record);
+
+    // Start the flight record of one wake-up of an audio thread
+    CallbackRecord BeginCallback(CallbackThread thread) const;
+
+    // Account a finished wake-up: stage times, DSP load (a callback that captured frames closes a
+    // device period; otherwise its time is charged to the next one), flight recorder and glitches
+    void EndCallback(CallbackRecord& record);
+
+    // Move as many queued frames as the render device can take right now (consumer side)
+    void ServiceRender(CallbackRecord& record);
+
+    // Process a captured packet into the capture->render queue. Returns the frames produced.
+    unsigned int ProcessIntoQueue(const void* input, unsigned int frameCount);
+
+    // Single-thread mode fast path: process a packet straight into the render buffer when nothing
+    // is queued and the pipeline keeps the frame layout. Returns false when the queue must be used.
+    bool CanRenderDirect() const;
+    bool RenderDirect(const void* input, unsigned int frameCount, unsigned int* processedFrames, CallbackRecord& record);
+
+    // Queue processed frames for render, dropping what exceeds the configured buffering
+    void QueueFrames(const float* frames, unsigned int frameCount);
+    unsigned int GetQueueRoom() const;
+
+    // Feed the buffer level to the drift controller after frameCount frames were produced, and
+    // adapt the buffer target to the render underruns seen since the last call
+    void UpdateDriftCompensation(unsigned int frameCount);
+    void UpdateBufferTarget(unsigned int frameCount);
+
+    // Speed playback up or down while the buffer level is far from its target (latency catch-up)
+    void UpdateCatchUp(unsigned int bufferedFrames, unsigned int frameCount);
+
+    // Whether the render device, reporting paddingFrames, has played all it was given (underrun)
+    bool IsRenderDry(unsigned int paddingFrames);
+
+    // Record the render buffer level, once writtenFrames are added to the paddingFrames the device
+    // reported, so the capture side can project it to any later time
+    void PublishRenderLevel(unsigned int paddingFrames, unsigned int writtenFrames);
+
+    // Note frames dropped by QueueFrames (0 = everything fit), logging when a run of drops starts and ends
+    void TrackQueueOverflow(unsigned int droppedFrames);
+
+    // Non-real-time consumer of m_diagnosticLog: formats its records and reports them
+    void DiagnosticsThread();
+    void DrainDiagnostics();
+    void StopDiagnosticsThread();
+    void ReportStats();
+    void WriteGlitchTrace();
+
+    // Channel mapping for the device pair from the options (empty = pipeline default)
+    ChannelMatrix BuildChannelMatrix(unsigned int inputChannels, unsigned int outputChannels);
+
+    std::unique_ptr<IAudioCaptureBackend> m_capture;
+    std::unique_ptr<IAudioRenderBackend> m_render;
 
     NoiseSuppress* m_noiseSuppressor;
     NoiseReductionConfig m_noiseConfig;
+    AudioPipeline m_pipeline;
+    AudioEngineOptions m_options;
+    AudioEngineLatency m_latency;
+    unsigned int m_noiseSuppressionRate;    // Rate m_noiseSuppressor runs at (0 = not in the chain)
+
+    // Scratch memory for the pipeline and noise processors, allocated once per Start()
+    BufferArena m_bufferArena;
+
+    // Capture packets that piled up while the thread was late, gathered into one block
+    // (capture device format, up to the device buffer size)
+    ArenaBuffer<unsigned char> m_captureStaging;
+
+    // Processed audio (output rate/channels) waiting for space in the render buffer
+    SpscRingBuffer m_ringBuffer;
+    unsigned int m_maxQueuedFrames;
+
+    // Stage timings and DSP load, recorded by the audio threads
+    ProcessingStats m_stats;
+
+    // Recent callbacks for post-mortems of glitches
+    FlightRecorder m_flightRecorder;
+    std::atomic<long long> m_lastGlitchNs;  // Last glitch reported to the diagnostic log
+    long long m_glitchTraceDueNs;           // Diagnostics thread: write a glitch trace at this time (0 = none pending)
+    unsigned int m_glitchTraceCount;
+
+    // Clock drift compensation (runs on the capture side)
+    DriftController m_driftController;
+    std::atomic<long long> m_renderDrainTime;          // Render device clock time (ns) its buffer runs dry if not refilled
+    RenderPeriodPhase m_renderPhase;                    // Whichever thread renders: what the padding still counts as unplayed
+    std::atomic<double> m_driftPpm;
+    std::atomic<double> m_bufferLevelMs;
+
+    // Adaptive buffer level target (capture side), published for the render side to re-prime to
+    AdaptiveBufferTarget m_bufferTarget;
+    std::atomic<unsigned int> m_bufferTargetFrames;     // 0 = adaptive buffering off
+    uint64_t m_seenStarvations;                         // Capture side: underruns already acted on
+    bool m_renderStarved;                               // Render side: device was left dry (underrun already counted)
 
-    HANDLE m_hThread;
-    HANDLE m_hStopEvent;
-    bool m_isRunning;
+    // Latency catch-up by time stretching (capture side)
+    CatchUpController m_catchUp;
+    double m_catchUpEpisodeSeconds;                     // Stream time stretched in the current episode
 
-    WAVEFORMATEX* m_pInputFormat;
-    WAVEFORMATEX* m_pOutputFormat;
-    UINT32 m_inputBufferFrameCount;
-    UINT32 m_outputBufferFrameCount;
-    HANDLE m_hInputEvent;
-    HANDLE m_hOutputEvent;
+    std::thread m_thread;
+    std::thread m_renderThread;
+    std::atomic<bool> m_isRunning;
 
-    // Audio format tracking for conversion
-    bool m_inputIsFloatFormat;
-    bool m_outputIsFloatFormat;
-    std::vector<float> m_conversionBuffer;
-    std::vector<float> m_resampleBuffer;
+    // Real-time diagnostics: the audio threads push binary records, m_diagnosticsThread turns them
+    // into status messages
+    DiagnosticLog m_diagnosticLog;
+    std::thread m_diagnosticsThread;
+    std::mutex m_diagnosticsMutex;
+    std::condition_variable m_diagnosticsWake;
+    bool m_stopDiagnostics;
+    long long m_streamStartNs;
+    bool m_queueOverflowing;                // Capture side only
+    unsigned long long m_overflowFrames;
+    unsigned long long m_droppedFrames;     // Capture side: all frames dropped since start
 
     // Status callback for reporting diagnostics to GUI
     std::function<void(const std::wstring&)> m_statusCallback;
+    std::mutex m_statusMutex;
+    FILE* m_diagnosticFile;
 
-    // Helper to report status
+    // Helper to report status (to the callback and the diagnostic log file)
     void ReportStatus(const std::wstring& status);
 };
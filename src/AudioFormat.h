@@ -0,0 +1,56 @@
+#pragma once
+
+// Sample encodings understood by the processing pipeline
+enum class SampleFormat
+{
+    Float32 = 0,
+    PCM16 = 1,
+    PCM24 = 2,      // Packed, 3 bytes per sample
+    PCM32 = 3       // Also used for 24-bit samples in 32-bit containers (left justified)
+};
+
+// Portable description of a device or file stream format (always interleaved)
+struct AudioFormat
+{
+    SampleFormat sampleFormat = SampleFormat::Float32;
+    unsigned int sampleRate = 48000;
+    unsigned int channels = 2;
+
+    AudioFormat() = default;
+    AudioFormat(SampleFormat format, unsigned int rate, unsigned int channelCount)
+        : sampleFormat(format), sampleRate(rate), channels(channelCount) {}
+
+    unsigned int getBytesPerSample() const { return getBytesPerSample(sampleFormat); }
+    unsigned int getBlockAlign() const { return getBytesPerSample() * channels; }
+    bool isFloat() const { return sampleFormat == SampleFormat::Float32; }
+
+    bool operator==(const AudioFormat& other) const
+    {
+        return sampleFormat == other.sampleFormat && sampleRate == other.sampleRate && channels == other.channels;
+    }
+    bool operator!=(const AudioFormat& other) const { return !(*this == other); }
+
+    static unsigned int getBytesPerSample(SampleFormat format)
+    {
+        switch (format)
+        {
+            case SampleFormat::Float32: return 4;
+            case SampleFormat::PCM16: return 2;
+            case SampleFormat::PCM24: return 3;
+            case SampleFormat::PCM32: return 4;
+            default: return 0;
+        }
+    }
+
+    static const wchar_t* getSampleFormatName(SampleFormat format)
+    {
+        switch (format)
+        {
+            case SampleFormat::Float32: return L"Float32";
+            case SampleFormat::PCM16: return L"PCM16";
+            case SampleFormat::PCM24: return L"PCM24";
+            case SampleFormat::PCM32: return L"PCM32";
+            default: return L"Unknown";
+        }
+    }
+};
@@ -0,0 +1,230 @@
+#include "AudioPipeline.h"
+#include <cassert>
+#include <cstring>
+#include <sstream>
+
+namespace
+{
+    // Drift compensation trims the resampling ratio by well under 1%, which can add output
+    // frames beyond the nominal bound; reserve the resample buffer for 1% more input
+    const unsigned int RateTrimHeadroomDivisor = 100;
+}
+
+AudioPipeline::AudioPipeline()
+    : m_noiseSuppressor(nullptr)
+    , m_isTimeStretching(false)
+    , m_stats(nullptr)
+    , m_maxInputFrames(0)
+{
+}
+
+AudioPipeline::~AudioPipeline()
+{
+}
+
+bool AudioPipeline::Configure(const AudioFormat& inputFormat, const AudioFormat& outputFormat, NoiseSuppress* noiseSuppressor,
+                              bool variableRate, ResamplerQuality resamplerQuality, bool dither,
+                              const ChannelMatrix& channelMatrix, bool timeStretch)
+{
+    if (inputFormat.channels == 0 || outputFormat.channels == 0 ||
+        inputFormat.sampleRate == 0 || outputFormat.sampleRate == 0 ||
+        inputFormat.getBytesPerSample() == 0 || outputFormat.getBytesPerSample() == 0)
+    {
+        return false;
+    }
+
+    m_inputFormat = inputFormat;
+    m_outputFormat = outputFormat;
+    m_noiseSuppressor = noiseSuppressor;
+    m_maxInputFrames = 0;
+
+    // Conversion kernels are fixed for the stream, so pick them once here
+    m_inputConverter.Configure(inputFormat.sampleFormat);
+    m_outputConverter.Configure(outputFormat.sampleFormat, dither);
+
+    if (channelMatrix.isValid() &&
+        (channelMatrix.inputChannels != inputFormat.channels || channelMatrix.outputChannels != outputFormat.channels))
+    {
+        return false;
+    }
+    m_channelMixer.Configure(channelMatrix.isValid() ? channelMatrix
+                                                     : ChannelMatrix::createDefault(inputFormat.channels, outputFormat.channels));
+
+    // Resampling runs after channel conversion, so it works at the output channel count
+    if (!m_resampler.Configure(inputFormat.sampleRate, outputFormat.sampleRate, outputFormat.channels,
+                               variableRate, resamplerQuality))
+    {
+        return false;
+    }
+
+    // Time stretching runs last, on output rate frames, so its timing is that of the render side
+    m_isTimeStretching = timeStretch;
+    if (timeStretch && !m_timeStretcher.Configure(outputFormat.sampleRate, outputFormat.channels))
+        return false;
+
+    if (IsNoiseSuppressionActive() && m_diagnosticCallback)
+    {
+        std::wostringstream msg;
+        msg << L"Applying " << NoiseReductionConfig::getTypeName(m_noiseSuppressor->GetType()) << L" noise suppression";
+        m_diagnosticCallback(msg.str());
+    }
+    return true;
+}
+
+void AudioPipeline::ReserveBuffers(BufferArena& arena, unsigned int maxInputFrames)
+{
+    // Every stage may need its own buffer (Process() works in place where it can, but the
+    // caller decides per packet whether to pass a destination)
+    m_maxInputFrames = maxInputFrames;
+    arena.Reserve(m_conversionBuffer, (size_t)maxInputFrames * m_inputFormat.channels);
+    if (!m_channelMixer.IsPassthrough())
+        arena.Reserve(m_channelBuffer, (size_t)maxInputFrames * m_outputFormat.channels);
+    unsigned int headroomFrames = maxInputFrames / RateTrimHeadroomDivisor + 1;
+    unsigned int maxResampledFrames = m_resampler.GetMaxOutputFrames(maxInputFrames + headroomFrames);
+    if (!m_resampler.IsPassthrough())
+        arena.Reserve(m_resampleBuffer, (size_t)maxResampledFrames * m_outputFormat.channels);
+    if (m_isTimeStretching)
+    {
+        m_timeStretcher.ReserveBuffers(arena, maxResampledFrames);
+        arena.Reserve(m_stretchBuffer, (size_t)m_timeStretcher.GetMaxOutputFrames(maxResampledFrames) * m_outputFormat.channels);
+    }
+
+    if (IsNoiseSuppressionActive())
+        m_noiseSuppressor->ReserveBuffers(arena, maxInputFrames);
+}
+
+void AudioPipeline::WriteSilence(void* output, unsigned int outputFrames) const
+{
+    std::memset(output, 0, outputFrames * m_outputFormat.getBlockAlign());
+}
+
+bool AudioPipeline::IsNoiseSuppressionActive() const
+{
+    return m_noiseSuppressor && m_noiseSuppressor->GetType() != NoiseReductionType::Off && m_noiseSuppressor->IsInitialized();
+}
+
+bool AudioPipeline::IsRawCopy() const
+{
+    return m_inputFormat == m_outputFormat && IsFrameLayoutPreserved() && !IsNoiseSuppressionActive();
+}
+
+unsigned int AudioPipeline::GetMaxOutputFrames(unsigned int inputFrames) const
+{
+    unsigned int resampledFrames = m_resampler.GetMaxOutputFrames(inputFrames);
+    return m_isTimeStretching ? m_timeStretcher.GetMaxOutputFrames(resampledFrames) : resampledFrames;
+}
+
+int64_t AudioPipeline::MarkStage(ProcessingStage stage, int64_t startNs) const
+{
+    if (!m_stats)
+        return 0;
+    int64_t now = ProcessingStats::Now();
+    m_stats->RecordStage(stage, now - startNs);
+    return now;
+}
+
+void AudioPipeline::CopyRaw(const void* input, void* output, unsigned int frames) const
+{
+    int64_t startNs = m_stats ? ProcessingStats::Now() : 0;
+    if (input)
+        std::memcpy(output, input, frames * m_outputFormat.getBlockAlign());
+    else
+        WriteSilence(output, frames);
+    MarkStage(ProcessingStage::OutputConversion, startNs);
+}
+
+unsigned int AudioPipeline::Process(const void* input, unsigned int inputFrames, const float** output, float* destination)
+{
+    const unsigned int inputChannels = m_inputFormat.channels;
+
+    // The buffers were sized for the largest packet the capture device can deliver
+    assert(inputFrames <= m_maxInputFrames);
+    if (inputFrames > m_maxInputFrames)
+        inputFrames = m_maxInputFrames;
+
+    // With a destination the last active step writes straight into it, and the earlier
+    // steps work in place where the frame layout allows, so no stage is copied twice
+    const bool mixing = !m_channelMixer.IsPassthrough();
+    const bool resampling = !m_resampler.IsPassthrough();
+    const bool stretching = m_isTimeStretching;
+
+    // Each stage is timed from the end of the previous one (when stats are attached)
+    int64_t stageStart = m_stats ? ProcessingStats::Now() : 0;
+
+    // Step 1: Convert input to normalized float (interleaved)
+    unsigned int inputSamples = inputFrames * inputChannels;
+    float* pConverted = destination;
+    if (!destination || mixing || resampling || stretching)
+    {
+        pConverted = m_conversionBuffer.data();
+    }
+
+    if (!input)
+    {
+        // Silent packet: still run it through so processor and resampler timing stay continuous
+        std::memset(pConverted, 0, inputSamples * sizeof(float));
+    }
+    else
+    {
+        m_inputConverter.ToFloat(input, pConverted, inputSamples);
+    }
+    stageStart = MarkStage(ProcessingStage::InputConversion, stageStart);
+
+    // Step 2: Apply noise suppression (if enabled, works on input format)
+    if (IsNoiseSuppressionActive())
+    {
+        m_noiseSuppressor->Process(pConverted, inputFrames, inputChannels);
+        stageStart = MarkStage(ProcessingStage::NoiseSuppression, stageStart);
+    }
+
+    // Step 3: Convert channels if needed
+    float* pProcessedAudio = pConverted;
+
+    if (mixing)
+    {
+        float* pMixed = destination;
+        if (!destination || resampling || stretching)
+        {
+            pMixed = m_channelBuffer.data();
+        }
+
+        m_channelMixer.Process(pProcessedAudio, pMixed, inputFrames);
+        pProcessedAudio = pMixed;
+        stageStart = MarkStage(ProcessingStage::ChannelMix, stageStart);
+    }
+
+    // Step 4: Convert sample rate (and apply any drift correction)
+    unsigned int processedFrames = inputFrames;
+    if (resampling)
+    {
+        float* pResampled = destination;
+        if (!destination || stretching)
+        {
+            pResampled = m_resampleBuffer.data();
+        }
+
+        processedFrames = m_resampler.Process(pProcessedAudio, inputFrames, pResampled);
+        pProcessedAudio = pResampled;
+        stageStart = MarkStage(ProcessingStage::Resample, stageStart);
+    }
+
+    // Step 4b: Time stretch (latency catch-up)
+    if (stretching)
+    {
+        float* pStretched = destination ? destination : m_stretchBuffer.data();
+        processedFrames = m_timeStretcher.Process(pProcessedAudio, processedFrames, pStretched);
+        pProcessedAudio = pStretched;
+        MarkStage(ProcessingStage::TimeStretch, stageStart);
+    }
+
+    *output = pProcessedAudio;
+    return processedFrames;
+}
+
+void AudioPipeline::ConvertOutput(const float* input, void* output, unsigned int frames)
+{
+    // Step 5: Convert to output format
+    int64_t startNs = m_stats ? ProcessingStats::Now() : 0;
+    m_outputConverter.FromFloat(input, output, frames * m_outputFormat.channels);
+    MarkStage(ProcessingStage::OutputConversion, startNs);
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "AudioFormat.h"
+#include "BufferArena.h"
+#include "ChannelMixer.h"
+#include "NoiseSuppress.h"
+#include "ProcessingStats.h"
+#include "Resampler.h"
+#include "SampleConverter.h"
+#include "TimeStretcher.h"
+#include <string>
+#include <functional>
+
+// Platform independent processing chain used by AudioEngine:
+// input conversion -> noise suppression -> channel conversion -> resampling -> time stretching
+// -> output conversion.
+// The last step is separate so the engine can queue float frames between capture and render.
+// Knows nothing about devices, so it can be driven by any backend (or benchmarked directly).
+class AudioPipeline
+{
+public:
+    AudioPipeline();
+    ~AudioPipeline();
+
+    // Set up for the given device formats. noiseSuppressor may be null (no suppression).
+    // variableRate keeps the resampler running even at equal rates so SetRateAdjustment() works.
+    // dither adds TPDF dither when the output device is 16 or 24-bit PCM.
+    // channelMatrix maps input to output channels; an empty matrix selects the default layout mapping.
+    // timeStretch adds the time stretcher after resampling so SetPlaybackSpeed() works.
+    bool Configure(const AudioFormat& inputFormat, const AudioFormat& outputFormat, NoiseSuppress* noiseSuppressor,
+                   bool variableRate = false, ResamplerQuality resamplerQuality = ResamplerQuality::Medium,
+                   bool dither = false, const ChannelMatrix& channelMatrix = ChannelMatrix(), bool timeStretch = false);
+
+    // Reserve the scratch buffers for packets of up to maxInputFrames (this pipeline's and the
+    // noise suppressor's) in arena. Call after Configure() and allocate the arena before Process().
+    void ReserveBuffers(BufferArena& arena, unsigned int maxInputFrames);
+
+    // Largest packet Process() accepts (as reserved)
+    unsigned int GetMaxInputFrames() const { return m_maxInputFrames; }
+
+    // Trim the resampling ratio by ppm (positive = fewer output frames). Used for drift compensation.
+    void SetRateAdjustment(double ppm) { m_resampler.SetRatioAdjustment(ppm); }
+
+    // Play faster (above 1.0) or slower without changing pitch, when configured with timeStretch.
+    // Used to catch up on latency.
+    void SetPlaybackSpeed(double speed) { m_timeStretcher.SetSpeed(speed); }
+    bool IsTimeStretching() const { return m_isTimeStretching; }
+
+    const Resampler& GetResampler() const { return m_resampler; }
+    const TimeStretcher& GetTimeStretcher() const { return m_timeStretcher; }
+    const ChannelMixer& GetChannelMixer() const { return m_channelMixer; }
+    const SampleConverter& GetInputConverter() const { return m_inputConverter; }
+    const SampleConverter& GetOutputConverter() const { return m_outputConverter; }
+
+    // Run steps 1-4b on one captured packet of at most GetMaxInputFrames() frames (input device
+    // format; null input = silent packet). Never allocates.
+    // Produces normalized float frames at the output rate and channel count and returns how many.
+    // Without a destination the frames land in an internal buffer that stays valid until the next
+    // call; with one (room for GetMaxOutputFrames(inputFrames) frames) they are written straight
+    // into it, and *output points there.
+    unsigned int Process(const void* input, unsigned int inputFrames, const float** output, float* destination = nullptr);
+
+    // Upper bound on the frames Process() produces for inputFrames
+    unsigned int GetMaxOutputFrames(unsigned int inputFrames) const;
+
+    // True when steps 3, 4 and 4b are no-ops, so Process() emits one frame per input frame in the
+    // input channel layout and can run entirely in the destination buffer
+    bool IsFrameLayoutPreserved() const
+    {
+        return m_channelMixer.IsPassthrough() && m_resampler.IsPassthrough() && !m_isTimeStretching;
+    }
+
+    // True when the input and output formats are identical and nothing processes the audio:
+    // a packet can go to the output device with CopyRaw() and no float conversion at all
+    bool IsRawCopy() const;
+
+    // Copy frames in the (identical) device format; null input writes silence
+    void CopyRaw(const void* input, void* output, unsigned int frames) const;
+
+    // Step 5: convert normalized float frames to the output device format
+    void ConvertOutput(const float* input, void* output, unsigned int frames);
+
+    // Write silence in the output device format
+    void WriteSilence(void* output, unsigned int outputFrames) const;
+
+    const AudioFormat& GetInputFormat() const { return m_inputFormat; }
+    const AudioFormat& GetOutputFormat() const { return m_outputFormat; }
+
+    // Time every stage into stats (null = no timing). stats must outlive processing.
+    void SetStats(ProcessingStats* stats) { m_stats = stats; }
+
+    // Set callback for diagnostic messages
+    void SetDiagnosticCallback(std::function<void(const std::wstring&)> callback) { m_diagnosticCallback = callback; }
+
+private:
+    bool IsNoiseSuppressionActive() const;
+
+    // Record the time since startNs against stage and return the current time (for the next stage)
+    int64_t MarkStage(ProcessingStage stage, int64_t startNs) const;
+
+    AudioFormat m_inputFormat;
+    AudioFormat m_outputFormat;
+    NoiseSuppress* m_noiseSuppressor;
+
+    SampleConverter m_inputConverter;
+    SampleConverter m_outputConverter;
+    ChannelMixer m_channelMixer;
+    Resampler m_resampler;
+    TimeStretcher m_timeStretcher;
+    bool m_isTimeStretching;
+    ProcessingStats* m_stats;
+
+    // Scratch buffers, carved out of the route's arena
+    unsigned int m_maxInputFrames;
+    ArenaBuffer<float> m_conversionBuffer;
+    ArenaBuffer<float> m_channelBuffer;
+    ArenaBuffer<float> m_resampleBuffer;
+    ArenaBuffer<float> m_stretchBuffer;
+
+    std::function<void(const std::wstring&)> m_diagnosticCallback;
+};
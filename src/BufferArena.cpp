@@ -0,0 +1,75 @@
+#include "BufferArena.h"
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+namespace
+{
+    // Every buffer starts on its own cache line (which also satisfies the widest SIMD loads)
+    const size_t BufferAlignment = 64;
+
+    size_t AlignUp(size_t value)
+    {
+        return (value + BufferAlignment - 1) & ~(BufferAlignment - 1);
+    }
+}
+
+BufferArena::BufferArena()
+    : m_size(0)
+    , m_bufferCount(0)
+{
+}
+
+void BufferArena::ReserveBytes(ArenaBufferBase& buffer, size_t count, size_t elementSize)
+{
+    // A buffer reserved twice gets the larger of the two requests
+    for (Reservation& reservation : m_reservations)
+    {
+        if (reservation.buffer == &buffer)
+        {
+            if (count > reservation.count)
+                reservation.count = count;
+            return;
+        }
+    }
+    m_reservations.push_back({ &buffer, count, elementSize });
+}
+
+bool BufferArena::Allocate()
+{
+    size_t total = 0;
+    for (const Reservation& reservation : m_reservations)
+    {
+        total += AlignUp(reservation.count * reservation.elementSize);
+    }
+
+    std::unique_ptr<unsigned char[]> block;
+    if (total > 0)
+    {
+        block.reset(new (std::nothrow) unsigned char[total + BufferAlignment]);
+        if (!block)
+            return false;
+        std::memset(block.get(), 0, total + BufferAlignment);
+    }
+
+    unsigned char* next = block.get();
+    if (next)
+        next += (BufferAlignment - (uintptr_t)next % BufferAlignment) % BufferAlignment;
+
+    for (const Reservation& reservation : m_reservations)
+    {
+        reservation.buffer->m_data = reservation.count > 0 ? next : nullptr;
+        reservation.buffer->m_size = reservation.count;
+        next += AlignUp(reservation.count * reservation.elementSize);
+    }
+
+    m_block = std::move(block);
+    m_size = total;
+    m_bufferCount = m_reservations.size();
+    return true;
+}
+
+void BufferArena::Clear()
+{
+    m_reservations.clear();
+}
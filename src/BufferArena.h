@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Untyped part of ArenaBuffer, so the arena can hand out memory to buffers of any type
+class ArenaBufferBase
+{
+protected:
+    ArenaBufferBase() : m_data(nullptr), m_size(0) {}
+    ~ArenaBufferBase() = default;
+
+    ArenaBufferBase(const ArenaBufferBase&) = delete;
+    ArenaBufferBase& operator=(const ArenaBufferBase&) = delete;
+
+    void* m_data;
+    size_t m_size;
+
+    friend class BufferArena;
+};
+
+// Fixed-size scratch buffer whose memory belongs to a BufferArena. Empty until the arena
+// it was reserved in is allocated; it never grows after that.
+template <typename T>
+class ArenaBuffer : public ArenaBufferBase
+{
+public:
+    T* data() const { return static_cast<T*>(m_data); }
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    T& operator[](size_t index) const { return data()[index]; }
+};
+
+// Scratch memory for one route's real-time path. The pipeline and the noise processors
+// reserve every buffer they need while a stream is set up, then Allocate() makes a single
+// zeroed block and carves it up between them. Processing only uses those buffers, so the
+// callback path never touches the heap.
+class BufferArena
+{
+public:
+    BufferArena();
+
+    // Ask for count elements in buffer. Takes effect at the next Allocate(); buffer must stay
+    // at the same address until then.
+    template <typename T>
+    void Reserve(ArenaBuffer<T>& buffer, size_t count) { ReserveBytes(buffer, count, sizeof(T)); }
+
+    // Allocate one block for everything reserved since the last Clear() and point the buffers
+    // into it (all zero). Replaces any previous block.
+    bool Allocate();
+
+    // Forget all reservations (buffers from the previous Allocate() keep pointing into the
+    // current block until the next one)
+    void Clear();
+
+    // Bytes in the allocated block and buffers carved out of it
+    size_t GetSize() const { return m_size; }
+    size_t GetBufferCount() const { return m_bufferCount; }
+
+private:
+    struct Reservation
+    {
+        ArenaBufferBase* buffer;
+        size_t count;
+        size_t elementSize;
+    };
+
+    void ReserveBytes(ArenaBufferBase& buffer, size_t count, size_t elementSize);
+
+    std::vector<Reservation> m_reservations;
+    std::unique_ptr<unsigned char[]> m_block;
+    size_t m_size;
+    size_t m_bufferCount;
+};
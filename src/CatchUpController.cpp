@@ -0,0 +1,80 @@
+#include "CatchUpController.h"
+
+namespace
+{
+    // Short enough to react within a few packets, long enough to ride out the packet-sized
+    // sawtooth of the level
+    const double FillTimeConstantSeconds = 0.1;
+
+    // Speeding speech up by 5% or slowing it by 4% is hard to notice; 20 ms of excess latency
+    // is gone in 0.4 s
+    const double FastSpeed = 1.05;
+    const double SlowSpeed = 0.96;
+}
+
+CatchUpController::CatchUpController()
+    : m_sampleRate(48000)
+    , m_thresholdFrames(0)
+{
+    Reset();
+}
+
+void CatchUpController::Configure(unsigned int sampleRate, unsigned int thresholdFrames)
+{
+    m_sampleRate = sampleRate > 0 ? sampleRate : 48000;
+    m_thresholdFrames = thresholdFrames;
+    Reset();
+}
+
+void CatchUpController::Reset()
+{
+    m_averageFill = 0.0;
+    m_hasAverage = false;
+    m_speed = 1.0;
+}
+
+double CatchUpController::Update(unsigned int fillFrames, double targetFrames, unsigned int elapsedFrames)
+{
+    if (elapsedFrames == 0)
+        return m_speed;
+
+    const double dt = (double)elapsedFrames / (double)m_sampleRate;
+    if (!m_hasAverage)
+    {
+        m_averageFill = (double)fillFrames;
+        m_hasAverage = true;
+    }
+    else
+    {
+        m_averageFill += (dt / (FillTimeConstantSeconds + dt)) * ((double)fillFrames - m_averageFill);
+    }
+
+    if (targetFrames <= 0.0 || m_thresholdFrames == 0)
+    {
+        m_speed = 1.0;
+        return m_speed;
+    }
+
+    // Each episode runs until the level is back at the target, so it does not stop and start
+    // around the threshold
+    double lowDistance = targetFrames / 2 < m_thresholdFrames ? targetFrames / 2 : (double)m_thresholdFrames;
+    if (m_speed > 1.0)
+    {
+        if (m_averageFill <= targetFrames)
+            m_speed = 1.0;
+    }
+    else if (m_speed < 1.0)
+    {
+        if (m_averageFill >= targetFrames)
+            m_speed = 1.0;
+    }
+    else if (m_averageFill > targetFrames + m_thresholdFrames)
+    {
+        m_speed = FastSpeed;
+    }
+    else if (m_averageFill < targetFrames - lowDistance)
+    {
+        m_speed = SlowSpeed;
+    }
+    return m_speed;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+// Decides when the time stretcher should close a gap between the buffer level and its target,
+// instead of waiting for the queue to overflow (dropping audio) or the render device to run
+// dry (inserting silence).
+//
+// The level is smoothed over a fraction of a second. Once it is more than a threshold above the
+// target, playback runs a few percent faster until the level is back at the target; once it
+// falls well below the target, playback runs slightly slower until it has recovered. In
+// between, the drift controller holds the level by trimming the resampling ratio.
+class CatchUpController
+{
+public:
+    CatchUpController();
+
+    // sampleRate: rate the level is measured at (output rate)
+    // thresholdFrames: distance above the target that starts catching up; running low starts
+    // at half the target or this far below it, whichever is closer
+    void Configure(unsigned int sampleRate, unsigned int thresholdFrames);
+
+    // Back to normal speed (start of a new stream)
+    void Reset();
+
+    // Feed one level observation, taken after elapsedFrames (at sampleRate) were queued.
+    // targetFrames: level aimed for (0 = not known yet). Returns the playback speed to use.
+    double Update(unsigned int fillFrames, double targetFrames, unsigned int elapsedFrames);
+
+    // 1.0 while not catching up
+    double GetSpeed() const { return m_speed; }
+    bool IsActive() const { return m_speed != 1.0; }
+
+    // Smoothed level in frames
+    double GetAverageFill() const { return m_averageFill; }
+
+private:
+    unsigned int m_sampleRate;
+    unsigned int m_thresholdFrames;
+
+    double m_averageFill;
+    bool m_hasAverage;
+    double m_speed;
+};
@@ -0,0 +1,326 @@
+#include "ChannelMixer.h"
+#include "CpuFeatures.h"
+#include <cstring>
+
+#ifdef AUDIOROUTER_X86
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // Largest input count that gets its own N->1 kernel
+    const unsigned int MaxFixedMonoInputs = 8;
+
+    // Scalar matrix product for compile-time channel counts (fully unrolled by the compiler).
+    // The vector kernels below accumulate in the same order, so tails match their output exactly.
+    template <unsigned int In, unsigned int Out>
+    void MixScalar(const float* input, float* output, unsigned int frames, const float* gains)
+    {
+        for (unsigned int f = 0; f < frames; f++, input += In, output += Out)
+        {
+            for (unsigned int o = 0; o < Out; o++)
+            {
+                const float* row = gains + o * In;
+                float sum = input[0] * row[0];
+                for (unsigned int i = 1; i < In; i++)
+                {
+                    sum += input[i] * row[i];
+                }
+                output[o] = sum;
+            }
+        }
+    }
+
+    // Kernels specialized on the channel counts; gains are the row-major matrix
+    template <unsigned int In, unsigned int Out>
+    struct FixedMix
+    {
+        static void Run(const float* input, float* output, unsigned int frames, const float* gains,
+                        unsigned int, unsigned int)
+        {
+            MixScalar<In, Out>(input, output, frames, gains);
+        }
+    };
+
+    // Mono to stereo: four frames in, eight samples out
+    template <>
+    struct FixedMix<1, 2>
+    {
+        static void Run(const float* input, float* output, unsigned int frames, const float* gains,
+                        unsigned int, unsigned int)
+        {
+            unsigned int f = 0;
+#ifdef AUDIOROUTER_X86
+            const __m128 g = _mm_setr_ps(gains[0], gains[1], gains[0], gains[1]);
+            for (; f + 4 <= frames; f += 4)
+            {
+                __m128 x = _mm_loadu_ps(input + f);
+                _mm_storeu_ps(output + f * 2, _mm_mul_ps(_mm_unpacklo_ps(x, x), g));
+                _mm_storeu_ps(output + f * 2 + 4, _mm_mul_ps(_mm_unpackhi_ps(x, x), g));
+            }
+#endif
+            MixScalar<1, 2>(input + f, output + f * 2, frames - f, gains);
+        }
+    };
+
+    // Stereo to mono: deinterleave four frames, then weight and add
+    template <>
+    struct FixedMix<2, 1>
+    {
+        static void Run(const float* input, float* output, unsigned int frames, const float* gains,
+                        unsigned int, unsigned int)
+        {
+            unsigned int f = 0;
+#ifdef AUDIOROUTER_X86
+            const __m128 gainLeft = _mm_set1_ps(gains[0]);
+            const __m128 gainRight = _mm_set1_ps(gains[1]);
+            for (; f + 4 <= frames; f += 4)
+            {
+                __m128 a = _mm_loadu_ps(input + f * 2);
+                __m128 b = _mm_loadu_ps(input + f * 2 + 4);
+                __m128 left = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+                __m128 right = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+                _mm_storeu_ps(output + f, _mm_add_ps(_mm_mul_ps(left, gainLeft), _mm_mul_ps(right, gainRight)));
+            }
+#endif
+            MixScalar<2, 1>(input + f * 2, output + f, frames - f, gains);
+        }
+    };
+
+    // Stereo to stereo (balance, swap, cross-feed): each frame times its swapped copy
+    template <>
+    struct FixedMix<2, 2>
+    {
+        static void Run(const float* input, float* output, unsigned int frames, const float* gains,
+                        unsigned int, unsigned int)
+        {
+            unsigned int f = 0;
+#ifdef AUDIOROUTER_X86
+            const __m128 direct = _mm_setr_ps(gains[0], gains[3], gains[0], gains[3]);
+            const __m128 cross = _mm_setr_ps(gains[1], gains[2], gains[1], gains[2]);
+            for (; f + 4 <= frames; f += 4)
+            {
+                __m128 a = _mm_loadu_ps(input + f * 2);
+                __m128 b = _mm_loadu_ps(input + f * 2 + 4);
+                __m128 swappedA = _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1));
+                __m128 swappedB = _mm_shuffle_ps(b, b, _MM_SHUFFLE(2, 3, 0, 1));
+                _mm_storeu_ps(output + f * 2, _mm_add_ps(_mm_mul_ps(a, direct), _mm_mul_ps(swappedA, cross)));
+                _mm_storeu_ps(output + f * 2 + 4, _mm_add_ps(_mm_mul_ps(b, direct), _mm_mul_ps(swappedB, cross)));
+            }
+#endif
+            MixScalar<2, 2>(input + f * 2, output + f * 2, frames - f, gains);
+        }
+    };
+
+    // N to mono: four frames per step, one channel at a time
+    template <unsigned int In>
+    struct FixedMix<In, 1>
+    {
+        static void Run(const float* input, float* output, unsigned int frames, const float* gains,
+                        unsigned int, unsigned int)
+        {
+            unsigned int f = 0;
+#ifdef AUDIOROUTER_X86
+            __m128 g[In];
+            for (unsigned int i = 0; i < In; i++)
+            {
+                g[i] = _mm_set1_ps(gains[i]);
+            }
+            for (; f + 4 <= frames; f += 4)
+            {
+                const float* x = input + f * In;
+                __m128 sum = _mm_mul_ps(_mm_setr_ps(x[0], x[In], x[2 * In], x[3 * In]), g[0]);
+                for (unsigned int i = 1; i < In; i++)
+                {
+                    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_setr_ps(x[i], x[In + i], x[2 * In + i], x[3 * In + i]), g[i]));
+                }
+                _mm_storeu_ps(output + f, sum);
+            }
+#endif
+            MixScalar<In, 1>(input + f * In, output + f, frames - f, gains);
+        }
+    };
+
+    // Any layout. gains holds one column per input channel, each padded to a multiple of four
+    // outputs, so a frame is the sum of its input samples times their columns.
+    void MixGeneric(const float* input, float* output, unsigned int frames, const float* gains,
+                    unsigned int inputChannels, unsigned int outputChannels)
+    {
+        const unsigned int padded = (outputChannels + 3) & ~3u;
+        const size_t totalSamples = (size_t)frames * outputChannels;
+
+        for (unsigned int f = 0; f < frames; f++, input += inputChannels, output += outputChannels)
+        {
+            for (unsigned int o = 0; o < padded; o += 4)
+            {
+#ifdef AUDIOROUTER_X86
+                __m128 sum = _mm_mul_ps(_mm_set1_ps(input[0]), _mm_loadu_ps(gains + o));
+                for (unsigned int i = 1; i < inputChannels; i++)
+                {
+                    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(input[i]), _mm_loadu_ps(gains + i * padded + o)));
+                }
+
+                // Spill into the next frame is fine (it is written afterwards), past the buffer is not
+                if ((size_t)f * outputChannels + o + 4 <= totalSamples)
+                {
+                    _mm_storeu_ps(output + o, sum);
+                }
+                else
+                {
+                    float last[4];
+                    _mm_storeu_ps(last, sum);
+                    std::memcpy(output + o, last, (outputChannels - o) * sizeof(float));
+                }
+#else
+                for (unsigned int k = o; k < o + 4 && k < outputChannels; k++)
+                {
+                    float sum = input[0] * gains[k];
+                    for (unsigned int i = 1; i < inputChannels; i++)
+                    {
+                        sum += input[i] * gains[i * padded + k];
+                    }
+                    output[k] = sum;
+                }
+#endif
+            }
+        }
+    }
+
+    ChannelMixer::MixFn SelectMonoKernel(unsigned int inputChannels)
+    {
+        switch (inputChannels)
+        {
+        case 1: return FixedMix<1, 1>::Run;
+        case 2: return FixedMix<2, 1>::Run;
+        case 3: return FixedMix<3, 1>::Run;
+        case 4: return FixedMix<4, 1>::Run;
+        case 5: return FixedMix<5, 1>::Run;
+        case 6: return FixedMix<6, 1>::Run;
+        case 7: return FixedMix<7, 1>::Run;
+        case 8: return FixedMix<8, 1>::Run;
+        default: return nullptr;
+        }
+    }
+}
+
+bool ChannelMatrix::isIdentity() const
+{
+    if (!isValid() || inputChannels != outputChannels)
+        return false;
+
+    for (unsigned int o = 0; o < outputChannels; o++)
+    {
+        for (unsigned int i = 0; i < inputChannels; i++)
+        {
+            if (at(o, i) != (o == i ? 1.0f : 0.0f))
+                return false;
+        }
+    }
+    return true;
+}
+
+ChannelMatrix ChannelMatrix::createDefault(unsigned int inputCount, unsigned int outputCount)
+{
+    ChannelMatrix matrix(inputCount, outputCount);
+    if (inputCount == 0 || outputCount == 0)
+        return matrix;
+
+    if (inputCount >= outputCount)
+    {
+        // Fold the extra inputs onto the outputs and average what lands on each
+        for (unsigned int o = 0; o < outputCount; o++)
+        {
+            unsigned int sources = (inputCount - o + outputCount - 1) / outputCount;
+            for (unsigned int i = o; i < inputCount; i += outputCount)
+            {
+                matrix.at(o, i) = 1.0f / sources;
+            }
+        }
+    }
+    else
+    {
+        for (unsigned int o = 0; o < outputCount; o++)
+        {
+            matrix.at(o, o % inputCount) = 1.0f;
+        }
+    }
+    return matrix;
+}
+
+ChannelMatrix ChannelMatrix::createPickInput(unsigned int inputCount, unsigned int outputCount, unsigned int inputChannel)
+{
+    ChannelMatrix matrix(inputCount, outputCount);
+    if (inputChannel < inputCount)
+    {
+        for (unsigned int o = 0; o < outputCount; o++)
+        {
+            matrix.at(o, inputChannel) = 1.0f;
+        }
+    }
+    return matrix;
+}
+
+ChannelMixer::ChannelMixer()
+    : m_isPassthrough(true)
+    , m_kernelName(L"None")
+    , m_mix(nullptr)
+{
+}
+
+bool ChannelMixer::Configure(const ChannelMatrix& matrix)
+{
+    if (!matrix.isValid())
+        return false;
+
+    m_matrix = matrix;
+    m_isPassthrough = matrix.isIdentity();
+    m_kernelGains = matrix.gains;
+
+    const unsigned int in = matrix.inputChannels;
+    const unsigned int out = matrix.outputChannels;
+    m_mix = nullptr;
+
+    if (in == 1 && out == 2)
+    {
+        m_mix = FixedMix<1, 2>::Run;
+        m_kernelName = L"1->2";
+    }
+    else if (in == 2 && out == 2)
+    {
+        m_mix = FixedMix<2, 2>::Run;
+        m_kernelName = L"2->2";
+    }
+    else if (out == 1 && in <= MaxFixedMonoInputs)
+    {
+        m_mix = SelectMonoKernel(in);
+        m_kernelName = in == 2 ? L"2->1" : L"N->1";
+    }
+
+    if (!m_mix)
+    {
+        // Rearrange into padded input-major columns for the generic kernel
+        const unsigned int padded = (out + 3) & ~3u;
+        m_kernelGains.assign(in * padded, 0.0f);
+        for (unsigned int i = 0; i < in; i++)
+        {
+            for (unsigned int o = 0; o < out; o++)
+            {
+                m_kernelGains[i * padded + o] = matrix.at(o, i);
+            }
+        }
+        m_mix = MixGeneric;
+        m_kernelName = L"Generic";
+    }
+
+    return true;
+}
+
+void ChannelMixer::Process(const float* input, float* output, unsigned int frames) const
+{
+    if (m_isPassthrough)
+    {
+        std::memcpy(output, input, (size_t)frames * m_matrix.outputChannels * sizeof(float));
+        return;
+    }
+    m_mix(input, output, frames, m_kernelGains.data(), m_matrix.inputChannels, m_matrix.outputChannels);
+}
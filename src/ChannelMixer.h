@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vector>
+
+// Gains from every input channel to every output channel
+struct ChannelMatrix
+{
+    unsigned int inputChannels = 0;
+    unsigned int outputChannels = 0;
+    std::vector<float> gains;   // outputChannels rows of inputChannels gains
+
+    ChannelMatrix() = default;
+    ChannelMatrix(unsigned int inputCount, unsigned int outputCount)
+        : inputChannels(inputCount), outputChannels(outputCount), gains(inputCount * outputCount, 0.0f) {}
+
+    float& at(unsigned int output, unsigned int input) { return gains[output * inputChannels + input]; }
+    float at(unsigned int output, unsigned int input) const { return gains[output * inputChannels + input]; }
+
+    bool isValid() const { return inputChannels > 0 && outputChannels > 0 && gains.size() == inputChannels * outputChannels; }
+    bool isIdentity() const;
+
+    // Layout mapping used when nothing is configured: mono is copied to every output, more
+    // inputs than outputs fold input i into output i % outputs (averaged), fewer inputs than
+    // outputs repeat the inputs across the outputs.
+    static ChannelMatrix createDefault(unsigned int inputCount, unsigned int outputCount);
+
+    // Route a single input channel to every output channel (e.g. the mic input of a multi-channel interface)
+    static ChannelMatrix createPickInput(unsigned int inputCount, unsigned int outputCount, unsigned int inputChannel);
+};
+
+// Channel conversion stage: out[frame][o] = sum over i of gains[o][i] * in[frame][i].
+// Common layouts (1->2, 2->1, 2->2, N->1) run kernels specialized at compile time for their
+// channel counts; anything else uses a generic kernel vectorized across output channels.
+// The kernel is chosen once in Configure().
+class ChannelMixer
+{
+public:
+    ChannelMixer();
+
+    // matrix must match the channel counts
+    bool Configure(const ChannelMatrix& matrix);
+
+    // True when Process() would only copy (same channel count, identity matrix)
+    bool IsPassthrough() const { return m_isPassthrough; }
+
+    const ChannelMatrix& GetMatrix() const { return m_matrix; }
+
+    // Name of the selected kernel, for diagnostics
+    const wchar_t* GetKernelName() const { return m_kernelName; }
+
+    // Mix frames interleaved frames. input and output must not overlap.
+    void Process(const float* input, float* output, unsigned int frames) const;
+
+    typedef void (*MixFn)(const float* input, float* output, unsigned int frames, const float* gains,
+                          unsigned int inputChannels, unsigned int outputChannels);
+
+private:
+    ChannelMatrix m_matrix;
+    bool m_isPassthrough;
+    const wchar_t* m_kernelName;
+    MixFn m_mix;
+
+    // Gains in the layout the selected kernel reads (the generic kernel wants
+    // input-major columns padded to a multiple of four outputs)
+    std::vector<float> m_kernelGains;
+};
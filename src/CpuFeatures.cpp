@@ -0,0 +1,73 @@
+#include "CpuFeatures.h"
+
+#ifdef AUDIOROUTER_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace
+{
+#ifdef AUDIOROUTER_X86
+    void QueryCpuid(unsigned int leaf, unsigned int subleaf, unsigned int regs[4])
+    {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuidex(info, (int)leaf, (int)subleaf);
+        for (int i = 0; i < 4; i++)
+            regs[i] = (unsigned int)info[i];
+#else
+        __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    }
+
+    unsigned long long ReadXcr0()
+    {
+#ifdef _MSC_VER
+        return _xgetbv(0);
+#else
+        unsigned int eax, edx;
+        __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return ((unsigned long long)edx << 32) | eax;
+#endif
+    }
+#endif
+
+    CpuFeatures DetectCpuFeatures()
+    {
+        CpuFeatures features;
+
+#ifdef AUDIOROUTER_X86
+        unsigned int regs[4];
+        QueryCpuid(0, 0, regs);
+        const unsigned int maxLeaf = regs[0];
+        if (maxLeaf < 1)
+            return features;
+
+        QueryCpuid(1, 0, regs);
+        features.hasSse2 = (regs[3] & (1u << 26)) != 0;
+        features.hasSse41 = (regs[2] & (1u << 19)) != 0;
+
+        // AVX state must be enabled by the OS (OSXSAVE + XMM/YMM bits in XCR0)
+        const bool osSavesYmm = (regs[2] & (1u << 27)) != 0 && (ReadXcr0() & 0x6) == 0x6;
+        const bool hasAvx = (regs[2] & (1u << 28)) != 0 && osSavesYmm;
+        features.hasFma = hasAvx && (regs[2] & (1u << 12)) != 0;
+
+        if (maxLeaf >= 7)
+        {
+            QueryCpuid(7, 0, regs);
+            features.hasAvx2 = hasAvx && (regs[1] & (1u << 5)) != 0;
+        }
+#endif
+
+        return features;
+    }
+}
+
+const CpuFeatures& GetCpuFeatures()
+{
+    static const CpuFeatures features = DetectCpuFeatures();
+    return features;
+}
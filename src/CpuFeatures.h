@@ -0,0 +1,20 @@
+#pragma once
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define AUDIOROUTER_X86 1
+#endif
+
+// Instruction set extensions usable by the SIMD kernels on this machine.
+// AVX flags are only set when the OS also saves the YMM registers.
+struct CpuFeatures
+{
+    bool hasSse2 = false;
+    bool hasSse41 = false;
+    bool hasAvx2 = false;
+    bool hasFma = false;
+
+    CpuFeatures() = default;
+};
+
+// Detected once on first use
+const CpuFeatures& GetCpuFeatures();
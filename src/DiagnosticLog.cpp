@@ -0,0 +1,151 @@
+#include "DiagnosticLog.h"
+#include "FlightRecorder.h"
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+
+DiagnosticLog::DiagnosticLog(size_t capacity)
+    : m_mask(0)
+    , m_writeIndex(0)
+    , m_dropped(0)
+    , m_readIndex(0)
+{
+    size_t size = 2;
+    while (size < capacity)
+        size <<= 1;
+
+    m_slots.reset(new Slot[size]);
+    m_mask = size - 1;
+    for (size_t i = 0; i < size; i++)
+    {
+        m_slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+bool DiagnosticLog::Push(DiagnosticCode code, const double* args, unsigned int argCount)
+{
+    // Claim a slot: it is free when its sequence equals the write index
+    size_t index = m_writeIndex.load(std::memory_order_relaxed);
+    Slot* slot = nullptr;
+    for (;;)
+    {
+        slot = &m_slots[index & m_mask];
+        size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        intptr_t difference = (intptr_t)sequence - (intptr_t)index;
+        if (difference == 0)
+        {
+            if (m_writeIndex.compare_exchange_weak(index, index + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (difference < 0)
+        {
+            // Consumer has not freed this slot yet: full
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        else
+        {
+            index = m_writeIndex.load(std::memory_order_relaxed);
+        }
+    }
+
+    DiagnosticRecord& record = slot->record;
+    record.code = code;
+    record.argCount = argCount < DiagnosticRecord::MaxArgs ? argCount : DiagnosticRecord::MaxArgs;
+    record.timestampNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    for (unsigned int i = 0; i < record.argCount; i++)
+    {
+        record.args[i] = args[i];
+    }
+
+    // Publish to the consumer
+    slot->sequence.store(index + 1, std::memory_order_release);
+    return true;
+}
+
+bool DiagnosticLog::Pop(DiagnosticRecord* record)
+{
+    size_t index = m_readIndex.load(std::memory_order_relaxed);
+    Slot& slot = m_slots[index & m_mask];
+    if (slot.sequence.load(std::memory_order_acquire) != index + 1)
+        return false;
+
+    *record = slot.record;
+
+    // Hand the slot back to the producers for the next lap
+    slot.sequence.store(index + m_mask + 1, std::memory_order_release);
+    m_readIndex.store(index + 1, std::memory_order_relaxed);
+    return true;
+}
+
+std::wstring DiagnosticLog::Format(const DiagnosticRecord& record)
+{
+    double args[DiagnosticRecord::MaxArgs] = {};
+    for (unsigned int i = 0; i < record.argCount; i++)
+    {
+        args[i] = record.args[i];
+    }
+
+    std::wostringstream msg;
+    switch (record.code)
+    {
+    case DiagnosticCode::CaptureDiscontinuity:
+        msg << L"WARNING: Capture discontinuity (" << (unsigned int)args[0] << L" frames) - input audio was lost";
+        break;
+    case DiagnosticCode::QueueOverflowStarted:
+        msg << L"WARNING: Buffer full (" << (unsigned int)args[0] << L" frames queued) - dropping captured audio";
+        break;
+    case DiagnosticCode::QueueOverflowEnded:
+        msg << L"Buffer has room again (" << (unsigned int)args[0] << L" frames dropped)";
+        break;
+    case DiagnosticCode::CatchUpStarted:
+        msg << std::fixed << std::setprecision(1) << L"Buffer at " << args[1] << L" ms (target " << args[2]
+            << L" ms) - playing at " << args[0] * 100.0 << L"% speed to " << (args[0] > 1.0 ? L"catch up" : L"refill");
+        break;
+    case DiagnosticCode::CatchUpEnded:
+        msg << std::fixed << std::setprecision(2) << L"Buffer back at target after " << args[0] << L" s of time stretching";
+        break;
+    case DiagnosticCode::Glitch:
+    {
+        static const wchar_t* const threadNames[] = { L"audio", L"capture", L"render" };
+        unsigned int thread = (unsigned int)args[0];
+        unsigned int flags = (unsigned int)args[1];
+        msg << L"WARNING: Glitch on the " << (thread < 3 ? threadNames[thread] : L"unknown") << L" thread";
+        const wchar_t* separator = L": ";
+        if (flags & CallbackFlag_FramesDropped)
+        {
+            msg << separator << (unsigned int)args[2] << L" frames dropped";
+            separator = L", ";
+        }
+        if (flags & CallbackFlag_RenderStarved)
+        {
+            msg << separator << L"render buffer ran dry";
+            separator = L", ";
+        }
+        if (flags & CallbackFlag_CaptureDiscontinuity)
+            msg << separator << L"capture discontinuity";
+        break;
+    }
+    case DiagnosticCode::RNNoiseFirstInput:
+        msg << L"RNNoise Input (normalized): avg=" << args[0] << L", max=" << args[1]
+            << L", first 3=[" << args[2] << L", " << args[3] << L", " << args[4] << L"]";
+        break;
+    case DiagnosticCode::RNNoiseFirstOutput:
+        msg << L"RNNoise Output (normalized): avg=" << args[0] << L", max=" << args[1] << L", VAD=" << args[2]
+            << L", first 3=[" << args[3] << L", " << args[4] << L", " << args[5] << L"]";
+        break;
+    case DiagnosticCode::SpeexFirstInput:
+        msg << L"Speex Input: max=" << args[0]
+            << L", first 3=[" << args[1] << L", " << args[2] << L", " << args[3] << L"]";
+        break;
+    case DiagnosticCode::SpeexFirstOutput:
+        msg << L"Speex Output: max=" << args[0] << L", VAD=" << (int)args[1]
+            << L", first 3=[" << args[2] << L", " << args[3] << L", " << args[4] << L"]";
+        break;
+    default:
+        msg << L"Diagnostic code " << (unsigned int)record.code;
+        break;
+    }
+    return msg.str();
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// What a diagnostic record reports; the args each code carries are listed with it
+enum class DiagnosticCode : uint32_t
+{
+    CaptureDiscontinuity,       // Capture device reported a gap: packet frames
+    QueueOverflowStarted,       // Capture->render queue full, newest frames dropped: queued frames
+    QueueOverflowEnded,         // Queue has room again: frames dropped while full
+    CatchUpStarted,             // Buffer level far from target, time stretching: speed, level ms, target ms
+    CatchUpEnded,               // Buffer level back at target: seconds stretched
+    Glitch,                     // Audible problem in a callback: CallbackThread, CallbackFlags, frames dropped
+    RNNoiseFirstInput,          // First RNNoise frame in: mean |x|, peak, first 3 samples
+    RNNoiseFirstOutput,         // First RNNoise frame out: mean |x|, peak, VAD probability, first 3 samples
+    SpeexFirstInput,            // First Speex frame in (int16 scale): peak, first 3 samples
+    SpeexFirstOutput            // First Speex frame out: peak, VAD result, first 3 samples
+};
+
+// Fixed-size binary record: one cache line, no pointers, so pushing is a copy
+struct DiagnosticRecord
+{
+    static const unsigned int MaxArgs = 6;
+
+    DiagnosticCode code;
+    uint32_t argCount;
+    int64_t timestampNs;        // steady_clock
+    double args[MaxArgs];
+};
+
+// Real-time-safe diagnostics channel. Audio threads Push() records in constant time without
+// locks or allocation; a non-real-time consumer Pop()s them and turns them into text with
+// Format(). Several threads may push concurrently (bounded multi-producer queue with a
+// sequence number per slot), one thread pops. When the ring is full the record is dropped
+// and counted instead of waiting.
+class DiagnosticLog
+{
+public:
+    // capacity is rounded up to a power of two; all memory is allocated here
+    explicit DiagnosticLog(size_t capacity = 256);
+
+    // Producer side (any thread, real-time safe). Returns false if the ring was full.
+    bool Push(DiagnosticCode code, const double* args, unsigned int argCount);
+    bool Push(DiagnosticCode code) { return Push(code, nullptr, 0); }
+    bool Push(DiagnosticCode code, double arg) { return Push(code, &arg, 1); }
+
+    // Consumer side (one thread). Returns false when empty.
+    bool Pop(DiagnosticRecord* record);
+
+    // Records lost to a full ring since the last call
+    unsigned long long TakeDroppedCount() { return m_dropped.exchange(0, std::memory_order_relaxed); }
+
+    // Human-readable text for a record (allocates; consumer side only)
+    static std::wstring Format(const DiagnosticRecord& record);
+
+private:
+    static const size_t CacheLineSize = 64;
+
+    struct Slot
+    {
+        std::atomic<size_t> sequence;
+        DiagnosticRecord record;
+    };
+
+    std::unique_ptr<Slot[]> m_slots;
+    size_t m_mask;
+
+    // Producers and the consumer update their indices on separate cache lines (padding
+    // rather than alignas, as in SpscRingBuffer)
+    char m_padding0[CacheLineSize];
+    std::atomic<size_t> m_writeIndex;
+    std::atomic<unsigned long long> m_dropped;
+    char m_padding1[CacheLineSize - sizeof(std::atomic<size_t>) - sizeof(std::atomic<unsigned long long>)];
+    std::atomic<size_t> m_readIndex;
+};
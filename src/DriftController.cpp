@@ -0,0 +1,135 @@
+#include "DriftController.h"
+
+namespace
+{
+    // Smoothing of the raw fill level. Packet-sized sawtooth ripple averages out well within this.
+    const double FillTimeConstantSeconds = 1.0;
+
+    // Time allowed for start-up transients (pre-filled render buffer, first packets) to pass
+    const double SettleSeconds = 2.0;
+
+    // How often the controller output is recomputed
+    const double ControlIntervalSeconds = 0.1;
+
+    // PI gains on the fill error in seconds. Ki = Kp^2 / 4 gives a critically damped loop
+    // with a time constant of about 20 s: slow enough to be inaudible, fast enough to hold
+    // latency within a few ms of the target over hours.
+    const double ProportionalGain = 0.1;
+    const double IntegralGain = ProportionalGain * ProportionalGain / 4.0;
+
+    // Largest change of the correction per control interval
+    const double MaxStepPpm = 2.0;
+
+    // Pace a new target is ramped to, as a share of the sample rate: a fifth of the largest
+    // correction, so the level can keep up with it
+    const double TargetRampPpm = 200.0;
+}
+
+DriftController::DriftController()
+    : m_sampleRate(48000)
+    , m_configuredTarget(0)
+    , m_maxCorrectionPpm(1000.0)
+{
+    Reset();
+}
+
+void DriftController::Configure(unsigned int sampleRate, unsigned int targetFrames, double maxCorrectionPpm)
+{
+    m_sampleRate = sampleRate > 0 ? sampleRate : 48000;
+    m_configuredTarget = targetFrames;
+    m_maxCorrectionPpm = maxCorrectionPpm;
+    Reset();
+}
+
+void DriftController::Reset()
+{
+    m_averageFill = 0.0;
+    m_hasAverage = false;
+    m_targetFill = (double)m_configuredTarget;
+    m_requestedTarget = m_targetFill;
+    m_isLocked = false;
+    m_elapsedSeconds = 0.0;
+    m_secondsSinceControl = 0.0;
+    m_integral = 0.0;
+    m_integralHeld = false;
+    m_correctionPpm = 0.0;
+}
+
+double DriftController::Update(unsigned int fillFrames, unsigned int elapsedFrames)
+{
+    if (elapsedFrames == 0)
+        return m_correctionPpm;
+
+    const double dt = (double)elapsedFrames / (double)m_sampleRate;
+
+    // Fill level estimate
+    if (!m_hasAverage)
+    {
+        m_averageFill = (double)fillFrames;
+        m_hasAverage = true;
+    }
+    else
+    {
+        m_averageFill += (dt / (FillTimeConstantSeconds + dt)) * ((double)fillFrames - m_averageFill);
+    }
+
+    m_elapsedSeconds += dt;
+    m_secondsSinceControl += dt;
+
+    if (!m_isLocked)
+    {
+        if (m_elapsedSeconds < SettleSeconds)
+            return m_correctionPpm;
+
+        // Steer from the level the start-up left and ramp to the target from there: that
+        // difference is the pre-fill's, not drift
+        m_targetFill = m_averageFill;
+        if (m_configuredTarget == 0)
+            m_requestedTarget = m_averageFill;
+        m_isLocked = true;
+        m_secondsSinceControl = 0.0;
+        return m_correctionPpm;
+    }
+
+    if (m_secondsSinceControl < ControlIntervalSeconds)
+        return m_correctionPpm;
+
+    const double interval = m_secondsSinceControl;
+    m_secondsSinceControl = 0.0;
+
+    const bool isRamping = m_targetFill != m_requestedTarget;
+    if (isRamping)
+    {
+        const double rampFrames = TargetRampPpm * 1e-6 * m_sampleRate * interval;
+        if (m_requestedTarget > m_targetFill + rampFrames)
+            m_targetFill += rampFrames;
+        else if (m_requestedTarget < m_targetFill - rampFrames)
+            m_targetFill -= rampFrames;
+        else
+            m_targetFill = m_requestedTarget;
+    }
+
+    // Positive error = too much queued = capture is ahead, so consume input faster
+    const double errorSeconds = (m_averageFill - m_targetFill) / (double)m_sampleRate;
+    const double integral = (m_integralHeld || isRamping) ? m_integral : m_integral + IntegralGain * errorSeconds * interval;
+    const double desiredPpm = (ProportionalGain * errorSeconds + integral) * 1e6;
+
+    double correctionPpm = desiredPpm;
+    if (correctionPpm > m_correctionPpm + MaxStepPpm)
+        correctionPpm = m_correctionPpm + MaxStepPpm;
+    else if (correctionPpm < m_correctionPpm - MaxStepPpm)
+        correctionPpm = m_correctionPpm - MaxStepPpm;
+    if (correctionPpm > m_maxCorrectionPpm)
+        correctionPpm = m_maxCorrectionPpm;
+    else if (correctionPpm < -m_maxCorrectionPpm)
+        correctionPpm = -m_maxCorrectionPpm;
+
+    // Anti-windup: while the output is saturated or still stepping towards the desired value, the
+    // level lags for want of correction, not because of drift. The integral may then only move
+    // back towards what is applied.
+    if (correctionPpm == desiredPpm || (integral - m_integral) * (desiredPpm - correctionPpm) < 0.0)
+        m_integral = integral;
+    m_correctionPpm = correctionPpm;
+
+    return m_correctionPpm;
+}
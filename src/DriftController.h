@@ -0,0 +1,69 @@
+#pragma once
+
+// Keeps the capture->render buffer level steady when the two devices run on independent clocks.
+//
+// The fill level (frames queued between capture and render) is smoothed into an estimate and
+// compared against a target. A PI controller turns the error into a resampling ratio correction
+// in ppm: the proportional part pulls the level back, the integral part converges on the actual
+// clock drift between the devices. The correction changes by a few ppm at a time so the pitch
+// change is inaudible.
+class DriftController
+{
+public:
+    DriftController();
+
+    // sampleRate: rate the fill level is measured at (output rate)
+    // targetFrames: desired fill level; 0 = hold the level measured once the stream has settled
+    // maxCorrectionPpm: limit on the ratio correction
+    void Configure(unsigned int sampleRate, unsigned int targetFrames, double maxCorrectionPpm = 1000.0);
+
+    // Forget all measurements (start of a new stream)
+    void Reset();
+
+    // Feed one fill level observation, taken after elapsedFrames (at sampleRate) were queued.
+    // Returns the ratio correction in ppm to apply (positive = consume input faster).
+    double Update(unsigned int fillFrames, unsigned int elapsedFrames);
+
+    // Current ratio correction in ppm
+    double GetCorrectionPpm() const { return m_correctionPpm; }
+
+    // Estimated clock drift in ppm (positive = capture clock runs faster than render clock)
+    double GetDriftPpm() const { return m_integral * 1e6; }
+
+    // Smoothed fill level in frames
+    double GetAverageFill() const { return m_averageFill; }
+
+    // Level being steered towards: from lock on, ramping from the level measured then to the
+    // target (0 until locked when measuring it automatically)
+    double GetTargetFill() const { return m_targetFill; }
+
+    // Steer towards a new level from now on (adaptive buffering). The level steered towards ramps
+    // there at a pace the correction can follow; the integral is held until it arrives, as the
+    // error on the way is the ramp's and not clock drift.
+    void SetTargetFill(double targetFrames) { m_requestedTarget = targetFrames; }
+
+    // While held, the integral (the drift estimate) is left alone: the level is being moved by
+    // something other than clock drift, such as latency catch-up
+    void SetIntegralHeld(bool held) { m_integralHeld = held; }
+
+    // True once the controller is actively steering
+    bool IsLocked() const { return m_isLocked; }
+
+private:
+    unsigned int m_sampleRate;
+    unsigned int m_configuredTarget;
+    double m_maxCorrectionPpm;
+
+    double m_averageFill;
+    bool m_hasAverage;
+    double m_targetFill;
+    double m_requestedTarget;       // Where m_targetFill is ramping to
+    bool m_isLocked;
+
+    double m_elapsedSeconds;        // Stream time observed so far
+    double m_secondsSinceControl;   // Stream time since the controller last ran
+
+    double m_integral;              // Integral term as a ratio (drift estimate)
+    bool m_integralHeld;
+    double m_correctionPpm;
+};
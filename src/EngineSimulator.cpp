@@ -0,0 +1,146 @@
+#include "EngineSimulator.h"
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <memory>
+#include <random>
+
+namespace
+{
+    std::string Narrow(const wchar_t* text)
+    {
+        std::string result;
+        for (; *text; text++)
+            result += (*text < 0x80) ? (char)*text : '?';
+        return result;
+    }
+
+    // About perHour windows of lengthMs per hour of the run, each starting at a random time
+    void AddRandomWindows(std::vector<SimulatedWindow>& windows, double perHour, double lengthMs, long long endNs,
+                          std::mt19937_64& random)
+    {
+        if (perHour <= 0.0 || lengthMs <= 0.0)
+            return;
+
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        const double expected = perHour * endNs / 3.6e12;
+        const unsigned int count = (unsigned int)(expected + uniform(random));
+        const long long lengthNs = (long long)(lengthMs * 1e6);
+        for (unsigned int i = 0; i < count; i++)
+        {
+            SimulatedWindow window;
+            window.startNs = (long long)(uniform(random) * endNs);
+            window.endNs = window.startNs + lengthNs;
+            windows.push_back(window);
+        }
+        std::sort(windows.begin(), windows.end(),
+                  [](const SimulatedWindow& a, const SimulatedWindow& b) { return a.startNs < b.startNs; });
+    }
+}
+
+EngineSimulator::EngineSimulator()
+{
+}
+
+bool EngineSimulator::Run(const EngineSimulationConfig& config, EngineSimulationResult& result)
+{
+    result = EngineSimulationResult();
+
+    if (config.durationSeconds <= 0.0 || config.sampleSeconds <= 0.0)
+    {
+        result.error = "duration and sample interval must be positive";
+        return false;
+    }
+    if (config.capture.periodFrames == 0 || config.render.periodFrames == 0)
+    {
+        result.error = "device periods must be at least a frame";
+        return false;
+    }
+
+    // The engine carries on without noise suppression it cannot set up, which would go unnoticed here
+    if (config.noiseConfig.isEnabled())
+    {
+        NoiseSuppress noiseSuppress;
+        if (!noiseSuppress.Initialize(config.noiseConfig, config.capture.format.sampleRate, config.capture.format.channels))
+        {
+            result.error = "cannot initialize " + Narrow(NoiseReductionConfig::getTypeName(config.noiseConfig.type)) + " noise suppression";
+            return false;
+        }
+    }
+
+    const long long endNs = (long long)(config.durationSeconds * 1e9);
+    const long long sampleNs = (long long)(config.sampleSeconds * 1e9);
+    const bool splitThreads = config.engineOptions.splitThreads;
+
+    SimulatedDeviceConfig captureConfig = config.capture;
+    SimulatedDeviceConfig renderConfig = config.render;
+    captureConfig.seed = config.seed;
+    renderConfig.seed = config.seed + 1;
+    std::mt19937_64 random(config.seed);
+    AddRandomWindows(captureConfig.stalls, config.stallsPerHour, config.stallMs, endNs, random);
+    if (splitThreads)
+        AddRandomWindows(renderConfig.stalls, config.stallsPerHour, config.stallMs, endNs, random);
+    AddRandomWindows(captureConfig.silentBursts, config.silentBurstsPerHour, config.silentBurstMs, endNs, random);
+
+    // The devices and the monitor only ever write into what is reserved here
+    result.log.glitches.reserve(config.maxGlitchesLogged);
+    result.trajectory.reserve((size_t)(endNs / sampleNs) + 1);
+
+    // The clock outlives the engine, which destroys the devices waiting on it
+    VirtualClock clock;
+    clock.Reset(splitThreads ? 2 : 1, endNs);
+
+    AudioEngine engine;
+    engine.SetOptions(config.engineOptions);
+    if (m_diagnosticCallback)
+        engine.SetStatusCallback(m_diagnosticCallback);
+
+    // Sampled with both engine threads blocked on the clock, so every value is from the same instant
+    const unsigned int outputRate = config.render.format.sampleRate;
+    SimulationLog& log = result.log;
+    std::vector<SimulationSample>& trajectory = result.trajectory;
+    clock.SetMonitor(sampleNs, [&](long long nowNs) {
+        ProcessingStatsSnapshot stats = engine.GetStats();
+        SimulationSample sample;
+        sample.timeSeconds = nowNs / 1e9;
+        sample.bufferLevelMs = engine.GetBufferLevelMs();
+        sample.latencyMs = sample.bufferLevelMs + engine.GetLatency().GetAddedMs();
+        sample.renderBufferMs = log.renderPaddingFrames * 1000.0 / outputRate;
+        sample.bufferTargetMs = stats.bufferTargetMs;
+        sample.driftPpm = engine.GetDriftPpm();
+        sample.underruns = log.underruns;
+        sample.overflows = log.overflows;
+        sample.droppedFrames = stats.droppedFrames;
+        if (trajectory.size() < trajectory.capacity())
+            trajectory.push_back(sample);
+    });
+
+    const std::chrono::steady_clock::time_point wallStart = std::chrono::steady_clock::now();
+    const std::clock_t cpuStart = std::clock();
+
+    std::unique_ptr<SimulatedCaptureBackend> capture(new SimulatedCaptureBackend(captureConfig, &clock, &result.log));
+    std::unique_ptr<SimulatedRenderBackend> render(new SimulatedRenderBackend(renderConfig, &clock, &result.log));
+    if (!engine.Start(std::move(capture), std::move(render), config.noiseConfig))
+    {
+        result.error = "engine did not start";
+        return false;
+    }
+
+    clock.WaitForEnd();
+    engine.Stop();
+
+    result.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    result.cpuSeconds = (double)(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+    result.simulatedSeconds = clock.Now() / 1e9;
+    result.engine = engine.GetLatency();
+    result.stats = engine.GetStats();
+
+    // An overflow is found when the engine next reads, after it began
+    std::stable_sort(result.log.glitches.begin(), result.log.glitches.end(),
+                     [](const SimulatedGlitch& a, const SimulatedGlitch& b) { return a.timeNs < b.timeNs; });
+
+    const TimingHistogram::Summary& callback = result.stats.stages[(int)ProcessingStage::Callback];
+    result.callbackSeconds = callback.count * callback.meanNs / 1e9;
+    result.success = true;
+    return true;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "AudioEngine.h"
+#include "SimulatedBackend.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+// One simulated run: the device pair, the engine setup, and the trouble to put it through
+struct EngineSimulationConfig
+{
+    AudioEngineOptions engineOptions;
+    NoiseReductionConfig noiseConfig;
+    SimulatedDeviceConfig capture;
+    SimulatedDeviceConfig render;           // The engine's render thread waits on its events in split mode
+    double durationSeconds = 3600.0;        // Virtual time simulated
+    double sampleSeconds = 10.0;            // Latency trajectory sample interval
+
+    // Random trouble on top of the devices' scripted windows, placed at random over the run. Stalls
+    // hold the capture events (and, with split threads, separately the render events).
+    double stallsPerHour = 0.0;
+    double stallMs = 50.0;
+    double silentBurstsPerHour = 0.0;
+    double silentBurstMs = 200.0;
+
+    unsigned int maxGlitchesLogged = 1000;  // Glitches listed with their times; the rest are counted
+    uint64_t seed = 1;                      // Seeds the devices and the random trouble
+
+    EngineSimulationConfig() { render.bufferPeriods = 2; }
+};
+
+// The stream as it was at one point of the run
+struct SimulationSample
+{
+    double timeSeconds = 0.0;
+    double latencyMs = 0.0;                 // Buffer level plus the engine's fixed delays
+    double bufferLevelMs = 0.0;             // Smoothed level the engine measures (queue + render buffer)
+    double renderBufferMs = 0.0;            // Render device buffer at the last engine call
+    double bufferTargetMs = 0.0;
+    double driftPpm = 0.0;                  // Drift the engine has measured
+    uint64_t underruns = 0;                 // Counts since the start of the run
+    uint64_t overflows = 0;
+    uint64_t droppedFrames = 0;             // Captured frames the engine dropped (queue full)
+};
+
+struct EngineSimulationResult
+{
+    bool success = false;
+    std::string error;
+
+    double simulatedSeconds = 0.0;
+    double wallSeconds = 0.0;
+    double cpuSeconds = 0.0;                // Process CPU time for the run, simulation included
+    double callbackSeconds = 0.0;           // Time the engine's audio callbacks took
+
+    SimulationLog log;
+    std::vector<SimulationSample> trajectory;
+    AudioEngineLatency engine;
+    ProcessingStatsSnapshot stats;
+
+    double GetSpeedFactor() const { return wallSeconds > 0.0 ? simulatedSeconds / wallSeconds : 0.0; }
+    double GetCpuSecondsPerHour() const { return simulatedSeconds > 0.0 ? cpuSeconds * 3600.0 / simulatedSeconds : 0.0; }
+    double GetCallbackSecondsPerHour() const { return simulatedSeconds > 0.0 ? callbackSeconds * 3600.0 / simulatedSeconds : 0.0; }
+};
+
+// Runs the engine, unchanged, between a simulated capture and render device on a VirtualClock:
+// as fast as the engine can process the audio, and the same way every time for the same config.
+// Device periods, packet sizes, clock skew, event jitter, missed events, stalls and silent
+// packets are all programmable, so timing trouble seen on real devices can be reproduced.
+class EngineSimulator
+{
+public:
+    EngineSimulator();
+
+    // Run config to the end of its duration. Returns result.success.
+    bool Run(const EngineSimulationConfig& config, EngineSimulationResult& result);
+
+    // Set callback for the engine's diagnostic messages (timestamped in wall clock time)
+    void SetDiagnosticCallback(std::function<void(const std::wstring&)> callback) { m_diagnosticCallback = callback; }
+
+private:
+    std::function<void(const std::wstring&)> m_diagnosticCallback;
+};
@@ -0,0 +1,82 @@
+#include "FileBackend.h"
+#include <cstring>
+
+//
+// FileCaptureBackend
+//
+
+AudioFormat FileCaptureBackend::ProbeFormat(const std::string& path)
+{
+    WavReader probe;
+    if (probe.Open(path))
+        return probe.GetFormat();
+    return AudioFormat();
+}
+
+FileCaptureBackend::FileCaptureBackend(const std::string& path, unsigned int periodFrames, bool loop)
+    : PacedCaptureBackend(ProbeFormat(path), periodFrames)
+    , m_loop(loop)
+    , m_isFinished(false)
+{
+    m_reader.Open(path);
+}
+
+void FileCaptureBackend::FillPacket(void* data, unsigned int frameCount, unsigned int* flags)
+{
+    const unsigned int blockAlign = m_format.getBlockAlign();
+    unsigned char* pData = (unsigned char*)data;
+    unsigned int framesRead = 0;
+
+    while (framesRead < frameCount && !m_isFinished)
+    {
+        unsigned int got = m_reader.Read(pData + framesRead * blockAlign, frameCount - framesRead);
+        framesRead += got;
+
+        if (got == 0)
+        {
+            if (m_loop && m_reader.GetFrameCount() > 0 && m_reader.Rewind())
+                continue;
+            m_isFinished = true;
+        }
+    }
+
+    if (framesRead < frameCount)
+        std::memset(pData + framesRead * blockAlign, 0, (frameCount - framesRead) * blockAlign);
+
+    if (framesRead == 0)
+        *flags |= AudioBufferFlag_Silent;
+}
+
+//
+// FileRenderBackend
+//
+
+FileRenderBackend::FileRenderBackend(const std::string& path, const AudioFormat& format, unsigned int periodFrames, unsigned int bufferPeriods)
+    : PacedRenderBackend(format, periodFrames, bufferPeriods)
+{
+    m_writer.Open(path, format);
+    m_silence.resize(periodFrames * format.getBlockAlign());
+}
+
+FileRenderBackend::~FileRenderBackend()
+{
+    m_writer.Close();
+}
+
+void FileRenderBackend::ConsumeFrames(const void* data, unsigned int frameCount)
+{
+    if (data)
+    {
+        m_writer.Write(data, frameCount);
+        return;
+    }
+
+    // Underrun: the listener hears silence, so record silence
+    const unsigned int periodFrames = GetPeriodFrameCount();
+    while (frameCount > 0)
+    {
+        unsigned int chunk = frameCount < periodFrames ? frameCount : periodFrames;
+        m_writer.Write(m_silence.data(), chunk);
+        frameCount -= chunk;
+    }
+}
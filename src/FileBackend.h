@@ -0,0 +1,47 @@
+#pragma once
+
+#include "PacedBackend.h"
+#include "WavFile.h"
+
+// Capture device that streams a WAV file at the file's own rate.
+// Once the file is exhausted it keeps delivering silent packets (optionally loops instead).
+class FileCaptureBackend : public PacedCaptureBackend
+{
+public:
+    // Opens the file to learn its format; check IsOpen() afterwards
+    FileCaptureBackend(const std::string& path, unsigned int periodFrames, bool loop = false);
+
+    bool IsOpen() const { return m_reader.IsOpen(); }
+    bool IsFinished() const { return m_isFinished; }
+
+    const wchar_t* GetName() const override { return L"File Capture"; }
+
+protected:
+    void FillPacket(void* data, unsigned int frameCount, unsigned int* flags) override;
+
+private:
+    static AudioFormat ProbeFormat(const std::string& path);
+
+    WavReader m_reader;
+    bool m_loop;
+    bool m_isFinished;
+};
+
+// Render device that records everything it plays (including underrun silence) to a WAV file
+class FileRenderBackend : public PacedRenderBackend
+{
+public:
+    FileRenderBackend(const std::string& path, const AudioFormat& format, unsigned int periodFrames, unsigned int bufferPeriods = 2);
+    ~FileRenderBackend() override;
+
+    bool IsOpen() const { return m_writer.IsOpen(); }
+
+    const wchar_t* GetName() const override { return L"File Render"; }
+
+protected:
+    void ConsumeFrames(const void* data, unsigned int frameCount) override;
+
+private:
+    WavWriter m_writer;
+    std::vector<unsigned char> m_silence;
+};
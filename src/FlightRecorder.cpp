@@ -0,0 +1,160 @@
+#include "FlightRecorder.h"
+#include <cstdio>
+
+namespace
+{
+    const char* GetThreadName(uint32_t thread)
+    {
+        switch ((CallbackThread)thread)
+        {
+        case CallbackThread::Audio: return "Audio";
+        case CallbackThread::Capture: return "Capture";
+        case CallbackThread::Render: return "Render";
+        default: return "Unknown";
+        }
+    }
+
+    const char* GetTraceStageName(unsigned int stage)
+    {
+        switch ((ProcessingStage)stage)
+        {
+        case ProcessingStage::InputConversion: return "Input conversion";
+        case ProcessingStage::NoiseSuppression: return "Noise suppression";
+        case ProcessingStage::ChannelMix: return "Channel mix";
+        case ProcessingStage::Resample: return "Resample";
+        case ProcessingStage::TimeStretch: return "Time stretch";
+        case ProcessingStage::OutputConversion: return "Output conversion";
+        default: return "Unknown";
+        }
+    }
+
+    // Trace timestamps are microseconds
+    double ToTraceUs(int64_t ns, int64_t originNs)
+    {
+        return (ns - originNs) / 1000.0;
+    }
+
+    void WriteInstant(FILE* file, const char* name, uint32_t thread, double tsUs)
+    {
+        std::fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"glitch\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%u,\"ts\":%.3f}",
+                     name, thread, tsUs);
+    }
+}
+
+FlightRecorder::FlightRecorder(size_t capacity)
+    : m_mask(0)
+    , m_writeIndex(0)
+{
+    size_t size = 2;
+    while (size < capacity)
+        size <<= 1;
+
+    m_slots.reset(new Slot[size]);
+    m_mask = size - 1;
+    Reset();
+}
+
+void FlightRecorder::Record(const CallbackRecord& record)
+{
+    uint64_t index = m_writeIndex.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = m_slots[index & m_mask];
+
+    // Mark the slot as being written before touching the record
+    slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.record = record;
+    slot.sequence.store(2 * (index + 1), std::memory_order_release);
+}
+
+void FlightRecorder::Reset()
+{
+    for (size_t i = 0; i <= m_mask; i++)
+    {
+        m_slots[i].sequence.store(0, std::memory_order_relaxed);
+    }
+    m_writeIndex.store(0, std::memory_order_relaxed);
+}
+
+std::vector<CallbackRecord> FlightRecorder::Snapshot() const
+{
+    const uint64_t capacity = m_mask + 1;
+    uint64_t end = m_writeIndex.load(std::memory_order_acquire);
+    uint64_t begin = end > capacity ? end - capacity : 0;
+
+    std::vector<CallbackRecord> records;
+    records.reserve((size_t)(end - begin));
+    for (uint64_t index = begin; index < end; index++)
+    {
+        const Slot& slot = m_slots[index & m_mask];
+        uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != 2 * (index + 1))
+            continue;   // Still being written, or already overwritten by a later lap
+
+        CallbackRecord record = slot.record;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence)
+            continue;
+        records.push_back(record);
+    }
+    return records;
+}
+
+bool FlightRecorder::WriteChromeTrace(const std::string& path, int64_t originNs) const
+{
+    std::vector<CallbackRecord> records = Snapshot();
+
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (!file)
+        return false;
+
+    std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    std::fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"AudioRouter\"}}");
+    for (uint32_t thread = (uint32_t)CallbackThread::Audio; thread <= (uint32_t)CallbackThread::Render; thread++)
+    {
+        std::fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                     thread, GetThreadName(thread));
+    }
+
+    for (const CallbackRecord& record : records)
+    {
+        double wakeUs = ToTraceUs(record.wakeNs, originNs);
+        double endUs = ToTraceUs(record.endNs, originNs);
+
+        std::fprintf(file, ",\n{\"name\":\"Callback\",\"cat\":\"audio\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                           "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"packets\":%u,\"captured\":%u,\"padding\":%u,"
+                           "\"rendered\":%u,\"queued\":%u,\"dropped\":%u,\"flags\":%u}}",
+                     record.thread, wakeUs, endUs - wakeUs, record.packetsCaptured, record.framesCaptured, record.renderPadding,
+                     record.framesRendered, record.queuedFrames, record.framesDropped, record.flags);
+
+        // Only durations are recorded per stage: lay the processing stages out back to back from
+        // the wake-up and output conversion against the end of the callback, where they ran
+        double stageUs = wakeUs;
+        for (unsigned int stage = 0; stage < CallbackRecord::StageCount; stage++)
+        {
+            if (record.stageNs[stage] == 0)
+                continue;
+
+            double durationUs = record.stageNs[stage] / 1000.0;
+            double startUs = stage == (unsigned int)ProcessingStage::OutputConversion ? endUs - durationUs : stageUs;
+            std::fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"audio\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                               "\"ts\":%.3f,\"dur\":%.3f}",
+                         GetTraceStageName(stage), record.thread, startUs, durationUs);
+            stageUs = startUs + durationUs;
+        }
+
+        std::fprintf(file, ",\n{\"name\":\"Buffer\",\"ph\":\"C\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,"
+                           "\"args\":{\"queued\":%u,\"padding\":%u}}",
+                     record.thread, wakeUs, record.queuedFrames, record.renderPadding);
+
+        if (record.flags & CallbackFlag_FramesDropped)
+            WriteInstant(file, "Frames dropped", record.thread, wakeUs);
+        if (record.flags & CallbackFlag_RenderStarved)
+            WriteInstant(file, "Render starved", record.thread, wakeUs);
+        if (record.flags & CallbackFlag_CaptureDiscontinuity)
+            WriteInstant(file, "Capture discontinuity", record.thread, wakeUs);
+    }
+
+    std::fprintf(file, "\n]}\n");
+    bool written = std::ferror(file) == 0;
+    return std::fclose(file) == 0 && written;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "ProcessingStats.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Thread that serviced a callback
+enum class CallbackThread : uint32_t
+{
+    Audio,      // Single-thread mode: capture and render
+    Capture,
+    Render
+};
+
+// Something audible went wrong during a callback
+enum CallbackFlags : uint32_t
+{
+    CallbackFlag_FramesDropped = 0x1,           // Capture->render queue full, captured frames discarded
+    CallbackFlag_RenderStarved = 0x2,           // Render buffer had run dry (device played silence)
+    CallbackFlag_CaptureDiscontinuity = 0x4     // Capture device reported a gap
+};
+
+// One wake-up of an audio thread. Fixed size, no pointers, so recording is a copy.
+struct CallbackRecord
+{
+    static const unsigned int StageCount = (unsigned int)ProcessingStage::Callback;
+
+    int64_t wakeNs;             // steady_clock, as ProcessingStats::Now()
+    int64_t endNs;
+    uint32_t thread;            // CallbackThread
+    uint32_t flags;             // CallbackFlags
+    uint32_t packetsCaptured;   // Capture packets drained in this wake-up
+    uint32_t framesCaptured;
+    uint32_t renderPadding;     // GetCurrentPadding() before writing (0 = device ran dry)
+    uint32_t framesRendered;
+    uint32_t queuedFrames;      // Capture->render queue level at the end of the callback
+    uint32_t framesDropped;
+    uint32_t stageNs[StageCount];
+};
+
+// Fixed-memory flight recorder of the most recent callbacks. Audio threads Record() in constant
+// time without locks or allocation, overwriting the oldest entry; any other thread can take a
+// Snapshot() or write the history as Chrome trace-event JSON (chrome://tracing, Perfetto).
+// Every slot carries a sequence number that is odd while its record is being written, so a
+// reader skips entries that are torn by a concurrent write.
+class FlightRecorder
+{
+public:
+    // capacity is rounded up to a power of two; all memory is allocated here
+    explicit FlightRecorder(size_t capacity = 4096);
+
+    // Any audio thread, real-time safe
+    void Record(const CallbackRecord& record);
+
+    // Forget the history (start of a stream; nothing may be recording)
+    void Reset();
+
+    // Recorded callbacks, oldest first (allocates; not for the audio threads)
+    std::vector<CallbackRecord> Snapshot() const;
+
+    // Write Snapshot() as Chrome trace-event JSON, timestamps relative to originNs
+    bool WriteChromeTrace(const std::string& path, int64_t originNs) const;
+
+private:
+    struct Slot
+    {
+        std::atomic<uint64_t> sequence;     // 2 * (index + 1) once written, odd while writing
+        CallbackRecord record;
+    };
+
+    std::unique_ptr<Slot[]> m_slots;
+    size_t m_mask;
+    std::atomic<uint64_t> m_writeIndex;
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "AudioFormat.h"
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <functional>
+
+// Flags reported with a captured packet (mirrors AUDCLNT_BUFFERFLAGS_*)
+enum AudioBufferFlags : unsigned int
+{
+    AudioBufferFlag_None = 0,
+    AudioBufferFlag_Silent = 0x1,         // Packet contents should be treated as silence
+    AudioBufferFlag_Discontinuity = 0x2   // Data is not continuous with the previous packet
+};
+
+// Result of waiting for a device event
+enum class BackendWaitResult
+{
+    Ready,        // Device signalled that it needs service
+    Timeout,      // Nothing happened within the timeout
+    Interrupted,  // Interrupt() was called (engine is stopping)
+    Error         // Device failed or was lost
+};
+
+// Common part of capture and render backends.
+// A backend owns one opened device (or a simulated/file-backed stand-in for one)
+// in a fixed format. The engine drives it from its audio thread(s).
+class IAudioBackend
+{
+public:
+    virtual ~IAudioBackend() = default;
+
+    // Format of the data exchanged through GetBuffer/ReleaseBuffer
+    virtual const AudioFormat& GetFormat() const = 0;
+
+    // Total size of the device buffer in frames
+    virtual unsigned int GetBufferFrameCount() const = 0;
+
+    // Size of one device period (event interval) in frames
+    virtual unsigned int GetPeriodFrameCount() const = 0;
+
+    // Start/stop the device stream
+    virtual bool Start() = 0;
+    virtual void Stop() = 0;
+
+    // Block until the device signals that it needs service, Interrupt() is called, or the timeout expires
+    virtual BackendWaitResult WaitForEvent(unsigned int timeoutMs) = 0;
+
+    // Wake every thread blocked in WaitForEvent. Stays signalled until Start() is called again.
+    virtual void Interrupt() = 0;
+
+    // Get the name of this backend for display purposes
+    virtual const wchar_t* GetName() const = 0;
+
+    // Current time in ns on the clock the device's events are timed by. The engine times render
+    // buffer levels with it; devices on a simulated clock override it.
+    virtual long long GetClockNs() const
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Set callback for diagnostic messages
+    virtual void SetDiagnosticCallback(std::function<void(const std::wstring&)> callback) = 0;
+};
+
+// Capture side (mirrors IAudioCaptureClient)
+class IAudioCaptureBackend : public IAudioBackend
+{
+public:
+    // Get the next captured packet. Returns false on device error.
+    // frameCount is set to 0 when no packet is available.
+    virtual bool GetBuffer(const void** data, unsigned int* frameCount, unsigned int* flags) = 0;
+
+    // Release a packet obtained from GetBuffer (frameCount must match)
+    virtual void ReleaseBuffer(unsigned int frameCount) = 0;
+
+    // Size of the packet GetBuffer would return next, without taking it; 0 = none pending.
+    // Call it with no packet held (after ReleaseBuffer), as IAudioCaptureClient documents.
+    // Returns false on device error.
+    virtual bool GetNextPacketSize(unsigned int* frameCount) = 0;
+};
+
+// Render side (mirrors IAudioRenderClient + IAudioClient::GetCurrentPadding)
+class IAudioRenderBackend : public IAudioBackend
+{
+public:
+    // Frames queued in the device buffer that have not been played yet
+    virtual bool GetCurrentPadding(unsigned int* paddingFrames) = 0;
+
+    // Frames the device has played since Start(), as of now: unlike the padding of a device that
+    // takes a period at a time, it advances between period boundaries too (mirrors
+    // IAudioClock::GetPosition). False when the device cannot tell.
+    virtual bool GetPlayedFrames(uint64_t* playedFrames) { (void)playedFrames; return false; }
+
+    // Get a pointer to frameCount writable frames. Fails if they do not fit.
+    virtual bool GetBuffer(unsigned int frameCount, void** data) = 0;
+
+    // Commit frames written to the buffer obtained from GetBuffer
+    virtual void ReleaseBuffer(unsigned int frameCount, unsigned int flags) = 0;
+};
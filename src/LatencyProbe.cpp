@@ -0,0 +1,219 @@
+#include "LatencyProbe.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <thread>
+
+namespace
+{
+    // A burst counts as found when the output matches it at least this well (normalized
+    // correlation); below that the chain has changed it beyond timing reliably
+    const double MinCorrelation = 0.5;
+
+    // Buffer level is sampled this often while the bursts go through
+    const unsigned int LevelSampleMs = 10;
+
+    double Median(std::vector<double> values)
+    {
+        if (values.empty())
+            return 0.0;
+        std::sort(values.begin(), values.end());
+        size_t middle = values.size() / 2;
+        return values.size() % 2 ? values[middle] : 0.5 * (values[middle - 1] + values[middle]);
+    }
+
+    std::string Narrow(const wchar_t* text)
+    {
+        std::string result;
+        for (; *text; text++)
+            result += (*text < 0x80) ? (char)*text : '?';
+        return result;
+    }
+}
+
+LatencyProbe::LatencyProbe()
+{
+}
+
+bool LatencyProbe::Run(const LatencyProbeConfig& config, LatencyProbeResult& result)
+{
+    result = LatencyProbeResult();
+
+    // Bands both rates carry, leaving the resampler's transition band out
+    const double bandLimit = 0.45 * std::min(config.inputRate, config.outputRate);
+    LoopbackSignal signal(config.stimulus, bandLimit, config.settleMs / 1000.0, config.intervalMs / 1000.0);
+    if (config.intervalMs / 1000.0 < config.maxLatencyMs / 1000.0 + 2.0 * signal.GetBurstSeconds())
+    {
+        result.error = "burst interval must be longer than the longest delay searched for plus two bursts";
+        return false;
+    }
+    if (config.bursts == 0)
+    {
+        result.error = "no bursts to send";
+        return false;
+    }
+
+    // The engine carries on without noise suppression it cannot set up, which would go unnoticed here
+    if (config.noiseConfig.isEnabled())
+    {
+        NoiseSuppress noiseSuppress;
+        if (!noiseSuppress.Initialize(config.noiseConfig, config.inputRate, config.inputChannels))
+        {
+            result.error = "cannot initialize " + Narrow(NoiseReductionConfig::getTypeName(config.noiseConfig.type)) + " noise suppression";
+            return false;
+        }
+    }
+
+    // Room for everything played until the last burst has had time to come out, and some slack
+    const double runSeconds = (config.settleMs + (double)config.bursts * config.intervalMs) / 1000.0;
+    LoopbackRecording recording;
+    recording.played.assign((size_t)((runSeconds + 1.0) * config.outputRate * (1.0 + std::fabs(config.outputSkewPpm) * 1e-6)), 0.0f);
+
+    AudioFormat inputFormat(config.sampleFormat, config.inputRate, config.inputChannels);
+    AudioFormat outputFormat(config.sampleFormat, config.outputRate, config.outputChannels);
+    std::unique_ptr<LoopbackCaptureBackend> capture(
+        new LoopbackCaptureBackend(inputFormat, config.capturePeriodFrames, config.captureBufferPeriods, signal, &recording));
+    std::unique_ptr<LoopbackRenderBackend> render(
+        new LoopbackRenderBackend(outputFormat, config.renderPeriodFrames, config.renderBufferPeriods, &recording));
+    capture->SetClockSkewPpm(config.inputSkewPpm);
+    render->SetClockSkewPpm(config.outputSkewPpm);
+    capture->SetJitter(config.jitterMs, config.seed);
+    render->SetJitter(config.jitterMs, config.seed + 1);
+
+    AudioEngine engine;
+    engine.SetOptions(config.engineOptions);
+    if (m_diagnosticCallback)
+        engine.SetStatusCallback(m_diagnosticCallback);
+    if (!engine.Start(std::move(capture), std::move(render), config.noiseConfig))
+    {
+        result.error = "engine did not start";
+        return false;
+    }
+
+    // Run until the last burst has had the longest delay to come out; average the buffer level
+    // from the first burst on
+    const std::chrono::steady_clock::time_point firstBurst = recording.captureStart +
+        std::chrono::milliseconds(config.settleMs);
+    const std::chrono::steady_clock::time_point end = recording.captureStart +
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(runSeconds + config.maxLatencyMs / 1000.0 + 0.1));
+    double levelSum = 0.0;
+    unsigned int levelSamples = 0;
+    while (std::chrono::steady_clock::now() < end)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(LevelSampleMs));
+        if (std::chrono::steady_clock::now() >= firstBurst)
+        {
+            levelSum += engine.GetBufferLevelMs();
+            levelSamples++;
+        }
+    }
+    engine.Stop();
+
+    result.engine = engine.GetLatency();
+    result.stats = engine.GetStats();
+    result.bufferLevelMs = levelSamples > 0 ? levelSum / levelSamples : 0.0;
+
+    std::vector<double> correlations;
+    for (unsigned int burst = 0; burst < config.bursts; burst++)
+    {
+        result.burstsSent++;
+        double latencyMs = 0.0;
+        double correlation = 0.0;
+        if (FindBurst(signal, burst, recording, config, &latencyMs, &correlation))
+        {
+            result.burstLatencyMs.push_back(latencyMs);
+            correlations.push_back(correlation);
+        }
+    }
+
+    result.burstsFound = (unsigned int)result.burstLatencyMs.size();
+    if (result.burstsFound == 0)
+    {
+        result.error = "no burst found in the output";
+        return false;
+    }
+
+    result.latencyMs = Median(result.burstLatencyMs);
+    result.minLatencyMs = *std::min_element(result.burstLatencyMs.begin(), result.burstLatencyMs.end());
+    result.maxLatencyMs = *std::max_element(result.burstLatencyMs.begin(), result.burstLatencyMs.end());
+    result.correlation = Median(correlations);
+    result.success = true;
+    return true;
+}
+
+bool LatencyProbe::FindBurst(const LoopbackSignal& signal, unsigned int burst, const LoopbackRecording& recording,
+                             const LatencyProbeConfig& config, double* latencyMs, double* correlation) const
+{
+    // Render frame m is played at playOffset + m / renderRate seconds after the capture clock
+    // started: the render device plays each period over the period after it takes it
+    const double renderRate = config.outputRate * (1.0 + config.outputSkewPpm * 1e-6);
+    const double playOffset = std::chrono::duration<double>(recording.renderStart - recording.captureStart).count() +
+                              config.renderPeriodFrames / renderRate;
+
+    // The burst sampled on the render clock, as it would be played with no delay at all
+    const double start = signal.GetBurstStart(burst);
+    const long long first = (long long)std::ceil((start - playOffset) * renderRate);
+    const long long last = (long long)std::floor((start + signal.GetBurstSeconds() - playOffset) * renderRate);
+    const long long maxLag = (long long)(config.maxLatencyMs / 1000.0 * renderRate);
+    if (first < 0 || last + maxLag + 1 >= (long long)recording.playedFrames)
+        return false;
+
+    const size_t length = (size_t)(last - first + 1);
+    std::vector<double> reference(length);
+    double referenceEnergy = 0.0;
+    for (size_t i = 0; i < length; i++)
+    {
+        reference[i] = signal.EvaluateBurst(playOffset + (first + (long long)i) / renderRate - start);
+        referenceEnergy += reference[i] * reference[i];
+    }
+
+    // Cross-correlate with the recording at every delay up to maxLag frames
+    const float* played = recording.played.data() + first;
+    double playedEnergy = 0.0;
+    for (size_t i = 0; i < length; i++)
+        playedEnergy += (double)played[i] * played[i];
+
+    std::vector<double> products((size_t)maxLag + 1);
+    long long bestLag = 0;
+    double bestNormalized = 0.0;
+    for (long long lag = 0; lag <= maxLag; lag++)
+    {
+        const float* window = played + lag;
+        double sum = 0.0;
+        for (size_t i = 0; i < length; i++)
+            sum += reference[i] * window[i];
+        products[(size_t)lag] = sum;
+
+        if (sum > products[(size_t)bestLag] || lag == 0)
+        {
+            bestLag = lag;
+            bestNormalized = playedEnergy > 0.0 ? sum / std::sqrt(referenceEnergy * playedEnergy) : 0.0;
+        }
+
+        // Slide the energy of the window along by a frame
+        playedEnergy += (double)window[length] * window[length] - (double)window[0] * window[0];
+        if (playedEnergy < 0.0)
+            playedEnergy = 0.0;
+    }
+
+    if (bestNormalized < MinCorrelation)
+        return false;
+
+    // Refine to a fraction of a frame with a parabola through the peak and its neighbours
+    double offset = 0.0;
+    if (bestLag > 0 && bestLag < maxLag)
+    {
+        double before = products[(size_t)bestLag - 1];
+        double peak = products[(size_t)bestLag];
+        double after = products[(size_t)bestLag + 1];
+        double curvature = before - 2.0 * peak + after;
+        if (curvature < 0.0)
+            offset = 0.5 * (before - after) / curvature;
+    }
+
+    *latencyMs = (bestLag + offset) * 1000.0 / renderRate;
+    *correlation = bestNormalized;
+    return true;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "AudioEngine.h"
+#include "LoopbackBackend.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+// One device pair and engine setup to measure
+struct LatencyProbeConfig
+{
+    AudioEngineOptions engineOptions;
+    NoiseReductionConfig noiseConfig;
+    LoopbackStimulus stimulus = LoopbackStimulus::Chirp;
+    SampleFormat sampleFormat = SampleFormat::Float32;  // Both devices
+    unsigned int inputRate = 48000;
+    unsigned int outputRate = 48000;
+    unsigned int inputChannels = 2;
+    unsigned int outputChannels = 2;
+    unsigned int capturePeriodFrames = 480;
+    unsigned int renderPeriodFrames = 480;
+    unsigned int captureBufferPeriods = 4;
+    unsigned int renderBufferPeriods = 2;
+    double inputSkewPpm = 0.0;        // Capture device clock off nominal
+    double outputSkewPpm = 0.0;       // Render device clock off nominal
+    double jitterMs = 0.0;            // Each device event is serviced up to this late
+    unsigned int seed = 1;            // Seeds the jitter, so runs can be repeated
+    unsigned int settleMs = 1000;     // Stream runs this long before the first burst
+    unsigned int intervalMs = 500;    // Between bursts
+    unsigned int bursts = 8;
+    unsigned int maxLatencyMs = 300;  // Longest delay searched for
+
+    LatencyProbeConfig() = default;
+};
+
+// What one run measured
+struct LatencyProbeResult
+{
+    bool success = false;
+    std::string error;
+
+    unsigned int burstsSent = 0;
+    unsigned int burstsFound = 0;     // Bursts that correlate with the output well enough to time
+    std::vector<double> burstLatencyMs;  // Input-to-output delay of each burst found
+
+    double latencyMs = 0.0;           // Median of burstLatencyMs
+    double minLatencyMs = 0.0;
+    double maxLatencyMs = 0.0;
+    double correlation = 0.0;         // Median normalized correlation peak (1 = output is the burst, delayed)
+
+    // Where the delay comes from: the engine's fixed delays, and the buffer level it ran at
+    // (capture-to-speaker audio in the queue and render buffer) averaged over the bursts
+    AudioEngineLatency engine;
+    double bufferLevelMs = 0.0;
+    ProcessingStatsSnapshot stats;
+
+    // Part of latencyMs the parts above do not account for: packet timing and scheduling
+    double GetUnexplainedMs() const
+    {
+        return latencyMs - (bufferLevelMs + engine.GetAddedMs());
+    }
+};
+
+// Measures the true input-to-output delay of the engine: runs it in real time between a
+// loopback capture device that sends bursts (clicks or chirps) and a render device that records
+// what it plays, then finds each burst in the recording by cross-correlation. Both devices
+// sample the bursts on their own clocks, so rate conversion, clock skew and period sizes are
+// all part of the measurement.
+class LatencyProbe
+{
+public:
+    LatencyProbe();
+
+    // Run config (takes about settleMs + bursts * intervalMs of wall clock time). Returns
+    // result.success.
+    bool Run(const LatencyProbeConfig& config, LatencyProbeResult& result);
+
+    // Set callback for the engine's diagnostic messages
+    void SetDiagnosticCallback(std::function<void(const std::wstring&)> callback) { m_diagnosticCallback = callback; }
+
+private:
+    // Find burst in the recording. Returns false when nothing correlates well enough.
+    bool FindBurst(const LoopbackSignal& signal, unsigned int burst, const LoopbackRecording& recording,
+                   const LatencyProbeConfig& config, double* latencyMs, double* correlation) const;
+
+    std::function<void(const std::wstring&)> m_diagnosticCallback;
+};
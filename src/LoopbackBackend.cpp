@@ -0,0 +1,178 @@
+#include "LoopbackBackend.h"
+#include <cmath>
+#include <thread>
+
+namespace
+{
+    const double Pi = 3.14159265358979323846;
+    const float Amplitude = 0.5f;
+
+    const double ImpulseSeconds = 0.004;
+    const double ChirpSeconds = 0.030;
+    const double ChirpStartHz = 200.0;
+
+    // Uniform delay in [0, jitterMs) ms, as a sleep
+    void SleepJitter(double jitterMs, std::minstd_rand& random)
+    {
+        if (jitterMs <= 0.0)
+            return;
+        double delayMs = jitterMs * (random() - random.min()) / ((double)random.max() - random.min() + 1.0);
+        std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(delayMs));
+    }
+}
+
+//
+// LoopbackSignal
+//
+
+LoopbackSignal::LoopbackSignal(LoopbackStimulus stimulus, double bandLimitHz, double firstBurstSeconds, double intervalSeconds)
+    : m_stimulus(stimulus)
+    , m_bandLimit(bandLimitHz)
+    , m_burstSeconds(stimulus == LoopbackStimulus::Impulse ? ImpulseSeconds : ChirpSeconds)
+    , m_firstBurst(firstBurstSeconds)
+    , m_interval(intervalSeconds)
+{
+}
+
+float LoopbackSignal::Evaluate(double t) const
+{
+    if (t < m_firstBurst)
+        return 0.0f;
+    double sinceFirst = t - m_firstBurst;
+    return EvaluateBurst(sinceFirst - std::floor(sinceFirst / m_interval) * m_interval);
+}
+
+float LoopbackSignal::EvaluateBurst(double t) const
+{
+    if (t < 0.0 || t >= m_burstSeconds)
+        return 0.0f;
+
+    double window = 0.5 - 0.5 * std::cos(2.0 * Pi * t / m_burstSeconds);
+    if (m_stimulus == LoopbackStimulus::Impulse)
+    {
+        // sinc through the band limit, centred in the burst
+        double x = 2.0 * m_bandLimit * (t - 0.5 * m_burstSeconds);
+        double sinc = x == 0.0 ? 1.0 : std::sin(Pi * x) / (Pi * x);
+        return (float)(Amplitude * window * sinc);
+    }
+
+    // Instantaneous frequency rises linearly from ChirpStartHz to the band limit
+    double sweepRate = (m_bandLimit - ChirpStartHz) / m_burstSeconds;
+    double phase = 2.0 * Pi * (ChirpStartHz * t + 0.5 * sweepRate * t * t);
+    return (float)(Amplitude * window * std::sin(phase));
+}
+
+//
+// LoopbackCaptureBackend
+//
+
+LoopbackCaptureBackend::LoopbackCaptureBackend(const AudioFormat& format, unsigned int periodFrames, unsigned int bufferPeriods,
+                                               const LoopbackSignal& signal, LoopbackRecording* recording)
+    : PacedCaptureBackend(format, periodFrames, bufferPeriods)
+    , m_signal(signal)
+    , m_recording(recording)
+    , m_jitterMs(0.0)
+{
+    m_converter.Configure(format.sampleFormat);
+    m_scratch.resize((size_t)periodFrames * format.channels);
+}
+
+void LoopbackCaptureBackend::SetJitter(double jitterMs, unsigned int seed)
+{
+    m_jitterMs = jitterMs;
+    m_random.seed(seed);
+}
+
+bool LoopbackCaptureBackend::Start()
+{
+    bool started = PacedCaptureBackend::Start();
+    m_recording->captureStart = GetStartTime();
+    return started;
+}
+
+BackendWaitResult LoopbackCaptureBackend::WaitForEvent(unsigned int timeoutMs)
+{
+    BackendWaitResult result = PacedCaptureBackend::WaitForEvent(timeoutMs);
+    if (result == BackendWaitResult::Ready)
+        SleepJitter(m_jitterMs, m_random);
+    return result;
+}
+
+void LoopbackCaptureBackend::FillPacket(void* data, unsigned int frameCount, unsigned int*)
+{
+    // Sample the signal at the times this device's clock captured the packet's frames
+    const double clockRate = m_format.sampleRate * (1.0 + GetClockSkewPpm() * 1e-6);
+    const uint64_t firstFrame = GetPacketIndex() * GetPeriodFrameCount();
+    const unsigned int channels = m_format.channels;
+    for (unsigned int i = 0; i < frameCount; i++)
+    {
+        float value = m_signal.Evaluate((firstFrame + i) / clockRate);
+        for (unsigned int ch = 0; ch < channels; ch++)
+            m_scratch[i * channels + ch] = value;
+    }
+    m_converter.FromFloat(m_scratch.data(), data, (size_t)frameCount * channels);
+}
+
+//
+// LoopbackRenderBackend
+//
+
+LoopbackRenderBackend::LoopbackRenderBackend(const AudioFormat& format, unsigned int periodFrames, unsigned int bufferPeriods,
+                                             LoopbackRecording* recording)
+    : PacedRenderBackend(format, periodFrames, bufferPeriods)
+    , m_recording(recording)
+    , m_jitterMs(0.0)
+{
+    m_converter.Configure(format.sampleFormat);
+    m_scratch.resize((size_t)periodFrames * format.channels);
+}
+
+void LoopbackRenderBackend::SetJitter(double jitterMs, unsigned int seed)
+{
+    m_jitterMs = jitterMs;
+    m_random.seed(seed);
+}
+
+bool LoopbackRenderBackend::Start()
+{
+    bool started = PacedRenderBackend::Start();
+    m_recording->renderStart = GetStartTime();
+    return started;
+}
+
+BackendWaitResult LoopbackRenderBackend::WaitForEvent(unsigned int timeoutMs)
+{
+    BackendWaitResult result = PacedRenderBackend::WaitForEvent(timeoutMs);
+    if (result == BackendWaitResult::Ready)
+        SleepJitter(m_jitterMs, m_random);
+    return result;
+}
+
+void LoopbackRenderBackend::ConsumeFrames(const void* data, unsigned int frameCount)
+{
+    // Played in pieces of at most a period (underrun silence can come as one larger piece)
+    const unsigned int channels = m_format.channels;
+    const unsigned int periodFrames = GetPeriodFrameCount();
+    const unsigned char* pData = (const unsigned char*)data;
+    while (frameCount > 0)
+    {
+        unsigned int frames = frameCount < periodFrames ? frameCount : periodFrames;
+        size_t room = m_recording->played.size() - m_recording->playedFrames;
+        unsigned int recorded = frames < room ? frames : (unsigned int)room;
+        float* output = m_recording->played.data() + m_recording->playedFrames;
+        if (pData)
+        {
+            m_converter.ToFloat(pData, m_scratch.data(), (size_t)frames * channels);
+            for (unsigned int i = 0; i < recorded; i++)
+                output[i] = m_scratch[i * channels];
+            pData += (size_t)frames * m_format.getBlockAlign();
+        }
+        else
+        {
+            for (unsigned int i = 0; i < recorded; i++)
+                output[i] = 0.0f;
+        }
+        m_recording->playedFrames += recorded;
+        frameCount -= frames;
+    }
+}
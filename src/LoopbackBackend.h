@@ -0,0 +1,108 @@
+#pragma once
+
+#include "PacedBackend.h"
+#include "SampleConverter.h"
+#include <chrono>
+#include <random>
+#include <vector>
+
+// Test signal a loopback capture device sends: a short burst repeated at a fixed interval
+enum class LoopbackStimulus
+{
+    Impulse,    // Band-limited click (Hann-windowed sinc), 4 ms
+    Chirp       // Linear sweep from 200 Hz to the band limit, Hann-windowed, 30 ms
+};
+
+// The stimulus as a function of time, so it can be sampled on either device's clock. Bursts
+// start at firstBurst and every interval after it.
+class LoopbackSignal
+{
+public:
+    // bandLimitHz keeps the bursts inside what both device rates can carry
+    LoopbackSignal(LoopbackStimulus stimulus, double bandLimitHz, double firstBurstSeconds, double intervalSeconds);
+
+    LoopbackStimulus GetStimulus() const { return m_stimulus; }
+    double GetBurstSeconds() const { return m_burstSeconds; }
+    double GetFirstBurstSeconds() const { return m_firstBurst; }
+    double GetIntervalSeconds() const { return m_interval; }
+
+    // Start of burst n, in seconds of capture device time
+    double GetBurstStart(unsigned int n) const { return m_firstBurst + n * m_interval; }
+
+    // Value of the whole signal at t seconds of capture device time
+    float Evaluate(double t) const;
+
+    // Value of one burst, t seconds after it starts (0 outside it)
+    float EvaluateBurst(double t) const;
+
+private:
+    LoopbackStimulus m_stimulus;
+    double m_bandLimit;
+    double m_burstSeconds;
+    double m_firstBurst;
+    double m_interval;
+};
+
+// What a loopback device pair saw, filled in by the devices and read once they have stopped:
+// when each device clock started and what the render device played. Owned by the caller, so it
+// outlives the backends (the engine destroys them on Stop()).
+struct LoopbackRecording
+{
+    std::chrono::steady_clock::time_point captureStart;
+    std::chrono::steady_clock::time_point renderStart;
+    std::vector<float> played;      // First output channel, sized up front (recording stops when full)
+    size_t playedFrames = 0;
+};
+
+// Capture device that sends a LoopbackSignal on every channel, sampled on its own clock (which
+// SetClockSkewPpm() runs off nominal). With jitter, each event is serviced up to jitterMs late,
+// like a device thread that is scheduled late.
+class LoopbackCaptureBackend : public PacedCaptureBackend
+{
+public:
+    LoopbackCaptureBackend(const AudioFormat& format, unsigned int periodFrames, unsigned int bufferPeriods,
+                           const LoopbackSignal& signal, LoopbackRecording* recording);
+
+    void SetJitter(double jitterMs, unsigned int seed);
+
+    bool Start() override;
+    BackendWaitResult WaitForEvent(unsigned int timeoutMs) override;
+    const wchar_t* GetName() const override { return L"Loopback Capture"; }
+
+protected:
+    void FillPacket(void* data, unsigned int frameCount, unsigned int* flags) override;
+
+private:
+    LoopbackSignal m_signal;
+    LoopbackRecording* m_recording;
+    SampleConverter m_converter;
+    std::vector<float> m_scratch;
+    double m_jitterMs;
+    std::minstd_rand m_random;
+};
+
+// Render device that records its first channel into a LoopbackRecording. Each tick it takes a
+// period from its buffer and plays it over the following period, so frame n reaches the speaker
+// (n + period) frames after its clock started.
+class LoopbackRenderBackend : public PacedRenderBackend
+{
+public:
+    LoopbackRenderBackend(const AudioFormat& format, unsigned int periodFrames, unsigned int bufferPeriods,
+                          LoopbackRecording* recording);
+
+    void SetJitter(double jitterMs, unsigned int seed);
+
+    bool Start() override;
+    BackendWaitResult WaitForEvent(unsigned int timeoutMs) override;
+    const wchar_t* GetName() const override { return L"Loopback Render"; }
+
+protected:
+    void ConsumeFrames(const void* data, unsigned int frameCount) override;
+
+private:
+    LoopbackRecording* m_recording;
+    SampleConverter m_converter;
+    std::vector<float> m_scratch;
+    double m_jitterMs;
+    std::minstd_rand m_random;
+};
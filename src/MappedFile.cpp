@@ -0,0 +1,118 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile()
+    : m_data(nullptr)
+    , m_size(0)
+    , m_file(INVALID_HANDLE_VALUE)
+    , m_mapping(nullptr)
+{
+}
+
+bool MappedFile::Open(const std::string& path)
+{
+    Close();
+
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    m_file = file;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0 || (unsigned long long)size.QuadPart > (size_t)-1)
+    {
+        Close();
+        return false;
+    }
+
+    m_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!m_mapping)
+    {
+        Close();
+        return false;
+    }
+
+    m_data = (const unsigned char*)MapViewOfFile((HANDLE)m_mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!m_data)
+    {
+        Close();
+        return false;
+    }
+    m_size = (size_t)size.QuadPart;
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_data)
+        UnmapViewOfFile(m_data);
+    if (m_mapping)
+        CloseHandle((HANDLE)m_mapping);
+    if (m_file != INVALID_HANDLE_VALUE)
+        CloseHandle((HANDLE)m_file);
+    m_data = nullptr;
+    m_size = 0;
+    m_mapping = nullptr;
+    m_file = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+MappedFile::MappedFile()
+    : m_data(nullptr)
+    , m_size(0)
+{
+}
+
+bool MappedFile::Open(const std::string& path)
+{
+    Close();
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    // The mapping keeps its own reference to the file
+    void* data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return false;
+
+    madvise(data, (size_t)info.st_size, MADV_SEQUENTIAL);
+    m_data = (const unsigned char*)data;
+    m_size = (size_t)info.st_size;
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_data)
+        munmap((void*)m_data, m_size);
+    m_data = nullptr;
+    m_size = 0;
+}
+
+#endif
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file (MapViewOfFile on Windows, mmap elsewhere).
+// Pages are read in by the OS as they are touched, with sequential read-ahead requested.
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    bool Open(const std::string& path);
+    void Close();
+    bool IsOpen() const { return m_data != nullptr; }
+
+    const unsigned char* GetData() const { return m_data; }
+    size_t GetSize() const { return m_size; }
+
+private:
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const unsigned char* m_data;
+    size_t m_size;
+#ifdef _WIN32
+    void* m_file;
+    void* m_mapping;
+#endif
+};
@@ -3,6 +3,9 @@
 #include <string>
 #include <functional>
 
+class BufferArena;
+class DiagnosticLog;
+
 // Noise reduction algorithm types
 enum class NoiseReductionType
 {
@@ -40,6 +43,7 @@ struct NoiseReductionConfig
     NoiseReductionType type = NoiseReductionType::Off;
     SpeexConfig speex;
     RNNoiseConfig rnnoise;
+    bool perChannel = false;    // Denoise every channel on its own instead of a mono downmix (keeps stereo)
 
     NoiseReductionConfig() = default;
     NoiseReductionConfig(NoiseReductionType t) : type(t) {}
@@ -58,6 +62,25 @@ struct NoiseReductionConfig
     }
 };
 
+// Buffering a processor that works in frames of frameSize needs so that calls of callFrames
+// (0 = any size) always find a whole call's worth of processed audio: the most a call can end
+// short of a frame boundary. Zero when calls are whole frames.
+inline unsigned int GetFrameAlignmentDelay(unsigned int frameSize, unsigned int callFrames)
+{
+    if (callFrames == 0)
+        return frameSize - 1;
+
+    unsigned int a = frameSize;
+    unsigned int b = callFrames;
+    while (b != 0)
+    {
+        unsigned int r = a % b;
+        a = b;
+        b = r;
+    }
+    return frameSize - a;
+}
+
 // Abstract interface for noise processors
 class INoiseProcessor
 {
@@ -73,6 +96,21 @@ public:
     // channels: number of channels in the audio data
     virtual void Process(float* audioData, unsigned int frameCount, unsigned int channels) = 0;
 
+    // Size every Process() call will have, in frames (0 = varies). A processor that works in
+    // frames of its own uses it to buffer only as much as that call size needs to line up with
+    // them: none when it is a multiple of the frame size. Call after Initialize(), before
+    // ReserveBuffers(). A call of another size still works, at the cost of added delay.
+    virtual void SetCallFrameCount(unsigned int frameCount) { (void)frameCount; }
+
+    // Reserve the processor's scratch buffers for calls of up to maxFrames frames. Called after
+    // Initialize(); the arena is allocated before the first Process(), which must not allocate.
+    virtual void ReserveBuffers(BufferArena& arena, unsigned int maxFrames) { (void)arena; (void)maxFrames; }
+
+    // Delay from input to output in frames at the processor's rate: the algorithm's own delay
+    // plus the buffering for the call size. Valid once ReserveBuffers() has been called; grows
+    // by whatever calls of another size add. Safe to call from any thread.
+    virtual unsigned int GetLatencyFrames() const { return 0; }
+
     // Get the name of this processor for display purposes
     virtual const wchar_t* GetName() const = 0;
 
@@ -82,6 +120,10 @@ public:
     // Get the required sample rate (0 = any rate)
     virtual unsigned int GetRequiredSampleRate() const { return 0; }
 
-    // Set callback for diagnostic messages
+    // Set callback for diagnostic messages. Only used while initializing: it formats text and
+    // may allocate, so Process() reports through the real-time log instead.
     virtual void SetDiagnosticCallback(std::function<void(const std::wstring&)> callback) = 0;
+
+    // Set the real-time-safe log Process() reports to (may be null)
+    virtual void SetDiagnosticLog(DiagnosticLog* log) { (void)log; }
 };
@@ -1,10 +1,22 @@
 #include "NoiseSuppress.h"
+#include "PerChannelNoiseProcessor.h"
 #include "RNNoiseProcessor.h"
 #include "SpeexProcessor.h"
 #include <sstream>
+#include <iomanip>
+#include <cstring>
 
 NoiseSuppress::NoiseSuppress()
     : m_isInitialized(false)
+    , m_sampleRate(0)
+    , m_processorRate(0)
+    , m_isResampling(false)
+    , m_channels(0)
+    , m_processorCallFrames(0)
+    , m_isStreamStart(true)
+    , m_outputQueueFrames(0)
+    , m_resamplingLatencyFrames(0)
+    , m_diagnosticLog(nullptr)
 {
 }
 
@@ -15,11 +27,17 @@ NoiseSuppress::~NoiseSuppress()
 
 bool NoiseSuppress::Initialize(const NoiseReductionConfig& config, unsigned int sampleRate, unsigned int channels)
 {
-    m_config = config;
+    m_isInitialized = false;
 
     // If noise reduction is off, no processor needed
     if (config.type == NoiseReductionType::Off)
     {
+        m_config = config;
+        m_isResampling = false;
+        m_processorCallFrames = 0;
+        m_resamplingLatencyFrames = 0;
+        m_sampleRate = sampleRate;
+        m_processorRate = sampleRate;
         m_processor.reset();
         m_isInitialized = true;
         if (m_diagnosticCallback)
@@ -30,6 +48,7 @@ bool NoiseSuppress::Initialize(const NoiseReductionConfig& config, unsigned int
     }
 
     // Create appropriate processor based on type
+    PerChannelNoiseProcessor::Factory create;
     switch (config.type)
     {
         case NoiseReductionType::RNNoise:
@@ -38,7 +57,8 @@ bool NoiseSuppress::Initialize(const NoiseReductionConfig& config, unsigned int
             {
                 m_diagnosticCallback(L"Initializing RNNoise processor...");
             }
-            m_processor = std::make_unique<RNNoiseProcessor>(config.rnnoise);
+            RNNoiseConfig rnnoiseConfig = config.rnnoise;
+            create = [rnnoiseConfig]() -> std::unique_ptr<INoiseProcessor> { return std::make_unique<RNNoiseProcessor>(rnnoiseConfig); };
             break;
         }
 
@@ -48,7 +68,8 @@ bool NoiseSuppress::Initialize(const NoiseReductionConfig& config, unsigned int
             {
                 m_diagnosticCallback(L"Initializing Speex processor...");
             }
-            m_processor = std::make_unique<SpeexProcessor>(config.speex);
+            SpeexConfig speexConfig = config.speex;
+            create = [speexConfig]() -> std::unique_ptr<INoiseProcessor> { return std::make_unique<SpeexProcessor>(speexConfig); };
             break;
         }
 
@@ -60,27 +81,71 @@ bool NoiseSuppress::Initialize(const NoiseReductionConfig& config, unsigned int
             return false;
     }
 
+    // Multichannel input either shares one processor or gets a mono instance per channel
+    std::unique_ptr<INoiseProcessor> processor;
+    if (config.perChannel && channels > 1)
+        processor = std::make_unique<PerChannelNoiseProcessor>(create);
+    else
+        processor = create();
+
+    return Initialize(config, std::move(processor), sampleRate, channels);
+}
+
+bool NoiseSuppress::Initialize(const NoiseReductionConfig& config, std::unique_ptr<INoiseProcessor> processor,
+                               unsigned int sampleRate, unsigned int channels)
+{
+    m_config = config;
+    m_isInitialized = false;
+    m_isResampling = false;
+    m_processorCallFrames = 0;
+    m_resamplingLatencyFrames = 0;
+    m_isStreamStart = true;
+    m_sampleRate = sampleRate;
+    m_processorRate = sampleRate;
+    m_processor = std::move(processor);
+    if (!m_processor)
+        return false;
+
     // Set diagnostic callback on processor
-    if (m_processor && m_diagnosticCallback)
+    if (m_diagnosticCallback)
     {
         m_processor->SetDiagnosticCallback(m_diagnosticCallback);
     }
+    m_processor->SetDiagnosticLog(m_diagnosticLog);
 
     // Check sample rate requirements
+    unsigned int processorRate = sampleRate;
     unsigned int requiredRate = m_processor->GetRequiredSampleRate();
     if (requiredRate > 0 && sampleRate != requiredRate)
     {
+        // Bridge through the required rate. The rates are fixed, so both directions use exact
+        // rational phase stepping (e.g. 147/160 for 44.1 kHz) and keep their state between calls.
+        m_upsampler.Configure(sampleRate, requiredRate, channels, false, ResamplerQuality::Medium);
+        m_downsampler.Configure(requiredRate, sampleRate, channels, false, ResamplerQuality::Medium);
+        m_channels = channels;
+        processorRate = requiredRate;
+        m_processorRate = requiredRate;
+        m_isResampling = true;
+
+        // Both filters delay the signal; the output queue starts with that much silence (plus a
+        // frame of slack for rounding) so every call can hand back exactly as many frames as it got.
+        // The queue memory comes zeroed from the arena.
+        m_resamplingLatencyFrames = (unsigned int)((unsigned long long)m_upsampler.GetLatencyFrames() * sampleRate / requiredRate) +
+                                    m_downsampler.GetLatencyFrames() + 2;
+        m_outputQueueFrames = m_resamplingLatencyFrames;
+
         if (m_diagnosticCallback)
         {
             std::wostringstream msg;
-            msg << L"WARNING: " << m_processor->GetName() << L" requires " << requiredRate
-                << L" Hz, but input is " << sampleRate << L" Hz";
+            msg << L"Resampling " << sampleRate << L" Hz -> " << requiredRate << L" Hz for "
+                << m_processor->GetName() << L" (adds " << std::fixed << std::setprecision(2)
+                << m_resamplingLatencyFrames * 1000.0 / sampleRate << L" ms latency)";
             m_diagnosticCallback(msg.str());
         }
     }
 
     // Initialize the processor
-    if (!m_processor->Initialize(sampleRate, channels))
+    if (!m_processor->Initialize(processorRate, channels))
     {
         if (m_diagnosticCallback)
         {
@@ -103,14 +168,146 @@ bool NoiseSuppress::Initialize(const NoiseReductionConfig& config, unsigned int
     return true;
 }
 
+void NoiseSuppress::SetCallFrameCount(unsigned int frameCount)
+{
+    if (!m_processor)
+        return;
+
+    if (!m_isResampling)
+    {
+        m_processor->SetCallFrameCount(frameCount);
+        return;
+    }
+
+    // Through the bridge, calls keep one size at the processor rate when the period is a whole
+    // number of frames there (441 at 44.1 kHz -> 480 at 48 kHz). Only the upsampler's first call
+    // comes up short, by its filter delay: that delay is then handed to the processor once, as
+    // leading silence, instead of being queued at the output, so the total delay stays the same.
+    unsigned long long scaled = (unsigned long long)frameCount * m_processorRate;
+    if (frameCount > 0 && scaled % m_sampleRate == 0)
+    {
+        m_processorCallFrames = (unsigned int)(scaled / m_sampleRate);
+        m_outputQueueFrames = m_resamplingLatencyFrames -
+                              (unsigned int)((unsigned long long)m_upsampler.GetLatencyFrames() * m_sampleRate / m_processorRate);
+    }
+    else
+    {
+        m_processorCallFrames = 0;
+        m_outputQueueFrames = m_resamplingLatencyFrames;
+    }
+    m_processor->SetCallFrameCount(m_processorCallFrames);
+    m_isStreamStart = true;
+}
+
+unsigned int NoiseSuppress::GetAlignedCallFrameCount() const
+{
+    if (!m_processor || m_processor->GetRequiredFrameSize() == 0 || m_processorRate == 0)
+        return 0;
+
+    // Smallest device-rate period that is a whole number of processor frames at its rate
+    unsigned long long frameTime = (unsigned long long)m_processor->GetRequiredFrameSize() * m_sampleRate;
+    unsigned long long a = frameTime;
+    unsigned long long b = m_processorRate;
+    while (b != 0)
+    {
+        unsigned long long r = a % b;
+        a = b;
+        b = r;
+    }
+    return (unsigned int)(frameTime / a);
+}
+
+unsigned int NoiseSuppress::GetLatencyFrames() const
+{
+    if (!m_processor)
+        return 0;
+
+    unsigned long long processorLatency = m_processor->GetLatencyFrames();
+    return m_resamplingLatencyFrames + (unsigned int)(processorLatency * m_sampleRate / m_processorRate);
+}
+
+void NoiseSuppress::ReserveBuffers(BufferArena& arena, unsigned int maxFrames)
+{
+    if (!m_processor)
+        return;
+
+    if (!m_isResampling)
+    {
+        m_processor->ReserveBuffers(arena, maxFrames);
+        return;
+    }
+
+    // The queue holds the primed latency plus one call's worth of downsampled output; the first
+    // call at the processor rate may also carry the upsampler's delay as leading silence
+    unsigned int maxProcessorFrames = m_upsampler.GetMaxOutputFrames(maxFrames) + m_upsampler.GetLatencyFrames();
+    arena.Reserve(m_processorBuffer, (size_t)maxProcessorFrames * m_channels);
+    arena.Reserve(m_outputQueue, (size_t)(m_resamplingLatencyFrames + m_downsampler.GetMaxOutputFrames(maxProcessorFrames)) * m_channels);
+    m_processor->ReserveBuffers(arena, maxProcessorFrames);
+}
+
 void NoiseSuppress::Process(float* audioData, unsigned int frameCount, unsigned int channels)
 {
     if (!m_isInitialized || !m_processor || m_config.type == NoiseReductionType::Off)
         return;
 
+    if (m_isResampling)
+    {
+        ProcessResampled(audioData, frameCount, channels);
+        return;
+    }
+
     m_processor->Process(audioData, frameCount, channels);
 }
 
+void NoiseSuppress::ProcessResampled(float* audioData, unsigned int frameCount, unsigned int channels)
+{
+    if (channels != m_channels)
+        return;
+
+    // Up to the processor rate. With calls lined up to the processor's frames, the first call of
+    // the stream is preceded by the upsampler's filter delay in silence (what its output comes up
+    // short by), which lines the processor's frames up with the calls; later calls of any size
+    // pass straight through.
+    float* upsampled = m_processorBuffer.data();
+    unsigned int padding = 0;
+    if (m_isStreamStart && m_processorCallFrames > 0)
+    {
+        padding = m_upsampler.GetLatencyFrames();
+        std::memset(m_processorBuffer.data(), 0, padding * channels * sizeof(float));
+        upsampled += padding * channels;
+    }
+    m_isStreamStart = false;
+    unsigned int processorFrames = padding + m_upsampler.Process(audioData, frameCount, upsampled);
+
+    m_processor->Process(m_processorBuffer.data(), processorFrames, channels);
+
+    // Back down, appended behind what is already queued. Fixed ratios keep the queue at the
+    // primed latency; should it ever creep past the reserved space, drop its oldest frames.
+    const unsigned int queueCapacity = (unsigned int)(m_outputQueue.size() / channels);
+    const unsigned int maxDownsampledFrames = m_downsampler.GetMaxOutputFrames(processorFrames);
+    if (m_outputQueueFrames + maxDownsampledFrames > queueCapacity)
+    {
+        unsigned int excess = m_outputQueueFrames + maxDownsampledFrames - queueCapacity;
+        excess = excess < m_outputQueueFrames ? excess : m_outputQueueFrames;
+        m_outputQueueFrames -= excess;
+        std::memmove(m_outputQueue.data(), m_outputQueue.data() + excess * channels, m_outputQueueFrames * channels * sizeof(float));
+    }
+    m_outputQueueFrames += m_downsampler.Process(m_processorBuffer.data(), processorFrames,
+                                                 m_outputQueue.data() + m_outputQueueFrames * channels);
+
+    // Hand back exactly frameCount frames. The queue was primed with the bridge latency, so it
+    // only runs short if the resamplers drift apart, which fixed rational ratios cannot do.
+    unsigned int available = m_outputQueueFrames < frameCount ? m_outputQueueFrames : frameCount;
+    std::memcpy(audioData, m_outputQueue.data(), available * channels * sizeof(float));
+    if (available < frameCount)
+    {
+        std::memset(audioData + available * channels, 0, (frameCount - available) * channels * sizeof(float));
+    }
+
+    m_outputQueueFrames -= available;
+    std::memmove(m_outputQueue.data(), m_outputQueue.data() + available * channels, m_outputQueueFrames * channels * sizeof(float));
+}
+
 void NoiseSuppress::SetDiagnosticCallback(std::function<void(const std::wstring&)> callback)
 {
     m_diagnosticCallback = callback;
@@ -121,3 +318,13 @@ void NoiseSuppress::SetDiagnosticCallback(std::function<void(const std::wstring&
         m_processor->SetDiagnosticCallback(callback);
     }
 }
+
+void NoiseSuppress::SetDiagnosticLog(DiagnosticLog* log)
+{
+    m_diagnosticLog = log;
+
+    if (m_processor)
+    {
+        m_processor->SetDiagnosticLog(log);
+    }
+}
@@ -1,18 +1,43 @@
 #pragma once
 
+#include "BufferArena.h"
 #include "NoiseReductionTypes.h"
+#include "Resampler.h"
 #include <memory>
 
 class NoiseSuppress
 {
 public:
+    // RNNoise (480 frames at 48 kHz) and Speex both work in 10 ms frames, so device periods that
+    // are multiples of this need no frame buffering
+    static const unsigned int FrameMs = 10;
+
     NoiseSuppress();
     ~NoiseSuppress();
 
-    // Initialize with specific noise reduction type and config
+    // Initialize with specific noise reduction type and config.
+    // Processors that need a fixed rate (RNNoise: 48 kHz) are run behind a resampling bridge.
     bool Initialize(const NoiseReductionConfig& config, unsigned int sampleRate, unsigned int channels);
 
-    // Process audio data in-place
+    // Same with a processor supplied by the caller (a stand-in, e.g. in tests) in place of the
+    // one config.type selects, which must not be Off
+    bool Initialize(const NoiseReductionConfig& config, std::unique_ptr<INoiseProcessor> processor,
+                    unsigned int sampleRate, unsigned int channels);
+
+    // Size of every Process() call (the capture period), in frames at the device rate. When it
+    // lines up with the processor's frames, its accumulator buffers nothing; otherwise up to a
+    // frame. Call after Initialize(), before ReserveBuffers().
+    void SetCallFrameCount(unsigned int frameCount);
+
+    // Smallest call size that lines up with the processor's frames, in frames at the device
+    // rate (0 = the processor takes any size, or there is none)
+    unsigned int GetAlignedCallFrameCount() const;
+
+    // Reserve scratch buffers (bridge and processor) for calls of up to maxFrames frames.
+    // Call after Initialize(); the arena must be allocated before Process().
+    void ReserveBuffers(BufferArena& arena, unsigned int maxFrames);
+
+    // Process audio data in-place (at most the reserved frame count; never allocates)
     void Process(float* audioData, unsigned int frameCount, unsigned int channels);
 
     // Get current noise reduction type
@@ -24,15 +49,47 @@ public:
     // Check if initialized
     bool IsInitialized() const { return m_isInitialized; }
 
+    // True when audio is resampled to and from the processor's required rate
+    bool IsResampling() const { return m_isResampling; }
+
+    // Delay added by the resampling bridge, in frames at the device rate (0 when not resampling)
+    unsigned int GetResamplingLatencyFrames() const { return m_resamplingLatencyFrames; }
+
+    // Whole delay from input to output in frames at the device rate: the bridge plus the
+    // processor's own delay and frame buffering. Valid after ReserveBuffers(); follows the
+    // processor's as calls of another size add to it. Safe to call from any thread.
+    unsigned int GetLatencyFrames() const;
+
     // Set callback for diagnostic messages
     void SetDiagnosticCallback(std::function<void(const std::wstring&)> callback);
 
+    // Set the real-time-safe log the processor reports to while processing (may be null)
+    void SetDiagnosticLog(DiagnosticLog* log);
+
     // Get the underlying processor (for advanced configuration)
     INoiseProcessor* GetProcessor() { return m_processor.get(); }
 
 private:
+    // Device rate -> processor rate -> process -> device rate, frameCount frames in and out
+    void ProcessResampled(float* audioData, unsigned int frameCount, unsigned int channels);
+
     std::unique_ptr<INoiseProcessor> m_processor;
     NoiseReductionConfig m_config;
     bool m_isInitialized;
+    unsigned int m_sampleRate;                  // Device rate
+    unsigned int m_processorRate;               // Rate the processor runs at
+
+    // Resampling bridge
+    bool m_isResampling;
+    unsigned int m_channels;
+    unsigned int m_processorCallFrames;         // Frames each call hands the processor (0 = varies)
+    bool m_isStreamStart;                       // No call yet: the first is padded with the upsampler's delay
+    Resampler m_upsampler;                      // Device rate -> processor rate
+    Resampler m_downsampler;                    // Processor rate -> device rate
+    ArenaBuffer<float> m_processorBuffer;       // Audio at the processor rate
+    ArenaBuffer<float> m_outputQueue;           // Device rate audio waiting to be handed back (starts zeroed)
+    unsigned int m_outputQueueFrames;
+    unsigned int m_resamplingLatencyFrames;
     std::function<void(const std::wstring&)> m_diagnosticCallback;
+    DiagnosticLog* m_diagnosticLog;
 };
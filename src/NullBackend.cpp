@@ -0,0 +1,13 @@
+#include "NullBackend.h"
+#include <cstring>
+
+void NullCaptureBackend::FillPacket(void* data, unsigned int frameCount, unsigned int* flags)
+{
+    std::memset(data, 0, frameCount * m_format.getBlockAlign());
+    *flags |= AudioBufferFlag_Silent;
+}
+
+void NullRenderBackend::ConsumeFrames(const void*, unsigned int frameCount)
+{
+    m_framesPlayed += frameCount;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "PacedBackend.h"
+
+// Capture device that delivers silent packets at the device rate
+class NullCaptureBackend : public PacedCaptureBackend
+{
+public:
+    NullCaptureBackend(const AudioFormat& format, unsigned int periodFrames)
+        : PacedCaptureBackend(format, periodFrames) {}
+
+    const wchar_t* GetName() const override { return L"Null Capture"; }
+
+protected:
+    void FillPacket(void* data, unsigned int frameCount, unsigned int* flags) override;
+};
+
+// Render device that plays into the void at the device rate
+class NullRenderBackend : public PacedRenderBackend
+{
+public:
+    NullRenderBackend(const AudioFormat& format, unsigned int periodFrames, unsigned int bufferPeriods = 2)
+        : PacedRenderBackend(format, periodFrames, bufferPeriods), m_framesPlayed(0) {}
+
+    const wchar_t* GetName() const override { return L"Null Render"; }
+
+    unsigned long long GetFramesPlayed() const { return m_framesPlayed; }
+
+protected:
+    void ConsumeFrames(const void* data, unsigned int frameCount) override;
+
+private:
+    unsigned long long m_framesPlayed;
+};
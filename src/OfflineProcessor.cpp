@@ -0,0 +1,495 @@
+#include "OfflineProcessor.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <system_error>
+#include <thread>
+
+namespace
+{
+    std::string Narrow(const wchar_t* text)
+    {
+        std::string result;
+        for (; *text; text++)
+            result += (*text < 0x80) ? (char)*text : '?';
+        return result;
+    }
+
+    uint64_t GreatestCommonDivisor(uint64_t a, uint64_t b)
+    {
+        while (b != 0)
+        {
+            uint64_t r = a % b;
+            a = b;
+            b = r;
+        }
+        return a;
+    }
+
+    // Shortest chunk worth splitting off, in seconds beyond its warm-up and crossfade
+    const unsigned int MinChunkSeconds = 10;
+}
+
+OfflineProcessor::OfflineProcessor()
+    : m_periodFrames(0)
+    , m_blockFrames(0)
+    , m_noiseLatencyFrames(0)
+    , m_outputBlockCapacity(0)
+    , m_outputBlockFrames(0)
+    , m_segmentWriter(nullptr)
+    , m_writerMutex(nullptr)
+    , m_skipFrames(0)
+    , m_outputPosition(0)
+    , m_outputBlockStart(0)
+{
+}
+
+OfflineProcessor::~OfflineProcessor()
+{
+}
+
+bool OfflineProcessor::OpenInput(const std::string& inputPath, OfflineResult& result)
+{
+    if (!m_reader.Open(inputPath))
+    {
+        result.error = inputPath + ": " + m_reader.GetError();
+        return false;
+    }
+    m_reader.Map();
+    result.inputFormat = m_reader.GetFormat();
+    result.inputFrames = m_reader.GetFrameCount();
+    return true;
+}
+
+bool OfflineProcessor::Configure(const AudioFormat& inputFormat, OfflineResult& result)
+{
+    AudioFormat outputFormat = inputFormat;
+    if (m_options.outputRate > 0)
+        outputFormat.sampleRate = m_options.outputRate;
+    if (m_options.outputChannels > 0)
+        outputFormat.channels = m_options.outputChannels;
+    if (m_options.outputSampleFormat >= 0)
+        outputFormat.sampleFormat = (SampleFormat)m_options.outputSampleFormat;
+    result.outputFormat = outputFormat;
+
+    // Blocks hold whole packets, so every packet but the file's last has the period size the
+    // noise processor was set up for
+    m_periodFrames = std::max(1u, inputFormat.sampleRate * std::max(1u, m_options.periodMs) / 1000);
+    unsigned int blockFrames = (unsigned int)std::min<unsigned long long>(
+        (unsigned long long)inputFormat.sampleRate * m_options.blockMs / 1000, 1u << 24);
+    m_blockFrames = std::max(1u, (blockFrames + m_periodFrames - 1) / m_periodFrames) * m_periodFrames;
+
+    m_noiseSuppressor.reset(new NoiseSuppress());
+    m_noiseSuppressor->SetDiagnosticCallback(m_diagnosticCallback);
+    const bool noiseEnabled = m_options.noiseConfig.isEnabled();
+    if (noiseEnabled)
+    {
+        if (!m_noiseSuppressor->Initialize(m_options.noiseConfig, inputFormat.sampleRate, inputFormat.channels))
+        {
+            result.error = "cannot initialize " + Narrow(NoiseReductionConfig::getTypeName(m_options.noiseConfig.type)) +
+                           " noise suppression";
+            return false;
+        }
+        m_noiseSuppressor->SetCallFrameCount(m_periodFrames);
+    }
+
+    m_pipeline.reset(new AudioPipeline());
+    m_pipeline->SetDiagnosticCallback(m_diagnosticCallback);
+    if (!m_pipeline->Configure(inputFormat, outputFormat, noiseEnabled ? m_noiseSuppressor.get() : nullptr,
+                               false, m_options.resamplerQuality, m_options.dither))
+    {
+        result.error = "unsupported conversion";
+        return false;
+    }
+
+    m_arena.Clear();
+    m_pipeline->ReserveBuffers(m_arena, m_periodFrames);
+    if (!m_reader.IsMapped())
+        m_arena.Reserve(m_inputBlock, (size_t)m_blockFrames * inputFormat.getBlockAlign());
+    m_outputBlockCapacity = m_pipeline->GetMaxOutputFrames(m_periodFrames) * (m_blockFrames / m_periodFrames);
+    m_arena.Reserve(m_outputBlock, (size_t)m_outputBlockCapacity * outputFormat.getBlockAlign());
+    if (!m_arena.Allocate())
+    {
+        result.error = "cannot allocate processing buffers";
+        return false;
+    }
+    m_outputBlockFrames = 0;
+
+    // Noise suppression runs at the input rate ahead of the resampler. Its delay arrives as
+    // leading silence, to be dropped; the resampler's holds back its look-ahead instead (its
+    // first output is short, not late), so that part only has to be flushed at the end.
+    unsigned int noiseLatency = noiseEnabled ? m_noiseSuppressor->GetLatencyFrames() : 0;
+    m_noiseLatencyFrames = (unsigned int)(((unsigned long long)noiseLatency * outputFormat.sampleRate + inputFormat.sampleRate / 2) /
+                                          inputFormat.sampleRate);
+    result.latencyFrames = m_noiseLatencyFrames + m_pipeline->GetResampler().GetLatencyFrames();
+    return true;
+}
+
+bool OfflineProcessor::ProcessFile(const std::string& inputPath, const std::string& outputPath, OfflineResult& result)
+{
+    result = OfflineResult();
+    auto start = std::chrono::steady_clock::now();
+
+    if (!OpenInput(inputPath, result))
+        return false;
+    if (!Configure(result.inputFormat, result))
+    {
+        m_reader.Close();
+        return false;
+    }
+    if (!m_writer.Open(outputPath, result.outputFormat))
+    {
+        result.error = outputPath + ": cannot create file";
+        m_reader.Close();
+        return false;
+    }
+
+    // With latency compensation the output has the input's duration; otherwise it is what the
+    // chain produced by the time the input ran out, as it would have played live
+    const uint64_t expectedFrames = (result.inputFrames * result.outputFormat.sampleRate + result.inputFormat.sampleRate / 2) /
+                                    result.inputFormat.sampleRate;
+
+    bool ok;
+    unsigned int chunkCount = GetChunkCount(result);
+    if (chunkCount > 1)
+    {
+        ok = ProcessChunks(inputPath, PlanChunks(chunkCount, expectedFrames, result), result);
+    }
+    else
+    {
+        Segment whole;
+        whole.inputEnd = result.inputFrames;
+        whole.outputEnd = m_options.compensateLatency ? expectedFrames : UINT64_MAX;
+        whole.flush = m_options.compensateLatency;
+        ok = RunSegment(whole, m_writer, nullptr, result);
+    }
+
+    result.outputFrames = m_writer.GetFrameCount();
+    m_writer.Close();
+    m_reader.Close();
+    if (!ok)
+    {
+        if (result.error.empty())
+            result.error = outputPath + ": write failed";
+        return false;
+    }
+
+    result.processingSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.success = true;
+    return true;
+}
+
+unsigned int OfflineProcessor::GetChunkCount(const OfflineResult& result) const
+{
+    // Chunks are stitched on the output timeline, which needs the chain's delay removed; a raw
+    // copy has no state to warm up and gains nothing
+    if (m_options.chunks <= 1 || !m_options.compensateLatency || m_pipeline->IsRawCopy())
+        return 1;
+
+    const uint64_t inputRate = result.inputFormat.sampleRate;
+    const uint64_t alignment = GetChunkAlignment(result);
+    const uint64_t overheadFrames = inputRate * ((uint64_t)m_options.warmupMs + m_options.crossfadeMs) / 1000;
+    const uint64_t minChunkFrames = std::max(overheadFrames + inputRate * MinChunkSeconds, alignment);
+    return (unsigned int)std::max<uint64_t>(1, std::min<uint64_t>(m_options.chunks, result.inputFrames / minChunkFrames));
+}
+
+uint64_t OfflineProcessor::GetChunkAlignment(const OfflineResult& result) const
+{
+    // Whole packets, and input frames that land on whole output frames (multiples of 147 at
+    // 44.1 -> 48 kHz), so a chunk's resampler starts in the phase the sequential one is in there
+    const uint64_t inputRate = result.inputFormat.sampleRate;
+    const uint64_t ratioStep = inputRate / GreatestCommonDivisor(inputRate, result.outputFormat.sampleRate);
+    return ratioStep / GreatestCommonDivisor(ratioStep, m_periodFrames) * m_periodFrames;
+}
+
+std::vector<OfflineProcessor::Segment> OfflineProcessor::PlanChunks(unsigned int chunkCount, uint64_t outputFrames,
+                                                                    const OfflineResult& result) const
+{
+    const uint64_t inputRate = result.inputFormat.sampleRate;
+    const uint64_t outputRate = result.outputFormat.sampleRate;
+    const uint64_t inputFrames = result.inputFrames;
+    const uint64_t alignment = GetChunkAlignment(result);
+
+    const uint64_t warmupFrames = inputRate * m_options.warmupMs / 1000;
+    const unsigned int crossfadeFrames = (unsigned int)(outputRate * m_options.crossfadeMs / 1000);
+    const uint64_t crossfadeInputFrames = (crossfadeFrames * inputRate + outputRate - 1) / outputRate;
+
+    // A chunk reads on past its end until the chain's delay has carried its last frame out
+    const uint64_t lookaheadFrames = (uint64_t)result.latencyFrames * inputRate / outputRate + 4 * m_periodFrames;
+
+    std::vector<uint64_t> boundaries(chunkCount + 1);
+    for (unsigned int k = 1; k < chunkCount; k++)
+        boundaries[k] = inputFrames * k / chunkCount / alignment * alignment;
+    boundaries[0] = 0;
+    boundaries[chunkCount] = inputFrames;
+
+    std::vector<Segment> segments(chunkCount);
+    for (unsigned int k = 0; k < chunkCount; k++)
+    {
+        Segment& segment = segments[k];
+        const bool isLast = (k == chunkCount - 1);
+
+        if (k > 0)
+        {
+            uint64_t lead = warmupFrames + crossfadeInputFrames;
+            segment.inputStart = boundaries[k] > lead ? (boundaries[k] - lead) / alignment * alignment : 0;
+            segment.outputStart = boundaries[k] * outputRate / inputRate;
+            segment.headFrames = crossfadeFrames;
+        }
+
+        if (isLast)
+        {
+            segment.inputEnd = inputFrames;
+            segment.outputEnd = outputFrames;
+        }
+        else
+        {
+            // Whole packets, so the last one is not short
+            uint64_t needed = boundaries[k + 1] + lookaheadFrames - segment.inputStart;
+            segment.inputEnd = std::min(inputFrames, segment.inputStart + (needed + m_periodFrames - 1) / m_periodFrames * m_periodFrames);
+            segment.outputEnd = boundaries[k + 1] * outputRate / inputRate;
+            segment.tailFrames = crossfadeFrames;
+        }
+        segment.flush = (segment.inputEnd == inputFrames);
+    }
+    return segments;
+}
+
+bool OfflineProcessor::ProcessChunks(const std::string& inputPath, const std::vector<Segment>& segments, OfflineResult& result)
+{
+    const size_t helperCount = segments.size() - 1;
+    std::vector<std::unique_ptr<OfflineProcessor>> helpers;
+    std::vector<OfflineResult> helperResults(helperCount);
+    std::vector<char> helperOk(helperCount, 0);
+    std::mutex writerMutex;
+
+    if (m_diagnosticCallback)
+    {
+        std::wostringstream msg;
+        msg << L"Processing in " << segments.size() << L" chunks (" << m_options.warmupMs << L" ms warm-up, "
+            << m_options.crossfadeMs << L" ms crossfade)";
+        m_diagnosticCallback(msg.str());
+    }
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < helperCount; i++)
+    {
+        helpers.emplace_back(new OfflineProcessor());
+        helpers.back()->SetOptions(m_options);
+    }
+    auto runHelper = [&](size_t i)
+    {
+        helperOk[i] = helpers[i]->ProcessChunk(inputPath, segments[i + 1], m_writer, &writerMutex, helperResults[i]);
+    };
+    size_t started = 0;
+    try
+    {
+        for (; started < helperCount; started++)
+            threads.emplace_back(runHelper, started);
+    }
+    catch (const std::system_error&)
+    {
+        // Out of threads: the remaining chunks run here after the first
+    }
+
+    bool ok = RunSegment(segments[0], m_writer, &writerMutex, result);
+    for (size_t i = started; i < helperCount; i++)
+        runHelper(i);
+    for (std::thread& thread : threads)
+        thread.join();
+
+    for (size_t i = 0; i < helperCount; i++)
+    {
+        if (!helperOk[i])
+        {
+            if (result.error.empty())
+                result.error = helperResults[i].error;
+            ok = false;
+        }
+    }
+    if (!ok)
+        return false;
+
+    // Crossfade every boundary: the earlier chunk fades out as the later one, warmed up by now,
+    // fades in (equal gain, raised cosine - both carry the same signal)
+    const unsigned int channels = result.outputFormat.channels;
+    std::vector<float> mixed;
+    std::vector<unsigned char> converted;
+    for (size_t k = 1; k < segments.size(); k++)
+    {
+        const unsigned int frames = segments[k].headFrames;
+        result.chunkBoundaries.push_back(segments[k].outputStart);
+        if (frames == 0)
+            continue;
+
+        const std::vector<float>& fadeOut = (k == 1) ? m_tailOverlap : helpers[k - 2]->m_tailOverlap;
+        const std::vector<float>& fadeIn = helpers[k - 1]->m_headOverlap;
+        mixed.resize((size_t)frames * channels);
+        for (unsigned int i = 0; i < frames; i++)
+        {
+            float s = (float)std::sin(1.5707963267948966 * (i + 0.5) / frames);
+            float gain = s * s;
+            for (unsigned int ch = 0; ch < channels; ch++)
+            {
+                size_t index = (size_t)i * channels + ch;
+                mixed[index] = fadeOut[index] + gain * (fadeIn[index] - fadeOut[index]);
+            }
+        }
+
+        converted.resize((size_t)frames * result.outputFormat.getBlockAlign());
+        m_pipeline->ConvertOutput(mixed.data(), converted.data(), frames);
+        if (!m_writer.WriteAt(segments[k].outputStart - frames, converted.data(), frames))
+            return false;
+    }
+    return true;
+}
+
+bool OfflineProcessor::ProcessChunk(const std::string& inputPath, const Segment& segment, WavWriter& writer, std::mutex* writerMutex,
+                                    OfflineResult& result)
+{
+    bool ok = OpenInput(inputPath, result) && Configure(result.inputFormat, result) &&
+              RunSegment(segment, writer, writerMutex, result);
+    m_reader.Close();
+    return ok;
+}
+
+bool OfflineProcessor::RunSegment(const Segment& segment, WavWriter& writer, std::mutex* writerMutex, const OfflineResult& result)
+{
+    m_segment = segment;
+    m_segmentWriter = &writer;
+    m_writerMutex = writerMutex;
+    m_skipFrames = m_options.compensateLatency ? m_noiseLatencyFrames : 0;
+    m_outputPosition = segment.inputStart * result.outputFormat.sampleRate / result.inputFormat.sampleRate;
+    m_outputBlockStart = segment.outputStart;
+    m_outputBlockFrames = 0;
+    m_headOverlap.assign((size_t)segment.headFrames * result.outputFormat.channels, 0.0f);
+    m_tailOverlap.assign((size_t)segment.tailFrames * result.outputFormat.channels, 0.0f);
+
+    if (!m_reader.Seek(segment.inputStart))
+        return false;
+
+    const unsigned int blockAlign = result.inputFormat.getBlockAlign();
+    uint64_t position = segment.inputStart;
+    bool ok = true;
+    while (ok && position < segment.inputEnd && m_outputPosition < segment.outputEnd)
+    {
+        unsigned int wanted = (unsigned int)std::min<uint64_t>(m_blockFrames, segment.inputEnd - position);
+        const unsigned char* block = nullptr;
+        unsigned int blockFrames = 0;
+        if (m_reader.IsMapped())
+        {
+            block = (const unsigned char*)m_reader.ReadMapped(wanted, &blockFrames);
+        }
+        else
+        {
+            blockFrames = m_reader.Read(m_inputBlock.data(), wanted);
+            block = m_inputBlock.data();
+        }
+        if (blockFrames == 0)
+            break;
+        position += blockFrames;
+
+        for (unsigned int offset = 0; ok && offset < blockFrames; offset += m_periodFrames)
+            ok = ProcessPacket(block + (size_t)offset * blockAlign, std::min(m_periodFrames, blockFrames - offset));
+        ok = ok && FlushOutput();
+    }
+
+    // Push the audio still inside the chain out with silence. A short last packet can add up to
+    // a processor frame of delay on top of the reported latency, hence the margin.
+    if (segment.flush)
+    {
+        unsigned int flushPackets = (unsigned int)(((uint64_t)result.latencyFrames * result.inputFormat.sampleRate /
+                                                    result.outputFormat.sampleRate + m_periodFrames - 1) / m_periodFrames) + 3;
+        for (unsigned int i = 0; ok && i < flushPackets && m_outputPosition < segment.outputEnd; i++)
+            ok = ProcessPacket(nullptr, m_periodFrames);
+    }
+    return FlushOutput() && ok;
+}
+
+bool OfflineProcessor::ProcessPacket(const void* input, unsigned int frames)
+{
+    // Make room for the most the packet can produce
+    if (m_outputBlockFrames + m_pipeline->GetMaxOutputFrames(frames) > m_outputBlockCapacity && !FlushOutput())
+        return false;
+
+    if (m_pipeline->IsRawCopy())
+    {
+        // Same fast path as the engine: nothing to convert, no delay to skip (never chunked)
+        unsigned int copied = (unsigned int)std::min<uint64_t>(frames, m_segment.outputEnd - m_outputPosition);
+        unsigned char* destination = m_outputBlock.data() + (size_t)m_outputBlockFrames * m_pipeline->GetOutputFormat().getBlockAlign();
+        m_pipeline->CopyRaw(input, destination, copied);
+        m_outputBlockFrames += copied;
+        m_outputPosition += copied;
+        return true;
+    }
+
+    const float* processed = nullptr;
+    unsigned int produced = m_pipeline->Process(input, frames, &processed);
+
+    unsigned int skip = std::min(m_skipFrames, produced);
+    m_skipFrames -= skip;
+    processed += (size_t)skip * m_pipeline->GetOutputFormat().channels;
+    DeliverOutput(processed, produced - skip);
+    return true;
+}
+
+void OfflineProcessor::DeliverOutput(const float* frames, unsigned int frameCount)
+{
+    const unsigned int channels = m_pipeline->GetOutputFormat().channels;
+    const uint64_t headStart = m_segment.outputStart - m_segment.headFrames;
+    const uint64_t tailStart = m_segment.outputEnd - m_segment.tailFrames;
+
+    while (frameCount > 0 && m_outputPosition < m_segment.outputEnd)
+    {
+        const uint64_t position = m_outputPosition;
+        unsigned int count;
+        if (position < headStart)
+        {
+            // Warm-up: discarded
+            count = (unsigned int)std::min<uint64_t>(frameCount, headStart - position);
+        }
+        else if (position < m_segment.outputStart)
+        {
+            count = (unsigned int)std::min<uint64_t>(frameCount, m_segment.outputStart - position);
+            std::memcpy(m_headOverlap.data() + (position - headStart) * channels, frames, (size_t)count * channels * sizeof(float));
+        }
+        else if (position < tailStart)
+        {
+            count = (unsigned int)std::min<uint64_t>(frameCount, tailStart - position);
+            unsigned char* destination = m_outputBlock.data() + (size_t)m_outputBlockFrames * m_pipeline->GetOutputFormat().getBlockAlign();
+            m_pipeline->ConvertOutput(frames, destination, count);
+            m_outputBlockFrames += count;
+        }
+        else
+        {
+            count = (unsigned int)std::min<uint64_t>(frameCount, m_segment.outputEnd - position);
+            std::memcpy(m_tailOverlap.data() + (position - tailStart) * channels, frames, (size_t)count * channels * sizeof(float));
+        }
+
+        frames += (size_t)count * channels;
+        frameCount -= count;
+        m_outputPosition += count;
+    }
+}
+
+bool OfflineProcessor::FlushOutput()
+{
+    if (m_outputBlockFrames == 0)
+        return true;
+
+    bool ok;
+    if (m_writerMutex)
+    {
+        std::lock_guard<std::mutex> lock(*m_writerMutex);
+        ok = m_segmentWriter->WriteAt(m_outputBlockStart, m_outputBlock.data(), m_outputBlockFrames);
+    }
+    else
+    {
+        ok = m_segmentWriter->WriteAt(m_outputBlockStart, m_outputBlock.data(), m_outputBlockFrames);
+    }
+    m_outputBlockStart += m_outputBlockFrames;
+    m_outputBlockFrames = 0;
+    return ok;
+}
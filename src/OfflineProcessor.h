@@ -0,0 +1,161 @@
+#pragma once
+
+#include "AudioPipeline.h"
+#include "BufferArena.h"
+#include "NoiseSuppress.h"
+#include "WavFile.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Settings for running the live processing chain over files
+struct OfflineOptions
+{
+    NoiseReductionConfig noiseConfig;
+    ResamplerQuality resamplerQuality = ResamplerQuality::Medium;
+    bool dither = false;              // TPDF dither when writing 16 or 24-bit PCM
+    unsigned int outputRate = 0;      // Output sample rate (0 = the input's)
+    unsigned int outputChannels = 0;  // Output channel count (0 = the input's)
+    int outputSampleFormat = -1;      // SampleFormat value of the output (-1 = the input's)
+    unsigned int periodMs = 10;       // Packet size the pipeline is fed, like a capture device period
+    unsigned int blockMs = 1000;      // Audio read from the input and written to the output at a time
+    bool compensateLatency = true;    // Drop the chain's delay from the start and flush it at the end,
+                                      // so the output lines up with the input and has its length
+    unsigned int chunks = 1;          // Split each file into this many chunks processed at the same time
+                                      // (needs compensateLatency; short files use fewer)
+    unsigned int warmupMs = 3000;     // Audio ahead of every chunk run through its chain and discarded,
+                                      // so noise suppressor state has settled by the chunk boundary
+    unsigned int crossfadeMs = 20;    // Overlap over which neighbouring chunks are crossfaded
+
+    OfflineOptions() = default;
+};
+
+// Outcome of processing one file
+struct OfflineResult
+{
+    bool success = false;
+    std::string error;                // Why processing failed
+    AudioFormat inputFormat;
+    AudioFormat outputFormat;
+    uint64_t inputFrames = 0;
+    uint64_t outputFrames = 0;
+    unsigned int latencyFrames = 0;   // Delay of the chain, in output frames
+    double processingSeconds = 0.0;   // Wall clock time spent on the file
+    std::vector<uint64_t> chunkBoundaries;  // Output frames where chunks meet (crossfades end there)
+
+    double GetAudioSeconds() const { return inputFormat.sampleRate ? (double)inputFrames / inputFormat.sampleRate : 0.0; }
+
+    // Seconds of audio processed per second of wall clock time
+    double GetRealtimeFactor() const { return processingSeconds > 0.0 ? GetAudioSeconds() / processingSeconds : 0.0; }
+};
+
+// Runs WAV files through the same AudioPipeline and NoiseSuppress the engine runs live: the
+// input is fed in packets of one period, as a capture device would deliver it, and the output
+// is converted to the output format and written as it is produced. The input is memory-mapped
+// where possible and both files are handled a block at a time.
+//
+// With chunks > 1 a long file is cut into that many parts processed at the same time, each on
+// its own chain and thread. Noise suppressors and resamplers carry state, so every chunk but
+// the first starts warmupMs early and throws that output away, and neighbouring chunks are
+// crossfaded over crossfadeMs before the boundary. Chunk boundaries fall on whole packets and
+// on input frames that map to whole output frames, so every chunk sees the same packet and
+// resampler phase as sequential processing would.
+//
+// Not thread safe; use one instance per thread. The chain is set up again for every file, so
+// nothing carries over between files.
+class OfflineProcessor
+{
+public:
+    OfflineProcessor();
+    ~OfflineProcessor();
+
+    void SetOptions(const OfflineOptions& options) { m_options = options; }
+    const OfflineOptions& GetOptions() const { return m_options; }
+
+    // Process inputPath into outputPath. Returns result.success.
+    bool ProcessFile(const std::string& inputPath, const std::string& outputPath, OfflineResult& result);
+
+    // Set callback for diagnostic messages (chain setup)
+    void SetDiagnosticCallback(std::function<void(const std::wstring&)> callback) { m_diagnosticCallback = callback; }
+
+private:
+    // Part of the input to run through the chain and where its output goes, in output frames
+    // counted from the start of the file
+    struct Segment
+    {
+        uint64_t inputStart = 0;      // First input frame fed to the chain (includes warm-up)
+        uint64_t inputEnd = 0;        // Input frames fed up to here, then silence when it is the end
+        uint64_t outputStart = 0;     // First frame written to the file
+        uint64_t outputEnd = 0;       // Output stops here
+        unsigned int headFrames = 0;  // Frames before outputStart kept for the crossfade in
+        unsigned int tailFrames = 0;  // Frames before outputEnd kept for the crossfade out, not written
+        bool flush = false;           // inputEnd is the end of the file: flush the chain with silence
+    };
+
+    // Open the input and note its format and length in result
+    bool OpenInput(const std::string& inputPath, OfflineResult& result);
+
+    // Set up the chain and its buffers for inputFormat. Returns false with result.error set.
+    bool Configure(const AudioFormat& inputFormat, OfflineResult& result);
+
+    // How many chunks a file of result's length is processed in (1 = sequentially)
+    unsigned int GetChunkCount(const OfflineResult& result) const;
+
+    // Input frames chunk boundaries are multiples of
+    uint64_t GetChunkAlignment(const OfflineResult& result) const;
+
+    // Cut the file into chunkCount segments
+    std::vector<Segment> PlanChunks(unsigned int chunkCount, uint64_t outputFrames, const OfflineResult& result) const;
+
+    // Process the chunks of the open input on helper processors, one thread each (this one
+    // takes the first), then crossfade the overlaps into the file
+    bool ProcessChunks(const std::string& inputPath, const std::vector<Segment>& segments, OfflineResult& result);
+
+    // Open inputPath on this processor and run one segment into writer (a helper's part)
+    bool ProcessChunk(const std::string& inputPath, const Segment& segment, WavWriter& writer, std::mutex* writerMutex,
+                      OfflineResult& result);
+
+    // Feed segment through the configured chain. writerMutex guards writer when chunks share it.
+    bool RunSegment(const Segment& segment, WavWriter& writer, std::mutex* writerMutex, const OfflineResult& result);
+
+    // Run one packet (null = silence) through the chain and hand the output on. Returns false
+    // when the output block could not be written out to make room.
+    bool ProcessPacket(const void* input, unsigned int frames);
+
+    // Route produced frames to the discarded warm-up, the overlaps or the output block
+    void DeliverOutput(const float* frames, unsigned int frameCount);
+
+    // Write the output block to the file and empty it
+    bool FlushOutput();
+
+    OfflineOptions m_options;
+    std::unique_ptr<NoiseSuppress> m_noiseSuppressor;
+    std::unique_ptr<AudioPipeline> m_pipeline;
+    BufferArena m_arena;
+
+    WavReader m_reader;
+    WavWriter m_writer;
+
+    unsigned int m_periodFrames;
+    unsigned int m_blockFrames;
+    unsigned int m_noiseLatencyFrames;           // Noise suppressor delay, in output frames
+    ArenaBuffer<unsigned char> m_inputBlock;     // Input frames when the file could not be mapped
+    ArenaBuffer<unsigned char> m_outputBlock;    // Output frames waiting to be written
+    unsigned int m_outputBlockCapacity;          // In frames
+    unsigned int m_outputBlockFrames;
+
+    // Segment being processed
+    Segment m_segment;
+    WavWriter* m_segmentWriter;
+    std::mutex* m_writerMutex;
+    unsigned int m_skipFrames;                   // Noise suppressor delay still to drop from the output
+    uint64_t m_outputPosition;                   // Output frame the chain produces next
+    uint64_t m_outputBlockStart;                 // Output frame the output block starts at
+    std::vector<float> m_headOverlap;            // Crossfade in (kept for the parent to mix)
+    std::vector<float> m_tailOverlap;            // Crossfade out
+
+    std::function<void(const std::wstring&)> m_diagnosticCallback;
+};
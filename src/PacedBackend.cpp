@@ -0,0 +1,255 @@
+#include "PacedBackend.h"
+#include <cstring>
+
+//
+// BackendPacer
+//
+
+BackendPacer::BackendPacer()
+    : m_period(0.01)
+    , m_periodFrames(0)
+    , m_lastSignalledTick(0)
+    , m_interrupted(false)
+{
+}
+
+void BackendPacer::Start(unsigned int periodFrames, unsigned int sampleRate, double clockSkewPpm)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_startTime = std::chrono::steady_clock::now();
+    m_period = std::chrono::duration<double>((double)periodFrames / ((double)sampleRate * (1.0 + clockSkewPpm * 1e-6)));
+    m_periodFrames = periodFrames;
+    m_lastSignalledTick = 0;
+    m_interrupted = false;
+}
+
+uint64_t BackendPacer::GetTicksElapsed() const
+{
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - m_startTime;
+    return (uint64_t)(elapsed.count() / m_period.count());
+}
+
+uint64_t BackendPacer::GetFramesElapsed() const
+{
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - m_startTime;
+    return (uint64_t)(elapsed.count() / m_period.count() * m_periodFrames);
+}
+
+BackendWaitResult BackendPacer::WaitForTick(unsigned int timeoutMs)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    std::chrono::steady_clock::time_point nextTick = m_startTime +
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(m_period * (double)(m_lastSignalledTick + 1));
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+
+    bool interrupted = m_condition.wait_until(lock, nextTick < deadline ? nextTick : deadline,
+                                              [this] { return m_interrupted; });
+    if (interrupted)
+        return BackendWaitResult::Interrupted;
+
+    uint64_t ticks = GetTicksElapsed();
+    if (ticks <= m_lastSignalledTick)
+        return BackendWaitResult::Timeout;
+
+    m_lastSignalledTick = ticks;
+    return BackendWaitResult::Ready;
+}
+
+void BackendPacer::Interrupt()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_interrupted = true;
+    }
+    m_condition.notify_all();
+}
+
+//
+// PacedCaptureBackend
+//
+
+PacedCaptureBackend::PacedCaptureBackend(const AudioFormat& format, unsigned int periodFrames, unsigned int bufferPeriods)
+    : m_format(format)
+    , m_periodFrames(periodFrames)
+    , m_bufferPeriods(bufferPeriods > 0 ? bufferPeriods : 1)
+    , m_clockSkewPpm(0.0)
+    , m_packetsDelivered(0)
+    , m_packetOutstanding(false)
+    , m_isStarted(false)
+{
+    m_packet.resize(periodFrames * format.getBlockAlign());
+}
+
+PacedCaptureBackend::~PacedCaptureBackend()
+{
+}
+
+bool PacedCaptureBackend::Start()
+{
+    m_packetsDelivered = 0;
+    m_packetOutstanding = false;
+    m_pacer.Start(m_periodFrames, m_format.sampleRate, m_clockSkewPpm);
+    m_isStarted = true;
+    return true;
+}
+
+void PacedCaptureBackend::Stop()
+{
+    m_isStarted = false;
+}
+
+bool PacedCaptureBackend::GetBuffer(const void** data, unsigned int* frameCount, unsigned int* flags)
+{
+    *data = nullptr;
+    *frameCount = 0;
+    *flags = AudioBufferFlag_None;
+
+    if (!m_isStarted || m_packetOutstanding)
+        return m_isStarted;
+
+    uint64_t packetsDue = m_pacer.GetTicksElapsed();
+    if (m_packetsDelivered >= packetsDue)
+        return true;
+
+    // Like a real device, a reader that falls behind by more than the buffer loses the oldest data
+    if (packetsDue - m_packetsDelivered > m_bufferPeriods)
+    {
+        m_packetsDelivered = packetsDue - m_bufferPeriods;
+        *flags |= AudioBufferFlag_Discontinuity;
+    }
+
+    FillPacket(m_packet.data(), m_periodFrames, flags);
+    m_packetOutstanding = true;
+
+    *data = m_packet.data();
+    *frameCount = m_periodFrames;
+    return true;
+}
+
+void PacedCaptureBackend::ReleaseBuffer(unsigned int frameCount)
+{
+    if (m_packetOutstanding && frameCount > 0)
+        m_packetsDelivered++;
+    m_packetOutstanding = false;
+}
+
+bool PacedCaptureBackend::GetNextPacketSize(unsigned int* frameCount)
+{
+    *frameCount = 0;
+    if (!m_isStarted)
+        return false;
+
+    uint64_t nextPacket = m_packetsDelivered + (m_packetOutstanding ? 1 : 0);
+    if (nextPacket < m_pacer.GetTicksElapsed())
+        *frameCount = m_periodFrames;
+    return true;
+}
+
+//
+// PacedRenderBackend
+//
+
+PacedRenderBackend::PacedRenderBackend(const AudioFormat& format, unsigned int periodFrames, unsigned int bufferPeriods)
+    : m_format(format)
+    , m_periodFrames(periodFrames)
+    , m_bufferFrames(periodFrames * (bufferPeriods > 0 ? bufferPeriods : 1))
+    , m_clockSkewPpm(0.0)
+    , m_paddingFrames(0)
+    , m_pendingFrames(0)
+    , m_ticksPlayed(0)
+    , m_underrunFrames(0)
+    , m_isStarted(false)
+{
+    m_buffer.resize(m_bufferFrames * format.getBlockAlign());
+}
+
+PacedRenderBackend::~PacedRenderBackend()
+{
+}
+
+bool PacedRenderBackend::Start()
+{
+    m_ticksPlayed = 0;
+    m_pacer.Start(m_periodFrames, m_format.sampleRate, m_clockSkewPpm);
+    m_isStarted = true;
+    return true;
+}
+
+void PacedRenderBackend::Stop()
+{
+    AdvanceToNow();
+    m_isStarted = false;
+}
+
+void PacedRenderBackend::AdvanceToNow()
+{
+    if (!m_isStarted)
+        return;
+
+    const unsigned int blockAlign = m_format.getBlockAlign();
+    uint64_t ticks = m_pacer.GetTicksElapsed();
+
+    while (m_ticksPlayed < ticks)
+    {
+        unsigned int played = m_paddingFrames < m_periodFrames ? m_paddingFrames : m_periodFrames;
+        if (played > 0)
+            ConsumeFrames(m_buffer.data(), played);
+
+        if (played < m_periodFrames)
+        {
+            ConsumeFrames(nullptr, m_periodFrames - played);
+            m_underrunFrames += m_periodFrames - played;
+        }
+
+        m_paddingFrames -= played;
+        if (m_paddingFrames > 0)
+            std::memmove(m_buffer.data(), m_buffer.data() + played * blockAlign, m_paddingFrames * blockAlign);
+
+        m_ticksPlayed++;
+    }
+}
+
+BackendWaitResult PacedRenderBackend::WaitForEvent(unsigned int timeoutMs)
+{
+    BackendWaitResult result = m_pacer.WaitForTick(timeoutMs);
+    if (result == BackendWaitResult::Ready)
+        AdvanceToNow();
+    return result;
+}
+
+bool PacedRenderBackend::GetCurrentPadding(unsigned int* paddingFrames)
+{
+    AdvanceToNow();
+    *paddingFrames = m_paddingFrames;
+    return m_isStarted;
+}
+
+bool PacedRenderBackend::GetPlayedFrames(uint64_t* playedFrames)
+{
+    *playedFrames = m_pacer.GetFramesElapsed();
+    return m_isStarted;
+}
+
+bool PacedRenderBackend::GetBuffer(unsigned int frameCount, void** data)
+{
+    *data = nullptr;
+    if (frameCount > m_bufferFrames - m_paddingFrames)
+        return false;
+
+    m_pendingFrames = frameCount;
+    *data = m_buffer.data() + m_paddingFrames * m_format.getBlockAlign();
+    return true;
+}
+
+void PacedRenderBackend::ReleaseBuffer(unsigned int frameCount, unsigned int flags)
+{
+    if (frameCount > m_pendingFrames)
+        frameCount = m_pendingFrames;
+
+    if (flags & AudioBufferFlag_Silent)
+        std::memset(m_buffer.data() + m_paddingFrames * m_format.getBlockAlign(), 0, frameCount * m_format.getBlockAlign());
+
+    m_paddingFrames += frameCount;
+    m_pendingFrames = 0;
+}
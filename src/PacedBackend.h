@@ -0,0 +1,150 @@
+#pragma once
+
+#include "IAudioBackend.h"
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+
+// Wall-clock period timer shared by the simulated backends.
+// Tick n fires at start + n * period; waits can be interrupted from another thread.
+class BackendPacer
+{
+public:
+    BackendPacer();
+
+    // clockSkewPpm makes the simulated device clock run fast (positive) or slow (negative)
+    void Start(unsigned int periodFrames, unsigned int sampleRate, double clockSkewPpm = 0.0);
+
+    // Number of whole periods elapsed since Start()
+    uint64_t GetTicksElapsed() const;
+
+    // Device frames elapsed since Start(), between ticks too
+    uint64_t GetFramesElapsed() const;
+
+    // When the device clock started (tick 0)
+    std::chrono::steady_clock::time_point GetStartTime() const { return m_startTime; }
+
+    // Wait for the next tick not yet reported by a previous call
+    BackendWaitResult WaitForTick(unsigned int timeoutMs);
+
+    void Interrupt();
+
+private:
+    std::chrono::steady_clock::time_point m_startTime;
+    std::chrono::duration<double> m_period;
+    unsigned int m_periodFrames;
+    uint64_t m_lastSignalledTick;
+    bool m_interrupted;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+};
+
+// Capture device stand-in that produces one period-sized packet per tick.
+// Subclasses supply the packet contents.
+class PacedCaptureBackend : public IAudioCaptureBackend
+{
+public:
+    PacedCaptureBackend(const AudioFormat& format, unsigned int periodFrames, unsigned int bufferPeriods = 4);
+    ~PacedCaptureBackend() override;
+
+    // IAudioBackend interface
+    const AudioFormat& GetFormat() const override { return m_format; }
+    unsigned int GetBufferFrameCount() const override { return m_periodFrames * m_bufferPeriods; }
+    unsigned int GetPeriodFrameCount() const override { return m_periodFrames; }
+    bool Start() override;
+    void Stop() override;
+    BackendWaitResult WaitForEvent(unsigned int timeoutMs) override { return m_pacer.WaitForTick(timeoutMs); }
+    void Interrupt() override { m_pacer.Interrupt(); }
+    void SetDiagnosticCallback(std::function<void(const std::wstring&)> callback) override { m_diagnosticCallback = callback; }
+
+    // IAudioCaptureBackend interface
+    bool GetBuffer(const void** data, unsigned int* frameCount, unsigned int* flags) override;
+    void ReleaseBuffer(unsigned int frameCount) override;
+    bool GetNextPacketSize(unsigned int* frameCount) override;
+
+    // Run the simulated device clock off nominal by ppm (takes effect on Start)
+    void SetClockSkewPpm(double ppm) { m_clockSkewPpm = ppm; }
+    double GetClockSkewPpm() const { return m_clockSkewPpm; }
+
+protected:
+    // Fill one packet in the backend format. Set AudioBufferFlag_Silent in flags for silence.
+    virtual void FillPacket(void* data, unsigned int frameCount, unsigned int* flags) = 0;
+
+    // Index of the packet being filled, counted from Start(): its first frame is index * period.
+    // Packets lost to a late reader are skipped, so it can jump.
+    uint64_t GetPacketIndex() const { return m_packetsDelivered; }
+
+    // When the device clock started; packet n is due at this plus n + 1 periods
+    std::chrono::steady_clock::time_point GetStartTime() const { return m_pacer.GetStartTime(); }
+
+    AudioFormat m_format;
+    std::function<void(const std::wstring&)> m_diagnosticCallback;
+
+private:
+    unsigned int m_periodFrames;
+    unsigned int m_bufferPeriods;
+    double m_clockSkewPpm;
+    BackendPacer m_pacer;
+    std::vector<unsigned char> m_packet;
+    uint64_t m_packetsDelivered;
+    bool m_packetOutstanding;
+    bool m_isStarted;
+};
+
+// Render device stand-in that plays one period from its buffer per tick.
+// Subclasses receive the played frames (nullptr data = silence inserted on underrun).
+class PacedRenderBackend : public IAudioRenderBackend
+{
+public:
+    PacedRenderBackend(const AudioFormat& format, unsigned int periodFrames, unsigned int bufferPeriods = 2);
+    ~PacedRenderBackend() override;
+
+    // IAudioBackend interface
+    const AudioFormat& GetFormat() const override { return m_format; }
+    unsigned int GetBufferFrameCount() const override { return m_bufferFrames; }
+    unsigned int GetPeriodFrameCount() const override { return m_periodFrames; }
+    bool Start() override;
+    void Stop() override;
+    BackendWaitResult WaitForEvent(unsigned int timeoutMs) override;
+    void Interrupt() override { m_pacer.Interrupt(); }
+    void SetDiagnosticCallback(std::function<void(const std::wstring&)> callback) override { m_diagnosticCallback = callback; }
+
+    // IAudioRenderBackend interface
+    bool GetCurrentPadding(unsigned int* paddingFrames) override;
+    bool GetPlayedFrames(uint64_t* playedFrames) override;
+    bool GetBuffer(unsigned int frameCount, void** data) override;
+    void ReleaseBuffer(unsigned int frameCount, unsigned int flags) override;
+
+    // Frames of silence the device had to play because the buffer ran dry
+    uint64_t GetUnderrunFrameCount() const { return m_underrunFrames; }
+
+    // Run the simulated device clock off nominal by ppm (takes effect on Start)
+    void SetClockSkewPpm(double ppm) { m_clockSkewPpm = ppm; }
+    double GetClockSkewPpm() const { return m_clockSkewPpm; }
+
+protected:
+    virtual void ConsumeFrames(const void* data, unsigned int frameCount) = 0;
+
+    // When the device clock started; tick n takes the nth period from the buffer
+    std::chrono::steady_clock::time_point GetStartTime() const { return m_pacer.GetStartTime(); }
+
+    AudioFormat m_format;
+    std::function<void(const std::wstring&)> m_diagnosticCallback;
+
+private:
+    // Play every period that elapsed since the last call
+    void AdvanceToNow();
+
+    unsigned int m_periodFrames;
+    unsigned int m_bufferFrames;
+    double m_clockSkewPpm;
+    BackendPacer m_pacer;
+    std::vector<unsigned char> m_buffer;
+    unsigned int m_paddingFrames;
+    unsigned int m_pendingFrames;
+    uint64_t m_ticksPlayed;
+    uint64_t m_underrunFrames;
+    bool m_isStarted;
+};
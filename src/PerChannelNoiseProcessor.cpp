@@ -0,0 +1,124 @@
+#include "PerChannelNoiseProcessor.h"
+#include <algorithm>
+#include <sstream>
+#include <thread>
+
+PerChannelNoiseProcessor::PerChannelNoiseProcessor(const Factory& factory)
+    : m_factory(factory)
+    , m_channels(0)
+    , m_maxWorkers(0)
+    , m_maxFrames(0)
+    , m_block(nullptr)
+    , m_blockFrames(0)
+{
+    // The first instance answers the format questions asked before Initialize()
+    m_processors.push_back(m_factory());
+}
+
+PerChannelNoiseProcessor::~PerChannelNoiseProcessor()
+{
+    m_pool.Stop();
+}
+
+void PerChannelNoiseProcessor::SetDiagnosticCallback(std::function<void(const std::wstring&)> callback)
+{
+    // Only the first instance reports how it was set up; the others would repeat it per channel
+    m_diagnosticCallback = callback;
+    m_processors[0]->SetDiagnosticCallback(callback);
+}
+
+void PerChannelNoiseProcessor::SetDiagnosticLog(DiagnosticLog* log)
+{
+    m_processors[0]->SetDiagnosticLog(log);
+}
+
+bool PerChannelNoiseProcessor::Initialize(unsigned int sampleRate, unsigned int channels)
+{
+    if (channels == 0)
+        return false;
+
+    m_pool.Stop();
+    m_processors.resize(1);
+    m_channels = channels;
+    while (m_processors.size() < channels)
+        m_processors.push_back(m_factory());
+
+    for (unsigned int ch = 0; ch < channels; ch++)
+    {
+        if (!m_processors[ch] || !m_processors[ch]->Initialize(sampleRate, 1))
+            return false;
+    }
+
+    // The calling thread processes channels too, so it needs one worker less than the channels
+    unsigned int workers = 0;
+    if (channels > ParallelThreshold)
+    {
+        // One core (or an unknown count) leaves nothing to run in parallel on
+        unsigned int cores = std::thread::hardware_concurrency();
+        workers = cores > 1 ? std::min(channels - 1, cores - 1) : 0;
+        if (m_maxWorkers > 0 && workers > m_maxWorkers)
+            workers = m_maxWorkers;
+        if (!m_pool.Start(workers))
+            workers = 0;
+    }
+
+    if (m_diagnosticCallback)
+    {
+        std::wostringstream msg;
+        msg << L"Denoising " << channels << L" channels separately";
+        if (workers > 0)
+            msg << L" on " << workers + 1 << L" threads";
+        m_diagnosticCallback(msg.str());
+    }
+    return true;
+}
+
+void PerChannelNoiseProcessor::SetCallFrameCount(unsigned int frameCount)
+{
+    for (unsigned int ch = 0; ch < m_channels; ch++)
+        m_processors[ch]->SetCallFrameCount(frameCount);
+}
+
+void PerChannelNoiseProcessor::ReserveBuffers(BufferArena& arena, unsigned int maxFrames)
+{
+    m_maxFrames = maxFrames;
+    arena.Reserve(m_planes, (size_t)maxFrames * m_channels);
+    for (unsigned int ch = 0; ch < m_channels; ch++)
+        m_processors[ch]->ReserveBuffers(arena, maxFrames);
+}
+
+void PerChannelNoiseProcessor::Process(float* audioData, unsigned int frameCount, unsigned int channels)
+{
+    if (!audioData || frameCount == 0 || channels != m_channels)
+        return;
+
+    // Larger than reserved: leave the audio untouched rather than allocate here
+    if (frameCount > m_maxFrames)
+        return;
+
+    m_block = audioData;
+    m_blockFrames = frameCount;
+    m_pool.Run(&PerChannelNoiseProcessor::ProcessChannel, this, m_channels);
+
+    // Interleave the denoised planes back on this thread: channels written from several threads
+    // would share cache lines
+    for (unsigned int ch = 0; ch < m_channels; ch++)
+    {
+        const float* plane = m_planes.data() + (size_t)ch * m_maxFrames;
+        for (unsigned int i = 0; i < frameCount; i++)
+            audioData[i * m_channels + ch] = plane[i];
+    }
+}
+
+void PerChannelNoiseProcessor::ProcessChannel(void* context, unsigned int channel)
+{
+    PerChannelNoiseProcessor* self = static_cast<PerChannelNoiseProcessor*>(context);
+    const unsigned int channels = self->m_channels;
+    const unsigned int frameCount = self->m_blockFrames;
+    float* plane = self->m_planes.data() + (size_t)channel * self->m_maxFrames;
+
+    for (unsigned int i = 0; i < frameCount; i++)
+        plane[i] = self->m_block[i * channels + channel];
+
+    self->m_processors[channel]->Process(plane, frameCount, 1);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "BufferArena.h"
+#include "NoiseReductionTypes.h"
+#include "WorkerPool.h"
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Runs a mono instance of a noise processor per channel, so stereo and multichannel inputs keep
+// their channels apart instead of being downmixed to one. Every instance has its own state
+// (DenoiseState, SpeexPreprocessState) and frame accumulation, so the channels stay in step.
+//
+// With more than two channels the instances run concurrently on a small pool of pinned audio
+// threads (the calling thread takes a share), joined before each call returns.
+class PerChannelNoiseProcessor : public INoiseProcessor
+{
+public:
+    typedef std::function<std::unique_ptr<INoiseProcessor>()> Factory;
+
+    // Channel counts above this are processed in parallel
+    static const unsigned int ParallelThreshold = 2;
+
+    // factory creates one (uninitialized) instance of the wrapped processor
+    explicit PerChannelNoiseProcessor(const Factory& factory);
+    ~PerChannelNoiseProcessor() override;
+
+    // Most worker threads Initialize() starts (0 = one per channel beyond the first, up to the
+    // cores available). Call before Initialize().
+    void SetMaxWorkers(unsigned int maxWorkers) { m_maxWorkers = maxWorkers; }
+    unsigned int GetWorkerCount() const { return m_pool.GetWorkerCount(); }
+
+    // INoiseProcessor interface
+    bool Initialize(unsigned int sampleRate, unsigned int channels) override;
+    void Process(float* audioData, unsigned int frameCount, unsigned int channels) override;
+    void SetCallFrameCount(unsigned int frameCount) override;
+    void ReserveBuffers(BufferArena& arena, unsigned int maxFrames) override;
+    unsigned int GetLatencyFrames() const override { return m_processors[0]->GetLatencyFrames(); }
+    const wchar_t* GetName() const override { return m_processors[0]->GetName(); }
+    unsigned int GetRequiredFrameSize() const override { return m_processors[0]->GetRequiredFrameSize(); }
+    unsigned int GetRequiredSampleRate() const override { return m_processors[0]->GetRequiredSampleRate(); }
+    void SetDiagnosticCallback(std::function<void(const std::wstring&)> callback) override;
+    void SetDiagnosticLog(DiagnosticLog* log) override;
+
+private:
+    // Worker pool task: denoise one channel of the current block in its plane
+    static void ProcessChannel(void* context, unsigned int channel);
+
+    Factory m_factory;
+    std::vector<std::unique_ptr<INoiseProcessor>> m_processors;   // One per channel (the first exists from construction)
+    unsigned int m_channels;
+    unsigned int m_maxWorkers;
+    WorkerPool m_pool;
+
+    // Planar copy of the block being processed, one plane of m_maxFrames per channel
+    ArenaBuffer<float> m_planes;
+    unsigned int m_maxFrames;
+    const float* m_block;           // Interleaved block the tasks read their channel from
+    unsigned int m_blockFrames;
+
+    std::function<void(const std::wstring&)> m_diagnosticCallback;
+};
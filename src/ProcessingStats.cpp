@@ -0,0 +1,150 @@
+#include "ProcessingStats.h"
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+    // Smoothing of the load gauge per device period (about a second at 10 ms periods)
+    const double LoadSmoothing = 0.01;
+}
+
+ProcessingStats::ProcessingStats()
+    : m_pendingBusyNs(0)
+    , m_dspLoad(0.0)
+    , m_peakDspLoad(0.0)
+    , m_droppedFrames(0)
+    , m_renderStarvations(0)
+    , m_insertedSilenceFrames(0)
+    , m_bufferTargetMs(0.0)
+    , m_captureWakes(0)
+    , m_capturePackets(0)
+    , m_maxPacketsPerWake(0)
+    , m_catchUpEpisodes(0)
+    , m_catchUpSeconds(0.0)
+{
+    Reset();
+}
+
+int64_t ProcessingStats::Now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void ProcessingStats::Reset()
+{
+    for (int i = 0; i < (int)ProcessingStage::Count; i++)
+    {
+        m_stages[i].Reset();
+        m_callbackStageNs[i].store(0, std::memory_order_relaxed);
+    }
+    m_pendingBusyNs.store(0, std::memory_order_relaxed);
+    m_dspLoad.store(0.0, std::memory_order_relaxed);
+    m_peakDspLoad.store(0.0, std::memory_order_relaxed);
+    m_droppedFrames.store(0, std::memory_order_relaxed);
+    m_renderStarvations.store(0, std::memory_order_relaxed);
+    m_insertedSilenceFrames.store(0, std::memory_order_relaxed);
+    m_bufferTargetMs.store(0.0, std::memory_order_relaxed);
+    m_captureWakes.store(0, std::memory_order_relaxed);
+    m_capturePackets.store(0, std::memory_order_relaxed);
+    m_maxPacketsPerWake.store(0, std::memory_order_relaxed);
+    m_catchUpEpisodes.store(0, std::memory_order_relaxed);
+    m_catchUpSeconds.store(0.0, std::memory_order_relaxed);
+}
+
+void ProcessingStats::RecordLoad(int64_t busyNs, double audioNs)
+{
+    if (audioNs <= 0.0)
+        return;
+
+    busyNs += m_pendingBusyNs.exchange(0, std::memory_order_relaxed);
+    double load = busyNs / audioNs;
+
+    double smoothed = m_dspLoad.load(std::memory_order_relaxed);
+    smoothed = smoothed == 0.0 ? load : smoothed + (load - smoothed) * LoadSmoothing;
+    m_dspLoad.store(smoothed, std::memory_order_relaxed);
+
+    if (load > m_peakDspLoad.load(std::memory_order_relaxed))
+        m_peakDspLoad.store(load, std::memory_order_relaxed);
+}
+
+void ProcessingStats::RecordCaptureWake(unsigned int packets)
+{
+    m_captureWakes.fetch_add(1, std::memory_order_relaxed);
+    m_capturePackets.fetch_add(packets, std::memory_order_relaxed);
+    if (packets > m_maxPacketsPerWake.load(std::memory_order_relaxed))
+        m_maxPacketsPerWake.store(packets, std::memory_order_relaxed);
+}
+
+ProcessingStatsSnapshot ProcessingStats::GetSnapshot() const
+{
+    ProcessingStatsSnapshot snapshot;
+    for (int i = 0; i < (int)ProcessingStage::Count; i++)
+    {
+        snapshot.stages[i] = m_stages[i].Summarize();
+    }
+    snapshot.dspLoad = m_dspLoad.load(std::memory_order_relaxed);
+    snapshot.peakDspLoad = m_peakDspLoad.load(std::memory_order_relaxed);
+    snapshot.droppedFrames = m_droppedFrames.load(std::memory_order_relaxed);
+    snapshot.renderStarvations = m_renderStarvations.load(std::memory_order_relaxed);
+    snapshot.insertedSilenceFrames = m_insertedSilenceFrames.load(std::memory_order_relaxed);
+    snapshot.bufferTargetMs = m_bufferTargetMs.load(std::memory_order_relaxed);
+    snapshot.captureWakes = m_captureWakes.load(std::memory_order_relaxed);
+    snapshot.capturePackets = m_capturePackets.load(std::memory_order_relaxed);
+    snapshot.maxPacketsPerWake = m_maxPacketsPerWake.load(std::memory_order_relaxed);
+    snapshot.catchUpEpisodes = m_catchUpEpisodes.load(std::memory_order_relaxed);
+    snapshot.catchUpSeconds = m_catchUpSeconds.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+const wchar_t* ProcessingStats::GetStageName(ProcessingStage stage)
+{
+    switch (stage)
+    {
+    case ProcessingStage::InputConversion: return L"Input conversion";
+    case ProcessingStage::NoiseSuppression: return L"Noise suppression";
+    case ProcessingStage::ChannelMix: return L"Channel mix";
+    case ProcessingStage::Resample: return L"Resample";
+    case ProcessingStage::TimeStretch: return L"Time stretch";
+    case ProcessingStage::OutputConversion: return L"Output conversion";
+    case ProcessingStage::Callback: return L"Callback";
+    default: return L"Unknown";
+    }
+}
+
+std::wstring ProcessingStats::FormatSnapshot(const ProcessingStatsSnapshot& snapshot)
+{
+    std::wostringstream text;
+    text << std::fixed << std::setprecision(1);
+    text << L"DSP load: " << snapshot.dspLoad * 100.0 << L"% (peak " << snapshot.peakDspLoad * 100.0 << L"%)";
+    text << L"\r\nBuffer target: " << snapshot.bufferTargetMs << L" ms, " << snapshot.renderStarvations
+         << L" underruns (" << snapshot.insertedSilenceFrames << L" frames of silence inserted), "
+         << snapshot.droppedFrames << L" frames dropped";
+    if (snapshot.captureWakes > 0)
+    {
+        text << L"\r\nCapture: " << snapshot.capturePackets << L" packets in " << snapshot.captureWakes << L" wake-ups ("
+             << (double)snapshot.capturePackets / snapshot.captureWakes << L" per wake-up, max "
+             << snapshot.maxPacketsPerWake << L")";
+    }
+    if (snapshot.catchUpEpisodes > 0)
+    {
+        text << L"\r\nLatency catch-up: " << snapshot.catchUpEpisodes << L" episodes, " << snapshot.catchUpSeconds
+             << L" s time-stretched";
+    }
+
+    // Times in microseconds; stages that never ran are left out
+    text << std::setprecision(2);
+    for (int i = 0; i < (int)ProcessingStage::Count; i++)
+    {
+        const TimingHistogram::Summary& stage = snapshot.stages[i];
+        if (stage.count == 0)
+            continue;
+
+        text << L"\r\n" << GetStageName((ProcessingStage)i) << L": mean " << stage.meanNs / 1000.0
+             << L" us, p50 " << stage.p50Ns / 1000.0 << L", p99 " << stage.p99Ns / 1000.0
+             << L", p99.9 " << stage.p999Ns / 1000.0 << L", max " << stage.maxNs / 1000.0
+             << L" (" << stage.count << L" calls)";
+    }
+    return text.str();
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "TimingHistogram.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Timed parts of the real-time path
+enum class ProcessingStage
+{
+    InputConversion = 0,    // Device format -> float
+    NoiseSuppression,
+    ChannelMix,
+    Resample,
+    TimeStretch,            // Latency catch-up (WSOLA)
+    OutputConversion,       // Float -> device format (or the raw copy)
+    Callback,               // One wake-up of an audio thread, start to finish
+    Count
+};
+
+struct ProcessingStatsSnapshot
+{
+    TimingHistogram::Summary stages[(int)ProcessingStage::Count];
+    double dspLoad = 0.0;       // Smoothed processing time / audio time (1.0 = no headroom left)
+    double peakDspLoad = 0.0;   // Highest single-period load since the stream started
+
+    // Stream health since the stream started
+    uint64_t droppedFrames = 0;         // Captured frames discarded because the queue was full
+    uint64_t renderStarvations = 0;     // Times the render device ran dry
+    uint64_t insertedSilenceFrames = 0; // Silence written to re-prime the render device after starving
+    double bufferTargetMs = 0.0;        // Buffer level currently aimed for (adaptive)
+    uint64_t captureWakes = 0;          // Capture wake-ups that found data
+    uint64_t capturePackets = 0;        // Packets drained in them
+    unsigned int maxPacketsPerWake = 0;
+    uint64_t catchUpEpisodes = 0;       // Times time stretching set in to bring the buffer level back to target
+    double catchUpSeconds = 0.0;        // Stream time spent stretched
+};
+
+// Where a route spends its time: a timing histogram per stage plus a DSP load gauge.
+// The audio threads record (lock-free, no allocation); any thread may take a snapshot.
+class ProcessingStats
+{
+public:
+    ProcessingStats();
+
+    // Clock used for all stage timings, in ns
+    static int64_t Now();
+
+    // Forget everything (start of a stream; nothing may be recording)
+    void Reset();
+
+    void RecordStage(ProcessingStage stage, int64_t durationNs)
+    {
+        m_stages[(int)stage].Record(durationNs);
+        m_callbackStageNs[(int)stage].fetch_add(durationNs, std::memory_order_relaxed);
+    }
+
+    // Time recorded for stage since the last call (what the current callback spent on it)
+    int64_t TakeCallbackStageTime(ProcessingStage stage) { return m_callbackStageNs[(int)stage].exchange(0, std::memory_order_relaxed); }
+
+    // Time spent on a thread that does not produce load samples itself (the render thread in
+    // split mode); it is charged to the next RecordLoad() call
+    void AddBusyTime(int64_t durationNs) { m_pendingBusyNs.fetch_add(durationNs, std::memory_order_relaxed); }
+
+    // One device period: busyNs of processing for audioNs of audio. Single thread (capture side).
+    void RecordLoad(int64_t busyNs, double audioNs);
+
+    // Stream health counters (any thread)
+    void AddDroppedFrames(uint64_t frames) { m_droppedFrames.fetch_add(frames, std::memory_order_relaxed); }
+    void AddRenderStarvation() { m_renderStarvations.fetch_add(1, std::memory_order_relaxed); }
+    void AddInsertedSilence(uint64_t frames) { m_insertedSilenceFrames.fetch_add(frames, std::memory_order_relaxed); }
+    uint64_t GetRenderStarvations() const { return m_renderStarvations.load(std::memory_order_relaxed); }
+    void SetBufferTarget(double ms) { m_bufferTargetMs.store(ms, std::memory_order_relaxed); }
+
+    // One capture wake-up drained this many packets (capture thread only)
+    void RecordCaptureWake(unsigned int packets);
+
+    // Latency catch-up accounting (capture thread only)
+    void CountCatchUpEpisode() { m_catchUpEpisodes.fetch_add(1, std::memory_order_relaxed); }
+    void AddCatchUpTime(double seconds)
+    {
+        m_catchUpSeconds.store(m_catchUpSeconds.load(std::memory_order_relaxed) + seconds, std::memory_order_relaxed);
+    }
+
+    ProcessingStatsSnapshot GetSnapshot() const;
+
+    static const wchar_t* GetStageName(ProcessingStage stage);
+
+    // Multi-line table of the stages and the load, for the diagnostics pane and logs
+    static std::wstring FormatSnapshot(const ProcessingStatsSnapshot& snapshot);
+
+private:
+    TimingHistogram m_stages[(int)ProcessingStage::Count];
+    std::atomic<int64_t> m_callbackStageNs[(int)ProcessingStage::Count];
+    std::atomic<int64_t> m_pendingBusyNs;
+    std::atomic<double> m_dspLoad;
+    std::atomic<double> m_peakDspLoad;
+    std::atomic<uint64_t> m_droppedFrames;
+    std::atomic<uint64_t> m_renderStarvations;
+    std::atomic<uint64_t> m_insertedSilenceFrames;
+    std::atomic<double> m_bufferTargetMs;
+    std::atomic<uint64_t> m_captureWakes;
+    std::atomic<uint64_t> m_capturePackets;
+    std::atomic<unsigned int> m_maxPacketsPerWake;
+    std::atomic<uint64_t> m_catchUpEpisodes;
+    std::atomic<double> m_catchUpSeconds;
+};
@@ -1,4 +1,5 @@
 #include "RNNoiseProcessor.h"
+#include "CpuFeatures.h"
 
 #ifdef HAVE_RNNOISE
 #include "rnnoise.h"
@@ -9,31 +10,77 @@
 #include <cmath>
 #include <sstream>
 
+const wchar_t* RNNoiseProcessor::GetKernelName()
+{
+    const CpuFeatures& cpu = GetCpuFeatures();
+    (void)cpu;
+#ifdef AUDIOROUTER_RNNOISE_AVX2
+    if (cpu.hasAvx2 && cpu.hasFma)
+        return L"AVX2";
+#endif
+#ifdef AUDIOROUTER_RNNOISE_SSE4_1
+    if (cpu.hasSse41)
+        return L"SSE4.1";
+#endif
+    return L"C";
+}
+
 #ifndef HAVE_RNNOISE
 // Stub implementation when RNNoise is not available
 RNNoiseProcessor::RNNoiseProcessor(const RNNoiseConfig& config)
-    : m_state(nullptr), m_isInitialized(false), m_config(config), m_totalFramesProcessed(0) {}
+    : m_state(nullptr), m_isInitialized(false), m_config(config), m_callFrameCount(0), m_bufferingFrames(0), m_totalFramesProcessed(0), m_diagnosticLog(nullptr) {}
 RNNoiseProcessor::~RNNoiseProcessor() {}
 bool RNNoiseProcessor::Initialize(unsigned int, unsigned int) {
     if (m_diagnosticCallback) m_diagnosticCallback(L"RNNoise not available (not compiled in)");
     return false;
 }
 void RNNoiseProcessor::Process(float*, unsigned int, unsigned int) {}
+void RNNoiseProcessor::ReserveBuffers(BufferArena&, unsigned int) {}
+unsigned int RNNoiseProcessor::GetLatencyFrames() const { return 0; }
 void RNNoiseProcessor::UpdateConfig(const RNNoiseConfig& config) { m_config = config; }
 #else
 
+namespace
+{
+    const unsigned int RNNOISE_FRAME_SIZE = 480;
+
+    // Write a mono sample to every channel of an interleaved frame
+    inline void WriteToChannels(float* audioData, unsigned int frame, unsigned int channels, float sample)
+    {
+        if (channels == 1)
+        {
+            audioData[frame] = sample;
+        }
+        else if (channels == 2)
+        {
+            audioData[frame * 2] = sample;
+            audioData[frame * 2 + 1] = sample;
+        }
+        else
+        {
+            for (unsigned int ch = 0; ch < channels; ch++)
+            {
+                audioData[frame * channels + ch] = sample;
+            }
+        }
+    }
+}
+
 RNNoiseProcessor::RNNoiseProcessor(const RNNoiseConfig& config)
     : m_state(nullptr)
     , m_isInitialized(false)
     , m_config(config)
+    , m_callFrameCount(0)
+    , m_bufferingFrames(0)
     , m_inputSampleRate(0)
     , m_inputChannels(0)
     , m_accumulatedSamples(0)
-    , m_outputBufferReadPos(0)
-    , m_outputBufferAvailable(0)
+    , m_outputQueued(0)
     , m_lastVadProbability(0.0f)
     , m_vadGraceSamplesRemaining(0.0f)
+    , m_isFirstFrame(true)
     , m_totalFramesProcessed(0)
+    , m_diagnosticLog(nullptr)
 {
 }
 
@@ -63,7 +110,7 @@ bool RNNoiseProcessor::Initialize(unsigned int sampleRate, unsigned int channels
     if (m_diagnosticCallback)
     {
         std::wostringstream msg;
-        msg << L"RNNoise frame size: " << frameSize;
+        msg << L"RNNoise frame size: " << frameSize << L", network kernels: " << GetKernelName();
         m_diagnosticCallback(msg.str());
     }
 
@@ -90,34 +137,44 @@ bool RNNoiseProcessor::Initialize(unsigned int sampleRate, unsigned int channels
         m_diagnosticCallback(msg.str());
     }
 
-    // Pre-allocate buffers
-    // RNNoise processes 480-sample frames at 48kHz
-    m_frameBuffer.resize(480);              // Exactly one RNNoise frame
-    m_monoBuffer.resize(4800);              // Buffer for mono conversion
-    m_processedBuffer.resize(480);          // Single processed frame
-    m_outputBuffer.resize(4800);            // Output buffer to hold processed samples
+    // Buffers are reserved in ReserveBuffers() once the largest callback size is known
 
     // Reset accumulation state
     m_accumulatedSamples = 0;
-    m_outputBufferReadPos = 0;
-    m_outputBufferAvailable = 0;
+    m_outputQueued = 0;
     m_totalFramesProcessed = 0;
 
     return true;  // Success
 }
 
+void RNNoiseProcessor::ReserveBuffers(BufferArena& arena, unsigned int maxFrames)
+{
+    // RNNoise processes 480-sample frames at 48kHz
+    arena.Reserve(m_frameBuffer, RNNOISE_FRAME_SIZE);     // Exactly one RNNoise frame
+    arena.Reserve(m_monoBuffer, maxFrames);                // Mono conversion of the largest callback
+
+    // Hand back the first calls from zeros queued ahead of the first frame: just enough that
+    // calls of the expected size always find a full call's worth processed. The queue never
+    // holds more than a frame at the end of a call, plus what one call adds.
+    m_bufferingFrames = GetFrameAlignmentDelay(RNNOISE_FRAME_SIZE, m_callFrameCount);
+    arena.Reserve(m_outputQueue, maxFrames + 2 * RNNOISE_FRAME_SIZE);
+    m_outputQueued = m_bufferingFrames;
+}
+
+unsigned int RNNoiseProcessor::GetLatencyFrames() const
+{
+    // RNNoise's overlap-add synthesis returns each frame one frame late
+    return RNNOISE_FRAME_SIZE + m_bufferingFrames.load(std::memory_order_relaxed);
+}
+
 void RNNoiseProcessor::Process(float* audioData, unsigned int frameCount, unsigned int channels)
 {
     if (!m_isInitialized || !m_state || !audioData || frameCount == 0 || channels == 0)
         return;
 
-    const unsigned int RNNOISE_FRAME_SIZE = 480;
-
-    // Ensure mono buffer is large enough
+    // Larger than reserved: leave the audio untouched rather than allocate here
     if (frameCount > m_monoBuffer.size())
-    {
-        m_monoBuffer.resize(frameCount);
-    }
+        return;
 
     // Step 1: Convert input to mono
     if (channels == 1)
@@ -142,179 +199,142 @@ void RNNoiseProcessor::Process(float* audioData, unsigned int frameCount, unsign
         }
     }
 
-    // Step 2: Process using frame accumulation
-    // This ensures RNNoise always gets exactly 480 samples to process
+    // Step 2: Feed the input through RNNoise a frame at a time, queueing the processed frames
     unsigned int inputPos = 0;
-    unsigned int outputPos = 0;
-
-    while (outputPos < frameCount)
+    while (inputPos < frameCount)
     {
-        // First, try to output any previously processed samples
-        if (m_outputBufferAvailable > 0)
+        // Accumulate samples into frame buffer until we have 480
+        unsigned int samplesToAccumulate = std::min(
+            RNNOISE_FRAME_SIZE - m_accumulatedSamples,
+            frameCount - inputPos
+        );
+
+        // Copy to accumulation buffer
+        std::memcpy(
+            &m_frameBuffer[m_accumulatedSamples],
+            &m_monoBuffer[inputPos],
+            samplesToAccumulate * sizeof(float)
+        );
+
+        m_accumulatedSamples += samplesToAccumulate;
+        inputPos += samplesToAccumulate;
+
+        // If we have a full frame, process it straight into the output queue
+        if (m_accumulatedSamples == RNNOISE_FRAME_SIZE)
         {
-            unsigned int samplesToOutput = std::min(m_outputBufferAvailable, frameCount - outputPos);
+            float* processed = m_outputQueue.data() + m_outputQueued;
 
-            // Copy from output buffer
-            for (unsigned int i = 0; i < samplesToOutput; i++)
+            // DIAGNOSTIC: Check input samples before processing
+            if (m_isFirstFrame && m_diagnosticLog)
             {
-                // Convert mono to multi-channel
-                float sample = m_outputBuffer[m_outputBufferReadPos + i];
-
-                if (channels == 1)
-                {
-                    audioData[outputPos] = sample;
-                }
-                else if (channels == 2)
-                {
-                    audioData[outputPos * 2] = sample;
-                    audioData[outputPos * 2 + 1] = sample;
-                }
-                else
+                float inputSum = 0;
+                float inputMax = 0;
+                for (unsigned int i = 0; i < RNNOISE_FRAME_SIZE; i++)
                 {
-                    for (unsigned int ch = 0; ch < channels; ch++)
-                    {
-                        audioData[outputPos * channels + ch] = sample;
-                    }
+                    inputSum += std::abs(m_frameBuffer[i]);
+                    inputMax = std::max(inputMax, std::abs(m_frameBuffer[i]));
                 }
-                outputPos++;
-            }
 
-            m_outputBufferReadPos += samplesToOutput;
-            m_outputBufferAvailable -= samplesToOutput;
-
-            if (m_outputBufferAvailable == 0)
-            {
-                m_outputBufferReadPos = 0; // Reset read position
+                const double args[] = { inputSum / RNNOISE_FRAME_SIZE, inputMax,
+                                        m_frameBuffer[0], m_frameBuffer[1], m_frameBuffer[2] };
+                m_diagnosticLog->Push(DiagnosticCode::RNNoiseFirstInput, args, 5);
             }
-        }
-        else
-        {
-            // No processed samples available, need to process more input
-            if (inputPos >= frameCount)
+
+            // RNNoise expects float samples in int16 range (-32768 to 32767), not normalized (-1.0 to 1.0)
+            // Scale input from normalized float to int16 range
+            for (unsigned int i = 0; i < RNNOISE_FRAME_SIZE; i++)
             {
-                // No more input samples - shouldn't happen, but handle gracefully
-                break;
+                m_frameBuffer[i] *= 32768.0f;
             }
 
-            // Accumulate samples into frame buffer until we have 480
-            unsigned int samplesToAccumulate = std::min(
-                RNNOISE_FRAME_SIZE - m_accumulatedSamples,
-                frameCount - inputPos
+            // Process the frame with RNNoise
+            float vad_prob = rnnoise_process_frame(
+                m_state,
+                processed,
+                m_frameBuffer.data()
             );
 
-            // Copy to accumulation buffer
-            std::memcpy(
-                &m_frameBuffer[m_accumulatedSamples],
-                &m_monoBuffer[inputPos],
-                samplesToAccumulate * sizeof(float)
-            );
+            // Scale output back from int16 range to normalized float
+            for (unsigned int i = 0; i < RNNOISE_FRAME_SIZE; i++)
+            {
+                processed[i] /= 32768.0f;
+            }
 
-            m_accumulatedSamples += samplesToAccumulate;
-            inputPos += samplesToAccumulate;
+            m_lastVadProbability = vad_prob;
 
-            // If we have a full frame, process it
-            if (m_accumulatedSamples == RNNOISE_FRAME_SIZE)
+            // Apply VAD gating if enabled (vadThreshold > 0)
+            if (m_config.vadThreshold > 0.0f)
             {
-                // DIAGNOSTIC: Check input samples before processing
-                static bool firstFrame = true;
-                if (firstFrame && m_diagnosticCallback)
-                {
-                    float inputSum = 0;
-                    float inputMax = 0;
-                    for (unsigned int i = 0; i < RNNOISE_FRAME_SIZE; i++)
-                    {
-                        inputSum += std::abs(m_frameBuffer[i]);
-                        inputMax = std::max(inputMax, std::abs(m_frameBuffer[i]));
-                    }
-
-                    std::wostringstream msg;
-                    msg << L"RNNoise Input (normalized): avg=" << (inputSum / RNNOISE_FRAME_SIZE)
-                        << L", max=" << inputMax
-                        << L", first 3=[" << m_frameBuffer[0] << L", " << m_frameBuffer[1] << L", " << m_frameBuffer[2] << L"]";
-                    m_diagnosticCallback(msg.str());
-                }
+                bool isSpeech = (vad_prob >= m_config.vadThreshold);
 
-                // RNNoise expects float samples in int16 range (-32768 to 32767), not normalized (-1.0 to 1.0)
-                // Scale input from normalized float to int16 range
-                for (unsigned int i = 0; i < RNNOISE_FRAME_SIZE; i++)
+                if (isSpeech)
                 {
-                    m_frameBuffer[i] *= 32768.0f;
+                    // Reset grace period when speech detected
+                    m_vadGraceSamplesRemaining = (m_config.vadGracePeriodMs / 1000.0f) * m_inputSampleRate;
                 }
-
-                // Process the frame with RNNoise
-                float vad_prob = rnnoise_process_frame(
-                    m_state,
-                    m_processedBuffer.data(),
-                    m_frameBuffer.data()
-                );
-
-                // Scale output back from int16 range to normalized float
-                for (unsigned int i = 0; i < RNNOISE_FRAME_SIZE; i++)
+                else if (m_vadGraceSamplesRemaining > 0)
                 {
-                    m_processedBuffer[i] /= 32768.0f;
+                    // In grace period after speech
+                    m_vadGraceSamplesRemaining -= RNNOISE_FRAME_SIZE;
+                    isSpeech = true;  // Treat as speech during grace period
                 }
 
-                m_lastVadProbability = vad_prob;
-
-                // Apply VAD gating if enabled (vadThreshold > 0)
-                if (m_config.vadThreshold > 0.0f)
+                if (!isSpeech)
                 {
-                    bool isSpeech = (vad_prob >= m_config.vadThreshold);
-
-                    if (isSpeech)
-                    {
-                        // Reset grace period when speech detected
-                        m_vadGraceSamplesRemaining = (m_config.vadGracePeriodMs / 1000.0f) * m_inputSampleRate;
-                    }
-                    else if (m_vadGraceSamplesRemaining > 0)
-                    {
-                        // In grace period after speech
-                        m_vadGraceSamplesRemaining -= RNNOISE_FRAME_SIZE;
-                        isSpeech = true;  // Treat as speech during grace period
-                    }
-
-                    if (!isSpeech)
+                    // Apply attenuation when not speech
+                    for (unsigned int i = 0; i < RNNOISE_FRAME_SIZE; i++)
                     {
-                        // Apply attenuation when not speech
-                        for (unsigned int i = 0; i < RNNOISE_FRAME_SIZE; i++)
-                        {
-                            m_processedBuffer[i] *= m_config.attenuationFactor;
-                        }
+                        processed[i] *= m_config.attenuationFactor;
                     }
                 }
+            }
 
-                // DIAGNOSTIC: Check output and voice activity
-                if (firstFrame && m_diagnosticCallback)
+            // DIAGNOSTIC: Check output and voice activity
+            if (m_isFirstFrame && m_diagnosticLog)
+            {
+                float outputSum = 0;
+                float outputMax = 0;
+                for (unsigned int i = 0; i < RNNOISE_FRAME_SIZE; i++)
                 {
-                    float outputSum = 0;
-                    float outputMax = 0;
-                    for (unsigned int i = 0; i < RNNOISE_FRAME_SIZE; i++)
-                    {
-                        outputSum += std::abs(m_processedBuffer[i]);
-                        outputMax = std::max(outputMax, std::abs(m_processedBuffer[i]));
-                    }
-
-                    std::wostringstream msg;
-                    msg << L"RNNoise Output (normalized): avg=" << (outputSum / RNNOISE_FRAME_SIZE)
-                        << L", max=" << outputMax
-                        << L", VAD=" << vad_prob
-                        << L", first 3=[" << m_processedBuffer[0] << L", " << m_processedBuffer[1] << L", " << m_processedBuffer[2] << L"]";
-                    m_diagnosticCallback(msg.str());
-                    firstFrame = false;
+                    outputSum += std::abs(processed[i]);
+                    outputMax = std::max(outputMax, std::abs(processed[i]));
                 }
 
-                m_totalFramesProcessed++;
+                const double args[] = { outputSum / RNNOISE_FRAME_SIZE, outputMax, vad_prob,
+                                        processed[0], processed[1], processed[2] };
+                m_diagnosticLog->Push(DiagnosticCode::RNNoiseFirstOutput, args, 6);
+            }
+            m_isFirstFrame = false;
 
-                // Move processed frame to output buffer
-                std::memcpy(m_outputBuffer.data(), m_processedBuffer.data(), RNNOISE_FRAME_SIZE * sizeof(float));
-                m_outputBufferReadPos = 0;
-                m_outputBufferAvailable = RNNOISE_FRAME_SIZE;
+            m_totalFramesProcessed++;
 
-                // Reset accumulation
-                m_accumulatedSamples = 0;
-            }
+            m_outputQueued += RNNOISE_FRAME_SIZE;
+
+            // Reset accumulation
+            m_accumulatedSamples = 0;
         }
     }
+
+    // Step 3: Hand back frameCount samples from the front of the queue, converted back to the
+    // channel count. The queue was primed for the expected call size, so it only runs short
+    // after a call of another size; the gap is filled with silence ahead of the queued samples.
+    // That keeps the stream continuous and delays it by as much more from then on, which the
+    // reported latency takes in. It adds up to at most a frame less the priming.
+    unsigned int available = std::min(m_outputQueued, frameCount);
+    unsigned int silence = frameCount - available;
+    if (silence > 0)
+        m_bufferingFrames.fetch_add(silence, std::memory_order_relaxed);
+    for (unsigned int i = 0; i < silence; i++)
+    {
+        WriteToChannels(audioData, i, channels, 0.0f);
+    }
+    for (unsigned int i = 0; i < available; i++)
+    {
+        WriteToChannels(audioData, silence + i, channels, m_outputQueue[i]);
+    }
+
+    m_outputQueued -= available;
+    std::memmove(m_outputQueue.data(), m_outputQueue.data() + available, m_outputQueued * sizeof(float));
 }
 
 #endif // HAVE_RNNOISE
@@ -1,7 +1,9 @@
 #pragma once
 
+#include "BufferArena.h"
+#include "DiagnosticLog.h"
 #include "NoiseReductionTypes.h"
-#include <vector>
+#include <atomic>
 
 #ifdef HAVE_RNNOISE
 // Forward declaration for RNNoise state
@@ -22,6 +24,9 @@ public:
     // INoiseProcessor interface
     bool Initialize(unsigned int sampleRate, unsigned int channels) override;
     void Process(float* audioData, unsigned int frameCount, unsigned int channels) override;
+    void SetCallFrameCount(unsigned int frameCount) override { m_callFrameCount = frameCount; }
+    void ReserveBuffers(BufferArena& arena, unsigned int maxFrames) override;
+    unsigned int GetLatencyFrames() const override;
     const wchar_t* GetName() const override { return L"RNNoise"; }
     unsigned int GetRequiredFrameSize() const override { return 480; }
     unsigned int GetRequiredSampleRate() const override { return 48000; }
@@ -29,6 +34,7 @@ public:
     {
         m_diagnosticCallback = callback;
     }
+    void SetDiagnosticLog(DiagnosticLog* log) override { m_diagnosticLog = log; }
 
     // Check if RNNoise is available at compile time
     static bool IsAvailable() {
@@ -39,6 +45,10 @@ public:
 #endif
     }
 
+    // Network kernels RNNoise runs on this machine (L"AVX2", L"SSE4.1" or L"C"): the newest set
+    // it was built with that the CPU supports, as RNNoise's own CPUID dispatch picks them
+    static const wchar_t* GetKernelName();
+
     // Diagnostic function to get processing stats
     unsigned int GetProcessedFrameCount() const { return m_totalFramesProcessed; }
 
@@ -46,31 +56,35 @@ private:
     DenoiseState* m_state;
     bool m_isInitialized;
     RNNoiseConfig m_config;
+    unsigned int m_callFrameCount;            // Expected Process() size (0 = varies)
+    std::atomic<unsigned int> m_bufferingFrames;  // Samples queued ahead of the first call, plus silence
+                                                  // inserted since (read from any thread)
 
 #ifdef HAVE_RNNOISE
     // Audio format tracking
     unsigned int m_inputSampleRate;
     unsigned int m_inputChannels;
 
-    // Processing buffers
-    std::vector<float> m_frameBuffer;         // Accumulation buffer for 480-sample frames
-    std::vector<float> m_monoBuffer;          // Mono conversion buffer
-    std::vector<float> m_processedBuffer;     // Processed output buffer
-    std::vector<float> m_outputBuffer;        // Output buffer for processed frames
+    // Processing buffers (carved out of the route's arena)
+    ArenaBuffer<float> m_frameBuffer;         // Accumulation buffer for 480-sample frames
+    ArenaBuffer<float> m_monoBuffer;          // Mono conversion buffer
+    ArenaBuffer<float> m_outputQueue;         // Processed samples waiting to be handed back (starts zeroed)
 
     // Frame accumulation state
     unsigned int m_accumulatedSamples;        // How many samples currently in frame buffer
-    unsigned int m_outputBufferReadPos;       // Read position in output buffer
-    unsigned int m_outputBufferAvailable;     // Available samples in output buffer
+    unsigned int m_outputQueued;              // Samples in the output queue
 
     // VAD state for grace period
     float m_lastVadProbability;               // Last VAD probability from RNNoise
     float m_vadGraceSamplesRemaining;         // Samples remaining in grace period
+
+    bool m_isFirstFrame;                      // Log the first frame in and out (per instance)
 #endif
 
     // Diagnostic counters
     unsigned int m_totalFramesProcessed;
 
-    // Diagnostic callback
+    // Diagnostic callback (setup) and real-time log (processing)
     std::function<void(const std::wstring&)> m_diagnosticCallback;
+    DiagnosticLog* m_diagnosticLog;
 };
@@ -0,0 +1,75 @@
+#include "RealtimeCheck.h"
+
+#ifdef AUDIOROUTER_CHECK_RT_ALLOCATIONS
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    thread_local int t_realtimeDepth = 0;
+
+    void CheckHeapAccess(const char* operation)
+    {
+        if (t_realtimeDepth > 0)
+        {
+            // Leave the section first: reporting may allocate itself
+            t_realtimeDepth = 0;
+            std::fprintf(stderr, "AudioRouter: %s on the real-time path\n", operation);
+            std::abort();
+        }
+    }
+
+    void* Allocate(std::size_t size)
+    {
+        CheckHeapAccess("heap allocation");
+        return std::malloc(size ? size : 1);
+    }
+
+    void Free(void* pointer)
+    {
+        if (pointer)
+        {
+            CheckHeapAccess("heap free");
+            std::free(pointer);
+        }
+    }
+}
+
+void* operator new(std::size_t size)
+{
+    void* pointer = Allocate(size);
+    if (!pointer)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void* operator new[](std::size_t size)
+{
+    void* pointer = Allocate(size);
+    if (!pointer)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return Allocate(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return Allocate(size); }
+void operator delete(void* pointer) noexcept { Free(pointer); }
+void operator delete[](void* pointer) noexcept { Free(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept { Free(pointer); }
+void operator delete[](void* pointer, std::size_t) noexcept { Free(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { Free(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { Free(pointer); }
+
+ScopedRealtimeSection::ScopedRealtimeSection() { t_realtimeDepth++; }
+ScopedRealtimeSection::~ScopedRealtimeSection() { t_realtimeDepth--; }
+bool IsRealtimeAllocationCheckEnabled() { return true; }
+
+#else
+
+ScopedRealtimeSection::ScopedRealtimeSection() {}
+ScopedRealtimeSection::~ScopedRealtimeSection() {}
+bool IsRealtimeAllocationCheckEnabled() { return false; }
+
+#endif
@@ -0,0 +1,22 @@
+#pragma once
+
+// Debug check that the real-time path never touches the heap.
+//
+// Builds with AUDIOROUTER_CHECK_RT_ALLOCATIONS replace the global operator new and delete:
+// while a ScopedRealtimeSection is active on the calling thread, any allocation or free
+// reports what happened and aborts, so the offending call is on the stack in the debugger.
+// Without the define the section is empty and the allocator is left alone.
+
+// Marks the calling thread as running real-time code for the lifetime of the object (nests)
+class ScopedRealtimeSection
+{
+public:
+    ScopedRealtimeSection();
+    ~ScopedRealtimeSection();
+
+    ScopedRealtimeSection(const ScopedRealtimeSection&) = delete;
+    ScopedRealtimeSection& operator=(const ScopedRealtimeSection&) = delete;
+};
+
+// True when this build aborts on real-time allocations
+bool IsRealtimeAllocationCheckEnabled();
@@ -0,0 +1,55 @@
+#include "RenderPeriodPhase.h"
+
+RenderPeriodPhase::RenderPeriodPhase()
+{
+    Reset(0);
+}
+
+void RenderPeriodPhase::Reset(unsigned int periodFrames)
+{
+    m_periodFrames = periodFrames;
+    m_boundaryOffset = 0;
+    m_lastPlayedFrames = 0;
+    m_lastLevelFrames = 0;
+    m_hasLast = false;
+}
+
+uint64_t RenderPeriodPhase::GetBoundaries(uint64_t frames) const
+{
+    return (frames + m_periodFrames - m_boundaryOffset) / m_periodFrames;
+}
+
+unsigned int RenderPeriodPhase::Update(unsigned int paddingFrames, unsigned int levelFrames, uint64_t playedFrames)
+{
+    if (m_periodFrames == 0)
+        return 0;
+
+    // Padding that dropped but not to zero tells exactly how many periods were taken since the
+    // last call. A device that ran dry only says some were.
+    if (m_hasLast && paddingFrames > 0 && playedFrames >= m_lastPlayedFrames)
+    {
+        const unsigned int droppedFrames = m_lastLevelFrames > paddingFrames ? m_lastLevelFrames - paddingFrames : 0;
+        const uint64_t observed = (droppedFrames + m_periodFrames / 2) / m_periodFrames;
+        const uint64_t predicted = GetBoundaries(playedFrames) - GetBoundaries(m_lastPlayedFrames);
+        if (observed != predicted)
+            m_boundaryOffset = (unsigned int)(playedFrames % m_periodFrames);
+    }
+
+    m_lastPlayedFrames = playedFrames;
+    m_lastLevelFrames = levelFrames;
+    m_hasLast = true;
+
+    if (paddingFrames == 0)
+        return 0;
+    return (unsigned int)((playedFrames + m_periodFrames - m_boundaryOffset) % m_periodFrames);
+}
+
+bool RenderPeriodPhase::HasRunDry(uint64_t playedFrames) const
+{
+    if (!m_hasLast || m_periodFrames == 0)
+        return true;
+
+    // Every boundary since took a period
+    const uint64_t wantedFrames = (GetBoundaries(playedFrames) - GetBoundaries(m_lastPlayedFrames)) * m_periodFrames;
+    return wantedFrames > m_lastLevelFrames;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+
+// How far the render device is into its current period, for devices that take their buffer a
+// whole period at a time: their padding only drops at period boundaries, while the audio drains
+// steadily, so between two boundaries it is ahead of that steady level by what has been played
+// since the last one.
+//
+// The device's play position runs continuously, but where its period boundaries fall on it is
+// not known up front. It is learned from the padding: each time the padding says a different
+// number of boundaries passed than the position does, the true boundary lies between the
+// estimate and now, so the estimate is moved to now. Corrections only ever bring it closer, and
+// the capture and render clocks beating against each other keep sampling every part of the period.
+class RenderPeriodPhase
+{
+public:
+    RenderPeriodPhase();
+
+    // periodFrames: how much the device takes at each boundary (start of a new stream)
+    void Reset(unsigned int periodFrames);
+
+    // The device reported paddingFrames at play position playedFrames. levelFrames: what the
+    // padding will be once the caller has written. Returns the frames of the current period the
+    // device has played by now (0 until a position has been seen, and for a device that ran dry).
+    unsigned int Update(unsigned int paddingFrames, unsigned int levelFrames, uint64_t playedFrames);
+
+    // Whether the device, by play position playedFrames, has wanted more periods than the level
+    // left at the last Update() held. A padding of zero alone does not say so: it reads zero right
+    // after a boundary that took exactly what was left, while that period is still playing out.
+    // True when no position was seen yet.
+    bool HasRunDry(uint64_t playedFrames) const;
+
+private:
+    // Boundaries up to and including position frames
+    uint64_t GetBoundaries(uint64_t frames) const;
+
+    unsigned int m_periodFrames;
+    unsigned int m_boundaryOffset;  // Boundaries are at this position modulo the period
+    uint64_t m_lastPlayedFrames;
+    unsigned int m_lastLevelFrames;
+    bool m_hasLast;
+};
@@ -0,0 +1,568 @@
+#include "Resampler.h"
+#include <cstring>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+#ifdef HAVE_SPEEX
+#include <speex/speex_resampler.h>
+#endif
+
+namespace
+{
+    // Filter parameters of the sinc tiers
+    struct SincTier
+    {
+        unsigned int taps;          // Filter length (multiple of 8 for the SIMD kernels)
+        unsigned int phases;        // Rows of the oversampled (interpolated) table
+        double rolloff;             // Passband edge as a fraction of the lower Nyquist frequency
+        double kaiserBeta;          // Stopband attenuation vs. transition width
+    };
+
+    const SincTier LowTier = { 16, 128, 0.85, 6.0 };
+    const SincTier MediumTier = { 32, 256, 0.91, 8.0 };
+    const SincTier HighTier = { 64, 512, 0.95, 10.0 };
+
+    // Largest ratio denominator that gets a row per exact phase (e.g. 44.1k <-> 48k needs 160)
+    const unsigned int MaxDirectPhases = 1024;
+
+    // Longest filter used for large downsampling factors
+    const unsigned int MaxTaps = 512;
+
+    // Input is deinterleaved into the history in blocks of at most this many frames
+    const unsigned int BlockFrames = 1024;
+
+    const double Pi = 3.14159265358979323846;
+
+    unsigned int GreatestCommonDivisor(unsigned int a, unsigned int b)
+    {
+        while (b != 0)
+        {
+            unsigned int t = a % b;
+            a = b;
+            b = t;
+        }
+        return a;
+    }
+
+    // Zeroth order modified Bessel function of the first kind (for the Kaiser window)
+    double BesselI0(double x)
+    {
+        double sum = 1.0;
+        double term = 1.0;
+        for (int k = 1; k < 64; k++)
+        {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+            if (term < sum * 1e-12)
+                break;
+        }
+        return sum;
+    }
+
+    // Fill rows x taps coefficients. Row r is the filter for an output at fractional
+    // position r / phases past the centre tap (taps / 2 - 1).
+    void DesignPolyphaseTable(float* table, unsigned int rows, unsigned int phases, unsigned int taps,
+                              double cutoff, double kaiserBeta)
+    {
+        const double half = taps / 2.0;
+        const double i0Beta = BesselI0(kaiserBeta);
+        std::vector<double> values(taps);
+
+        for (unsigned int r = 0; r < rows; r++)
+        {
+            const double frac = (double)r / (double)phases;
+            float* row = table + r * taps;
+            double sum = 0.0;
+
+            for (unsigned int k = 0; k < taps; k++)
+            {
+                const double t = (double)k - (half - 1.0) - frac;
+                const double x = cutoff * t;
+                const double sinc = std::fabs(x) < 1e-9 ? 1.0 : std::sin(Pi * x) / (Pi * x);
+                const double ratio = t / half;
+                const double window = BesselI0(kaiserBeta * std::sqrt(std::max(0.0, 1.0 - ratio * ratio))) / i0Beta;
+                values[k] = cutoff * sinc * window;
+                sum += values[k];
+            }
+
+            // Normalise each phase to unity DC gain so the output has no phase-dependent ripple
+            for (unsigned int k = 0; k < taps; k++)
+            {
+                row[k] = (float)(values[k] / sum);
+            }
+        }
+    }
+
+    // Size table for rows x taps floats and return the first 32-byte aligned float
+    float* AllocateAlignedRows(std::vector<float>& table, unsigned int rows, unsigned int taps)
+    {
+        table.assign(rows * taps + 8, 0.0f);
+        uintptr_t address = (uintptr_t)table.data();
+        uintptr_t aligned = (address + 31) & ~(uintptr_t)31;
+        return table.data() + (aligned - address) / sizeof(float);
+    }
+}
+
+Resampler::Resampler()
+    : m_inputRate(0)
+    , m_outputRate(0)
+    , m_channels(0)
+    , m_quality(ResamplerQuality::Medium)
+    , m_isPassthrough(true)
+    , m_adjustmentPpm(0.0)
+    , m_step(1.0)
+    , m_phase(0.0)
+    , m_hasHistory(false)
+    , m_taps(0)
+    , m_ratioNum(1)
+    , m_ratioDen(1)
+    , m_directRows(nullptr)
+    , m_interpolationPhases(0)
+    , m_interpolationRows(nullptr)
+    , m_historyFrames(0)
+    , m_index(0)
+    , m_useDirect(false)
+    , m_phaseNum(0)
+    , m_frac(0.0)
+    , m_stepWhole(1)
+    , m_stepFrac(0.0)
+    , m_dotProduct(ResamplerKernels::DotProductScalar)
+    , m_interpolatedDotProduct(ResamplerKernels::InterpolatedDotProductScalar)
+#ifdef HAVE_SPEEX
+    , m_speex(nullptr)
+    , m_speexRatioNum(0)
+#endif
+{
+}
+
+Resampler::~Resampler()
+{
+    DestroySpeex();
+}
+
+const wchar_t* Resampler::GetQualityName(ResamplerQuality quality)
+{
+    switch (quality)
+    {
+    case ResamplerQuality::Linear: return L"Linear";
+    case ResamplerQuality::Low:    return L"Low";
+    case ResamplerQuality::Medium: return L"Medium";
+    case ResamplerQuality::High:   return L"High";
+    case ResamplerQuality::Speex:  return L"Speex";
+    default:                       return L"Unknown";
+    }
+}
+
+bool Resampler::Configure(unsigned int inputRate, unsigned int outputRate, unsigned int channels,
+                          bool variableRate, ResamplerQuality quality)
+{
+    if (inputRate == 0 || outputRate == 0 || channels == 0)
+        return false;
+
+    DestroySpeex();
+
+    m_inputRate = inputRate;
+    m_outputRate = outputRate;
+    m_channels = channels;
+    m_quality = quality;
+    m_isPassthrough = (inputRate == outputRate) && !variableRate;
+    m_adjustmentPpm = 0.0;
+    m_step = (double)inputRate / (double)outputRate;
+    m_lastFrame.assign(channels, 0.0f);
+
+    unsigned int divisor = GreatestCommonDivisor(inputRate, outputRate);
+    m_ratioNum = inputRate / divisor;
+    m_ratioDen = outputRate / divisor;
+
+    m_taps = 0;
+    m_useDirect = false;
+    m_history.clear();
+
+#ifdef HAVE_SPEEX
+    if (m_quality == ResamplerQuality::Speex && !m_isPassthrough && !ConfigureSpeex())
+        m_quality = ResamplerQuality::High;
+#else
+    if (m_quality == ResamplerQuality::Speex)
+        m_quality = ResamplerQuality::High;
+#endif
+
+    if (m_quality != ResamplerQuality::Linear && m_quality != ResamplerQuality::Speex && !m_isPassthrough)
+        ConfigureSinc();
+
+    Reset();
+    return true;
+}
+
+void Resampler::ConfigureSinc()
+{
+    const SincTier& tier = m_quality == ResamplerQuality::Low ? LowTier :
+                           m_quality == ResamplerQuality::High ? HighTier : MediumTier;
+    m_taps = tier.taps;
+    m_interpolationPhases = tier.phases;
+
+    // Cut off below the lower of the two Nyquist frequencies. When downsampling the filter is
+    // stretched by the same factor so the transition band keeps its width relative to the cutoff.
+    double cutoff = tier.rolloff;
+    if (m_outputRate < m_inputRate)
+    {
+        cutoff *= (double)m_outputRate / (double)m_inputRate;
+        unsigned int stretched = (unsigned int)std::ceil(m_taps * (double)m_inputRate / (double)m_outputRate);
+        m_taps = std::min((stretched + 7) & ~7u, MaxTaps);
+    }
+
+    float* interpolationRows = AllocateAlignedRows(m_interpolationTable, m_interpolationPhases + 1, m_taps);
+    DesignPolyphaseTable(interpolationRows, m_interpolationPhases + 1, m_interpolationPhases, m_taps, cutoff, tier.kaiserBeta);
+    m_interpolationRows = interpolationRows;
+
+    if (m_ratioDen <= MaxDirectPhases)
+    {
+        float* directRows = AllocateAlignedRows(m_directTable, m_ratioDen, m_taps);
+        DesignPolyphaseTable(directRows, m_ratioDen, m_ratioDen, m_taps, cutoff, tier.kaiserBeta);
+        m_directRows = directRows;
+    }
+    else
+    {
+        m_directTable.clear();
+        m_directRows = nullptr;
+    }
+
+    // History holds what the filter still needs plus one block of new input
+    m_history.assign(m_channels, std::vector<float>(m_taps + BlockFrames, 0.0f));
+
+    // Pick the widest kernel this CPU runs
+    m_dotProduct = ResamplerKernels::DotProductScalar;
+    m_interpolatedDotProduct = ResamplerKernels::InterpolatedDotProductScalar;
+#ifdef AUDIOROUTER_X86
+    const CpuFeatures& cpu = GetCpuFeatures();
+#ifdef AUDIOROUTER_HAVE_AVX2
+    if (cpu.hasAvx2 && cpu.hasFma)
+    {
+        m_dotProduct = ResamplerKernels::DotProductAvx2;
+        m_interpolatedDotProduct = ResamplerKernels::InterpolatedDotProductAvx2;
+    }
+    else
+#endif
+    if (cpu.hasSse2)
+    {
+        m_dotProduct = ResamplerKernels::DotProductSse;
+        m_interpolatedDotProduct = ResamplerKernels::InterpolatedDotProductSse;
+    }
+#endif
+}
+
+void Resampler::Reset()
+{
+    // Linear
+    m_phase = 0.0;
+    m_hasHistory = false;
+    std::fill(m_lastFrame.begin(), m_lastFrame.end(), 0.0f);
+
+    // Sinc: half a filter of silence ahead of the first frame, so the first output is centred on it
+    if (m_taps > 0)
+    {
+        for (size_t ch = 0; ch < m_history.size(); ch++)
+            std::fill(m_history[ch].begin(), m_history[ch].end(), 0.0f);
+        m_historyFrames = m_taps / 2 - 1;
+        m_index = m_taps / 2 - 1;
+    }
+    m_phaseNum = 0;
+    m_frac = 0.0;
+    SetRatioAdjustment(m_adjustmentPpm);
+
+#ifdef HAVE_SPEEX
+    if (m_speex)
+        speex_resampler_reset_mem(m_speex);
+#endif
+}
+
+void Resampler::SetRatioAdjustment(double ppm)
+{
+    m_adjustmentPpm = ppm;
+    m_step = (double)m_inputRate / (double)m_outputRate * (1.0 + ppm * 1e-6);
+
+    if (m_taps > 0)
+    {
+        // Exact rational stepping whenever the ratio is untrimmed and the table exists
+        bool useDirect = (ppm == 0.0) && m_directRows;
+        if (useDirect && !m_useDirect)
+        {
+            m_phaseNum = (unsigned int)(m_frac * m_ratioDen + 0.5);
+            if (m_phaseNum >= m_ratioDen)
+            {
+                m_phaseNum -= m_ratioDen;
+                m_index++;
+            }
+        }
+        else if (!useDirect && m_useDirect)
+        {
+            m_frac = (double)m_phaseNum / (double)m_ratioDen;
+        }
+        m_useDirect = useDirect;
+
+        m_stepWhole = (unsigned int)m_step;
+        m_stepFrac = m_step - m_stepWhole;
+    }
+
+#ifdef HAVE_SPEEX
+    if (m_speex)
+    {
+        // Speex takes the ratio as a 32-bit fraction, which limits the trim resolution
+        // (about 20 ppm at 48 kHz). Only touch it when the quantised ratio changes, as
+        // every change rebuilds its filter.
+        const unsigned long long scale = 0xFFFFFFFFull / (2ull * std::max(m_inputRate, m_outputRate));
+        unsigned int ratioNum = (unsigned int)std::llround(m_inputRate * (double)scale * (1.0 + ppm * 1e-6));
+        if (ratioNum != m_speexRatioNum)
+        {
+            speex_resampler_set_rate_frac(m_speex, ratioNum, (unsigned int)(m_outputRate * scale), m_inputRate, m_outputRate);
+            m_speexRatioNum = ratioNum;
+        }
+    }
+#endif
+}
+
+unsigned int Resampler::GetLatencyFrames() const
+{
+    if (m_isPassthrough)
+        return 0;
+
+#ifdef HAVE_SPEEX
+    if (m_speex)
+        return (unsigned int)speex_resampler_get_output_latency(m_speex);
+#endif
+
+    // Outputs are emitted once the filter's look-ahead (half its length) has arrived
+    unsigned int inputLatency = m_quality == ResamplerQuality::Linear ? 1 : m_taps / 2;
+    return (unsigned int)((unsigned long long)inputLatency * m_outputRate / m_inputRate);
+}
+
+unsigned int Resampler::GetMaxOutputFrames(unsigned int inputFrames) const
+{
+    if (m_isPassthrough)
+        return inputFrames;
+    return (unsigned int)std::ceil((inputFrames + 1) / m_step) + 2;
+}
+
+unsigned int Resampler::Process(const float* input, unsigned int inputFrames, float* output)
+{
+    if (m_isPassthrough)
+    {
+        std::memcpy(output, input, inputFrames * m_channels * sizeof(float));
+        return inputFrames;
+    }
+
+    if (inputFrames == 0)
+        return 0;
+
+    switch (m_quality)
+    {
+    case ResamplerQuality::Linear:
+        return ProcessLinear(input, inputFrames, output);
+    case ResamplerQuality::Speex:
+        return ProcessSpeex(input, inputFrames, output);
+    default:
+        return ProcessSinc(input, inputFrames, output);
+    }
+}
+
+unsigned int Resampler::ProcessLinear(const float* input, unsigned int inputFrames, float* output)
+{
+    const unsigned int channels = m_channels;
+
+    if (!m_hasHistory)
+    {
+        // Start exactly on the first input frame
+        std::memcpy(m_lastFrame.data(), input, channels * sizeof(float));
+        m_phase = 1.0;
+        m_hasHistory = true;
+    }
+
+    // Position p addresses the sequence [m_lastFrame, input[0], ..., input[inputFrames - 1]],
+    // so p = 0 is the previous call's last frame and p = k is input[k - 1].
+    unsigned int produced = 0;
+    double position = m_phase;
+    while (position < (double)inputFrames)
+    {
+        unsigned int index = (unsigned int)position;
+        float frac = (float)(position - index);
+        const float* a = index == 0 ? m_lastFrame.data() : input + (index - 1) * channels;
+        const float* b = input + index * channels;
+        float* out = output + produced * channels;
+
+        for (unsigned int ch = 0; ch < channels; ch++)
+        {
+            out[ch] = a[ch] + (b[ch] - a[ch]) * frac;
+        }
+
+        produced++;
+        position += m_step;
+    }
+
+    m_phase = position - inputFrames;
+    std::memcpy(m_lastFrame.data(), input + (inputFrames - 1) * channels, channels * sizeof(float));
+    return produced;
+}
+
+unsigned int Resampler::ProcessSinc(const float* input, unsigned int inputFrames, float* output)
+{
+    const unsigned int channels = m_channels;
+    const unsigned int keep = m_taps / 2 - 1;
+    unsigned int produced = 0;
+
+    while (inputFrames > 0)
+    {
+        // Append one block to the planar history
+        unsigned int block = std::min(inputFrames, BlockFrames);
+        for (unsigned int ch = 0; ch < channels; ch++)
+        {
+            float* history = m_history[ch].data() + m_historyFrames;
+            for (unsigned int i = 0; i < block; i++)
+            {
+                history[i] = input[i * channels + ch];
+            }
+        }
+        m_historyFrames += block;
+
+        produced += RunSinc(output + produced * channels);
+
+        // Drop frames no future output can reach. When downsampling by a large factor the
+        // next output may lie beyond the history; the surplus is skipped as input arrives.
+        unsigned int discard = std::min(m_index - keep, m_historyFrames);
+        if (discard > 0)
+        {
+            unsigned int remaining = m_historyFrames - discard;
+            for (unsigned int ch = 0; ch < channels; ch++)
+            {
+                float* history = m_history[ch].data();
+                std::memmove(history, history + discard, remaining * sizeof(float));
+            }
+            m_historyFrames = remaining;
+            m_index -= discard;
+        }
+
+        input += block * channels;
+        inputFrames -= block;
+    }
+
+    return produced;
+}
+
+unsigned int Resampler::RunSinc(float* output)
+{
+    const unsigned int channels = m_channels;
+    const unsigned int taps = m_taps;
+    const unsigned int half = taps / 2;
+    unsigned int produced = 0;
+
+    if (m_useDirect)
+    {
+        const unsigned int stepWhole = m_ratioNum / m_ratioDen;
+        const unsigned int stepPhase = m_ratioNum % m_ratioDen;
+
+        while (m_index + half < m_historyFrames)
+        {
+            const unsigned int start = m_index + 1 - half;
+            const float* row = GetDirectRow(m_phaseNum);
+            for (unsigned int ch = 0; ch < channels; ch++)
+            {
+                output[produced * channels + ch] = m_dotProduct(m_history[ch].data() + start, row, taps);
+            }
+            produced++;
+
+            m_index += stepWhole;
+            m_phaseNum += stepPhase;
+            if (m_phaseNum >= m_ratioDen)
+            {
+                m_phaseNum -= m_ratioDen;
+                m_index++;
+            }
+        }
+    }
+    else
+    {
+        const double phases = (double)m_interpolationPhases;
+
+        while (m_index + half < m_historyFrames)
+        {
+            const unsigned int start = m_index + 1 - half;
+            const double position = m_frac * phases;
+            const unsigned int row = (unsigned int)position;
+            const float rowFrac = (float)(position - row);
+            const float* row0 = GetInterpolationRow(row);
+            const float* row1 = GetInterpolationRow(row + 1);
+            for (unsigned int ch = 0; ch < channels; ch++)
+            {
+                output[produced * channels + ch] = m_interpolatedDotProduct(m_history[ch].data() + start, row0, row1, rowFrac, taps);
+            }
+            produced++;
+
+            m_index += m_stepWhole;
+            m_frac += m_stepFrac;
+            if (m_frac >= 1.0)
+            {
+                m_frac -= 1.0;
+                m_index++;
+            }
+        }
+    }
+
+    return produced;
+}
+
+#ifdef HAVE_SPEEX
+bool Resampler::ConfigureSpeex()
+{
+    int error = 0;
+    m_speex = speex_resampler_init(m_channels, m_inputRate, m_outputRate, SPEEX_RESAMPLER_QUALITY_DESKTOP, &error);
+    if (!m_speex || error != RESAMPLER_ERR_SUCCESS)
+    {
+        DestroySpeex();
+        return false;
+    }
+    m_speexRatioNum = 0;
+    return true;
+}
+
+unsigned int Resampler::ProcessSpeex(const float* input, unsigned int inputFrames, float* output)
+{
+    // Speex accepts everything as long as there is output space; loop in case it stops early
+    unsigned int produced = 0;
+    unsigned int capacity = GetMaxOutputFrames(inputFrames);
+    while (inputFrames > 0 && produced < capacity)
+    {
+        spx_uint32_t inLength = inputFrames;
+        spx_uint32_t outLength = capacity - produced;
+        speex_resampler_process_interleaved_float(m_speex, input, &inLength, output + produced * m_channels, &outLength);
+        if (inLength == 0 && outLength == 0)
+            break;
+
+        input += inLength * m_channels;
+        inputFrames -= inLength;
+        produced += outLength;
+    }
+    return produced;
+}
+
+void Resampler::DestroySpeex()
+{
+    if (m_speex)
+    {
+        speex_resampler_destroy(m_speex);
+        m_speex = nullptr;
+    }
+}
+#else
+bool Resampler::ConfigureSpeex()
+{
+    return false;
+}
+
+unsigned int Resampler::ProcessSpeex(const float* input, unsigned int inputFrames, float* output)
+{
+    return ProcessSinc(input, inputFrames, output);
+}
+
+void Resampler::DestroySpeex()
+{
+}
+#endif
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "ResamplerKernels.h"
+#include <vector>
+
+#ifdef HAVE_SPEEX
+struct SpeexResamplerState_;
+#endif
+
+// Conversion quality / algorithm
+enum class ResamplerQuality
+{
+    Linear = 0,     // Linear interpolation (cheapest, audible aliasing)
+    Low = 1,        // 16-tap windowed sinc
+    Medium = 2,     // 32-tap windowed sinc
+    High = 3,       // 64-tap windowed sinc
+    Speex = 4       // speexdsp resampler (falls back to High when Speex is not built in)
+};
+
+// Streaming sample rate converter for interleaved float audio.
+// Keeps its phase and filter history between calls, so packet boundaries are seamless.
+// The conversion ratio can be nudged by a few ppm while running (clock drift compensation).
+//
+// The sinc tiers use precomputed polyphase tables. For a fixed rational ratio with a small
+// denominator (e.g. 44100 -> 48000 = 147/160) every output phase has its own exact table row and
+// the phase advances in integer steps. Otherwise (large denominators, or while the ratio is being
+// trimmed) the filter is interpolated between the two nearest rows of an oversampled table.
+class Resampler
+{
+public:
+    Resampler();
+    ~Resampler();
+
+    // Set up for a conversion. With variableRate the resampler keeps running at equal rates
+    // so SetRatioAdjustment() can still steer it; otherwise equal rates are a passthrough.
+    bool Configure(unsigned int inputRate, unsigned int outputRate, unsigned int channels,
+                   bool variableRate = false, ResamplerQuality quality = ResamplerQuality::Medium);
+
+    // Forget history and phase (start of a new stream)
+    void Reset();
+
+    // Trim the conversion ratio by ppm. Positive values consume input faster,
+    // producing fewer output frames per input frame.
+    void SetRatioAdjustment(double ppm);
+    double GetRatioAdjustment() const { return m_adjustmentPpm; }
+
+    // Quality actually in use (Speex falls back when unavailable)
+    ResamplerQuality GetQuality() const { return m_quality; }
+    static const wchar_t* GetQualityName(ResamplerQuality quality);
+
+    // True when Process() would only copy (equal rates and no variable rate requested)
+    bool IsPassthrough() const { return m_isPassthrough; }
+
+    // True while the sinc tiers step through the exact per-phase rows (untrimmed ratio with a
+    // small enough denominator) rather than interpolating between rows
+    bool IsUsingDirectTable() const { return m_useDirect; }
+
+    // Delay added by the filter, in output frames
+    unsigned int GetLatencyFrames() const;
+
+    // Upper bound on the frames one Process() call can produce for inputFrames
+    unsigned int GetMaxOutputFrames(unsigned int inputFrames) const;
+
+    // Convert inputFrames frames. output must hold GetMaxOutputFrames(inputFrames) frames.
+    // Returns the number of frames written.
+    unsigned int Process(const float* input, unsigned int inputFrames, float* output);
+
+private:
+    Resampler(const Resampler&) = delete;
+    Resampler& operator=(const Resampler&) = delete;
+
+    unsigned int ProcessLinear(const float* input, unsigned int inputFrames, float* output);
+    unsigned int ProcessSinc(const float* input, unsigned int inputFrames, float* output);
+    unsigned int ProcessSpeex(const float* input, unsigned int inputFrames, float* output);
+
+    // Produce every output frame the buffered history allows
+    unsigned int RunSinc(float* output);
+
+    void ConfigureSinc();
+    bool ConfigureSpeex();
+    void DestroySpeex();
+
+    const float* GetDirectRow(unsigned int phase) const { return m_directRows + phase * m_taps; }
+    const float* GetInterpolationRow(unsigned int row) const { return m_interpolationRows + row * m_taps; }
+
+    unsigned int m_inputRate;
+    unsigned int m_outputRate;
+    unsigned int m_channels;
+    ResamplerQuality m_quality;
+    bool m_isPassthrough;
+    double m_adjustmentPpm;
+
+    // Linear interpolation state
+    double m_step;                    // Input frames advanced per output frame
+    double m_phase;                   // Position of the next output frame, relative to m_lastFrame
+    std::vector<float> m_lastFrame;   // Last input frame of the previous call
+    bool m_hasHistory;
+
+    // Polyphase sinc tables (rows are 32-byte aligned within the vectors)
+    unsigned int m_taps;
+    unsigned int m_ratioNum;          // Input/output ratio as a reduced fraction
+    unsigned int m_ratioDen;
+    std::vector<float> m_directTable; // One row per exact output phase; empty if m_ratioDen is too large
+    const float* m_directRows;
+    unsigned int m_interpolationPhases;
+    std::vector<float> m_interpolationTable;  // m_interpolationPhases + 1 rows
+    const float* m_interpolationRows;
+
+    // Polyphase sinc state
+    std::vector<std::vector<float>> m_history;   // Planar input history, one buffer per channel
+    unsigned int m_historyFrames;
+    unsigned int m_index;             // History frame the next output is centred on
+    bool m_useDirect;
+    unsigned int m_phaseNum;          // Direct mode: fractional position in 1/m_ratioDen units
+    double m_frac;                    // Interpolated mode: fractional position
+    unsigned int m_stepWhole;         // Interpolated mode: step split into whole and fractional frames
+    double m_stepFrac;
+
+    ResamplerKernels::DotProductFn m_dotProduct;
+    ResamplerKernels::InterpolatedDotProductFn m_interpolatedDotProduct;
+
+#ifdef HAVE_SPEEX
+    SpeexResamplerState_* m_speex;
+    unsigned int m_speexRatioNum;
+#endif
+};
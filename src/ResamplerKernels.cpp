@@ -0,0 +1,74 @@
+#include "ResamplerKernels.h"
+
+#ifdef AUDIOROUTER_X86
+#include <emmintrin.h>
+#endif
+
+namespace ResamplerKernels
+{
+    float DotProductScalar(const float* samples, const float* coeffs, unsigned int taps)
+    {
+        // Four partial sums so the compiler can keep several multiplies in flight
+        float sum0 = 0.0f, sum1 = 0.0f, sum2 = 0.0f, sum3 = 0.0f;
+        for (unsigned int k = 0; k < taps; k += 4)
+        {
+            sum0 += samples[k] * coeffs[k];
+            sum1 += samples[k + 1] * coeffs[k + 1];
+            sum2 += samples[k + 2] * coeffs[k + 2];
+            sum3 += samples[k + 3] * coeffs[k + 3];
+        }
+        return (sum0 + sum1) + (sum2 + sum3);
+    }
+
+    float InterpolatedDotProductScalar(const float* samples, const float* coeffs0, const float* coeffs1,
+                                       float frac, unsigned int taps)
+    {
+        // Blend the two dot products rather than the coefficients: same result, half the work
+        float sum0 = 0.0f, sum1 = 0.0f;
+        for (unsigned int k = 0; k < taps; k++)
+        {
+            sum0 += samples[k] * coeffs0[k];
+            sum1 += samples[k] * coeffs1[k];
+        }
+        return sum0 + frac * (sum1 - sum0);
+    }
+
+#ifdef AUDIOROUTER_X86
+    static inline float HorizontalSum(__m128 v)
+    {
+        __m128 shuffled = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+        __m128 sums = _mm_add_ps(v, shuffled);
+        shuffled = _mm_movehl_ps(shuffled, sums);
+        sums = _mm_add_ss(sums, shuffled);
+        return _mm_cvtss_f32(sums);
+    }
+
+    float DotProductSse(const float* samples, const float* coeffs, unsigned int taps)
+    {
+        __m128 sum0 = _mm_setzero_ps();
+        __m128 sum1 = _mm_setzero_ps();
+        for (unsigned int k = 0; k < taps; k += 8)
+        {
+            sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(samples + k), _mm_load_ps(coeffs + k)));
+            sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(samples + k + 4), _mm_load_ps(coeffs + k + 4)));
+        }
+        return HorizontalSum(_mm_add_ps(sum0, sum1));
+    }
+
+    float InterpolatedDotProductSse(const float* samples, const float* coeffs0, const float* coeffs1,
+                                    float frac, unsigned int taps)
+    {
+        __m128 sum0 = _mm_setzero_ps();
+        __m128 sum1 = _mm_setzero_ps();
+        for (unsigned int k = 0; k < taps; k += 4)
+        {
+            __m128 x = _mm_loadu_ps(samples + k);
+            sum0 = _mm_add_ps(sum0, _mm_mul_ps(x, _mm_load_ps(coeffs0 + k)));
+            sum1 = _mm_add_ps(sum1, _mm_mul_ps(x, _mm_load_ps(coeffs1 + k)));
+        }
+        float dot0 = HorizontalSum(sum0);
+        float dot1 = HorizontalSum(sum1);
+        return dot0 + frac * (dot1 - dot0);
+    }
+#endif
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "CpuFeatures.h"
+
+// Inner loops of the polyphase resampler. Each ISA variant lives in its own translation unit
+// so it can be compiled with the matching instruction set flags; Resampler picks one at
+// Configure() time from the detected CPU features.
+//
+// taps must be a multiple of 8. Coefficient rows are 32-byte aligned, samples need not be.
+namespace ResamplerKernels
+{
+    // sum(samples[k] * coeffs[k])
+    typedef float (*DotProductFn)(const float* samples, const float* coeffs, unsigned int taps);
+
+    // sum(samples[k] * (coeffs0[k] + frac * (coeffs1[k] - coeffs0[k]))): dot product against a
+    // filter phase interpolated between two adjacent table rows
+    typedef float (*InterpolatedDotProductFn)(const float* samples, const float* coeffs0, const float* coeffs1,
+                                              float frac, unsigned int taps);
+
+    float DotProductScalar(const float* samples, const float* coeffs, unsigned int taps);
+    float InterpolatedDotProductScalar(const float* samples, const float* coeffs0, const float* coeffs1,
+                                       float frac, unsigned int taps);
+
+#ifdef AUDIOROUTER_X86
+    float DotProductSse(const float* samples, const float* coeffs, unsigned int taps);
+    float InterpolatedDotProductSse(const float* samples, const float* coeffs0, const float* coeffs1,
+                                    float frac, unsigned int taps);
+#endif
+
+#ifdef AUDIOROUTER_HAVE_AVX2
+    float DotProductAvx2(const float* samples, const float* coeffs, unsigned int taps);
+    float InterpolatedDotProductAvx2(const float* samples, const float* coeffs0, const float* coeffs1,
+                                     float frac, unsigned int taps);
+#endif
+}
@@ -0,0 +1,50 @@
+// Built with AVX2/FMA code generation (see CMakeLists.txt); only called when the CPU supports both.
+#include "ResamplerKernels.h"
+
+#ifdef AUDIOROUTER_HAVE_AVX2
+#include <immintrin.h>
+
+namespace ResamplerKernels
+{
+    static inline float HorizontalSum(__m256 v)
+    {
+        __m128 sums = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        sums = _mm_add_ps(sums, _mm_movehl_ps(sums, sums));
+        sums = _mm_add_ss(sums, _mm_shuffle_ps(sums, sums, 1));
+        return _mm_cvtss_f32(sums);
+    }
+
+    float DotProductAvx2(const float* samples, const float* coeffs, unsigned int taps)
+    {
+        __m256 sum0 = _mm256_setzero_ps();
+        __m256 sum1 = _mm256_setzero_ps();
+        unsigned int k = 0;
+        for (; k + 16 <= taps; k += 16)
+        {
+            sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(samples + k), _mm256_load_ps(coeffs + k), sum0);
+            sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(samples + k + 8), _mm256_load_ps(coeffs + k + 8), sum1);
+        }
+        if (k < taps)
+        {
+            sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(samples + k), _mm256_load_ps(coeffs + k), sum0);
+        }
+        return HorizontalSum(_mm256_add_ps(sum0, sum1));
+    }
+
+    float InterpolatedDotProductAvx2(const float* samples, const float* coeffs0, const float* coeffs1,
+                                     float frac, unsigned int taps)
+    {
+        __m256 sum0 = _mm256_setzero_ps();
+        __m256 sum1 = _mm256_setzero_ps();
+        for (unsigned int k = 0; k < taps; k += 8)
+        {
+            __m256 x = _mm256_loadu_ps(samples + k);
+            sum0 = _mm256_fmadd_ps(x, _mm256_load_ps(coeffs0 + k), sum0);
+            sum1 = _mm256_fmadd_ps(x, _mm256_load_ps(coeffs1 + k), sum1);
+        }
+        float dot0 = HorizontalSum(sum0);
+        float dot1 = HorizontalSum(sum1);
+        return dot0 + frac * (dot1 - dot0);
+    }
+}
+#endif
@@ -0,0 +1,272 @@
+#include "SampleConvertKernels.h"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#ifdef AUDIOROUTER_X86
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // Largest float not above INT32_MAX; anything larger would overflow the conversion
+    const float MaxPcm32 = 2147483520.0f;
+
+    inline uint32_t NextRandom(uint32_t& state)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    // Difference of two uniform 16-bit values: triangular over (-1, 1) LSB
+    inline float NextDither(SampleConvertKernels::DitherState* dither)
+    {
+        uint32_t r = NextRandom(dither->lanes[0]);
+        return (float)((int32_t)(r & 0xFFFF) - (int32_t)(r >> 16)) * (1.0f / 65536.0f);
+    }
+
+    // Scale, dither, saturate and round one sample (same operation order as the vector kernels)
+    inline int32_t Quantize(float sample, float scale, float minValue, float maxValue,
+                            SampleConvertKernels::DitherState* dither)
+    {
+        float value = sample * scale;
+        if (dither)
+            value += NextDither(dither);
+        // Argument order makes NaN saturate to minValue, as minps/maxps do
+        value = std::min(maxValue, std::max(minValue, value));
+        return (int32_t)std::lrint(value);
+    }
+}
+
+namespace SampleConvertKernels
+{
+    void InitializeDither(DitherState& state, uint32_t seed)
+    {
+        // xorshift must not start at zero; spread the seed so the lanes are uncorrelated
+        for (int lane = 0; lane < 8; lane++)
+        {
+            uint32_t value = seed + 0x9E3779B9u * (uint32_t)(lane + 1);
+            value ^= value >> 16;
+            value *= 0x85EBCA6Bu;
+            value ^= value >> 13;
+            state.lanes[lane] = value != 0 ? value : 0x6D2B79F5u;
+        }
+    }
+
+    void Float32ToFloat(const void* input, float* output, size_t samples)
+    {
+        std::memcpy(output, input, samples * sizeof(float));
+    }
+
+    void FloatToFloat32(const float* input, void* output, size_t samples, DitherState*)
+    {
+        std::memcpy(output, input, samples * sizeof(float));
+    }
+
+    void Pcm16ToFloatScalar(const void* input, float* output, size_t samples)
+    {
+        const int16_t* source = (const int16_t*)input;
+        for (size_t i = 0; i < samples; i++)
+        {
+            output[i] = source[i] * (1.0f / 32768.0f);
+        }
+    }
+
+    void Pcm24ToFloatScalar(const void* input, float* output, size_t samples)
+    {
+        const uint8_t* source = (const uint8_t*)input;
+        for (size_t i = 0; i < samples; i++, source += 3)
+        {
+            // Assemble into the top 24 bits so the sign comes for free
+            int32_t value = (int32_t)(((uint32_t)source[0] << 8) | ((uint32_t)source[1] << 16) | ((uint32_t)source[2] << 24));
+            output[i] = value * (1.0f / 2147483648.0f);
+        }
+    }
+
+    void Pcm32ToFloatScalar(const void* input, float* output, size_t samples)
+    {
+        const int32_t* source = (const int32_t*)input;
+        for (size_t i = 0; i < samples; i++)
+        {
+            output[i] = source[i] * (1.0f / 2147483648.0f);
+        }
+    }
+
+    void FloatToPcm16Scalar(const float* input, void* output, size_t samples, DitherState* dither)
+    {
+        int16_t* target = (int16_t*)output;
+        for (size_t i = 0; i < samples; i++)
+        {
+            target[i] = (int16_t)Quantize(input[i], 32768.0f, -32768.0f, 32767.0f, dither);
+        }
+    }
+
+    void FloatToPcm24Scalar(const float* input, void* output, size_t samples, DitherState* dither)
+    {
+        uint8_t* target = (uint8_t*)output;
+        for (size_t i = 0; i < samples; i++, target += 3)
+        {
+            int32_t value = Quantize(input[i], 8388608.0f, -8388608.0f, 8388607.0f, dither);
+            target[0] = (uint8_t)value;
+            target[1] = (uint8_t)(value >> 8);
+            target[2] = (uint8_t)(value >> 16);
+        }
+    }
+
+    void FloatToPcm32Scalar(const float* input, void* output, size_t samples, DitherState*)
+    {
+        // Float carries 24 bits of mantissa, far below the 32-bit LSB, so dither is pointless here
+        int32_t* target = (int32_t*)output;
+        for (size_t i = 0; i < samples; i++)
+        {
+            target[i] = Quantize(input[i], 2147483648.0f, -2147483648.0f, MaxPcm32, nullptr);
+        }
+    }
+
+#ifdef AUDIOROUTER_X86
+    static inline __m128 NextDitherSse2(__m128i& state)
+    {
+        __m128i x = state;
+        x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+        x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+        x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+        state = x;
+        __m128i triangle = _mm_sub_epi32(_mm_and_si128(x, _mm_set1_epi32(0xFFFF)), _mm_srli_epi32(x, 16));
+        return _mm_mul_ps(_mm_cvtepi32_ps(triangle), _mm_set1_ps(1.0f / 65536.0f));
+    }
+
+    static inline __m128i QuantizeSse2(__m128 samples, __m128 scale, __m128 minValue, __m128 maxValue,
+                                       bool dither, __m128i& ditherState)
+    {
+        __m128 value = _mm_mul_ps(samples, scale);
+        if (dither)
+            value = _mm_add_ps(value, NextDitherSse2(ditherState));
+        value = _mm_min_ps(_mm_max_ps(value, minValue), maxValue);
+        return _mm_cvtps_epi32(value);
+    }
+
+    // Exactly 12 bytes, so neither end of a buffer is overrun
+    static inline __m128i LoadPacked24(const uint8_t* source)
+    {
+        int32_t tail;
+        std::memcpy(&tail, source + 8, 4);
+        return _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)source), _mm_cvtsi32_si128(tail));
+    }
+
+    static inline void StorePacked24(uint8_t* target, __m128i packed)
+    {
+        _mm_storel_epi64((__m128i*)target, packed);
+        int32_t tail = _mm_cvtsi128_si32(_mm_srli_si128(packed, 8));
+        std::memcpy(target + 8, &tail, 4);
+    }
+
+    void Pcm16ToFloatSse2(const void* input, float* output, size_t samples)
+    {
+        const int16_t* source = (const int16_t*)input;
+        const __m128 scale = _mm_set1_ps(1.0f / 2147483648.0f);
+        const __m128i zero = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 8 <= samples; i += 8)
+        {
+            // Interleaving with zeros puts each sample in the top half of a 32-bit lane
+            __m128i x = _mm_loadu_si128((const __m128i*)(source + i));
+            _mm_storeu_ps(output + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(zero, x)), scale));
+            _mm_storeu_ps(output + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(zero, x)), scale));
+        }
+        Pcm16ToFloatScalar(source + i, output + i, samples - i);
+    }
+
+    void Pcm24ToFloatSse2(const void* input, float* output, size_t samples)
+    {
+        const uint8_t* source = (const uint8_t*)input;
+        const __m128 scale = _mm_set1_ps(1.0f / 2147483648.0f);
+        size_t i = 0;
+        for (; i + 4 <= samples; i += 4)
+        {
+            // Without a byte shuffle, line each 3-byte sample up at the bottom of a lane by
+            // shifting the whole register, then move it to the top 24 bits for the sign
+            __m128i x = LoadPacked24(source + i * 3);
+            __m128i x01 = _mm_unpacklo_epi32(x, _mm_srli_si128(x, 3));
+            __m128i x23 = _mm_unpacklo_epi32(_mm_srli_si128(x, 6), _mm_srli_si128(x, 9));
+            __m128i values = _mm_slli_epi32(_mm_unpacklo_epi64(x01, x23), 8);
+            _mm_storeu_ps(output + i, _mm_mul_ps(_mm_cvtepi32_ps(values), scale));
+        }
+        Pcm24ToFloatScalar(source + i * 3, output + i, samples - i);
+    }
+
+    void Pcm32ToFloatSse2(const void* input, float* output, size_t samples)
+    {
+        const int32_t* source = (const int32_t*)input;
+        const __m128 scale = _mm_set1_ps(1.0f / 2147483648.0f);
+        size_t i = 0;
+        for (; i + 8 <= samples; i += 8)
+        {
+            __m128i x0 = _mm_loadu_si128((const __m128i*)(source + i));
+            __m128i x1 = _mm_loadu_si128((const __m128i*)(source + i + 4));
+            _mm_storeu_ps(output + i, _mm_mul_ps(_mm_cvtepi32_ps(x0), scale));
+            _mm_storeu_ps(output + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(x1), scale));
+        }
+        Pcm32ToFloatScalar(source + i, output + i, samples - i);
+    }
+
+    void FloatToPcm16Sse2(const float* input, void* output, size_t samples, DitherState* dither)
+    {
+        int16_t* target = (int16_t*)output;
+        const __m128 scale = _mm_set1_ps(32768.0f);
+        const __m128 minValue = _mm_set1_ps(-32768.0f);
+        const __m128 maxValue = _mm_set1_ps(32767.0f);
+        __m128i ditherState = dither ? _mm_loadu_si128((const __m128i*)dither->lanes) : _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 8 <= samples; i += 8)
+        {
+            __m128i x0 = QuantizeSse2(_mm_loadu_ps(input + i), scale, minValue, maxValue, dither != nullptr, ditherState);
+            __m128i x1 = QuantizeSse2(_mm_loadu_ps(input + i + 4), scale, minValue, maxValue, dither != nullptr, ditherState);
+            _mm_storeu_si128((__m128i*)(target + i), _mm_packs_epi32(x0, x1));
+        }
+        if (dither)
+            _mm_storeu_si128((__m128i*)dither->lanes, ditherState);
+        FloatToPcm16Scalar(input + i, target + i, samples - i, dither);
+    }
+
+    void FloatToPcm24Sse2(const float* input, void* output, size_t samples, DitherState* dither)
+    {
+        uint8_t* target = (uint8_t*)output;
+        const __m128 scale = _mm_set1_ps(8388608.0f);
+        const __m128 minValue = _mm_set1_ps(-8388608.0f);
+        const __m128 maxValue = _mm_set1_ps(8388607.0f);
+        const __m128i low24 = _mm_set_epi32(0, 0x00FFFFFF, 0, 0x00FFFFFF);
+        const __m128i high24 = _mm_set_epi32(0x0000FFFF, (int)0xFF000000, 0x0000FFFF, (int)0xFF000000);
+        __m128i ditherState = dither ? _mm_loadu_si128((const __m128i*)dither->lanes) : _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 4 <= samples; i += 4)
+        {
+            __m128i x = QuantizeSse2(_mm_loadu_ps(input + i), scale, minValue, maxValue, dither != nullptr, ditherState);
+
+            // Close the gap within each 64-bit half (6 useful bytes each), then join the halves
+            __m128i pairs = _mm_or_si128(_mm_and_si128(x, low24), _mm_and_si128(_mm_srli_epi64(x, 8), high24));
+            __m128i packed = _mm_or_si128(_mm_move_epi64(pairs), _mm_slli_si128(_mm_srli_si128(pairs, 8), 6));
+            StorePacked24(target + i * 3, packed);
+        }
+        if (dither)
+            _mm_storeu_si128((__m128i*)dither->lanes, ditherState);
+        FloatToPcm24Scalar(input + i, target + i * 3, samples - i, dither);
+    }
+
+    void FloatToPcm32Sse2(const float* input, void* output, size_t samples, DitherState*)
+    {
+        int32_t* target = (int32_t*)output;
+        const __m128 scale = _mm_set1_ps(2147483648.0f);
+        const __m128 minValue = _mm_set1_ps(-2147483648.0f);
+        const __m128 maxValue = _mm_set1_ps(MaxPcm32);
+        __m128i unused = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 4 <= samples; i += 4)
+        {
+            _mm_storeu_si128((__m128i*)(target + i), QuantizeSse2(_mm_loadu_ps(input + i), scale, minValue, maxValue, false, unused));
+        }
+        FloatToPcm32Scalar(input + i, target + i, samples - i, nullptr);
+    }
+#endif
+}
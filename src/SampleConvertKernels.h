@@ -0,0 +1,57 @@
+#pragma once
+
+#include "CpuFeatures.h"
+#include <cstddef>
+#include <cstdint>
+
+// Conversions between device sample encodings and normalized float. Like the resampler kernels,
+// each ISA variant lives in its own translation unit and SampleConverter picks one per format
+// at Configure() time.
+//
+// Integer formats are scaled by 2^(bits-1) in both directions. Float to integer rounds to
+// nearest and saturates to the format's range. PCM24 is packed (3 bytes per sample, little
+// endian); 24-in-32 containers are handled as PCM32. Buffers need no particular alignment.
+namespace SampleConvertKernels
+{
+    // Triangular (TPDF) dither source: independent xorshift32 generators, one per vector lane.
+    // Each sample draws one 32-bit value whose two 16-bit halves form the triangular sum.
+    struct DitherState
+    {
+        uint32_t lanes[8];
+    };
+
+    void InitializeDither(DitherState& state, uint32_t seed);
+
+    typedef void (*ToFloatFn)(const void* input, float* output, size_t samples);
+
+    // dither may be null; it is ignored by the formats that gain nothing from it (PCM32, float)
+    typedef void (*FromFloatFn)(const float* input, void* output, size_t samples, DitherState* dither);
+
+    void Float32ToFloat(const void* input, float* output, size_t samples);
+    void FloatToFloat32(const float* input, void* output, size_t samples, DitherState* dither);
+
+    void Pcm16ToFloatScalar(const void* input, float* output, size_t samples);
+    void Pcm24ToFloatScalar(const void* input, float* output, size_t samples);
+    void Pcm32ToFloatScalar(const void* input, float* output, size_t samples);
+    void FloatToPcm16Scalar(const float* input, void* output, size_t samples, DitherState* dither);
+    void FloatToPcm24Scalar(const float* input, void* output, size_t samples, DitherState* dither);
+    void FloatToPcm32Scalar(const float* input, void* output, size_t samples, DitherState* dither);
+
+#ifdef AUDIOROUTER_X86
+    void Pcm16ToFloatSse2(const void* input, float* output, size_t samples);
+    void Pcm24ToFloatSse2(const void* input, float* output, size_t samples);
+    void Pcm32ToFloatSse2(const void* input, float* output, size_t samples);
+    void FloatToPcm16Sse2(const float* input, void* output, size_t samples, DitherState* dither);
+    void FloatToPcm24Sse2(const float* input, void* output, size_t samples, DitherState* dither);
+    void FloatToPcm32Sse2(const float* input, void* output, size_t samples, DitherState* dither);
+#endif
+
+#ifdef AUDIOROUTER_HAVE_AVX2
+    void Pcm16ToFloatAvx2(const void* input, float* output, size_t samples);
+    void Pcm24ToFloatAvx2(const void* input, float* output, size_t samples);
+    void Pcm32ToFloatAvx2(const void* input, float* output, size_t samples);
+    void FloatToPcm16Avx2(const float* input, void* output, size_t samples, DitherState* dither);
+    void FloatToPcm24Avx2(const float* input, void* output, size_t samples, DitherState* dither);
+    void FloatToPcm32Avx2(const float* input, void* output, size_t samples, DitherState* dither);
+#endif
+}
@@ -0,0 +1,158 @@
+// Built with AVX2/FMA code generation (see CMakeLists.txt); only called when the CPU supports both.
+#include "SampleConvertKernels.h"
+
+#ifdef AUDIOROUTER_HAVE_AVX2
+#include <immintrin.h>
+#include <cstring>
+
+namespace SampleConvertKernels
+{
+    static inline __m256 NextDitherAvx2(__m256i& state)
+    {
+        __m256i x = state;
+        x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 13));
+        x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 17));
+        x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 5));
+        state = x;
+        __m256i triangle = _mm256_sub_epi32(_mm256_and_si256(x, _mm256_set1_epi32(0xFFFF)), _mm256_srli_epi32(x, 16));
+        return _mm256_mul_ps(_mm256_cvtepi32_ps(triangle), _mm256_set1_ps(1.0f / 65536.0f));
+    }
+
+    static inline __m256i QuantizeAvx2(__m256 samples, __m256 scale, __m256 minValue, __m256 maxValue,
+                                       bool dither, __m256i& ditherState)
+    {
+        __m256 value = _mm256_mul_ps(samples, scale);
+        if (dither)
+            value = _mm256_add_ps(value, NextDitherAvx2(ditherState));
+        value = _mm256_min_ps(_mm256_max_ps(value, minValue), maxValue);
+        return _mm256_cvtps_epi32(value);
+    }
+
+    // Exactly 12 bytes, so neither end of a buffer is overrun
+    static inline __m128i LoadPacked24(const uint8_t* source)
+    {
+        int32_t tail;
+        std::memcpy(&tail, source + 8, 4);
+        return _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)source), _mm_cvtsi32_si128(tail));
+    }
+
+    static inline void StorePacked24(uint8_t* target, __m128i packed)
+    {
+        _mm_storel_epi64((__m128i*)target, packed);
+        int32_t tail = _mm_extract_epi32(packed, 2);
+        std::memcpy(target + 8, &tail, 4);
+    }
+
+    void Pcm16ToFloatAvx2(const void* input, float* output, size_t samples)
+    {
+        const int16_t* source = (const int16_t*)input;
+        const __m256 scale = _mm256_set1_ps(1.0f / 32768.0f);
+        size_t i = 0;
+        for (; i + 16 <= samples; i += 16)
+        {
+            __m256i x0 = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(source + i)));
+            __m256i x1 = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(source + i + 8)));
+            _mm256_storeu_ps(output + i, _mm256_mul_ps(_mm256_cvtepi32_ps(x0), scale));
+            _mm256_storeu_ps(output + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(x1), scale));
+        }
+        Pcm16ToFloatScalar(source + i, output + i, samples - i);
+    }
+
+    void Pcm24ToFloatAvx2(const void* input, float* output, size_t samples)
+    {
+        const uint8_t* source = (const uint8_t*)input;
+        const __m256 scale = _mm256_set1_ps(1.0f / 2147483648.0f);
+
+        // Per 128-bit lane: sample k's three bytes into the top of 32-bit lane k, zero below
+        const __m256i unpack = _mm256_setr_epi8(
+            -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+            -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+        size_t i = 0;
+        for (; i + 8 <= samples; i += 8)
+        {
+            __m256i x = _mm256_inserti128_si256(_mm256_castsi128_si256(LoadPacked24(source + i * 3)),
+                                                LoadPacked24(source + i * 3 + 12), 1);
+            __m256i values = _mm256_shuffle_epi8(x, unpack);
+            _mm256_storeu_ps(output + i, _mm256_mul_ps(_mm256_cvtepi32_ps(values), scale));
+        }
+        Pcm24ToFloatScalar(source + i * 3, output + i, samples - i);
+    }
+
+    void Pcm32ToFloatAvx2(const void* input, float* output, size_t samples)
+    {
+        const int32_t* source = (const int32_t*)input;
+        const __m256 scale = _mm256_set1_ps(1.0f / 2147483648.0f);
+        size_t i = 0;
+        for (; i + 16 <= samples; i += 16)
+        {
+            __m256i x0 = _mm256_loadu_si256((const __m256i*)(source + i));
+            __m256i x1 = _mm256_loadu_si256((const __m256i*)(source + i + 8));
+            _mm256_storeu_ps(output + i, _mm256_mul_ps(_mm256_cvtepi32_ps(x0), scale));
+            _mm256_storeu_ps(output + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(x1), scale));
+        }
+        Pcm32ToFloatScalar(source + i, output + i, samples - i);
+    }
+
+    void FloatToPcm16Avx2(const float* input, void* output, size_t samples, DitherState* dither)
+    {
+        int16_t* target = (int16_t*)output;
+        const __m256 scale = _mm256_set1_ps(32768.0f);
+        const __m256 minValue = _mm256_set1_ps(-32768.0f);
+        const __m256 maxValue = _mm256_set1_ps(32767.0f);
+        __m256i ditherState = dither ? _mm256_loadu_si256((const __m256i*)dither->lanes) : _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 16 <= samples; i += 16)
+        {
+            __m256i x0 = QuantizeAvx2(_mm256_loadu_ps(input + i), scale, minValue, maxValue, dither != nullptr, ditherState);
+            __m256i x1 = QuantizeAvx2(_mm256_loadu_ps(input + i + 8), scale, minValue, maxValue, dither != nullptr, ditherState);
+
+            // The pack works per 128-bit lane; restore sample order across lanes
+            __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(x0, x1), 0xD8);
+            _mm256_storeu_si256((__m256i*)(target + i), packed);
+        }
+        if (dither)
+            _mm256_storeu_si256((__m256i*)dither->lanes, ditherState);
+        FloatToPcm16Scalar(input + i, target + i, samples - i, dither);
+    }
+
+    void FloatToPcm24Avx2(const float* input, void* output, size_t samples, DitherState* dither)
+    {
+        uint8_t* target = (uint8_t*)output;
+        const __m256 scale = _mm256_set1_ps(8388608.0f);
+        const __m256 minValue = _mm256_set1_ps(-8388608.0f);
+        const __m256 maxValue = _mm256_set1_ps(8388607.0f);
+
+        // Per 128-bit lane: the low three bytes of each 32-bit lane, packed into the first 12 bytes
+        const __m256i pack = _mm256_setr_epi8(
+            0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+            0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+        __m256i ditherState = dither ? _mm256_loadu_si256((const __m256i*)dither->lanes) : _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 8 <= samples; i += 8)
+        {
+            __m256i x = QuantizeAvx2(_mm256_loadu_ps(input + i), scale, minValue, maxValue, dither != nullptr, ditherState);
+            __m256i packed = _mm256_shuffle_epi8(x, pack);
+            StorePacked24(target + i * 3, _mm256_castsi256_si128(packed));
+            StorePacked24(target + i * 3 + 12, _mm256_extracti128_si256(packed, 1));
+        }
+        if (dither)
+            _mm256_storeu_si256((__m256i*)dither->lanes, ditherState);
+        FloatToPcm24Scalar(input + i, target + i * 3, samples - i, dither);
+    }
+
+    void FloatToPcm32Avx2(const float* input, void* output, size_t samples, DitherState*)
+    {
+        int32_t* target = (int32_t*)output;
+        const __m256 scale = _mm256_set1_ps(2147483648.0f);
+        const __m256 minValue = _mm256_set1_ps(-2147483648.0f);
+        const __m256 maxValue = _mm256_set1_ps(2147483520.0f);
+        __m256i unused = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 8 <= samples; i += 8)
+        {
+            _mm256_storeu_si256((__m256i*)(target + i), QuantizeAvx2(_mm256_loadu_ps(input + i), scale, minValue, maxValue, false, unused));
+        }
+        FloatToPcm32Scalar(input + i, target + i, samples - i, nullptr);
+    }
+}
+#endif
@@ -0,0 +1,99 @@
+#include "SampleConverter.h"
+
+namespace
+{
+    using namespace SampleConvertKernels;
+
+    // One instruction set's kernels for every integer format
+    struct KernelSet
+    {
+        const wchar_t* name;
+        ToFloatFn pcm16ToFloat;
+        ToFloatFn pcm24ToFloat;
+        ToFloatFn pcm32ToFloat;
+        FromFloatFn floatToPcm16;
+        FromFloatFn floatToPcm24;
+        FromFloatFn floatToPcm32;
+    };
+
+    const KernelSet ScalarKernels = {
+        L"Scalar",
+        Pcm16ToFloatScalar, Pcm24ToFloatScalar, Pcm32ToFloatScalar,
+        FloatToPcm16Scalar, FloatToPcm24Scalar, FloatToPcm32Scalar
+    };
+
+#ifdef AUDIOROUTER_X86
+    const KernelSet Sse2Kernels = {
+        L"SSE2",
+        Pcm16ToFloatSse2, Pcm24ToFloatSse2, Pcm32ToFloatSse2,
+        FloatToPcm16Sse2, FloatToPcm24Sse2, FloatToPcm32Sse2
+    };
+#endif
+
+#ifdef AUDIOROUTER_HAVE_AVX2
+    const KernelSet Avx2Kernels = {
+        L"AVX2",
+        Pcm16ToFloatAvx2, Pcm24ToFloatAvx2, Pcm32ToFloatAvx2,
+        FloatToPcm16Avx2, FloatToPcm24Avx2, FloatToPcm32Avx2
+    };
+#endif
+
+    // Fixed seed: dithered output is reproducible run to run
+    const uint32_t DitherSeed = 0x2545F491u;
+
+    // Pick the widest kernel set this CPU runs
+    const KernelSet& SelectKernelSet()
+    {
+#ifdef AUDIOROUTER_X86
+        const CpuFeatures& cpu = GetCpuFeatures();
+#ifdef AUDIOROUTER_HAVE_AVX2
+        if (cpu.hasAvx2)
+            return Avx2Kernels;
+#endif
+        if (cpu.hasSse2)
+            return Sse2Kernels;
+#endif
+        return ScalarKernels;
+    }
+}
+
+SampleConverter::SampleConverter()
+    : m_format(SampleFormat::Float32)
+    , m_dither(false)
+    , m_kernelName(L"Copy")
+    , m_toFloat(Float32ToFloat)
+    , m_fromFloat(FloatToFloat32)
+{
+    InitializeDither(m_ditherState, DitherSeed);
+}
+
+void SampleConverter::Configure(SampleFormat format, bool dither)
+{
+    m_format = format;
+    m_dither = dither && (format == SampleFormat::PCM16 || format == SampleFormat::PCM24);
+    InitializeDither(m_ditherState, DitherSeed);
+
+    const KernelSet& kernels = SelectKernelSet();
+    m_kernelName = kernels.name;
+
+    switch (format)
+    {
+    case SampleFormat::PCM16:
+        m_toFloat = kernels.pcm16ToFloat;
+        m_fromFloat = kernels.floatToPcm16;
+        break;
+    case SampleFormat::PCM24:
+        m_toFloat = kernels.pcm24ToFloat;
+        m_fromFloat = kernels.floatToPcm24;
+        break;
+    case SampleFormat::PCM32:
+        m_toFloat = kernels.pcm32ToFloat;
+        m_fromFloat = kernels.floatToPcm32;
+        break;
+    default:
+        m_kernelName = L"Copy";
+        m_toFloat = Float32ToFloat;
+        m_fromFloat = FloatToFloat32;
+        break;
+    }
+}
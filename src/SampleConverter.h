@@ -0,0 +1,40 @@
+#pragma once
+
+#include "AudioFormat.h"
+#include "SampleConvertKernels.h"
+#include <cstddef>
+
+// Converts one device sample format to and from normalized float.
+// The kernel for the format and CPU is chosen once in Configure(), so per-packet
+// conversion is a single indirect call with no format branching.
+class SampleConverter
+{
+public:
+    SampleConverter();
+
+    // Select kernels for format. dither adds TPDF dither when converting to 16 or 24-bit PCM.
+    void Configure(SampleFormat format, bool dither = false);
+
+    SampleFormat GetFormat() const { return m_format; }
+    bool IsDithering() const { return m_dither; }
+
+    // Instruction set of the selected kernels ("AVX2", "SSE2" or "Scalar"; "Copy" for float)
+    const wchar_t* GetKernelName() const { return m_kernelName; }
+
+    // Device format -> normalized float
+    void ToFloat(const void* input, float* output, size_t samples) const { m_toFloat(input, output, samples); }
+
+    // Normalized float -> device format (advances the dither state, hence not const)
+    void FromFloat(const float* input, void* output, size_t samples)
+    {
+        m_fromFloat(input, output, samples, m_dither ? &m_ditherState : nullptr);
+    }
+
+private:
+    SampleFormat m_format;
+    bool m_dither;
+    const wchar_t* m_kernelName;
+    SampleConvertKernels::ToFloatFn m_toFloat;
+    SampleConvertKernels::FromFloatFn m_fromFloat;
+    SampleConvertKernels::DitherState m_ditherState;
+};
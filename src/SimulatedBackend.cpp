@@ -0,0 +1,380 @@
+#include "SimulatedBackend.h"
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    const double Pi = 3.14159265358979323846;
+
+    // The capture tone runs at a 48th of the device rate (1 kHz at 48 kHz), so one cycle is a
+    // fixed table
+    const unsigned int ToneCycleFrames = 48;
+    const float ToneAmplitude = 0.25f;
+
+    // Frame counts derived from virtual time are nudged up by this much, so a frame that falls
+    // due exactly on an event is not lost to rounding
+    const double FrameEpsilon = 1e-6;
+
+    // splitmix64: a stateless hash, so event n's jitter does not depend on how many events
+    // came before it
+    uint64_t Mix(uint64_t x)
+    {
+        x += 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    // Uniform in [0, 1) for event n; stream tells apart the values drawn for one event
+    double Uniform(uint64_t seed, uint64_t n, unsigned int stream)
+    {
+        return (Mix(seed ^ Mix(n * 4 + stream)) >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    // Index of the glitch in the log, or NotLogged once it is full
+    const size_t NotLogged = (size_t)-1;
+
+    size_t RecordGlitch(SimulationLog* log, SimulatedGlitchType type, long long timeNs, uint64_t frames)
+    {
+        if (log->glitches.size() >= log->glitches.capacity())
+            return NotLogged;
+        log->glitches.push_back({ type, timeNs, frames });
+        return log->glitches.size() - 1;
+    }
+}
+
+//
+// SimulatedEvents
+//
+
+SimulatedEvents::SimulatedEvents(const SimulatedDeviceConfig& config, unsigned int clockSlot)
+    : m_periodNs(config.periodFrames * 1e9 / (config.format.sampleRate * (1.0 + config.clockSkewPpm * 1e-6)))
+    , m_jitterNs((long long)(config.jitterMs * 1e6))
+    , m_missedEventRate(config.missedEventRate < 0.99 ? config.missedEventRate : 0.99)
+    , m_stalls(config.stalls)
+    , m_seed(config.seed)
+    , m_clockSlot(clockSlot)
+    , m_startNs(0)
+    , m_nextEvent(1)
+{
+}
+
+void SimulatedEvents::Start(long long startNs)
+{
+    m_startNs = startNs;
+    m_nextEvent = 1;
+}
+
+long long SimulatedEvents::GetEventTime(uint64_t n) const
+{
+    if (m_missedEventRate > 0.0 && Uniform(m_seed, n, 1) < m_missedEventRate)
+        return -1;
+
+    long long timeNs = m_startNs + (long long)std::ceil(n * m_periodNs);
+    if (m_jitterNs > 0)
+        timeNs += (long long)(Uniform(m_seed, n, 0) * m_jitterNs);
+
+    for (const SimulatedWindow& stall : m_stalls)
+    {
+        if (timeNs >= stall.startNs && timeNs < stall.endNs)
+            timeNs = stall.endNs;
+    }
+    return timeNs;
+}
+
+BackendWaitResult SimulatedEvents::Wait(VirtualClock& clock, unsigned int timeoutMs, SimulationLog* log)
+{
+    long long eventNs = GetEventTime(m_nextEvent);
+    while (eventNs < 0)
+    {
+        log->missedEvents++;
+        eventNs = GetEventTime(++m_nextEvent);
+    }
+
+    const long long timeoutNs = clock.Now() + timeoutMs * 1000000LL;
+    BackendWaitResult result = clock.WaitUntil(eventNs < timeoutNs ? eventNs : timeoutNs, m_clockSlot);
+    if (result != BackendWaitResult::Ready)
+        return result;
+
+    const long long now = clock.Now();
+    if (now < eventNs)
+        return BackendWaitResult::Timeout;
+
+    // Every event due by now wakes the thread once
+    for (m_nextEvent++;; m_nextEvent++)
+    {
+        long long nextNs = GetEventTime(m_nextEvent);
+        if (nextNs > now)
+            break;
+        if (nextNs < 0)
+            log->missedEvents++;
+    }
+    return BackendWaitResult::Ready;
+}
+
+//
+// SimulatedCaptureBackend
+//
+
+SimulatedCaptureBackend::SimulatedCaptureBackend(const SimulatedDeviceConfig& config, VirtualClock* clock, SimulationLog* log)
+    : m_format(config.format)
+    , m_periodFrames(config.periodFrames)
+    , m_packetFrames(config.packetFrames > 0 ? config.packetFrames : config.periodFrames)
+    , m_bufferFrames(config.periodFrames * (config.bufferPeriods > 0 ? config.bufferPeriods : 1))
+    , m_frameRate(config.format.sampleRate * (1.0 + config.clockSkewPpm * 1e-6))
+    , m_silentBursts(config.silentBursts)
+    , m_clock(clock)
+    , m_log(log)
+    , m_events(config, 0)
+    , m_readFrame(0)
+    , m_packetOutstanding(false)
+    , m_discontinuity(false)
+    , m_isStarted(false)
+{
+    if (m_bufferFrames < m_packetFrames)
+        m_bufferFrames = m_packetFrames;
+
+    // A whole number of tone cycles, so each packet is a slice of it
+    const unsigned int channels = m_format.channels;
+    const unsigned int scratchFrames = (m_packetFrames / ToneCycleFrames + 2) * ToneCycleFrames;
+    m_scratch.resize((size_t)scratchFrames * channels);
+    for (unsigned int i = 0; i < scratchFrames; i++)
+    {
+        float value = (float)(ToneAmplitude * std::sin(2.0 * Pi * (i % ToneCycleFrames) / ToneCycleFrames));
+        for (unsigned int ch = 0; ch < channels; ch++)
+            m_scratch[(size_t)i * channels + ch] = value;
+    }
+    m_converter.Configure(m_format.sampleFormat);
+    m_packet.resize((size_t)m_packetFrames * m_format.getBlockAlign());
+}
+
+bool SimulatedCaptureBackend::Start()
+{
+    m_readFrame = 0;
+    m_packetOutstanding = false;
+    m_discontinuity = false;
+    m_events.Start(m_clock->Now());
+    m_isStarted = true;
+    return true;
+}
+
+void SimulatedCaptureBackend::Stop()
+{
+    m_isStarted = false;
+}
+
+BackendWaitResult SimulatedCaptureBackend::WaitForEvent(unsigned int timeoutMs)
+{
+    BackendWaitResult result = m_events.Wait(*m_clock, timeoutMs, m_log);
+    if (result == BackendWaitResult::Ready)
+        m_log->captureEvents++;
+    return result;
+}
+
+uint64_t SimulatedCaptureBackend::GetCapturedFrames() const
+{
+    long long elapsedNs = m_clock->Now() - m_events.GetStartNs();
+    return elapsedNs > 0 ? (uint64_t)(elapsedNs * 1e-9 * m_frameRate + FrameEpsilon) : 0;
+}
+
+bool SimulatedCaptureBackend::IsSilent(uint64_t frame) const
+{
+    const long long timeNs = m_events.GetStartNs() + (long long)(frame * 1e9 / m_frameRate);
+    for (const SimulatedWindow& burst : m_silentBursts)
+    {
+        if (timeNs >= burst.startNs && timeNs < burst.endNs)
+            return true;
+    }
+    return false;
+}
+
+bool SimulatedCaptureBackend::GetBuffer(const void** data, unsigned int* frameCount, unsigned int* flags)
+{
+    *data = nullptr;
+    *frameCount = 0;
+    *flags = AudioBufferFlag_None;
+
+    if (!m_isStarted || m_packetOutstanding)
+        return m_isStarted;
+
+    // Audio older than the buffer was overwritten: skip to the oldest whole packet left
+    const uint64_t captured = GetCapturedFrames();
+    if (captured > m_readFrame + m_bufferFrames)
+    {
+        const uint64_t oldest = captured - m_bufferFrames;
+        const uint64_t resumeFrame = (oldest + m_packetFrames - 1) / m_packetFrames * m_packetFrames;
+        const long long overflowNs = m_events.GetStartNs() + (long long)((m_readFrame + m_bufferFrames) * 1e9 / m_frameRate);
+        m_log->overflows++;
+        m_log->overflowFrames += resumeFrame - m_readFrame;
+        RecordGlitch(m_log, SimulatedGlitchType::Overflow, overflowNs, resumeFrame - m_readFrame);
+        m_readFrame = resumeFrame;
+        m_discontinuity = true;
+    }
+
+    if (captured < m_readFrame + m_packetFrames)
+        return true;
+
+    const size_t samples = (size_t)m_packetFrames * m_format.channels;
+    if (IsSilent(m_readFrame))
+    {
+        std::memset(m_packet.data(), 0, m_packet.size());
+        *flags |= AudioBufferFlag_Silent;
+        m_log->silentPackets++;
+    }
+    else
+    {
+        const size_t offset = (size_t)(m_readFrame % ToneCycleFrames) * m_format.channels;
+        m_converter.FromFloat(m_scratch.data() + offset, m_packet.data(), samples);
+    }
+
+    if (m_discontinuity)
+    {
+        *flags |= AudioBufferFlag_Discontinuity;
+        m_discontinuity = false;
+    }
+
+    m_packetOutstanding = true;
+    *data = m_packet.data();
+    *frameCount = m_packetFrames;
+    return true;
+}
+
+void SimulatedCaptureBackend::ReleaseBuffer(unsigned int frameCount)
+{
+    if (m_packetOutstanding && frameCount > 0)
+        m_readFrame += m_packetFrames;
+    m_packetOutstanding = false;
+}
+
+bool SimulatedCaptureBackend::GetNextPacketSize(unsigned int* frameCount)
+{
+    *frameCount = 0;
+    if (!m_isStarted)
+        return false;
+
+    const uint64_t nextFrame = m_readFrame + (m_packetOutstanding ? m_packetFrames : 0);
+    if (GetCapturedFrames() >= nextFrame + m_packetFrames)
+        *frameCount = m_packetFrames;
+    return true;
+}
+
+//
+// SimulatedRenderBackend
+//
+
+SimulatedRenderBackend::SimulatedRenderBackend(const SimulatedDeviceConfig& config, VirtualClock* clock, SimulationLog* log)
+    : m_format(config.format)
+    , m_periodFrames(config.periodFrames)
+    , m_bufferFrames(config.periodFrames * (config.bufferPeriods > 0 ? config.bufferPeriods : 1))
+    , m_clock(clock)
+    , m_log(log)
+    , m_events(config, 1)
+    , m_paddingFrames(0)
+    , m_pendingFrames(0)
+    , m_periodsPlayed(0)
+    , m_underrunning(false)
+    , m_underrunGlitch(0)
+    , m_isStarted(false)
+{
+    m_buffer.resize((size_t)m_bufferFrames * m_format.getBlockAlign());
+}
+
+bool SimulatedRenderBackend::Start()
+{
+    m_periodsPlayed = 0;
+    m_underrunning = false;
+    m_events.Start(m_clock->Now());
+    m_isStarted = true;
+    return true;
+}
+
+void SimulatedRenderBackend::Stop()
+{
+    AdvanceToNow();
+    m_isStarted = false;
+}
+
+void SimulatedRenderBackend::AdvanceToNow()
+{
+    if (!m_isStarted)
+        return;
+
+    const long long elapsedNs = m_clock->Now() - m_events.GetStartNs();
+    const uint64_t periods = elapsedNs > 0 ? (uint64_t)(elapsedNs / m_events.GetPeriodNs() + FrameEpsilon) : 0;
+
+    while (m_periodsPlayed < periods)
+    {
+        unsigned int played = m_paddingFrames < m_periodFrames ? m_paddingFrames : m_periodFrames;
+        if (played < m_periodFrames)
+        {
+            // Consecutive periods short of audio are one underrun
+            const unsigned int missing = m_periodFrames - played;
+            if (!m_underrunning)
+            {
+                m_log->underruns++;
+                m_underrunGlitch = RecordGlitch(m_log, SimulatedGlitchType::Underrun,
+                                                m_events.GetStartNs() + (long long)std::ceil(m_periodsPlayed * m_events.GetPeriodNs()), 0);
+                m_underrunning = true;
+            }
+            m_log->underrunFrames += missing;
+            if (m_underrunGlitch != NotLogged)
+                m_log->glitches[m_underrunGlitch].frames += missing;
+        }
+        else
+        {
+            m_underrunning = false;
+        }
+
+        m_paddingFrames -= played;
+        m_log->playedFrames += m_periodFrames;
+        m_periodsPlayed++;
+    }
+}
+
+BackendWaitResult SimulatedRenderBackend::WaitForEvent(unsigned int timeoutMs)
+{
+    BackendWaitResult result = m_events.Wait(*m_clock, timeoutMs, m_log);
+    if (result == BackendWaitResult::Ready)
+    {
+        m_log->renderEvents++;
+        AdvanceToNow();
+    }
+    return result;
+}
+
+bool SimulatedRenderBackend::GetCurrentPadding(unsigned int* paddingFrames)
+{
+    AdvanceToNow();
+    *paddingFrames = m_paddingFrames;
+    m_log->renderPaddingFrames = m_paddingFrames;
+    return m_isStarted;
+}
+
+bool SimulatedRenderBackend::GetPlayedFrames(uint64_t* playedFrames)
+{
+    // Each period is taken from the buffer at its boundary and played out over the one that follows
+    const long long elapsedNs = m_clock->Now() - m_events.GetStartNs();
+    *playedFrames = elapsedNs > 0 ? (uint64_t)(elapsedNs / m_events.GetPeriodNs() * m_periodFrames + FrameEpsilon) : 0;
+    return m_isStarted;
+}
+
+bool SimulatedRenderBackend::GetBuffer(unsigned int frameCount, void** data)
+{
+    *data = nullptr;
+    if (frameCount > m_bufferFrames - m_paddingFrames)
+        return false;
+
+    m_pendingFrames = frameCount;
+    *data = m_buffer.data();
+    return true;
+}
+
+void SimulatedRenderBackend::ReleaseBuffer(unsigned int frameCount, unsigned int)
+{
+    if (frameCount > m_pendingFrames)
+        frameCount = m_pendingFrames;
+
+    m_paddingFrames += frameCount;
+    m_pendingFrames = 0;
+    m_log->renderPaddingFrames = m_paddingFrames;
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+#include "IAudioBackend.h"
+#include "SampleConverter.h"
+#include "VirtualClock.h"
+#include <cstdint>
+#include <vector>
+
+// Stretch of virtual time a simulated device misbehaves in
+struct SimulatedWindow
+{
+    long long startNs = 0;
+    long long endNs = 0;
+};
+
+// One simulated device: its clock, how its events reach the engine, and scripted trouble
+struct SimulatedDeviceConfig
+{
+    AudioFormat format = AudioFormat(SampleFormat::Float32, 48000, 2);
+    unsigned int periodFrames = 480;        // Event interval
+    unsigned int bufferPeriods = 4;         // Device buffer
+    unsigned int packetFrames = 0;          // Capture packet size (0 = the period); need not divide the period
+    double clockSkewPpm = 0.0;              // Device clock runs fast (positive) or slow (negative)
+    double jitterMs = 0.0;                  // Each event is signalled up to this late
+    double missedEventRate = 0.0;           // Fraction of events never signalled (below 1)
+    std::vector<SimulatedWindow> stalls;    // Events due in a window are held to its end, as one
+    std::vector<SimulatedWindow> silentBursts;  // Capture packets that start in a window come flagged silent
+    uint64_t seed = 1;                      // Seeds the jitter and missed events
+
+    SimulatedDeviceConfig() = default;
+};
+
+enum class SimulatedGlitchType
+{
+    Underrun,   // Render device played silence: its buffer ran dry
+    Overflow    // Capture device lost audio: the engine read it too late
+};
+
+struct SimulatedGlitch
+{
+    SimulatedGlitchType type;
+    long long timeNs;       // Virtual time it began
+    uint64_t frames;        // Silence played or audio lost, over the whole episode
+};
+
+// What a simulated device pair went through, written by the devices and read while the clock is
+// stopped or after the run. Owned by the caller, so it outlives the backends (the engine destroys
+// them on Stop()).
+struct SimulationLog
+{
+    std::vector<SimulatedGlitch> glitches;  // Reserve capacity up front: the devices never grow it,
+                                            // glitches past it are only counted
+    uint64_t underruns = 0;                 // Underrun episodes (consecutive empty periods are one)
+    uint64_t underrunFrames = 0;
+    uint64_t overflows = 0;
+    uint64_t overflowFrames = 0;
+    uint64_t captureEvents = 0;             // Events the engine was woken by
+    uint64_t renderEvents = 0;
+    uint64_t missedEvents = 0;              // Events never signalled
+    uint64_t silentPackets = 0;             // Capture packets flagged silent
+    uint64_t playedFrames = 0;              // Render frames played, audio or not
+    unsigned int renderPaddingFrames = 0;   // Render buffer level at the last engine call
+};
+
+// Event timing shared by both simulated devices: event n is due n periods of device time after
+// start, plus its jitter, held to the end of any stall it falls in; missed events never come.
+// Several events due while nobody waited are taken as one, like a Win32 auto-reset event.
+class SimulatedEvents
+{
+public:
+    SimulatedEvents(const SimulatedDeviceConfig& config, unsigned int clockSlot);
+
+    void Start(long long startNs);
+
+    // Wait on clock for the next event; Timeout when timeoutMs of virtual time pass first
+    BackendWaitResult Wait(VirtualClock& clock, unsigned int timeoutMs, SimulationLog* log);
+
+    // Device time of frame 0 and the length of a device period, in ns
+    long long GetStartNs() const { return m_startNs; }
+    double GetPeriodNs() const { return m_periodNs; }
+
+private:
+    // When event n is signalled, or -1 if it never is
+    long long GetEventTime(uint64_t n) const;
+
+    double m_periodNs;
+    long long m_jitterNs;
+    double m_missedEventRate;
+    std::vector<SimulatedWindow> m_stalls;
+    uint64_t m_seed;
+    unsigned int m_clockSlot;
+    long long m_startNs;
+    uint64_t m_nextEvent;
+};
+
+// Capture device on a VirtualClock. It fills packets with a 1 kHz tone; a reader that falls
+// behind by more than the buffer loses the oldest packets (flagged as a discontinuity).
+class SimulatedCaptureBackend : public IAudioCaptureBackend
+{
+public:
+    SimulatedCaptureBackend(const SimulatedDeviceConfig& config, VirtualClock* clock, SimulationLog* log);
+
+    // IAudioBackend interface
+    const AudioFormat& GetFormat() const override { return m_format; }
+    unsigned int GetBufferFrameCount() const override { return m_bufferFrames; }
+    unsigned int GetPeriodFrameCount() const override { return m_periodFrames; }
+    bool Start() override;
+    void Stop() override;
+    BackendWaitResult WaitForEvent(unsigned int timeoutMs) override;
+    void Interrupt() override { m_clock->Interrupt(); }
+    const wchar_t* GetName() const override { return L"Simulated Capture"; }
+    long long GetClockNs() const override { return m_clock->Now(); }
+    void SetDiagnosticCallback(std::function<void(const std::wstring&)> callback) override { m_diagnosticCallback = callback; }
+
+    // IAudioCaptureBackend interface
+    bool GetBuffer(const void** data, unsigned int* frameCount, unsigned int* flags) override;
+    void ReleaseBuffer(unsigned int frameCount) override;
+    bool GetNextPacketSize(unsigned int* frameCount) override;
+
+private:
+    // Frames the device clock has captured by now
+    uint64_t GetCapturedFrames() const;
+
+    // Whether the packet starting at frame lies in a silent burst
+    bool IsSilent(uint64_t frame) const;
+
+    AudioFormat m_format;
+    unsigned int m_periodFrames;
+    unsigned int m_packetFrames;
+    unsigned int m_bufferFrames;
+    double m_frameRate;                     // Frames per second of virtual time
+    std::vector<SimulatedWindow> m_silentBursts;
+    VirtualClock* m_clock;
+    SimulationLog* m_log;
+    SimulatedEvents m_events;
+    SampleConverter m_converter;
+    std::vector<float> m_scratch;
+    std::vector<unsigned char> m_packet;
+    uint64_t m_readFrame;                   // First frame of the next packet
+    bool m_packetOutstanding;
+    bool m_discontinuity;                   // Audio was lost before the next packet
+    bool m_isStarted;
+    std::function<void(const std::wstring&)> m_diagnosticCallback;
+};
+
+// Render device on a VirtualClock: every device period it takes a period from its buffer, and
+// plays silence for whatever is missing.
+class SimulatedRenderBackend : public IAudioRenderBackend
+{
+public:
+    SimulatedRenderBackend(const SimulatedDeviceConfig& config, VirtualClock* clock, SimulationLog* log);
+
+    // IAudioBackend interface
+    const AudioFormat& GetFormat() const override { return m_format; }
+    unsigned int GetBufferFrameCount() const override { return m_bufferFrames; }
+    unsigned int GetPeriodFrameCount() const override { return m_periodFrames; }
+    bool Start() override;
+    void Stop() override;
+    BackendWaitResult WaitForEvent(unsigned int timeoutMs) override;
+    void Interrupt() override { m_clock->Interrupt(); }
+    const wchar_t* GetName() const override { return L"Simulated Render"; }
+    long long GetClockNs() const override { return m_clock->Now(); }
+    void SetDiagnosticCallback(std::function<void(const std::wstring&)> callback) override { m_diagnosticCallback = callback; }
+
+    // IAudioRenderBackend interface
+    bool GetCurrentPadding(unsigned int* paddingFrames) override;
+    bool GetPlayedFrames(uint64_t* playedFrames) override;
+    bool GetBuffer(unsigned int frameCount, void** data) override;
+    void ReleaseBuffer(unsigned int frameCount, unsigned int flags) override;
+
+private:
+    // Play every period that elapsed since the last call
+    void AdvanceToNow();
+
+    AudioFormat m_format;
+    unsigned int m_periodFrames;
+    unsigned int m_bufferFrames;
+    VirtualClock* m_clock;
+    SimulationLog* m_log;
+    SimulatedEvents m_events;
+    std::vector<unsigned char> m_buffer;    // Written by the engine, never played back
+    unsigned int m_paddingFrames;
+    unsigned int m_pendingFrames;
+    uint64_t m_periodsPlayed;
+    bool m_underrunning;
+    size_t m_underrunGlitch;                // Where the current underrun is in the log
+    bool m_isStarted;
+    std::function<void(const std::wstring&)> m_diagnosticCallback;
+};
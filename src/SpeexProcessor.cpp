@@ -2,6 +2,9 @@
 
 #ifdef HAVE_SPEEX
 #include <speex/speex_preprocess.h>
+#ifdef HAVE_SPEEX_FLOAT
+#include "speex_preprocess_float.h"
+#endif
 #endif
 
 #include <cstring>
@@ -12,16 +15,52 @@
 #ifndef HAVE_SPEEX
 // Stub implementation when Speex is not available
 SpeexProcessor::SpeexProcessor(const SpeexConfig& config)
-    : m_state(nullptr), m_config(config), m_isInitialized(false), m_sampleRate(0), m_channels(0), m_frameSize(0), m_totalFramesProcessed(0) {}
+    : m_state(nullptr), m_config(config), m_isInitialized(false), m_sampleRate(0), m_channels(0), m_frameSize(0), m_callFrameCount(0), m_bufferingFrames(0), m_totalFramesProcessed(0), m_diagnosticLog(nullptr) {}
 SpeexProcessor::~SpeexProcessor() {}
 bool SpeexProcessor::Initialize(unsigned int, unsigned int) {
     if (m_diagnosticCallback) m_diagnosticCallback(L"Speex not available (not compiled in)");
     return false;
 }
 void SpeexProcessor::Process(float*, unsigned int, unsigned int) {}
+void SpeexProcessor::ReserveBuffers(BufferArena&, unsigned int) {}
+unsigned int SpeexProcessor::GetLatencyFrames() const { return 0; }
 void SpeexProcessor::UpdateConfig(const SpeexConfig& config) { m_config = config; }
 #else
 
+namespace
+{
+    // With the float build of the preprocessor (speex_preprocess_float.h) frames stay float from
+    // capture to output; otherwise they are clamped to int16 for the stock API and widened back
+#ifdef HAVE_SPEEX_FLOAT
+    typedef float SpeexSample;
+
+    SpeexPreprocessState* CreatePreprocessor(int frameSize, int sampleRate) { return speex_preprocess_float_state_init(frameSize, sampleRate); }
+    void DestroyPreprocessor(SpeexPreprocessState* state) { speex_preprocess_float_state_destroy(state); }
+    int ControlPreprocessor(SpeexPreprocessState* state, int request, void* value) { return speex_preprocess_float_ctl(state, request, value); }
+    int RunPreprocessor(SpeexPreprocessState* state, SpeexSample* frame) { return speex_preprocess_float_run(state, frame); }
+
+    inline SpeexSample ToSpeexSample(float sample)
+    {
+        return sample * 32768.0f;
+    }
+#else
+    typedef short SpeexSample;
+
+    SpeexPreprocessState* CreatePreprocessor(int frameSize, int sampleRate) { return speex_preprocess_state_init(frameSize, sampleRate); }
+    void DestroyPreprocessor(SpeexPreprocessState* state) { speex_preprocess_state_destroy(state); }
+    int ControlPreprocessor(SpeexPreprocessState* state, int request, void* value) { return speex_preprocess_ctl(state, request, value); }
+    int RunPreprocessor(SpeexPreprocessState* state, SpeexSample* frame) { return speex_preprocess_run(state, frame); }
+
+    inline SpeexSample ToSpeexSample(float sample)
+    {
+        sample *= 32768.0f;
+        if (sample > 32767.0f) sample = 32767.0f;
+        if (sample < -32768.0f) sample = -32768.0f;
+        return (short)sample;
+    }
+#endif
+}
+
 SpeexProcessor::SpeexProcessor(const SpeexConfig& config)
     : m_state(nullptr)
     , m_config(config)
@@ -29,10 +68,13 @@ SpeexProcessor::SpeexProcessor(const SpeexConfig& config)
     , m_sampleRate(0)
     , m_channels(0)
     , m_frameSize(0)
+    , m_callFrameCount(0)
+    , m_bufferingFrames(0)
     , m_accumulatedSamples(0)
-    , m_outputBufferReadPos(0)
-    , m_outputBufferAvailable(0)
+    , m_outputQueued(0)
+    , m_isFirstFrame(true)
     , m_totalFramesProcessed(0)
+    , m_diagnosticLog(nullptr)
 {
 }
 
@@ -40,7 +82,7 @@ SpeexProcessor::~SpeexProcessor()
 {
     if (m_state)
     {
-        speex_preprocess_state_destroy(m_state);
+        DestroyPreprocessor(m_state);
     }
 }
 
@@ -55,7 +97,7 @@ bool SpeexProcessor::Initialize(unsigned int sampleRate, unsigned int channels)
         // Different parameters - need to reinitialize
         if (m_state)
         {
-            speex_preprocess_state_destroy(m_state);
+            DestroyPreprocessor(m_state);
             m_state = nullptr;
         }
     }
@@ -76,13 +118,13 @@ bool SpeexProcessor::Initialize(unsigned int sampleRate, unsigned int channels)
     }
 
     // Create Speex preprocessor state
-    m_state = speex_preprocess_state_init(m_frameSize, sampleRate);
+    m_state = CreatePreprocessor(m_frameSize, sampleRate);
 
     if (!m_state)
     {
         if (m_diagnosticCallback)
         {
-            m_diagnosticCallback(L"ERROR: speex_preprocess_state_init() returned NULL!");
+            m_diagnosticCallback(L"ERROR: Speex preprocessor state init returned NULL!");
         }
         return false;
     }
@@ -90,22 +132,13 @@ bool SpeexProcessor::Initialize(unsigned int sampleRate, unsigned int channels)
     // Apply configuration
     ApplyConfig();
 
-    // Pre-allocate buffers
-    m_frameBuffer.resize(m_frameSize);
-    m_monoBuffer.resize(m_frameSize * 4);  // Extra space for larger callbacks
-    m_outputBuffer.resize(m_frameSize * 4);
+    // Buffers are reserved in ReserveBuffers() once the largest callback size is known
 
     // Reset accumulation state
     m_accumulatedSamples = 0;
-    m_outputBufferReadPos = 0;
-    m_outputBufferAvailable = 0;
+    m_outputQueued = 0;
     m_totalFramesProcessed = 0;
 
-    // Pre-fill output buffer with silence to handle initial latency
-    // This adds one frame of latency but prevents choppy audio at startup
-    std::fill(m_outputBuffer.begin(), m_outputBuffer.begin() + m_frameSize, 0.0f);
-    m_outputBufferAvailable = m_frameSize;
-
     m_isInitialized = true;
 
     if (m_diagnosticCallback)
@@ -125,29 +158,29 @@ void SpeexProcessor::ApplyConfig()
 
     // Enable noise suppression
     int denoise = 1;
-    speex_preprocess_ctl(m_state, SPEEX_PREPROCESS_SET_DENOISE, &denoise);
+    ControlPreprocessor(m_state, SPEEX_PREPROCESS_SET_DENOISE, &denoise);
 
     // Set noise suppression level (in dB, negative value)
     int noiseSuppress = m_config.noiseSuppressionLevel;
-    speex_preprocess_ctl(m_state, SPEEX_PREPROCESS_SET_NOISE_SUPPRESS, &noiseSuppress);
+    ControlPreprocessor(m_state, SPEEX_PREPROCESS_SET_NOISE_SUPPRESS, &noiseSuppress);
 
     // Configure VAD if enabled
     int vad = m_config.enableVAD ? 1 : 0;
-    speex_preprocess_ctl(m_state, SPEEX_PREPROCESS_SET_VAD, &vad);
+    ControlPreprocessor(m_state, SPEEX_PREPROCESS_SET_VAD, &vad);
 
     // Configure AGC if enabled
     int agc = m_config.enableAGC ? 1 : 0;
-    speex_preprocess_ctl(m_state, SPEEX_PREPROCESS_SET_AGC, &agc);
+    ControlPreprocessor(m_state, SPEEX_PREPROCESS_SET_AGC, &agc);
 
     if (m_config.enableAGC)
     {
         float agcLevel = (float)m_config.agcLevel;
-        speex_preprocess_ctl(m_state, SPEEX_PREPROCESS_SET_AGC_LEVEL, &agcLevel);
+        ControlPreprocessor(m_state, SPEEX_PREPROCESS_SET_AGC_LEVEL, &agcLevel);
     }
 
     // Configure dereverb if enabled
     int dereverb = m_config.enableDereverb ? 1 : 0;
-    speex_preprocess_ctl(m_state, SPEEX_PREPROCESS_SET_DEREVERB, &dereverb);
+    ControlPreprocessor(m_state, SPEEX_PREPROCESS_SET_DEREVERB, &dereverb);
 
     if (m_diagnosticCallback)
     {
@@ -169,16 +202,34 @@ void SpeexProcessor::UpdateConfig(const SpeexConfig& config)
     }
 }
 
+void SpeexProcessor::ReserveBuffers(BufferArena& arena, unsigned int maxFrames)
+{
+    arena.Reserve(m_frameBuffer, m_frameSize);
+    arena.Reserve(m_monoBuffer, maxFrames);     // Mono conversion of the largest callback
+
+    // Hand back the first calls from zeros queued ahead of the first frame: just enough that
+    // calls of the expected size always find a full call's worth processed (none when they are
+    // whole frames). The queue never holds more than a frame at the end of a call, plus what
+    // one call adds.
+    m_bufferingFrames = GetFrameAlignmentDelay(m_frameSize, m_callFrameCount);
+    arena.Reserve(m_outputQueue, maxFrames + 2 * m_frameSize);
+    m_outputQueued = m_bufferingFrames;
+}
+
+unsigned int SpeexProcessor::GetLatencyFrames() const
+{
+    // The preprocessor's overlap-add synthesis returns each frame one frame late
+    return m_frameSize + m_bufferingFrames.load(std::memory_order_relaxed);
+}
+
 void SpeexProcessor::Process(float* audioData, unsigned int frameCount, unsigned int channels)
 {
     if (!m_isInitialized || !m_state || !audioData || frameCount == 0 || channels == 0)
         return;
 
-    // Ensure mono buffer is large enough
+    // Larger than reserved: leave the audio untouched rather than allocate here
     if (frameCount > m_monoBuffer.size())
-    {
-        m_monoBuffer.resize(frameCount);
-    }
+        return;
 
     // Step 1: Convert input to mono
     if (channels == 1)
@@ -203,154 +254,110 @@ void SpeexProcessor::Process(float* audioData, unsigned int frameCount, unsigned
         }
     }
 
-    // Step 2: Process using frame accumulation
+    // Step 2: Feed the input through Speex a frame at a time, queueing the processed frames
     unsigned int inputPos = 0;
-    unsigned int outputPos = 0;
-
-    while (outputPos < frameCount)
+    while (inputPos < frameCount)
     {
-        // First, try to output any previously processed samples
-        if (m_outputBufferAvailable > 0)
+        // Accumulate samples into frame buffer until we have enough
+        unsigned int samplesToAccumulate = std::min(
+            m_frameSize - m_accumulatedSamples,
+            frameCount - inputPos
+        );
+
+        // Scale to 16-bit range and accumulate
+        SpeexSample* frame = m_frameBuffer.data() + m_accumulatedSamples;
+        const float* mono = m_monoBuffer.data() + inputPos;
+        for (unsigned int i = 0; i < samplesToAccumulate; i++)
         {
-            unsigned int samplesToOutput = std::min(m_outputBufferAvailable, frameCount - outputPos);
+            frame[i] = ToSpeexSample(mono[i]);
+        }
 
-            // Copy from output buffer
-            for (unsigned int i = 0; i < samplesToOutput; i++)
-            {
-                // Convert mono to multi-channel
-                float sample = m_outputBuffer[m_outputBufferReadPos + i];
+        m_accumulatedSamples += samplesToAccumulate;
+        inputPos += samplesToAccumulate;
 
-                if (channels == 1)
-                {
-                    audioData[outputPos] = sample;
-                }
-                else if (channels == 2)
-                {
-                    audioData[outputPos * 2] = sample;
-                    audioData[outputPos * 2 + 1] = sample;
-                }
-                else
+        // If we have a full frame, process it into the output queue
+        if (m_accumulatedSamples == m_frameSize)
+        {
+            float* processed = m_outputQueue.data() + m_outputQueued;
+
+            // DIAGNOSTIC: Check input samples before processing
+            if (m_isFirstFrame && m_diagnosticLog)
+            {
+                float inputMax = 0;
+                for (unsigned int i = 0; i < m_frameSize; i++)
                 {
-                    for (unsigned int ch = 0; ch < channels; ch++)
-                    {
-                        audioData[outputPos * channels + ch] = sample;
-                    }
+                    inputMax = std::max(inputMax, std::abs((float)m_frameBuffer[i]));
                 }
-                outputPos++;
-            }
 
-            m_outputBufferReadPos += samplesToOutput;
-            m_outputBufferAvailable -= samplesToOutput;
-
-            if (m_outputBufferAvailable == 0)
-            {
-                m_outputBufferReadPos = 0;
+                const double args[] = { inputMax, (double)m_frameBuffer[0], (double)m_frameBuffer[1], (double)m_frameBuffer[2] };
+                m_diagnosticLog->Push(DiagnosticCode::SpeexFirstInput, args, 4);
             }
-        }
-        else if (inputPos < frameCount)
-        {
-            // No processed samples available, need to accumulate and process more input
 
-            // Accumulate samples into frame buffer until we have enough
-            unsigned int samplesToAccumulate = std::min(
-                m_frameSize - m_accumulatedSamples,
-                frameCount - inputPos
-            );
+            // Process the frame with Speex
+            // The preprocessor returns the VAD result (1 = speech, 0 = noise)
+            int vadResult = RunPreprocessor(m_state, m_frameBuffer.data());
 
-            // Convert to int16 and accumulate
-            for (unsigned int i = 0; i < samplesToAccumulate; i++)
+            // Scale back to [-1, 1] into the output queue
+            const SpeexSample* result = m_frameBuffer.data();
+            for (unsigned int i = 0; i < m_frameSize; i++)
             {
-                float sample = m_monoBuffer[inputPos + i] * 32768.0f;
-                if (sample > 32767.0f) sample = 32767.0f;
-                if (sample < -32768.0f) sample = -32768.0f;
-                m_frameBuffer[m_accumulatedSamples + i] = (short)sample;
+                processed[i] = result[i] * (1.0f / 32768.0f);
             }
 
-            m_accumulatedSamples += samplesToAccumulate;
-            inputPos += samplesToAccumulate;
-
-            // If we have a full frame, process it
-            if (m_accumulatedSamples == m_frameSize)
+            // DIAGNOSTIC: Check output
+            if (m_isFirstFrame && m_diagnosticLog)
             {
-                // DIAGNOSTIC: Check input samples before processing
-                static bool firstFrame = true;
-                if (firstFrame && m_diagnosticCallback)
-                {
-                    float inputMax = 0;
-                    for (unsigned int i = 0; i < m_frameSize; i++)
-                    {
-                        inputMax = std::max(inputMax, std::abs((float)m_frameBuffer[i]));
-                    }
-
-                    std::wostringstream msg;
-                    msg << L"Speex Input: max=" << inputMax
-                        << L", first 3=[" << m_frameBuffer[0] << L", " << m_frameBuffer[1] << L", " << m_frameBuffer[2] << L"]";
-                    m_diagnosticCallback(msg.str());
-                }
-
-                // Process the frame with Speex
-                // speex_preprocess_run returns VAD result (1 = speech, 0 = noise)
-                int vadResult = speex_preprocess_run(m_state, m_frameBuffer.data());
-
-                // Convert back to float and store in output buffer
-                if (m_outputBuffer.size() < m_frameSize)
-                {
-                    m_outputBuffer.resize(m_frameSize);
-                }
-
+                float outputMax = 0;
                 for (unsigned int i = 0; i < m_frameSize; i++)
                 {
-                    m_outputBuffer[i] = m_frameBuffer[i] / 32768.0f;
+                    outputMax = std::max(outputMax, std::abs(processed[i]));
                 }
 
-                // DIAGNOSTIC: Check output
-                if (firstFrame && m_diagnosticCallback)
-                {
-                    float outputMax = 0;
-                    for (unsigned int i = 0; i < m_frameSize; i++)
-                    {
-                        outputMax = std::max(outputMax, std::abs(m_outputBuffer[i]));
-                    }
-
-                    std::wostringstream msg;
-                    msg << L"Speex Output: max=" << outputMax
-                        << L", VAD=" << vadResult
-                        << L", first 3=[" << m_outputBuffer[0] << L", " << m_outputBuffer[1] << L", " << m_outputBuffer[2] << L"]";
-                    m_diagnosticCallback(msg.str());
-                    firstFrame = false;
-                }
+                const double args[] = { outputMax, (double)vadResult, processed[0], processed[1], processed[2] };
+                m_diagnosticLog->Push(DiagnosticCode::SpeexFirstOutput, args, 5);
+            }
+            m_isFirstFrame = false;
 
-                m_totalFramesProcessed++;
-                m_outputBufferReadPos = 0;
-                m_outputBufferAvailable = m_frameSize;
+            m_totalFramesProcessed++;
+            m_outputQueued += m_frameSize;
 
-                // Reset accumulation
-                m_accumulatedSamples = 0;
-            }
+            // Reset accumulation
+            m_accumulatedSamples = 0;
+        }
+    }
+
+    // Step 3: Hand back frameCount samples from the front of the queue, converted back to the
+    // channel count. Only a call of a size other than the expected one can find it short: the
+    // gap is filled with silence ahead of the queued samples, which keeps the stream continuous.
+    // The stream is then that much later for good, so it is added to the reported latency (never
+    // more than a frame less the priming in all).
+    unsigned int available = std::min(m_outputQueued, frameCount);
+    unsigned int silence = frameCount - available;
+    if (silence > 0)
+        m_bufferingFrames.fetch_add(silence, std::memory_order_relaxed);
+    for (unsigned int i = 0; i < frameCount; i++)
+    {
+        float sample = i < silence ? 0.0f : m_outputQueue[i - silence];
+        if (channels == 1)
+        {
+            audioData[i] = sample;
+        }
+        else if (channels == 2)
+        {
+            audioData[i * 2] = sample;
+            audioData[i * 2 + 1] = sample;
         }
         else
         {
-            // No more input and no processed output available
-            // Output silence to maintain timing (this should rarely happen with pre-filled buffer)
-            if (channels == 1)
-            {
-                audioData[outputPos] = 0.0f;
-            }
-            else if (channels == 2)
-            {
-                audioData[outputPos * 2] = 0.0f;
-                audioData[outputPos * 2 + 1] = 0.0f;
-            }
-            else
+            for (unsigned int ch = 0; ch < channels; ch++)
             {
-                for (unsigned int ch = 0; ch < channels; ch++)
-                {
-                    audioData[outputPos * channels + ch] = 0.0f;
-                }
+                audioData[i * channels + ch] = sample;
             }
-            outputPos++;
         }
     }
+
+    m_outputQueued -= available;
+    std::memmove(m_outputQueue.data(), m_outputQueue.data() + available, m_outputQueued * sizeof(float));
 }
 
 #endif // HAVE_SPEEX
@@ -1,7 +1,9 @@
 #pragma once
 
+#include "BufferArena.h"
+#include "DiagnosticLog.h"
 #include "NoiseReductionTypes.h"
-#include <vector>
+#include <atomic>
 
 #ifdef HAVE_SPEEX
 // Forward declaration for Speex preprocessor state
@@ -20,6 +22,9 @@ public:
     // INoiseProcessor interface
     bool Initialize(unsigned int sampleRate, unsigned int channels) override;
     void Process(float* audioData, unsigned int frameCount, unsigned int channels) override;
+    void SetCallFrameCount(unsigned int frameCount) override { m_callFrameCount = frameCount; }
+    void ReserveBuffers(BufferArena& arena, unsigned int maxFrames) override;
+    unsigned int GetLatencyFrames() const override;
     const wchar_t* GetName() const override { return L"Speex"; }
     unsigned int GetRequiredFrameSize() const override { return m_frameSize; }
     unsigned int GetRequiredSampleRate() const override { return 0; } // Speex supports any rate
@@ -27,6 +32,7 @@ public:
     {
         m_diagnosticCallback = callback;
     }
+    void SetDiagnosticLog(DiagnosticLog* log) override { m_diagnosticLog = log; }
 
     // Check if Speex is available at compile time
     static bool IsAvailable() {
@@ -56,22 +62,31 @@ private:
     unsigned int m_sampleRate;
     unsigned int m_channels;
     unsigned int m_frameSize;  // Frame size in samples (typically 10-30ms worth)
+    unsigned int m_callFrameCount;   // Expected Process() size (0 = varies)
+    std::atomic<unsigned int> m_bufferingFrames;  // Samples queued ahead of the first call, plus silence
+                                                  // inserted since (read from any thread)
 
 #ifdef HAVE_SPEEX
-    // Processing buffers
-    std::vector<short> m_frameBuffer;         // Buffer for Speex processing (int16)
-    std::vector<float> m_monoBuffer;          // Mono conversion buffer
-    std::vector<float> m_outputBuffer;        // Output buffer for processed frames
+    // Processing buffers (carved out of the route's arena)
+#ifdef HAVE_SPEEX_FLOAT
+    ArenaBuffer<float> m_frameBuffer;         // Buffer for Speex processing (float at 16-bit scale)
+#else
+    ArenaBuffer<short> m_frameBuffer;         // Buffer for Speex processing (int16)
+#endif
+    ArenaBuffer<float> m_monoBuffer;          // Mono conversion buffer
+    ArenaBuffer<float> m_outputQueue;         // Processed samples waiting to be handed back (starts zeroed)
 
     // Frame accumulation state
     unsigned int m_accumulatedSamples;
-    unsigned int m_outputBufferReadPos;
-    unsigned int m_outputBufferAvailable;
+    unsigned int m_outputQueued;
+
+    bool m_isFirstFrame;                      // Log the first frame in and out (per instance)
 #endif
 
     // Diagnostic counters
     unsigned int m_totalFramesProcessed;
 
-    // Diagnostic callback
+    // Diagnostic callback (setup) and real-time log (processing)
     std::function<void(const std::wstring&)> m_diagnosticCallback;
+    DiagnosticLog* m_diagnosticLog;
 };
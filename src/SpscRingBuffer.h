@@ -0,0 +1,190 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <cstring>
+
+// Wait-free single-producer/single-consumer ring of interleaved float frames.
+// One thread may write and one (other) thread may read concurrently without locks.
+// Capacity is rounded up to a power of two; indices run freely and are masked on access.
+class SpscRingBuffer
+{
+public:
+    // Contiguous region of the ring; a wrapped region is returned as two spans
+    struct Span
+    {
+        float* data;
+        size_t frames;
+    };
+
+    static const size_t CacheLineSize = 64;
+
+    SpscRingBuffer()
+        : m_channels(1)
+        , m_capacityFrames(0)
+        , m_mask(0)
+        , m_writeIndex(0)
+        , m_cachedReadIndex(0)
+        , m_readIndex(0)
+        , m_cachedWriteIndex(0)
+    {
+    }
+
+    // Allocate storage. Not thread-safe; call before the producer/consumer threads start.
+    void Reset(size_t minCapacityFrames, unsigned int channels)
+    {
+        size_t capacity = 1;
+        while (capacity < minCapacityFrames)
+            capacity <<= 1;
+
+        m_channels = channels > 0 ? channels : 1;
+        m_capacityFrames = capacity;
+        m_mask = capacity - 1;
+        m_buffer.assign(capacity * m_channels, 0.0f);
+        m_writeIndex.store(0, std::memory_order_relaxed);
+        m_readIndex.store(0, std::memory_order_relaxed);
+        m_cachedReadIndex = 0;
+        m_cachedWriteIndex = 0;
+    }
+
+    size_t GetCapacityFrames() const { return m_capacityFrames; }
+    unsigned int GetChannels() const { return m_channels; }
+
+    // Frames queued. From the consumer side, a lower bound on what it can read (the producer may
+    // have added more since). From the producer side a stale snapshot that may overstate it.
+    size_t GetReadAvailable() const
+    {
+        return m_writeIndex.load(std::memory_order_acquire) - m_readIndex.load(std::memory_order_relaxed);
+    }
+
+    // Free frames. From the producer side, a lower bound on what it can write (the consumer may
+    // have freed more since). From the consumer side a stale snapshot that may overstate it.
+    size_t GetWriteAvailable() const
+    {
+        return m_capacityFrames - (m_writeIndex.load(std::memory_order_relaxed) - m_readIndex.load(std::memory_order_acquire));
+    }
+
+    //
+    // Producer side
+    //
+
+    // Get up to maxFrames of writable space as at most two spans. Returns the total frames.
+    size_t GetWriteSpans(size_t maxFrames, Span* first, Span* second)
+    {
+        const size_t writeIndex = m_writeIndex.load(std::memory_order_relaxed);
+        size_t available = m_capacityFrames - (writeIndex - m_cachedReadIndex);
+        if (available < maxFrames)
+        {
+            // Only touch the consumer's cache line when the cached view is not enough
+            m_cachedReadIndex = m_readIndex.load(std::memory_order_acquire);
+            available = m_capacityFrames - (writeIndex - m_cachedReadIndex);
+        }
+        return SplitSpans(writeIndex, available < maxFrames ? available : maxFrames, first, second);
+    }
+
+    // Publish frames written into the spans from GetWriteSpans
+    void CommitWrite(size_t frames)
+    {
+        m_writeIndex.store(m_writeIndex.load(std::memory_order_relaxed) + frames, std::memory_order_release);
+    }
+
+    // Copy up to frames interleaved frames in. Returns frames written.
+    size_t Write(const float* data, size_t frames)
+    {
+        Span first, second;
+        size_t count = GetWriteSpans(frames, &first, &second);
+        std::memcpy(first.data, data, first.frames * m_channels * sizeof(float));
+        if (second.frames > 0)
+            std::memcpy(second.data, data + first.frames * m_channels, second.frames * m_channels * sizeof(float));
+        CommitWrite(count);
+        return count;
+    }
+
+    // Write frames of silence. Returns frames written.
+    size_t WriteSilence(size_t frames)
+    {
+        Span first, second;
+        size_t count = GetWriteSpans(frames, &first, &second);
+        std::memset(first.data, 0, first.frames * m_channels * sizeof(float));
+        if (second.frames > 0)
+            std::memset(second.data, 0, second.frames * m_channels * sizeof(float));
+        CommitWrite(count);
+        return count;
+    }
+
+    //
+    // Consumer side
+    //
+
+    // Get up to maxFrames of readable data as at most two spans. Returns the total frames.
+    size_t GetReadSpans(size_t maxFrames, Span* first, Span* second)
+    {
+        const size_t readIndex = m_readIndex.load(std::memory_order_relaxed);
+        size_t available = m_cachedWriteIndex - readIndex;
+        if (available < maxFrames)
+        {
+            m_cachedWriteIndex = m_writeIndex.load(std::memory_order_acquire);
+            available = m_cachedWriteIndex - readIndex;
+        }
+        return SplitSpans(readIndex, available < maxFrames ? available : maxFrames, first, second);
+    }
+
+    // Release frames consumed from the spans from GetReadSpans
+    void CommitRead(size_t frames)
+    {
+        m_readIndex.store(m_readIndex.load(std::memory_order_relaxed) + frames, std::memory_order_release);
+    }
+
+    // Copy up to frames interleaved frames out. Returns frames read.
+    size_t Read(float* data, size_t frames)
+    {
+        Span first, second;
+        size_t count = GetReadSpans(frames, &first, &second);
+        std::memcpy(data, first.data, first.frames * m_channels * sizeof(float));
+        if (second.frames > 0)
+            std::memcpy(data + first.frames * m_channels, second.data, second.frames * m_channels * sizeof(float));
+        CommitRead(count);
+        return count;
+    }
+
+    // Drop up to frames queued frames. Returns frames dropped.
+    size_t Skip(size_t frames)
+    {
+        Span first, second;
+        size_t count = GetReadSpans(frames, &first, &second);
+        CommitRead(count);
+        return count;
+    }
+
+private:
+    SpscRingBuffer(const SpscRingBuffer&) = delete;
+    SpscRingBuffer& operator=(const SpscRingBuffer&) = delete;
+
+    size_t SplitSpans(size_t index, size_t frames, Span* first, Span* second)
+    {
+        const size_t offset = index & m_mask;
+        const size_t untilEnd = m_capacityFrames - offset;
+
+        first->data = m_buffer.data() + offset * m_channels;
+        first->frames = frames < untilEnd ? frames : untilEnd;
+        second->data = m_buffer.data();
+        second->frames = frames - first->frames;
+        return frames;
+    }
+
+    std::vector<float> m_buffer;
+    unsigned int m_channels;
+    size_t m_capacityFrames;
+    size_t m_mask;
+
+    // Producer and consumer state live on separate cache lines. Padding (rather than
+    // alignas) keeps them apart even when the owning object is not over-aligned.
+    char m_padding0[CacheLineSize];
+    std::atomic<size_t> m_writeIndex;
+    size_t m_cachedReadIndex;
+    char m_padding1[CacheLineSize - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+    std::atomic<size_t> m_readIndex;
+    size_t m_cachedWriteIndex;
+    char m_padding2[CacheLineSize - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+};
@@ -0,0 +1,77 @@
+#include "ThreadPriority.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <avrt.h>
+#pragma comment(lib, "avrt.lib")
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <thread>
+
+#ifdef _WIN32
+
+ScopedAudioThreadPriority::ScopedAudioThreadPriority()
+    : m_handle(nullptr)
+    , m_isElevated(false)
+{
+    DWORD taskIndex = 0;
+    HANDLE hTask = AvSetMmThreadCharacteristics(L"Pro Audio", &taskIndex);
+    m_handle = hTask;
+    m_isElevated = (hTask != NULL);
+}
+
+ScopedAudioThreadPriority::~ScopedAudioThreadPriority()
+{
+    if (m_handle)
+        AvRevertMmThreadCharacteristics((HANDLE)m_handle);
+}
+
+bool PinCurrentThread(unsigned int core)
+{
+    unsigned int cores = std::thread::hardware_concurrency();
+    if (cores == 0 || cores > 64)
+        return false;
+    return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << (core % cores)) != 0;
+}
+
+#else
+
+ScopedAudioThreadPriority::ScopedAudioThreadPriority()
+    : m_handle(nullptr)
+    , m_isElevated(false)
+{
+    // Usually needs CAP_SYS_NICE or an rtprio limit; silently stay at normal priority otherwise
+    sched_param param = {};
+    param.sched_priority = sched_get_priority_min(SCHED_FIFO) + 10;
+    m_isElevated = (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0);
+}
+
+ScopedAudioThreadPriority::~ScopedAudioThreadPriority()
+{
+    if (m_isElevated)
+    {
+        sched_param param = {};
+        pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+    }
+}
+
+bool PinCurrentThread(unsigned int core)
+{
+#ifdef __linux__
+    unsigned int cores = std::thread::hardware_concurrency();
+    if (cores == 0)
+        return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core % cores, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)core;
+    return false;
+#endif
+}
+
+#endif
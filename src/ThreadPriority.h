@@ -0,0 +1,24 @@
+#pragma once
+
+// Raises the calling thread to audio priority for its lifetime
+// (MMCSS "Pro Audio" on Windows, best-effort SCHED_FIFO elsewhere).
+class ScopedAudioThreadPriority
+{
+public:
+    ScopedAudioThreadPriority();
+    ~ScopedAudioThreadPriority();
+
+    // True if the platform accepted the priority change
+    bool IsElevated() const { return m_isElevated; }
+
+private:
+    ScopedAudioThreadPriority(const ScopedAudioThreadPriority&) = delete;
+    ScopedAudioThreadPriority& operator=(const ScopedAudioThreadPriority&) = delete;
+
+    void* m_handle;
+    bool m_isElevated;
+};
+
+// Keep the calling thread on one core (wrapped to the cores present). Returns false where the
+// platform does not support it.
+bool PinCurrentThread(unsigned int core);
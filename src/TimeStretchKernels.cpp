@@ -0,0 +1,59 @@
+#include "TimeStretchKernels.h"
+
+#ifdef AUDIOROUTER_X86
+#include <emmintrin.h>
+#endif
+
+namespace TimeStretchKernels
+{
+    float CorrelateScalar(const float* reference, const float* candidate, unsigned int count, float* candidateEnergy)
+    {
+        // Two partial sums of each so the compiler can keep several multiplies in flight
+        float dot0 = 0.0f, dot1 = 0.0f;
+        float energy0 = 0.0f, energy1 = 0.0f;
+        unsigned int k = 0;
+        for (; k + 2 <= count; k += 2)
+        {
+            dot0 += reference[k] * candidate[k];
+            dot1 += reference[k + 1] * candidate[k + 1];
+            energy0 += candidate[k] * candidate[k];
+            energy1 += candidate[k + 1] * candidate[k + 1];
+        }
+        if (k < count)
+        {
+            dot0 += reference[k] * candidate[k];
+            energy0 += candidate[k] * candidate[k];
+        }
+        *candidateEnergy = energy0 + energy1;
+        return dot0 + dot1;
+    }
+
+#ifdef AUDIOROUTER_X86
+    static inline float HorizontalSum(__m128 v)
+    {
+        __m128 shuffled = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+        __m128 sums = _mm_add_ps(v, shuffled);
+        shuffled = _mm_movehl_ps(shuffled, sums);
+        sums = _mm_add_ss(sums, shuffled);
+        return _mm_cvtss_f32(sums);
+    }
+
+    float CorrelateSse(const float* reference, const float* candidate, unsigned int count, float* candidateEnergy)
+    {
+        __m128 dot = _mm_setzero_ps();
+        __m128 energy = _mm_setzero_ps();
+        unsigned int k = 0;
+        for (; k + 4 <= count; k += 4)
+        {
+            __m128 x = _mm_loadu_ps(candidate + k);
+            dot = _mm_add_ps(dot, _mm_mul_ps(_mm_loadu_ps(reference + k), x));
+            energy = _mm_add_ps(energy, _mm_mul_ps(x, x));
+        }
+
+        float tailEnergy = 0.0f;
+        float result = HorizontalSum(dot) + CorrelateScalar(reference + k, candidate + k, count - k, &tailEnergy);
+        *candidateEnergy = HorizontalSum(energy) + tailEnergy;
+        return result;
+    }
+#endif
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "CpuFeatures.h"
+
+// Similarity search of the WSOLA time stretcher. Like the resampler kernels, each ISA variant
+// lives in its own translation unit and TimeStretcher picks one at Configure() time.
+//
+// Buffers need no particular alignment and count may be any length.
+namespace TimeStretchKernels
+{
+    // Returns sum(reference[k] * candidate[k]) and stores sum(candidate[k]^2) in *candidateEnergy:
+    // the two terms of the normalized cross-correlation, in one pass over the candidate
+    typedef float (*CorrelateFn)(const float* reference, const float* candidate, unsigned int count,
+                                 float* candidateEnergy);
+
+    float CorrelateScalar(const float* reference, const float* candidate, unsigned int count, float* candidateEnergy);
+
+#ifdef AUDIOROUTER_X86
+    float CorrelateSse(const float* reference, const float* candidate, unsigned int count, float* candidateEnergy);
+#endif
+
+#ifdef AUDIOROUTER_HAVE_AVX2
+    float CorrelateAvx2(const float* reference, const float* candidate, unsigned int count, float* candidateEnergy);
+#endif
+}
@@ -0,0 +1,48 @@
+// Built with AVX2/FMA code generation (see CMakeLists.txt); only called when the CPU supports both.
+#include "TimeStretchKernels.h"
+
+#ifdef AUDIOROUTER_HAVE_AVX2
+#include <immintrin.h>
+
+namespace TimeStretchKernels
+{
+    static inline float HorizontalSum(__m256 v)
+    {
+        __m128 sums = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        sums = _mm_add_ps(sums, _mm_movehl_ps(sums, sums));
+        sums = _mm_add_ss(sums, _mm_shuffle_ps(sums, sums, 1));
+        return _mm_cvtss_f32(sums);
+    }
+
+    float CorrelateAvx2(const float* reference, const float* candidate, unsigned int count, float* candidateEnergy)
+    {
+        __m256 dot0 = _mm256_setzero_ps();
+        __m256 dot1 = _mm256_setzero_ps();
+        __m256 energy0 = _mm256_setzero_ps();
+        __m256 energy1 = _mm256_setzero_ps();
+        unsigned int k = 0;
+        for (; k + 16 <= count; k += 16)
+        {
+            __m256 x0 = _mm256_loadu_ps(candidate + k);
+            __m256 x1 = _mm256_loadu_ps(candidate + k + 8);
+            dot0 = _mm256_fmadd_ps(_mm256_loadu_ps(reference + k), x0, dot0);
+            dot1 = _mm256_fmadd_ps(_mm256_loadu_ps(reference + k + 8), x1, dot1);
+            energy0 = _mm256_fmadd_ps(x0, x0, energy0);
+            energy1 = _mm256_fmadd_ps(x1, x1, energy1);
+        }
+        if (k + 8 <= count)
+        {
+            __m256 x = _mm256_loadu_ps(candidate + k);
+            dot0 = _mm256_fmadd_ps(_mm256_loadu_ps(reference + k), x, dot0);
+            energy0 = _mm256_fmadd_ps(x, x, energy0);
+            k += 8;
+        }
+
+        float tailEnergy = 0.0f;
+        float result = HorizontalSum(_mm256_add_ps(dot0, dot1)) +
+                       CorrelateScalar(reference + k, candidate + k, count - k, &tailEnergy);
+        *candidateEnergy = HorizontalSum(_mm256_add_ps(energy0, energy1)) + tailEnergy;
+        return result;
+    }
+}
+#endif
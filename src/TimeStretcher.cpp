@@ -0,0 +1,232 @@
+#include "TimeStretcher.h"
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    // 10 ms windows crossfade over 5 ms, long enough to hide a splice in voiced speech. The
+    // search range has to span a pitch period to find a match (down to 125 Hz voices), and the
+    // coarse pass looks at about every 16 kHz sample position before refining.
+    const unsigned int HopMs = 5;
+    const unsigned int SearchMs = 4;
+    const unsigned int CoarseSearchRate = 16000;
+
+    const double Pi = 3.14159265358979323846;
+}
+
+const double TimeStretcher::MinSpeed = 0.9;
+const double TimeStretcher::MaxSpeed = 1.1;
+
+TimeStretcher::TimeStretcher()
+    : m_sampleRate(48000)
+    , m_channels(0)
+    , m_hopFrames(0)
+    , m_windowFrames(0)
+    , m_searchFrames(0)
+    , m_searchStep(1)
+    , m_speed(1.0)
+    , m_capacityFrames(0)
+    , m_historyFrames(0)
+    , m_nominal(0.0)
+    , m_continuation(0)
+    , m_isPrimed(false)
+    , m_correlate(TimeStretchKernels::CorrelateScalar)
+{
+}
+
+bool TimeStretcher::Configure(unsigned int sampleRate, unsigned int channels)
+{
+    if (sampleRate == 0 || channels == 0)
+        return false;
+
+    m_sampleRate = sampleRate;
+    m_channels = channels;
+    m_hopFrames = sampleRate * HopMs / 1000;
+    if (m_hopFrames == 0)
+        m_hopFrames = 1;
+    m_windowFrames = 2 * m_hopFrames;
+    m_searchFrames = sampleRate * SearchMs / 1000;
+    m_searchStep = sampleRate > CoarseSearchRate ? sampleRate / CoarseSearchRate : 1;
+    m_capacityFrames = 0;
+
+    m_fadeIn.resize(m_hopFrames);
+    for (unsigned int i = 0; i < m_hopFrames; i++)
+    {
+        double s = std::sin(0.5 * Pi * (i + 0.5) / m_hopFrames);
+        m_fadeIn[i] = (float)(s * s);
+    }
+
+    // Pick the widest kernel this CPU runs
+    m_correlate = TimeStretchKernels::CorrelateScalar;
+#ifdef AUDIOROUTER_X86
+    const CpuFeatures& cpu = GetCpuFeatures();
+#ifdef AUDIOROUTER_HAVE_AVX2
+    if (cpu.hasAvx2 && cpu.hasFma)
+        m_correlate = TimeStretchKernels::CorrelateAvx2;
+    else
+#endif
+    if (cpu.hasSse2)
+        m_correlate = TimeStretchKernels::CorrelateSse;
+#endif
+
+    Reset();
+    return true;
+}
+
+void TimeStretcher::ReserveBuffers(BufferArena& arena, unsigned int maxInputFrames)
+{
+    // After Compact() the history keeps less than two look-aheads, so a whole call always fits
+    m_capacityFrames = maxInputFrames + 2 * GetLatencyFrames() + m_hopFrames;
+    arena.Reserve(m_history, (size_t)m_capacityFrames * m_channels);
+}
+
+void TimeStretcher::Reset()
+{
+    m_speed = 1.0;
+    m_historyFrames = 0;
+    m_nominal = 0.0;
+    m_continuation = 0;
+    m_isPrimed = false;
+}
+
+void TimeStretcher::SetSpeed(double speed)
+{
+    if (speed < MinSpeed)
+        speed = MinSpeed;
+    else if (speed > MaxSpeed)
+        speed = MaxSpeed;
+    m_speed = speed;
+}
+
+unsigned int TimeStretcher::GetMaxOutputFrames(unsigned int inputFrames) const
+{
+    // A hop needs at least MinSpeed hops of new input, plus the partial hop left from last time
+    return (unsigned int)((inputFrames + 1) / MinSpeed) + 2 * m_hopFrames;
+}
+
+unsigned int TimeStretcher::Process(const float* input, unsigned int inputFrames, float* output)
+{
+    // The history is only reserved after Reset(), so the silence goes in here
+    if (!m_isPrimed)
+    {
+        m_historyFrames = GetLatencyFrames();
+        std::memset(m_history.data(), 0, (size_t)m_historyFrames * m_channels * sizeof(float));
+        m_isPrimed = true;
+    }
+
+    unsigned int producedFrames = 0;
+    while (inputFrames > 0)
+    {
+        Compact();
+        unsigned int room = m_capacityFrames - m_historyFrames;
+        if (room == 0)
+            break;
+
+        unsigned int chunk = inputFrames < room ? inputFrames : room;
+        std::memcpy(m_history.data() + (size_t)m_historyFrames * m_channels, input, (size_t)chunk * m_channels * sizeof(float));
+        m_historyFrames += chunk;
+        input += (size_t)chunk * m_channels;
+        inputFrames -= chunk;
+
+        producedFrames += Run(output + (size_t)producedFrames * m_channels);
+    }
+    return producedFrames;
+}
+
+unsigned int TimeStretcher::Run(float* output)
+{
+    const unsigned int samples = m_hopFrames * m_channels;
+    unsigned int producedFrames = 0;
+
+    // A window can be placed once its whole search range is buffered
+    while ((unsigned int)m_nominal + m_searchFrames + m_windowFrames <= m_historyFrames)
+    {
+        unsigned int position = FindSegment();
+        const float* previous = m_history.data() + (size_t)m_continuation * m_channels;
+        const float* next = m_history.data() + (size_t)position * m_channels;
+
+        if (position == m_continuation)
+        {
+            std::memcpy(output, next, samples * sizeof(float));
+        }
+        else
+        {
+            // Crossfade out of the previous window's second half into the new window's first
+            for (unsigned int i = 0; i < m_hopFrames; i++)
+            {
+                const float fadeIn = m_fadeIn[i];
+                const float fadeOut = 1.0f - fadeIn;
+                for (unsigned int ch = 0; ch < m_channels; ch++)
+                {
+                    unsigned int s = i * m_channels + ch;
+                    output[s] = fadeOut * previous[s] + fadeIn * next[s];
+                }
+            }
+        }
+
+        output += samples;
+        producedFrames += m_hopFrames;
+        m_continuation = position + m_hopFrames;
+        m_nominal += m_hopFrames * m_speed;
+    }
+    return producedFrames;
+}
+
+unsigned int TimeStretcher::FindSegment() const
+{
+    const unsigned int nominal = (unsigned int)m_nominal;
+    const unsigned int first = nominal > m_searchFrames ? nominal - m_searchFrames : 0;
+    const unsigned int last = nominal + m_searchFrames;
+    if (m_continuation >= first && m_continuation <= last)
+        return m_continuation;
+
+    // Normalized cross-correlation of each candidate's first half against the continuation.
+    // The reference energy is the same for every candidate, so it is left out.
+    const float* reference = m_history.data() + (size_t)m_continuation * m_channels;
+    const unsigned int count = m_hopFrames * m_channels;
+    const float floor = 1e-9f * count;
+    unsigned int best = nominal;
+    float bestScore = -2.0f;
+
+    auto search = [&](unsigned int from, unsigned int to, unsigned int step)
+    {
+        for (unsigned int position = from; position <= to; position += step)
+        {
+            float energy = 0.0f;
+            float dot = m_correlate(reference, m_history.data() + (size_t)position * m_channels, count, &energy);
+            float score = dot / std::sqrt(energy + floor);
+            if (score > bestScore)
+            {
+                bestScore = score;
+                best = position;
+            }
+        }
+    };
+
+    search(first, last, m_searchStep);
+    if (m_searchStep > 1)
+    {
+        unsigned int coarseBest = best;
+        unsigned int from = coarseBest > first + m_searchStep - 1 ? coarseBest - (m_searchStep - 1) : first;
+        unsigned int to = coarseBest + (m_searchStep - 1) < last ? coarseBest + (m_searchStep - 1) : last;
+        search(from, to, 1);
+    }
+    return best;
+}
+
+void TimeStretcher::Compact()
+{
+    // Future windows start no earlier than the continuation or the bottom of the search range
+    const unsigned int nominal = (unsigned int)m_nominal;
+    unsigned int discard = nominal > m_searchFrames ? nominal - m_searchFrames : 0;
+    if (m_continuation < discard)
+        discard = m_continuation;
+    if (discard == 0)
+        return;
+
+    m_historyFrames -= discard;
+    std::memmove(m_history.data(), m_history.data() + (size_t)discard * m_channels,
+                 (size_t)m_historyFrames * m_channels * sizeof(float));
+    m_continuation -= discard;
+    m_nominal -= discard;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "BufferArena.h"
+#include "TimeStretchKernels.h"
+#include <vector>
+
+// Streaming WSOLA (waveform similarity overlap-add) time-scale modification for interleaved
+// float audio: plays the input a few percent faster or slower without changing its pitch.
+//
+// Output is built from half-overlapping raised-cosine windows, one hop at a time. Each window
+// is taken from the input near where the playback speed says it should start; within a search
+// range of a few ms the position is chosen so it lines up best with the natural continuation
+// of the previous window, so speech is shortened or stretched by whole pitch periods. While
+// the natural continuation itself is in range it is taken unchanged, which makes speed 1.0 an
+// exact (delayed) copy and limits the similarity search to the hops where a splice happens.
+class TimeStretcher
+{
+public:
+    // Speeds SetSpeed() accepts
+    static const double MinSpeed;
+    static const double MaxSpeed;
+
+    TimeStretcher();
+
+    bool Configure(unsigned int sampleRate, unsigned int channels);
+
+    // Reserve the history for calls of up to maxInputFrames in arena. Call after Configure()
+    // and allocate the arena before Process().
+    void ReserveBuffers(BufferArena& arena, unsigned int maxInputFrames);
+
+    // Forget history and position, back to normal speed (start of a new stream)
+    void Reset();
+
+    // Input frames consumed per output frame (1.0 = normal, above = faster). Clamped to
+    // [MinSpeed, MaxSpeed]; takes effect from the next hop.
+    void SetSpeed(double speed);
+    double GetSpeed() const { return m_speed; }
+
+    // Look-ahead held back before a hop can be placed, in frames. A stream starts with that much
+    // silence, so output keeps pace with input from the first call, this much later.
+    unsigned int GetLatencyFrames() const { return m_searchFrames + m_windowFrames; }
+
+    // Upper bound on the frames one Process() call can produce for inputFrames (at any speed)
+    unsigned int GetMaxOutputFrames(unsigned int inputFrames) const;
+
+    // Stretch inputFrames frames (at most the reserved count). output must hold
+    // GetMaxOutputFrames(inputFrames) frames. Returns the number of frames written. Never allocates.
+    unsigned int Process(const float* input, unsigned int inputFrames, float* output);
+
+private:
+    TimeStretcher(const TimeStretcher&) = delete;
+    TimeStretcher& operator=(const TimeStretcher&) = delete;
+
+    // Emit every hop the buffered history allows
+    unsigned int Run(float* output);
+
+    // Start of the next window: the continuation when it is in range, else the best match to it
+    unsigned int FindSegment() const;
+
+    // Drop history no future window can start in
+    void Compact();
+
+    unsigned int m_sampleRate;
+    unsigned int m_channels;
+    unsigned int m_hopFrames;       // Output advance per window (half the window)
+    unsigned int m_windowFrames;
+    unsigned int m_searchFrames;    // Search range either side of the nominal position
+    unsigned int m_searchStep;      // Coarse search stride (then refined around the best)
+    double m_speed;
+
+    std::vector<float> m_fadeIn;    // Rising half of the window; the falling half is 1 - m_fadeIn
+
+    // Input history (interleaved); positions below are frame indices into it
+    ArenaBuffer<float> m_history;
+    unsigned int m_capacityFrames;
+    unsigned int m_historyFrames;
+    double m_nominal;               // Where the speed says the next window starts
+    unsigned int m_continuation;    // Where the previous window's second half continues naturally
+    bool m_isPrimed;                // Look-ahead of silence put in (first call of a stream)
+
+    TimeStretchKernels::CorrelateFn m_correlate;
+};
@@ -0,0 +1,127 @@
+#include "TimingHistogram.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace
+{
+    // Index of the highest set bit (value > 0)
+    unsigned int FloorLog2(uint64_t value)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return (unsigned int)index;
+#else
+        return 63u - (unsigned int)__builtin_clzll(value);
+#endif
+    }
+}
+
+TimingHistogram::TimingHistogram()
+{
+    Reset();
+}
+
+unsigned int TimingHistogram::GetBucketIndex(uint64_t value)
+{
+    if (value < 2 * SubBucketCount)
+        return (unsigned int)value;
+
+    const uint64_t maxValue = (1ull << MaxValueBits) - 1;
+    if (value > maxValue)
+        value = maxValue;
+
+    // value >> shift lies in [SubBucketCount, 2 * SubBucketCount)
+    unsigned int shift = FloorLog2(value) - SubBucketBits;
+    return (shift + 1) * SubBucketCount + (unsigned int)(value >> shift) - SubBucketCount;
+}
+
+uint64_t TimingHistogram::GetBucketStart(unsigned int index)
+{
+    if (index < 2 * SubBucketCount)
+        return index;
+    unsigned int shift = index / SubBucketCount - 1;
+    return (uint64_t)(index % SubBucketCount + SubBucketCount) << shift;
+}
+
+uint64_t TimingHistogram::GetBucketWidth(unsigned int index)
+{
+    if (index < 2 * SubBucketCount)
+        return 1;
+    return 1ull << (index / SubBucketCount - 1);
+}
+
+void TimingHistogram::Record(int64_t durationNs)
+{
+    uint64_t value = durationNs > 0 ? (uint64_t)durationNs : 0;
+    m_counts[GetBucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    m_totalNs.fetch_add(value, std::memory_order_relaxed);
+
+    uint64_t max = m_maxNs.load(std::memory_order_relaxed);
+    while (value > max && !m_maxNs.compare_exchange_weak(max, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+void TimingHistogram::Reset()
+{
+    for (unsigned int i = 0; i < BucketCount; i++)
+    {
+        m_counts[i].store(0, std::memory_order_relaxed);
+    }
+    m_totalNs.store(0, std::memory_order_relaxed);
+    m_maxNs.store(0, std::memory_order_relaxed);
+}
+
+double TimingHistogram::GetPercentile(const uint64_t* counts, uint64_t total, double fraction) const
+{
+    // Rank of the sample at this fraction, 1-based
+    uint64_t rank = (uint64_t)(fraction * total + 0.5);
+    if (rank < 1)
+        rank = 1;
+
+    uint64_t seen = 0;
+    for (unsigned int i = 0; i < BucketCount; i++)
+    {
+        seen += counts[i];
+        if (seen >= rank)
+            return GetBucketStart(i) + (GetBucketWidth(i) - 1) * 0.5;
+    }
+    return (double)m_maxNs.load(std::memory_order_relaxed);
+}
+
+TimingHistogram::Summary TimingHistogram::Summarize() const
+{
+    // Work on a copy so all percentiles come from the same counts
+    uint64_t counts[BucketCount];
+    uint64_t total = 0;
+    for (unsigned int i = 0; i < BucketCount; i++)
+    {
+        counts[i] = m_counts[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+
+    Summary summary;
+    summary.count = total;
+    if (total == 0)
+        return summary;
+
+    double maxNs = (double)m_maxNs.load(std::memory_order_relaxed);
+    summary.meanNs = (double)m_totalNs.load(std::memory_order_relaxed) / total;
+    summary.p50Ns = GetPercentile(counts, total, 0.50);
+    summary.p90Ns = GetPercentile(counts, total, 0.90);
+    summary.p99Ns = GetPercentile(counts, total, 0.99);
+    summary.p999Ns = GetPercentile(counts, total, 0.999);
+    summary.maxNs = maxNs;
+
+    // Bucket midpoints can overshoot the largest value actually seen
+    double* percentiles[] = { &summary.p50Ns, &summary.p90Ns, &summary.p99Ns, &summary.p999Ns };
+    for (double* percentile : percentiles)
+    {
+        if (*percentile > maxNs)
+            *percentile = maxNs;
+    }
+    return summary;
+}
@@ -0,0 +1,113 @@
+#include "VirtualClock.h"
+
+VirtualClock::VirtualClock()
+    : m_now(0)
+    , m_endNs(0)
+    , m_waiterCount(1)
+    , m_blockedCount(0)
+    , m_finished(false)
+    , m_interrupted(false)
+    , m_monitorIntervalNs(0)
+    , m_nextMonitorNs(0)
+{
+}
+
+void VirtualClock::Reset(unsigned int waiterCount, long long endNs)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_now.store(0, std::memory_order_release);
+    m_endNs = endNs;
+    m_waiterCount = waiterCount < 1 ? 1 : (waiterCount > MaxWaiters ? MaxWaiters : waiterCount);
+    m_blockedCount = 0;
+    m_finished = false;
+    m_interrupted = false;
+    for (Waiter& waiter : m_waiters)
+        waiter = Waiter();
+    m_nextMonitorNs = m_monitorIntervalNs;
+}
+
+void VirtualClock::SetMonitor(long long intervalNs, std::function<void(long long)> monitor)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_monitorIntervalNs = intervalNs > 0 ? intervalNs : 0;
+    m_nextMonitorNs = m_now.load(std::memory_order_relaxed) + m_monitorIntervalNs;
+    m_monitor = monitor;
+}
+
+BackendWaitResult VirtualClock::WaitUntil(long long wakeNs, unsigned int slot)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_finished || m_interrupted || slot >= m_waiterCount)
+        return BackendWaitResult::Interrupted;
+
+    Waiter& waiter = m_waiters[slot];
+    waiter.wakeNs = wakeNs;
+    waiter.waiting = true;
+    waiter.released = false;
+
+    // The last thread to block moves the clock on; that may well release itself
+    if (++m_blockedCount == m_waiterCount)
+        Advance();
+
+    m_condition.wait(lock, [&] { return waiter.released || m_finished || m_interrupted; });
+    waiter.waiting = false;
+    return waiter.released ? BackendWaitResult::Ready : BackendWaitResult::Interrupted;
+}
+
+void VirtualClock::Advance()
+{
+    Waiter* next = nullptr;
+    for (unsigned int i = 0; i < m_waiterCount; i++)
+    {
+        Waiter& waiter = m_waiters[i];
+        if (waiter.waiting && !waiter.released && (!next || waiter.wakeNs < next->wakeNs))
+            next = &waiter;
+    }
+    if (!next)
+        return;
+
+    const long long now = m_now.load(std::memory_order_relaxed);
+    const long long wakeNs = next->wakeNs > now ? next->wakeNs : now;
+    if (wakeNs > m_endNs)
+    {
+        RunMonitor(m_endNs);
+        m_now.store(m_endNs, std::memory_order_release);
+        m_finished = true;
+        m_condition.notify_all();
+        return;
+    }
+
+    RunMonitor(wakeNs);
+    m_now.store(wakeNs, std::memory_order_release);
+    next->released = true;
+    m_blockedCount--;
+    m_condition.notify_all();
+}
+
+void VirtualClock::RunMonitor(long long timeNs)
+{
+    if (m_monitorIntervalNs <= 0 || !m_monitor)
+        return;
+
+    while (m_nextMonitorNs <= timeNs)
+    {
+        m_now.store(m_nextMonitorNs, std::memory_order_release);
+        m_monitor(m_nextMonitorNs);
+        m_nextMonitorNs += m_monitorIntervalNs;
+    }
+}
+
+void VirtualClock::Interrupt()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_interrupted = true;
+    }
+    m_condition.notify_all();
+}
+
+void VirtualClock::WaitForEnd()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_condition.wait(lock, [this] { return m_finished || m_interrupted; });
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "IAudioBackend.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+// Discrete-event clock for running the engine against simulated devices faster than real time.
+// Time only moves while every thread that waits on it (the engine's audio threads) is blocked in
+// WaitUntil(): it then jumps to the earliest wake-up asked for and releases that one thread.
+// Work between waits takes no virtual time, and which thread runs next depends only on the
+// wake-up times, so a run repeats exactly.
+class VirtualClock
+{
+public:
+    // Most threads that can wait on one clock
+    static const unsigned int MaxWaiters = 4;
+
+    VirtualClock();
+
+    // Start over at time 0 for waiterCount threads; the run ends when time would pass endNs
+    void Reset(unsigned int waiterCount, long long endNs);
+
+    long long Now() const { return m_now.load(std::memory_order_acquire); }
+
+    // Block the calling thread until the clock reaches wakeNs (at once if it has). Each waiting
+    // thread has its own slot below waiterCount; the lower slot goes first on equal wake-ups.
+    // Interrupted once the run is over or Interrupt() was called.
+    BackendWaitResult WaitUntil(long long wakeNs, unsigned int slot);
+
+    // Release every waiter with Interrupted, now and from now on, until Reset()
+    void Interrupt();
+
+    // Call monitor(t) at every multiple t of intervalNs the clock passes, up to the end of the
+    // run, while every waiter is blocked (so it may read what the engine threads write)
+    void SetMonitor(long long intervalNs, std::function<void(long long)> monitor);
+
+    // Block a thread that does not wait on the clock (the one running the simulation) until the
+    // run is over or interrupted
+    void WaitForEnd();
+
+private:
+    struct Waiter
+    {
+        long long wakeNs = 0;
+        bool waiting = false;
+        bool released = false;
+    };
+
+    // Move time to the earliest wake-up and release its waiter (lock held, all waiters blocked)
+    void Advance();
+
+    // Call the monitor for every interval boundary up to timeNs (lock held)
+    void RunMonitor(long long timeNs);
+
+    std::atomic<long long> m_now;
+    long long m_endNs;
+    unsigned int m_waiterCount;
+    unsigned int m_blockedCount;
+    bool m_finished;
+    bool m_interrupted;
+    Waiter m_waiters[MaxWaiters];
+
+    long long m_monitorIntervalNs;
+    long long m_nextMonitorNs;
+    std::function<void(long long)> m_monitor;
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+};
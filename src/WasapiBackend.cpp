@@ -0,0 +1,499 @@
+#include "WasapiBackend.h"
+#include <mmreg.h>
+#include <ks.h>
+#include <ksmedia.h>
+#include <sstream>
+#include <iomanip>
+
+WasapiStream::WasapiStream()
+    : m_pDevice(nullptr)
+    , m_pClient(nullptr)
+    , m_pWaveFormat(nullptr)
+    , m_hEvent(NULL)
+    , m_hInterruptEvent(NULL)
+    , m_bufferFrameCount(0)
+    , m_periodFrameCount(0)
+{
+}
+
+WasapiStream::~WasapiStream()
+{
+    Close();
+}
+
+bool WasapiStream::Open(const std::wstring& deviceId, bool isInput, unsigned int periodMultipleMs)
+{
+    Close();
+
+    // Create device enumerator
+    IMMDeviceEnumerator* pEnumerator = nullptr;
+    HRESULT hr = CoCreateInstance(
+        __uuidof(MMDeviceEnumerator),
+        NULL,
+        CLSCTX_ALL,
+        __uuidof(IMMDeviceEnumerator),
+        (void**)&pEnumerator
+    );
+
+    if (FAILED(hr))
+    {
+        ReportStatus(L"ERROR: Failed to create device enumerator");
+        return false;
+    }
+
+    // Get device
+    if (deviceId == L"DEFAULT")
+    {
+        // Use system default device
+        hr = pEnumerator->GetDefaultAudioEndpoint(
+            isInput ? eCapture : eRender,
+            eConsole,
+            &m_pDevice
+        );
+    }
+    else
+    {
+        // Use specific device ID
+        hr = pEnumerator->GetDevice(deviceId.c_str(), &m_pDevice);
+    }
+    pEnumerator->Release();
+
+    if (FAILED(hr))
+    {
+        ReportError(L"get device", hr);
+        return false;
+    }
+
+    // Activate audio client
+    hr = m_pDevice->Activate(__uuidof(IAudioClient), CLSCTX_ALL, NULL, (void**)&m_pClient);
+    if (FAILED(hr))
+    {
+        ReportError(L"activate audio client", hr);
+        return false;
+    }
+
+    // Get mix format - use whatever WASAPI provides
+    hr = m_pClient->GetMixFormat(&m_pWaveFormat);
+    if (FAILED(hr))
+    {
+        ReportError(L"get mix format", hr);
+        return false;
+    }
+
+    // Detect the sample encoding: float or PCM, and for PCM the container size
+    bool isFloatFormat = false;
+    WORD validBits = m_pWaveFormat->wBitsPerSample;
+    if (m_pWaveFormat->wFormatTag == WAVE_FORMAT_IEEE_FLOAT)
+    {
+        isFloatFormat = true;
+    }
+    else if (m_pWaveFormat->wFormatTag == WAVE_FORMAT_EXTENSIBLE)
+    {
+        // Check the SubFormat GUID for float vs PCM
+        WAVEFORMATEXTENSIBLE* pWaveFormatEx = (WAVEFORMATEXTENSIBLE*)m_pWaveFormat;
+        isFloatFormat = (pWaveFormatEx->SubFormat == KSDATAFORMAT_SUBTYPE_IEEE_FLOAT) != 0;
+        if (pWaveFormatEx->Samples.wValidBitsPerSample != 0)
+            validBits = pWaveFormatEx->Samples.wValidBitsPerSample;
+    }
+
+    // Samples are left justified in their container, so e.g. 24 valid bits in a
+    // 32-bit container read correctly as PCM32
+    switch (m_pWaveFormat->wBitsPerSample)
+    {
+    case 16: m_format.sampleFormat = SampleFormat::PCM16; break;
+    case 24: m_format.sampleFormat = SampleFormat::PCM24; break;
+    case 32: m_format.sampleFormat = isFloatFormat ? SampleFormat::Float32 : SampleFormat::PCM32; break;
+    default:
+        {
+            std::wostringstream msg;
+            msg << L"ERROR: Unsupported device format (" << m_pWaveFormat->wBitsPerSample << L"-bit "
+                << (isFloatFormat ? L"float" : L"PCM") << L")";
+            ReportStatus(msg.str());
+            return false;
+        }
+    }
+    if (isFloatFormat && m_format.sampleFormat != SampleFormat::Float32)
+    {
+        ReportStatus(L"ERROR: Unsupported device format (non 32-bit float)");
+        return false;
+    }
+    if (validBits != m_pWaveFormat->wBitsPerSample)
+    {
+        std::wostringstream msg;
+        msg << L"  " << validBits << L" valid bits in a " << m_pWaveFormat->wBitsPerSample << L"-bit container";
+        ReportStatus(msg.str());
+    }
+
+    m_format.sampleRate = m_pWaveFormat->nSamplesPerSec;
+    m_format.channels = m_pWaveFormat->nChannels;
+
+    // Create events for event-driven mode and for interrupting waits
+    m_hEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    m_hInterruptEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (!m_hEvent || !m_hInterruptEvent)
+    {
+        ReportStatus(L"ERROR: Failed to create event handle");
+        return false;
+    }
+
+    // Initialize audio client with event-driven mode and smaller buffer (10ms for low latency)
+    REFERENCE_TIME hnsRequestedDuration = 100000; // 10ms for low latency
+    DWORD streamFlags = AUDCLNT_STREAMFLAGS_EVENTCALLBACK;
+
+    // A period the caller's frames divide into evenly, if the default is not one already.
+    // Falls back to the default period should the engine refuse it.
+    UINT32 alignedPeriod = periodMultipleMs > 0 ? FindAlignedPeriod(periodMultipleMs) : 0;
+    hr = E_FAIL;
+    IAudioClient3* pClient3 = nullptr;
+    if (alignedPeriod > 0 && SUCCEEDED(m_pClient->QueryInterface(__uuidof(IAudioClient3), (void**)&pClient3)))
+    {
+        hr = pClient3->InitializeSharedAudioStream(streamFlags, alignedPeriod, m_pWaveFormat, NULL);
+        pClient3->Release();
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        std::wostringstream msg;
+        msg << L"  Device period set to " << alignedPeriod << L" frames (a multiple of " << periodMultipleMs << L" ms)";
+        ReportStatus(msg.str());
+    }
+    else
+    {
+        alignedPeriod = 0;
+        hr = m_pClient->Initialize(
+            AUDCLNT_SHAREMODE_SHARED,
+            streamFlags,
+            hnsRequestedDuration,
+            0,
+            m_pWaveFormat,  // Use THIS device's native format
+            NULL
+        );
+    }
+
+    if (FAILED(hr))
+    {
+        ReportError(L"initialize audio client", hr);
+
+        // Common error codes
+        if (hr == AUDCLNT_E_UNSUPPORTED_FORMAT)
+            ReportStatus(L"  Reason: Unsupported format");
+        else if (hr == AUDCLNT_E_ALREADY_INITIALIZED)
+            ReportStatus(L"  Reason: Already initialized");
+        else if (hr == E_INVALIDARG)
+            ReportStatus(L"  Reason: Invalid argument");
+
+        return false;
+    }
+
+    // Set event handle for event-driven mode
+    hr = m_pClient->SetEventHandle(m_hEvent);
+    if (FAILED(hr))
+    {
+        ReportError(L"set event handle", hr);
+        return false;
+    }
+
+    // Get buffer size and device period
+    UINT32 bufferFrameCount = 0;
+    m_pClient->GetBufferSize(&bufferFrameCount);
+    m_bufferFrameCount = bufferFrameCount;
+
+    REFERENCE_TIME defaultPeriod = 0;
+    REFERENCE_TIME minimumPeriod = 0;
+    if (alignedPeriod > 0)
+    {
+        // GetDevicePeriod() keeps reporting the default period
+        m_periodFrameCount = alignedPeriod;
+    }
+    else if (SUCCEEDED(m_pClient->GetDevicePeriod(&defaultPeriod, &minimumPeriod)) && defaultPeriod > 0)
+    {
+        m_periodFrameCount = (unsigned int)((defaultPeriod * m_format.sampleRate + 5000000) / 10000000);
+    }
+    else
+    {
+        m_periodFrameCount = m_format.sampleRate / 100;
+    }
+
+    return true;
+}
+
+UINT32 WasapiStream::FindAlignedPeriod(unsigned int periodMultipleMs)
+{
+    IAudioClient3* pClient3 = nullptr;
+    if (FAILED(m_pClient->QueryInterface(__uuidof(IAudioClient3), (void**)&pClient3)))
+        return 0;
+
+    UINT32 defaultPeriod = 0, fundamentalPeriod = 0, minPeriod = 0, maxPeriod = 0;
+    HRESULT hr = pClient3->GetSharedModeEnginePeriod(m_pWaveFormat, &defaultPeriod, &fundamentalPeriod, &minPeriod, &maxPeriod);
+    pClient3->Release();
+    if (FAILED(hr) || fundamentalPeriod == 0)
+        return 0;
+
+    const UINT32 multiple = m_pWaveFormat->nSamplesPerSec * periodMultipleMs / 1000;
+    if (multiple == 0 || defaultPeriod % multiple == 0)
+        return 0;
+
+    // Supported periods are minPeriod plus whole fundamental periods, up to maxPeriod
+    for (UINT32 period = multiple; period <= maxPeriod; period += multiple)
+    {
+        if (period >= minPeriod && (period - minPeriod) % fundamentalPeriod == 0)
+            return period;
+    }
+    return 0;
+}
+
+void WasapiStream::Close()
+{
+    if (m_pClient)
+    {
+        m_pClient->Stop();
+        m_pClient->Release();
+        m_pClient = nullptr;
+    }
+
+    if (m_pDevice)
+    {
+        m_pDevice->Release();
+        m_pDevice = nullptr;
+    }
+
+    if (m_pWaveFormat)
+    {
+        CoTaskMemFree(m_pWaveFormat);
+        m_pWaveFormat = nullptr;
+    }
+
+    if (m_hEvent)
+    {
+        CloseHandle(m_hEvent);
+        m_hEvent = NULL;
+    }
+
+    if (m_hInterruptEvent)
+    {
+        CloseHandle(m_hInterruptEvent);
+        m_hInterruptEvent = NULL;
+    }
+
+    m_bufferFrameCount = 0;
+    m_periodFrameCount = 0;
+}
+
+bool WasapiStream::Start()
+{
+    if (!m_pClient)
+        return false;
+
+    ResetEvent(m_hInterruptEvent);
+    HRESULT hr = m_pClient->Start();
+    if (FAILED(hr))
+    {
+        ReportError(L"start audio client", hr);
+        return false;
+    }
+    return true;
+}
+
+void WasapiStream::Stop()
+{
+    if (m_pClient)
+        m_pClient->Stop();
+}
+
+BackendWaitResult WasapiStream::WaitForEvent(unsigned int timeoutMs)
+{
+    HANDLE waitArray[2] = { m_hInterruptEvent, m_hEvent };
+    DWORD waitResult = WaitForMultipleObjects(2, waitArray, FALSE, timeoutMs);
+
+    if (waitResult == WAIT_OBJECT_0)
+        return BackendWaitResult::Interrupted;
+    if (waitResult == WAIT_OBJECT_0 + 1)
+        return BackendWaitResult::Ready;
+    if (waitResult == WAIT_TIMEOUT)
+        return BackendWaitResult::Timeout;
+    return BackendWaitResult::Error;
+}
+
+void WasapiStream::Interrupt()
+{
+    if (m_hInterruptEvent)
+        SetEvent(m_hInterruptEvent);
+}
+
+void WasapiStream::ReportStatus(const std::wstring& status)
+{
+    if (m_diagnosticCallback)
+    {
+        m_diagnosticCallback(status);
+    }
+}
+
+void WasapiStream::ReportError(const wchar_t* what, HRESULT hr)
+{
+    std::wostringstream msg;
+    msg << L"ERROR: Failed to " << what << L" (HRESULT: 0x" << std::hex << hr << L")";
+    ReportStatus(msg.str());
+}
+
+//
+// Capture
+//
+
+WasapiCaptureBackend::WasapiCaptureBackend()
+    : m_pCaptureClient(nullptr)
+{
+}
+
+WasapiCaptureBackend::~WasapiCaptureBackend()
+{
+    if (m_pCaptureClient)
+    {
+        m_pCaptureClient->Release();
+        m_pCaptureClient = nullptr;
+    }
+}
+
+bool WasapiCaptureBackend::Open(const std::wstring& deviceId, unsigned int periodMultipleMs)
+{
+    if (!m_stream.Open(deviceId, true, periodMultipleMs))
+        return false;
+
+    HRESULT hr = m_stream.GetClient()->GetService(__uuidof(IAudioCaptureClient), (void**)&m_pCaptureClient);
+    if (FAILED(hr))
+    {
+        m_stream.ReportError(L"get capture client", hr);
+        return false;
+    }
+    return true;
+}
+
+bool WasapiCaptureBackend::GetBuffer(const void** data, unsigned int* frameCount, unsigned int* flags)
+{
+    BYTE* pData = nullptr;
+    UINT32 numFramesAvailable = 0;
+    DWORD bufferFlags = 0;
+
+    *data = nullptr;
+    *frameCount = 0;
+    *flags = AudioBufferFlag_None;
+
+    HRESULT hr = m_pCaptureClient->GetBuffer(&pData, &numFramesAvailable, &bufferFlags, NULL, NULL);
+    if (hr == AUDCLNT_S_BUFFER_EMPTY)
+        return true;
+    if (FAILED(hr))
+        return false;
+
+    *data = pData;
+    *frameCount = numFramesAvailable;
+    if (bufferFlags & AUDCLNT_BUFFERFLAGS_SILENT)
+        *flags |= AudioBufferFlag_Silent;
+    if (bufferFlags & AUDCLNT_BUFFERFLAGS_DATA_DISCONTINUITY)
+        *flags |= AudioBufferFlag_Discontinuity;
+    return true;
+}
+
+void WasapiCaptureBackend::ReleaseBuffer(unsigned int frameCount)
+{
+    m_pCaptureClient->ReleaseBuffer(frameCount);
+}
+
+bool WasapiCaptureBackend::GetNextPacketSize(unsigned int* frameCount)
+{
+    UINT32 packetFrames = 0;
+    HRESULT hr = m_pCaptureClient->GetNextPacketSize(&packetFrames);
+    *frameCount = SUCCEEDED(hr) ? packetFrames : 0;
+    return SUCCEEDED(hr);
+}
+
+//
+// Render
+//
+
+WasapiRenderBackend::WasapiRenderBackend()
+    : m_pRenderClient(nullptr)
+    , m_pClock(nullptr)
+    , m_clockFrequency(0)
+{
+}
+
+WasapiRenderBackend::~WasapiRenderBackend()
+{
+    if (m_pClock)
+    {
+        m_pClock->Release();
+        m_pClock = nullptr;
+    }
+    if (m_pRenderClient)
+    {
+        m_pRenderClient->Release();
+        m_pRenderClient = nullptr;
+    }
+}
+
+bool WasapiRenderBackend::Open(const std::wstring& deviceId)
+{
+    if (!m_stream.Open(deviceId, false))
+        return false;
+
+    HRESULT hr = m_stream.GetClient()->GetService(__uuidof(IAudioRenderClient), (void**)&m_pRenderClient);
+    if (FAILED(hr))
+    {
+        m_stream.ReportError(L"get render client", hr);
+        return false;
+    }
+
+    // Optional: without a position the engine goes by the padding alone
+    if (FAILED(m_stream.GetClient()->GetService(__uuidof(IAudioClock), (void**)&m_pClock)) ||
+        FAILED(m_pClock->GetFrequency(&m_clockFrequency)) || m_clockFrequency == 0)
+    {
+        if (m_pClock)
+        {
+            m_pClock->Release();
+            m_pClock = nullptr;
+        }
+    }
+    return true;
+}
+
+bool WasapiRenderBackend::GetCurrentPadding(unsigned int* paddingFrames)
+{
+    UINT32 numFramesPadding = 0;
+    HRESULT hr = m_stream.GetClient()->GetCurrentPadding(&numFramesPadding);
+    *paddingFrames = numFramesPadding;
+    return SUCCEEDED(hr);
+}
+
+bool WasapiRenderBackend::GetPlayedFrames(uint64_t* playedFrames)
+{
+    if (!m_pClock)
+        return false;
+
+    UINT64 position = 0;
+    UINT64 positionTime = 0;
+    if (FAILED(m_pClock->GetPosition(&position, &positionTime)))
+        return false;
+
+    // The position is as of positionTime (100 ns units of the performance counter); carry it on to now
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    const double nowTime = (double)counter.QuadPart * 1e7 / (double)frequency.QuadPart;
+    const double sinceSeconds = nowTime > (double)positionTime ? (nowTime - (double)positionTime) * 1e-7 : 0.0;
+
+    const double sampleRate = (double)m_stream.GetFormat().sampleRate;
+    *playedFrames = (uint64_t)((double)position * sampleRate / (double)m_clockFrequency + sinceSeconds * sampleRate);
+    return true;
+}
+
+bool WasapiRenderBackend::GetBuffer(unsigned int frameCount, void** data)
+{
+    BYTE* pRenderData = nullptr;
+    HRESULT hr = m_pRenderClient->GetBuffer(frameCount, &pRenderData);
+    *data = pRenderData;
+    return SUCCEEDED(hr);
+}
+
+void WasapiRenderBackend::ReleaseBuffer(unsigned int frameCount, unsigned int flags)
+{
+    m_pRenderClient->ReleaseBuffer(frameCount, (flags & AudioBufferFlag_Silent) ? AUDCLNT_BUFFERFLAGS_SILENT : 0);
+}
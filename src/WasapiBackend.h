@@ -0,0 +1,114 @@
+#pragma once
+
+#include <windows.h>
+#include <audioclient.h>
+#include <mmdeviceapi.h>
+#include "IAudioBackend.h"
+
+// Shared-mode, event-driven WASAPI endpoint used by both backend directions
+class WasapiStream
+{
+public:
+    WasapiStream();
+    ~WasapiStream();
+
+    // Open the endpoint ("DEFAULT" = system default) in its mix format. With periodMultipleMs,
+    // prefer an engine period that is a whole number of that many milliseconds.
+    bool Open(const std::wstring& deviceId, bool isInput, unsigned int periodMultipleMs = 0);
+    void Close();
+
+    bool Start();
+    void Stop();
+    BackendWaitResult WaitForEvent(unsigned int timeoutMs);
+    void Interrupt();
+
+    IAudioClient* GetClient() const { return m_pClient; }
+    const AudioFormat& GetFormat() const { return m_format; }
+    unsigned int GetBufferFrameCount() const { return m_bufferFrameCount; }
+    unsigned int GetPeriodFrameCount() const { return m_periodFrameCount; }
+
+    void SetDiagnosticCallback(std::function<void(const std::wstring&)> callback) { m_diagnosticCallback = callback; }
+
+    // Helpers to report status
+    void ReportStatus(const std::wstring& status);
+    void ReportError(const wchar_t* what, HRESULT hr);
+
+private:
+    // Shared-mode period (IAudioClient3, Windows 10+) that is a multiple of periodMultipleMs,
+    // or 0 when the default period already is one or the engine offers none
+    UINT32 FindAlignedPeriod(unsigned int periodMultipleMs);
+
+    IMMDevice* m_pDevice;
+    IAudioClient* m_pClient;
+    WAVEFORMATEX* m_pWaveFormat;
+    HANDLE m_hEvent;
+    HANDLE m_hInterruptEvent;
+    AudioFormat m_format;
+    unsigned int m_bufferFrameCount;
+    unsigned int m_periodFrameCount;
+
+    std::function<void(const std::wstring&)> m_diagnosticCallback;
+};
+
+class WasapiCaptureBackend : public IAudioCaptureBackend
+{
+public:
+    WasapiCaptureBackend();
+    ~WasapiCaptureBackend() override;
+
+    // periodMultipleMs: prefer device periods that are whole multiples of this many
+    // milliseconds, so packets line up with a noise processor's frames (0 = device default)
+    bool Open(const std::wstring& deviceId, unsigned int periodMultipleMs = 0);
+
+    // IAudioBackend interface
+    const AudioFormat& GetFormat() const override { return m_stream.GetFormat(); }
+    unsigned int GetBufferFrameCount() const override { return m_stream.GetBufferFrameCount(); }
+    unsigned int GetPeriodFrameCount() const override { return m_stream.GetPeriodFrameCount(); }
+    bool Start() override { return m_stream.Start(); }
+    void Stop() override { m_stream.Stop(); }
+    BackendWaitResult WaitForEvent(unsigned int timeoutMs) override { return m_stream.WaitForEvent(timeoutMs); }
+    void Interrupt() override { m_stream.Interrupt(); }
+    const wchar_t* GetName() const override { return L"WASAPI Capture"; }
+    void SetDiagnosticCallback(std::function<void(const std::wstring&)> callback) override { m_stream.SetDiagnosticCallback(callback); }
+
+    // IAudioCaptureBackend interface
+    bool GetBuffer(const void** data, unsigned int* frameCount, unsigned int* flags) override;
+    void ReleaseBuffer(unsigned int frameCount) override;
+    bool GetNextPacketSize(unsigned int* frameCount) override;
+
+private:
+    WasapiStream m_stream;
+    IAudioCaptureClient* m_pCaptureClient;
+};
+
+class WasapiRenderBackend : public IAudioRenderBackend
+{
+public:
+    WasapiRenderBackend();
+    ~WasapiRenderBackend() override;
+
+    bool Open(const std::wstring& deviceId);
+
+    // IAudioBackend interface
+    const AudioFormat& GetFormat() const override { return m_stream.GetFormat(); }
+    unsigned int GetBufferFrameCount() const override { return m_stream.GetBufferFrameCount(); }
+    unsigned int GetPeriodFrameCount() const override { return m_stream.GetPeriodFrameCount(); }
+    bool Start() override { return m_stream.Start(); }
+    void Stop() override { m_stream.Stop(); }
+    BackendWaitResult WaitForEvent(unsigned int timeoutMs) override { return m_stream.WaitForEvent(timeoutMs); }
+    void Interrupt() override { m_stream.Interrupt(); }
+    const wchar_t* GetName() const override { return L"WASAPI Render"; }
+    void SetDiagnosticCallback(std::function<void(const std::wstring&)> callback) override { m_stream.SetDiagnosticCallback(callback); }
+
+    // IAudioRenderBackend interface
+    bool GetCurrentPadding(unsigned int* paddingFrames) override;
+    bool GetPlayedFrames(uint64_t* playedFrames) override;
+    bool GetBuffer(unsigned int frameCount, void** data) override;
+    void ReleaseBuffer(unsigned int frameCount, unsigned int flags) override;
+
+private:
+    WasapiStream m_stream;
+    IAudioRenderClient* m_pRenderClient;
+    IAudioClock* m_pClock;              // Play position (null when the endpoint offers none)
+    UINT64 m_clockFrequency;            // Position units per second
+};
@@ -0,0 +1,320 @@
+#include "WavFile.h"
+#include <cstring>
+
+namespace
+{
+    const uint16_t WAV_FORMAT_PCM = 0x0001;
+    const uint16_t WAV_FORMAT_IEEE_FLOAT = 0x0003;
+    const uint16_t WAV_FORMAT_EXTENSIBLE = 0xFFFE;
+    const uint32_t WAV_HEADER_SIZE = 44;    // What WavWriter writes: RIFF, 16-byte fmt and data headers
+
+    uint16_t ReadLE16(const unsigned char* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+    uint32_t ReadLE32(const unsigned char* p) { return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24); }
+
+    void WriteLE16(unsigned char* p, uint16_t v) { p[0] = (unsigned char)v; p[1] = (unsigned char)(v >> 8); }
+    void WriteLE32(unsigned char* p, uint32_t v) { for (int i = 0; i < 4; i++) p[i] = (unsigned char)(v >> (8 * i)); }
+
+    int SeekTo(std::FILE* file, uint64_t offset)
+    {
+#ifdef _WIN32
+        return _fseeki64(file, (long long)offset, SEEK_SET);
+#else
+        return fseeko(file, (off_t)offset, SEEK_SET);
+#endif
+    }
+}
+
+//
+// WavReader
+//
+
+WavReader::WavReader()
+    : m_file(nullptr)
+    , m_dataOffset(0)
+    , m_frameCount(0)
+    , m_framePosition(0)
+{
+}
+
+WavReader::~WavReader()
+{
+    Close();
+}
+
+bool WavReader::Open(const std::string& path)
+{
+    Close();
+
+    m_file = std::fopen(path.c_str(), "rb");
+    if (!m_file)
+    {
+        m_error = "cannot open file";
+        return false;
+    }
+    m_path = path;
+
+    unsigned char riff[12];
+    if (std::fread(riff, 1, sizeof(riff), m_file) != sizeof(riff) ||
+        std::memcmp(riff, "RIFF", 4) != 0 || std::memcmp(riff + 8, "WAVE", 4) != 0)
+    {
+        m_error = "not a RIFF/WAVE file";
+        Close();
+        return false;
+    }
+
+    bool haveFormat = false;
+    uint64_t offset = sizeof(riff);
+
+    // Walk chunks until the data chunk
+    for (;;)
+    {
+        unsigned char chunkHeader[8];
+        if (std::fread(chunkHeader, 1, sizeof(chunkHeader), m_file) != sizeof(chunkHeader))
+        {
+            m_error = "no data chunk";
+            Close();
+            return false;
+        }
+        uint32_t chunkSize = ReadLE32(chunkHeader + 4);
+        offset += sizeof(chunkHeader);
+
+        if (std::memcmp(chunkHeader, "fmt ", 4) == 0)
+        {
+            unsigned char fmt[40] = {};
+            uint32_t toRead = chunkSize < sizeof(fmt) ? chunkSize : (uint32_t)sizeof(fmt);
+            if (chunkSize < 16 || std::fread(fmt, 1, toRead, m_file) != toRead)
+            {
+                m_error = "truncated fmt chunk";
+                Close();
+                return false;
+            }
+
+            uint16_t formatTag = ReadLE16(fmt);
+            uint16_t channels = ReadLE16(fmt + 2);
+            uint32_t sampleRate = ReadLE32(fmt + 4);
+            uint16_t bitsPerSample = ReadLE16(fmt + 14);
+
+            // For WAVE_FORMAT_EXTENSIBLE the real tag is the first two bytes of the SubFormat GUID
+            if (formatTag == WAV_FORMAT_EXTENSIBLE && toRead >= 26)
+                formatTag = ReadLE16(fmt + 24);
+
+            if (formatTag == WAV_FORMAT_IEEE_FLOAT && bitsPerSample == 32)
+                m_format.sampleFormat = SampleFormat::Float32;
+            else if (formatTag == WAV_FORMAT_PCM && bitsPerSample == 16)
+                m_format.sampleFormat = SampleFormat::PCM16;
+            else if (formatTag == WAV_FORMAT_PCM && bitsPerSample == 24)
+                m_format.sampleFormat = SampleFormat::PCM24;
+            else if (formatTag == WAV_FORMAT_PCM && bitsPerSample == 32)
+                m_format.sampleFormat = SampleFormat::PCM32;
+            else
+            {
+                m_error = "unsupported sample format (need PCM16/24/32 or Float32)";
+                Close();
+                return false;
+            }
+
+            m_format.sampleRate = sampleRate;
+            m_format.channels = channels;
+            haveFormat = (channels > 0 && sampleRate > 0);
+        }
+        else if (std::memcmp(chunkHeader, "data", 4) == 0)
+        {
+            if (!haveFormat)
+            {
+                m_error = "data chunk before fmt chunk";
+                Close();
+                return false;
+            }
+            m_dataOffset = offset;
+            m_frameCount = chunkSize / m_format.getBlockAlign();
+            m_framePosition = 0;
+            return SeekTo(m_file, m_dataOffset) == 0;
+        }
+
+        // Chunks are word aligned
+        offset += chunkSize + (chunkSize & 1);
+        if (SeekTo(m_file, offset) != 0)
+        {
+            m_error = "truncated file";
+            Close();
+            return false;
+        }
+    }
+}
+
+void WavReader::Close()
+{
+    if (m_file)
+    {
+        std::fclose(m_file);
+        m_file = nullptr;
+    }
+    m_mapping.Close();
+    m_frameCount = 0;
+    m_framePosition = 0;
+}
+
+unsigned int WavReader::Read(void* data, unsigned int frameCount)
+{
+    if (!m_file)
+        return 0;
+
+    if (IsMapped())
+    {
+        unsigned int framesRead = 0;
+        const void* frames = ReadMapped(frameCount, &framesRead);
+        if (framesRead > 0)
+            std::memcpy(data, frames, (size_t)framesRead * m_format.getBlockAlign());
+        return framesRead;
+    }
+
+    uint64_t remaining = GetFramesRemaining();
+    if (frameCount > remaining)
+        frameCount = (unsigned int)remaining;
+
+    size_t framesRead = std::fread(data, m_format.getBlockAlign(), frameCount, m_file);
+    m_framePosition += framesRead;
+    return (unsigned int)framesRead;
+}
+
+bool WavReader::Map()
+{
+    if (!m_file)
+        return false;
+    if (IsMapped())
+        return true;
+    if (!m_mapping.Open(m_path) || m_mapping.GetSize() < m_dataOffset)
+    {
+        m_mapping.Close();
+        return false;
+    }
+
+    // Recordings cut short leave a data chunk that claims more than the file holds
+    uint64_t framesInFile = (m_mapping.GetSize() - m_dataOffset) / m_format.getBlockAlign();
+    if (m_frameCount > framesInFile)
+        m_frameCount = framesInFile;
+    if (m_framePosition > m_frameCount)
+        m_framePosition = m_frameCount;
+    return true;
+}
+
+const void* WavReader::ReadMapped(unsigned int frameCount, unsigned int* framesRead)
+{
+    *framesRead = 0;
+    if (!IsMapped())
+        return nullptr;
+
+    uint64_t remaining = GetFramesRemaining();
+    if (frameCount > remaining)
+        frameCount = (unsigned int)remaining;
+    if (frameCount == 0)
+        return nullptr;
+
+    const unsigned char* frames = m_mapping.GetData() + m_dataOffset + m_framePosition * m_format.getBlockAlign();
+    m_framePosition += frameCount;
+    *framesRead = frameCount;
+    return frames;
+}
+
+bool WavReader::Rewind()
+{
+    return Seek(0);
+}
+
+bool WavReader::Seek(uint64_t frame)
+{
+    if (!m_file)
+        return false;
+    if (frame > m_frameCount)
+        frame = m_frameCount;
+    if (!IsMapped() && SeekTo(m_file, m_dataOffset + frame * m_format.getBlockAlign()) != 0)
+        return false;
+    m_framePosition = frame;
+    return true;
+}
+
+//
+// WavWriter
+//
+
+WavWriter::WavWriter()
+    : m_file(nullptr)
+    , m_frameCount(0)
+{
+}
+
+WavWriter::~WavWriter()
+{
+    Close();
+}
+
+bool WavWriter::Open(const std::string& path, const AudioFormat& format)
+{
+    Close();
+
+    m_file = std::fopen(path.c_str(), "wb");
+    if (!m_file)
+        return false;
+
+    m_format = format;
+    m_frameCount = 0;
+    WriteHeader();
+    return true;
+}
+
+void WavWriter::Close()
+{
+    if (m_file)
+    {
+        // Patch sizes now that they are known
+        SeekTo(m_file, 0);
+        WriteHeader();
+        std::fclose(m_file);
+        m_file = nullptr;
+    }
+}
+
+bool WavWriter::Write(const void* data, unsigned int frameCount)
+{
+    if (!m_file)
+        return false;
+
+    size_t written = std::fwrite(data, m_format.getBlockAlign(), frameCount, m_file);
+    m_frameCount += written;
+    return written == frameCount;
+}
+
+bool WavWriter::WriteAt(uint64_t frame, const void* data, unsigned int frameCount)
+{
+    const uint32_t blockAlign = m_format.getBlockAlign();
+    if (!m_file || SeekTo(m_file, WAV_HEADER_SIZE + frame * blockAlign) != 0)
+        return false;
+
+    size_t written = std::fwrite(data, blockAlign, frameCount, m_file);
+    if (frame + written > m_frameCount)
+        m_frameCount = frame + written;
+    SeekTo(m_file, WAV_HEADER_SIZE + m_frameCount * blockAlign);
+    return written == frameCount;
+}
+
+void WavWriter::WriteHeader()
+{
+    const uint32_t blockAlign = m_format.getBlockAlign();
+    const uint32_t dataSize = (uint32_t)(m_frameCount * blockAlign);
+
+    unsigned char header[WAV_HEADER_SIZE];
+    std::memcpy(header, "RIFF", 4);
+    WriteLE32(header + 4, 36 + dataSize);
+    std::memcpy(header + 8, "WAVEfmt ", 8);
+    WriteLE32(header + 16, 16);
+    WriteLE16(header + 20, m_format.isFloat() ? WAV_FORMAT_IEEE_FLOAT : WAV_FORMAT_PCM);
+    WriteLE16(header + 22, (uint16_t)m_format.channels);
+    WriteLE32(header + 24, m_format.sampleRate);
+    WriteLE32(header + 28, m_format.sampleRate * blockAlign);
+    WriteLE16(header + 32, (uint16_t)blockAlign);
+    WriteLE16(header + 34, (uint16_t)(m_format.getBytesPerSample() * 8));
+    std::memcpy(header + 36, "data", 4);
+    WriteLE32(header + 40, dataSize);
+
+    std::fwrite(header, 1, sizeof(header), m_file);
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "AudioFormat.h"
+#include "MappedFile.h"
+#include <cstdio>
+#include <cstdint>
+#include <string>
+
+// Minimal streaming RIFF/WAVE reader (PCM16/24/32 and IEEE float, including WAVE_FORMAT_EXTENSIBLE)
+class WavReader
+{
+public:
+    WavReader();
+    ~WavReader();
+
+    bool Open(const std::string& path);
+    void Close();
+    bool IsOpen() const { return m_file != nullptr; }
+
+    const AudioFormat& GetFormat() const { return m_format; }
+
+    // Total number of frames in the data chunk
+    uint64_t GetFrameCount() const { return m_frameCount; }
+
+    // Frames not read yet
+    uint64_t GetFramesRemaining() const { return m_frameCount - m_framePosition; }
+
+    // Read up to frameCount frames in the file's own format. Returns frames read.
+    unsigned int Read(void* data, unsigned int frameCount);
+
+    // Map the file into memory (after Open()) so ReadMapped() can hand out frames without a copy.
+    // Returns false where mapping fails; Read() works either way.
+    bool Map();
+    bool IsMapped() const { return m_mapping.IsOpen(); }
+
+    // Up to frameCount frames straight from the mapping, advancing like Read(); valid until
+    // Close(). Returns null (and 0 frames) when the file is not mapped or fully read.
+    const void* ReadMapped(unsigned int frameCount, unsigned int* framesRead);
+
+    // Seek back to the first frame
+    bool Rewind();
+
+    // Continue reading at frame (clamped to the end)
+    bool Seek(uint64_t frame);
+
+    // Human readable description of the last Open() failure
+    const std::string& GetError() const { return m_error; }
+
+private:
+    std::FILE* m_file;
+    MappedFile m_mapping;
+    std::string m_path;
+    AudioFormat m_format;
+    uint64_t m_dataOffset;
+    uint64_t m_frameCount;
+    uint64_t m_framePosition;
+    std::string m_error;
+};
+
+// Streaming RIFF/WAVE writer. The header is patched with the final sizes on Close().
+class WavWriter
+{
+public:
+    WavWriter();
+    ~WavWriter();
+
+    bool Open(const std::string& path, const AudioFormat& format);
+    void Close();
+    bool IsOpen() const { return m_file != nullptr; }
+
+    const AudioFormat& GetFormat() const { return m_format; }
+    uint64_t GetFrameCount() const { return m_frameCount; }
+
+    // Append frameCount frames in the writer's format
+    bool Write(const void* data, unsigned int frameCount);
+
+    // Write frameCount frames starting at frame, which may be past the end (the gap reads as
+    // silence once filled by the file system). Later Write() calls append after the last frame.
+    bool WriteAt(uint64_t frame, const void* data, unsigned int frameCount);
+
+private:
+    void WriteHeader();
+
+    std::FILE* m_file;
+    AudioFormat m_format;
+    uint64_t m_frameCount;
+};
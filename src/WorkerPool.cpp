@@ -0,0 +1,164 @@
+#include "WorkerPool.h"
+#include "RealtimeCheck.h"
+#include "ThreadPriority.h"
+#include <chrono>
+#include <system_error>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <emmintrin.h>
+#define AUDIOROUTER_CPU_RELAX() _mm_pause()
+#else
+#define AUDIOROUTER_CPU_RELAX() std::this_thread::yield()
+#endif
+
+namespace
+{
+    // How long an idle worker keeps polling for the next job before it goes to sleep: long
+    // enough to cover the gap between the stages of one callback, far shorter than a period
+    const long long IdleSpinNs = 100000;
+
+    long long SteadyNowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    uint32_t GetJob(uint64_t claim)
+    {
+        return (uint32_t)(claim >> 32);
+    }
+}
+
+WorkerPool::WorkerPool()
+    : m_claim(0)
+    , m_task(nullptr)
+    , m_context(nullptr)
+    , m_taskCount(0)
+    , m_pending(0)
+    , m_sleepers(0)
+    , m_stop(false)
+{
+}
+
+WorkerPool::~WorkerPool()
+{
+    Stop();
+}
+
+bool WorkerPool::Start(unsigned int workerCount)
+{
+    Stop();
+    m_stop = false;
+    try
+    {
+        for (unsigned int i = 0; i < workerCount; i++)
+            m_threads.emplace_back(&WorkerPool::WorkerThread, this, i + 1);
+    }
+    catch (const std::system_error&)
+    {
+        Stop();
+        return false;
+    }
+    return true;
+}
+
+void WorkerPool::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for (std::thread& thread : m_threads)
+    {
+        if (thread.joinable())
+            thread.join();
+    }
+    m_threads.clear();
+}
+
+void WorkerPool::Run(TaskFn task, void* context, unsigned int taskCount)
+{
+    if (taskCount == 0)
+        return;
+
+    if (m_threads.empty())
+    {
+        for (unsigned int i = 0; i < taskCount; i++)
+            task(context, i);
+        return;
+    }
+
+    // Publish the job, then wake whoever went to sleep since the last one
+    m_task.store(task, std::memory_order_relaxed);
+    m_context.store(context, std::memory_order_relaxed);
+    m_taskCount.store(taskCount, std::memory_order_relaxed);
+    m_pending.store(taskCount, std::memory_order_relaxed);
+    uint32_t job = GetJob(m_claim.load(std::memory_order_relaxed)) + 1;
+    m_claim.store((uint64_t)job << 32);
+    if (m_sleepers.load() > 0)
+    {
+        // Taking the lock orders the notification after a sleeper's check of the job
+        {
+            std::lock_guard<std::mutex> lock(m_wakeMutex);
+        }
+        m_wake.notify_all();
+    }
+
+    WorkOn(job);
+
+    // Barrier: the last tasks may still be running on the workers
+    while (m_pending.load(std::memory_order_acquire) != 0)
+        AUDIOROUTER_CPU_RELAX();
+}
+
+void WorkerPool::WorkOn(uint32_t job)
+{
+    for (;;)
+    {
+        uint64_t claim = m_claim.load(std::memory_order_acquire);
+        if (GetJob(claim) != job)
+            return;
+
+        unsigned int index = (unsigned int)(claim & 0xFFFFFFFFu);
+        if (index >= m_taskCount.load(std::memory_order_relaxed))
+            return;
+        if (!m_claim.compare_exchange_weak(claim, claim + 1, std::memory_order_acq_rel))
+            continue;
+
+        m_task.load(std::memory_order_relaxed)(m_context.load(std::memory_order_relaxed), index);
+        m_pending.fetch_sub(1, std::memory_order_acq_rel);
+    }
+}
+
+void WorkerPool::WorkerThread(unsigned int core)
+{
+    ScopedAudioThreadPriority priority;
+    PinCurrentThread(core);
+
+    uint32_t seen = GetJob(m_claim.load(std::memory_order_acquire));
+    while (!m_stop.load(std::memory_order_relaxed))
+    {
+        // Poll for a while, then sleep until Run() or Stop() wakes us
+        long long spinUntil = SteadyNowNs() + IdleSpinNs;
+        uint32_t job = GetJob(m_claim.load(std::memory_order_acquire));
+        while (job == seen && !m_stop.load(std::memory_order_relaxed) && SteadyNowNs() < spinUntil)
+        {
+            AUDIOROUTER_CPU_RELAX();
+            job = GetJob(m_claim.load(std::memory_order_acquire));
+        }
+
+        if (job == seen)
+        {
+            std::unique_lock<std::mutex> lock(m_wakeMutex);
+            m_sleepers.fetch_add(1);
+            m_wake.wait(lock, [&] { return m_stop.load() || GetJob(m_claim.load()) != seen; });
+            m_sleepers.fetch_sub(1);
+            continue;
+        }
+
+        seen = job;
+        ScopedRealtimeSection realtime;
+        WorkOn(job);
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small pool of audio-priority threads, each pinned to its own core, that an audio thread can
+// fan a block of independent tasks out to and wait for (a fork-join barrier per Run()).
+//
+// Run() never allocates or blocks on a lock while the workers are awake: tasks are claimed from
+// a lock-free counter, the calling thread works through them too, and it spins until the last
+// one finishes. Idle workers spin briefly after each job, so back-to-back callbacks find them
+// awake, and then sleep until the next one.
+class WorkerPool
+{
+public:
+    typedef void (*TaskFn)(void* context, unsigned int task);
+
+    WorkerPool();
+    ~WorkerPool();
+
+    // Start workerCount threads (pinned to cores 1..workerCount, leaving core 0 to the rest of the
+    // system). Returns false if the threads cannot be created.
+    bool Start(unsigned int workerCount);
+    void Stop();
+
+    unsigned int GetWorkerCount() const { return (unsigned int)m_threads.size(); }
+
+    // Run task(context, i) for every i below taskCount on the workers and the calling thread,
+    // and return once all have finished. Only one thread may call Run() at a time.
+    void Run(TaskFn task, void* context, unsigned int taskCount);
+
+private:
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void WorkerThread(unsigned int core);
+
+    // Claim and run tasks of the given job until none are left
+    void WorkOn(uint32_t job);
+
+    // Current job: generation in the high half, next unclaimed task in the low half, so a worker
+    // still finishing an old job can never claim a task of the next one
+    std::atomic<uint64_t> m_claim;
+    std::atomic<TaskFn> m_task;
+    std::atomic<void*> m_context;
+    std::atomic<unsigned int> m_taskCount;
+    std::atomic<unsigned int> m_pending;    // Tasks of the current job not finished yet
+
+    std::vector<std::thread> m_threads;
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wake;
+    std::atomic<unsigned int> m_sleepers;
+    std::atomic<bool> m_stop;
+};
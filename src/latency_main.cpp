@@ -0,0 +1,405 @@
+// audiorouter-latency: measures the input-to-output delay of the routing engine between loopback
+// devices, for every combination of the settings given, and shows where it comes from.
+//
+//   audiorouter-latency [options]
+//
+// Each configuration runs in real time (about settle + bursts * interval, 5 s by default); the
+// results are listed lowest latency first.
+
+#include "LatencyProbe.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    struct Measurement
+    {
+        std::string label;
+        LatencyProbeConfig config;
+        LatencyProbeResult result;
+    };
+
+    std::string Narrow(const std::wstring& text)
+    {
+        std::string result;
+        for (wchar_t c : text)
+            result += (c < 0x80) ? (char)c : '?';
+        return result;
+    }
+
+    void PrintUsage()
+    {
+        std::printf(
+            "Usage: audiorouter-latency [options]\n"
+            "\n"
+            "Runs the engine between a loopback capture device that sends bursts and a render\n"
+            "device that records them, and times the bursts by cross-correlation. Options that take\n"
+            "a list (comma separated) are swept: every combination is measured.\n"
+            "\n"
+            "Devices:\n"
+            "  --periods <list>          Period sizes in frames; c/r sets capture and render apart (default 480)\n"
+            "  --rates <list>            Device rates in Hz; in/out sets them apart (default 48000)\n"
+            "  --skew-ppm <list>         Render clock off the capture clock by this much (default 0)\n"
+            "  --jitter-ms <list>        Service each device event up to this late (default 0)\n"
+            "  --capture-buffer <n>      Capture buffer in periods (default 4)\n"
+            "  --render-buffer <n>       Render buffer in periods (default 2)\n"
+            "  --channels <in>/<out>     Channel counts (default 2/2)\n"
+            "  --format <f32|s16|s24|s32>  Sample format of both devices (default f32)\n"
+            "\n"
+            "Engine:\n"
+            "  --noise <list>            off, rnnoise, speex (default off)\n"
+            "  --resampler <list>        linear, low, medium, high, speex (default medium)\n"
+            "  --split-threads           Capture and render on their own threads\n"
+            "  --no-drift-compensation   Fixed resampling ratio\n"
+            "  --no-adaptive-buffer      Fixed buffer target\n"
+            "  --target-ms <ms>          Buffer level target (default: adaptive / measured)\n"
+            "  --max-buffer-ms <ms>      Most audio queued between the devices (default 50)\n"
+            "  --catch-up-ms <ms>        Time-stretch when the buffer is this far over target (default off)\n"
+            "\n"
+            "Measurement:\n"
+            "  --signal <impulse|chirp>  Burst sent (default chirp)\n"
+            "  --bursts <n>              Bursts per configuration (default 8)\n"
+            "  --interval-ms <ms>        Between bursts (default 500)\n"
+            "  --settle-ms <ms>          Stream runs this long before the first burst (default 1000)\n"
+            "  --max-latency-ms <ms>     Longest delay searched for (default 300)\n"
+            "  --seed <n>                Seed for the jitter (default 1)\n"
+            "  --csv <path>              Also write the results as CSV\n"
+            "  --verbose                 Print the engine's diagnostic messages\n");
+    }
+
+    std::vector<std::string> SplitList(const std::string& text)
+    {
+        std::vector<std::string> items;
+        std::stringstream stream(text);
+        std::string item;
+        while (std::getline(stream, item, ','))
+        {
+            if (!item.empty())
+                items.push_back(item);
+        }
+        return items;
+    }
+
+    // "a" or "a/b" -> (a, a) or (a, b)
+    bool ParsePair(const std::string& text, unsigned int* first, unsigned int* second)
+    {
+        char* end = nullptr;
+        long a = std::strtol(text.c_str(), &end, 10);
+        long b = a;
+        if (*end == '/')
+            b = std::strtol(end + 1, &end, 10);
+        if (*end != '\0' || a <= 0 || b <= 0)
+            return false;
+        *first = (unsigned int)a;
+        *second = (unsigned int)b;
+        return true;
+    }
+
+    bool ParseSampleFormat(const std::string& name, SampleFormat* format)
+    {
+        if (name == "f32") *format = SampleFormat::Float32;
+        else if (name == "s16") *format = SampleFormat::PCM16;
+        else if (name == "s24") *format = SampleFormat::PCM24;
+        else if (name == "s32") *format = SampleFormat::PCM32;
+        else return false;
+        return true;
+    }
+
+    bool ParseResamplerQuality(const std::string& name, ResamplerQuality* quality)
+    {
+        if (name == "linear") *quality = ResamplerQuality::Linear;
+        else if (name == "low") *quality = ResamplerQuality::Low;
+        else if (name == "medium") *quality = ResamplerQuality::Medium;
+        else if (name == "high") *quality = ResamplerQuality::High;
+        else if (name == "speex") *quality = ResamplerQuality::Speex;
+        else return false;
+        return true;
+    }
+
+    bool ParseNoiseType(const std::string& name, NoiseReductionType* type)
+    {
+        if (name == "off") *type = NoiseReductionType::Off;
+        else if (name == "rnnoise") *type = NoiseReductionType::RNNoise;
+        else if (name == "speex") *type = NoiseReductionType::Speex;
+        else return false;
+        return true;
+    }
+
+    const char* GetNoiseName(NoiseReductionType type)
+    {
+        switch (type)
+        {
+            case NoiseReductionType::Off: return "off";
+            case NoiseReductionType::RNNoise: return "rnnoise";
+            case NoiseReductionType::Speex: return "speex";
+            default: return "?";
+        }
+    }
+
+    const char* GetResamplerName(ResamplerQuality quality)
+    {
+        switch (quality)
+        {
+            case ResamplerQuality::Linear: return "linear";
+            case ResamplerQuality::Low: return "low";
+            case ResamplerQuality::Medium: return "medium";
+            case ResamplerQuality::High: return "high";
+            case ResamplerQuality::Speex: return "speex";
+            default: return "?";
+        }
+    }
+
+    std::string Describe(const LatencyProbeConfig& config)
+    {
+        char text[160];
+        std::snprintf(text, sizeof(text), "%u/%u %u->%u %+gppm jitter %gms noise %s %s",
+                      config.capturePeriodFrames, config.renderPeriodFrames, config.inputRate, config.outputRate,
+                      config.outputSkewPpm, config.jitterMs,
+                      GetNoiseName(config.noiseConfig.type),
+                      GetResamplerName(config.engineOptions.resamplerQuality));
+        return text;
+    }
+
+    void PrintHeader()
+    {
+        std::printf("%-52s %8s %17s %5s | %7s %7s %6s %6s %7s %7s | %s\n", "configuration", "latency", "(min - max)", "corr",
+                    "buffer", "prefill", "render", "noise", "resamp", "other", "underruns/dropped");
+    }
+
+    void PrintMeasurement(const Measurement& measurement)
+    {
+        const LatencyProbeResult& result = measurement.result;
+        if (!result.success)
+        {
+            std::printf("%-52s failed: %s\n", measurement.label.c_str(), result.error.c_str());
+            return;
+        }
+
+        std::printf("%-52s %8.2f (%6.2f - %6.2f) %5.2f | %7.2f %7.2f %6.2f %6.2f %7.2f %+7.2f | %llu/%llu",
+                    measurement.label.c_str(), result.latencyMs, result.minLatencyMs, result.maxLatencyMs, result.correlation,
+                    result.bufferLevelMs, result.engine.prefillMs, result.engine.renderPeriodMs, result.engine.noiseSuppressionMs,
+                    result.engine.resamplerMs + result.engine.timeStretchMs, result.GetUnexplainedMs(),
+                    (unsigned long long)result.stats.renderStarvations, (unsigned long long)result.stats.droppedFrames);
+        if (result.burstsFound < result.burstsSent)
+            std::printf("  (%u of %u bursts found)", result.burstsFound, result.burstsSent);
+        std::printf("\n");
+    }
+
+    bool WriteCsv(const std::string& path, const std::vector<Measurement>& measurements)
+    {
+        FILE* file = std::fopen(path.c_str(), "w");
+        if (!file)
+            return false;
+
+        std::fprintf(file, "capture_period,render_period,input_rate,output_rate,skew_ppm,jitter_ms,noise,resampler,"
+                           "latency_ms,min_latency_ms,max_latency_ms,correlation,bursts_found,bursts_sent,"
+                           "buffer_level_ms,prefill_ms,capture_period_ms,render_period_ms,noise_ms,resampler_ms,time_stretch_ms,"
+                           "unexplained_ms,underruns,dropped_frames,error\n");
+        for (const Measurement& measurement : measurements)
+        {
+            const LatencyProbeConfig& config = measurement.config;
+            const LatencyProbeResult& result = measurement.result;
+            std::fprintf(file, "%u,%u,%u,%u,%g,%g,%s,%s,", config.capturePeriodFrames, config.renderPeriodFrames,
+                         config.inputRate, config.outputRate, config.outputSkewPpm, config.jitterMs,
+                         GetNoiseName(config.noiseConfig.type),
+                         GetResamplerName(config.engineOptions.resamplerQuality));
+            if (result.success)
+            {
+                std::fprintf(file, "%.3f,%.3f,%.3f,%.3f,%u,%u,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%llu,%llu,\n",
+                             result.latencyMs, result.minLatencyMs, result.maxLatencyMs, result.correlation,
+                             result.burstsFound, result.burstsSent, result.bufferLevelMs, result.engine.prefillMs,
+                             result.engine.capturePeriodMs, result.engine.renderPeriodMs, result.engine.noiseSuppressionMs,
+                             result.engine.resamplerMs, result.engine.timeStretchMs, result.GetUnexplainedMs(),
+                             (unsigned long long)result.stats.renderStarvations, (unsigned long long)result.stats.droppedFrames);
+            }
+            else
+            {
+                std::fprintf(file, ",,,,,%u,,,,,,,,,,,%s\n", result.burstsSent, result.error.c_str());
+            }
+        }
+        return std::fclose(file) == 0;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    LatencyProbeConfig base;
+    std::vector<std::string> periods = { "480" };
+    std::vector<std::string> rates = { "48000" };
+    std::vector<std::string> skews = { "0" };
+    std::vector<std::string> jitters = { "0" };
+    std::vector<std::string> noiseTypes = { "off" };
+    std::vector<std::string> resamplers = { "medium" };
+    std::string csvPath;
+    bool verbose = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--periods" && hasValue)
+            periods = SplitList(argv[++i]);
+        else if (arg == "--rates" && hasValue)
+            rates = SplitList(argv[++i]);
+        else if (arg == "--skew-ppm" && hasValue)
+            skews = SplitList(argv[++i]);
+        else if (arg == "--jitter-ms" && hasValue)
+            jitters = SplitList(argv[++i]);
+        else if (arg == "--noise" && hasValue)
+            noiseTypes = SplitList(argv[++i]);
+        else if (arg == "--resampler" && hasValue)
+            resamplers = SplitList(argv[++i]);
+        else if (arg == "--capture-buffer" && hasValue)
+            base.captureBufferPeriods = (unsigned int)std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--render-buffer" && hasValue)
+            base.renderBufferPeriods = (unsigned int)std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--channels" && hasValue)
+        {
+            if (!ParsePair(argv[++i], &base.inputChannels, &base.outputChannels))
+            {
+                std::fprintf(stderr, "Invalid channel counts: %s\n", argv[i]);
+                return 2;
+            }
+        }
+        else if (arg == "--format" && hasValue)
+        {
+            if (!ParseSampleFormat(argv[++i], &base.sampleFormat))
+            {
+                std::fprintf(stderr, "Unknown sample format: %s\n", argv[i]);
+                return 2;
+            }
+        }
+        else if (arg == "--split-threads")
+            base.engineOptions.splitThreads = true;
+        else if (arg == "--no-drift-compensation")
+            base.engineOptions.driftCompensation = false;
+        else if (arg == "--no-adaptive-buffer")
+            base.engineOptions.adaptiveBuffer = false;
+        else if (arg == "--target-ms" && hasValue)
+            base.engineOptions.targetBufferMs = (unsigned int)std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--max-buffer-ms" && hasValue)
+            base.engineOptions.maxBufferMs = (unsigned int)std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--catch-up-ms" && hasValue)
+            base.engineOptions.catchUpMs = (unsigned int)std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--signal" && hasValue)
+        {
+            std::string name = argv[++i];
+            if (name == "impulse")
+                base.stimulus = LoopbackStimulus::Impulse;
+            else if (name == "chirp")
+                base.stimulus = LoopbackStimulus::Chirp;
+            else
+            {
+                std::fprintf(stderr, "Unknown signal: %s\n", name.c_str());
+                return 2;
+            }
+        }
+        else if (arg == "--bursts" && hasValue)
+            base.bursts = (unsigned int)std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--interval-ms" && hasValue)
+            base.intervalMs = (unsigned int)std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--settle-ms" && hasValue)
+            base.settleMs = (unsigned int)std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--max-latency-ms" && hasValue)
+            base.maxLatencyMs = (unsigned int)std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--seed" && hasValue)
+            base.seed = (unsigned int)std::atoi(argv[++i]);
+        else if (arg == "--csv" && hasValue)
+            csvPath = argv[++i];
+        else if (arg == "--verbose" || arg == "-v")
+            verbose = true;
+        else if (arg == "--help" || arg == "-h")
+        {
+            PrintUsage();
+            return 0;
+        }
+        else
+        {
+            std::fprintf(stderr, "Unknown option: %s\n", arg.c_str());
+            PrintUsage();
+            return 2;
+        }
+    }
+
+    // Every combination of the swept settings
+    std::vector<Measurement> measurements;
+    for (const std::string& period : periods)
+    for (const std::string& rate : rates)
+    for (const std::string& skew : skews)
+    for (const std::string& jitter : jitters)
+    for (const std::string& noise : noiseTypes)
+    for (const std::string& resampler : resamplers)
+    {
+        Measurement measurement;
+        LatencyProbeConfig& config = measurement.config;
+        config = base;
+        if (!ParsePair(period, &config.capturePeriodFrames, &config.renderPeriodFrames))
+        {
+            std::fprintf(stderr, "Invalid period: %s\n", period.c_str());
+            return 2;
+        }
+        if (!ParsePair(rate, &config.inputRate, &config.outputRate))
+        {
+            std::fprintf(stderr, "Invalid rate: %s\n", rate.c_str());
+            return 2;
+        }
+        config.outputSkewPpm = std::atof(skew.c_str());
+        config.jitterMs = std::max(0.0, std::atof(jitter.c_str()));
+        if (!ParseNoiseType(noise, &config.noiseConfig.type))
+        {
+            std::fprintf(stderr, "Unknown noise suppression: %s\n", noise.c_str());
+            return 2;
+        }
+        if (!ParseResamplerQuality(resampler, &config.engineOptions.resamplerQuality))
+        {
+            std::fprintf(stderr, "Unknown resampler: %s\n", resampler.c_str());
+            return 2;
+        }
+        measurement.label = Describe(config);
+        measurements.push_back(measurement);
+    }
+
+    LatencyProbe probe;
+    if (verbose)
+        probe.SetDiagnosticCallback([](const std::wstring& message) { std::printf("  %s\n", Narrow(message).c_str()); });
+
+    // Results as they come in, then all of them, lowest latency first
+    std::printf("Latency in ms; buffer = queue + render buffer level the engine ran at, other = what the parts do not explain\n\n");
+    PrintHeader();
+    unsigned int failed = 0;
+    for (Measurement& measurement : measurements)
+    {
+        probe.Run(measurement.config, measurement.result);
+        if (!measurement.result.success)
+            failed++;
+        PrintMeasurement(measurement);
+        std::fflush(stdout);
+    }
+
+    if (measurements.size() > 1)
+    {
+        std::vector<Measurement> sorted = measurements;
+        std::stable_sort(sorted.begin(), sorted.end(), [](const Measurement& a, const Measurement& b) {
+            if (a.result.success != b.result.success)
+                return a.result.success;
+            return a.result.latencyMs < b.result.latencyMs;
+        });
+        std::printf("\nLowest latency first:\n");
+        PrintHeader();
+        for (const Measurement& measurement : sorted)
+            PrintMeasurement(measurement);
+    }
+
+    if (!csvPath.empty() && !WriteCsv(csvPath, measurements))
+    {
+        std::fprintf(stderr, "Cannot write %s\n", csvPath.c_str());
+        return 1;
+    }
+
+    return failed == measurements.size() ? 1 : 0;
+}
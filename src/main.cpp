@@ -41,6 +41,7 @@
 #define ID_TRAY_RESTORE      2001
 #define ID_TRAY_EXIT         2002
 #define TRAY_ICON_ID         1
+#define IDT_STATUS_TIMER     3001
 
 // Global variables
 HWND g_hWnd = NULL;
@@ -89,6 +90,20 @@ struct CommandLineParams
     bool speexDereverb = false;
     int rnnoiseVadThreshold = 0;  // 0-100 (0 = disabled)
     int rnnoiseGracePeriod = 200; // ms (0-1000)
+    bool noisePerChannel = false; // Denoise each channel separately instead of a mono downmix
+    int bufferMs = 0;             // Max capture->render buffering in ms (0 = engine default)
+    bool splitThreads = false;    // Separate capture and render threads
+    bool noDriftCompensation = false; // Disable clock drift compensation
+    bool fixedBuffer = false;     // Hold the buffer target instead of adapting it to underruns
+    int targetBufferMs = 0;       // Buffer level held by drift compensation (0 = measured at start)
+    int catchUpMs = 0;            // Time-stretch when the buffer is this far over its target (0 = off)
+    int resamplerQuality = -1;    // ResamplerQuality value (-1 = engine default)
+    bool dither = false;          // TPDF dither on 16/24-bit PCM output
+    int inputChannel = 0;         // 1-based input channel routed to all outputs (0 = all channels)
+    std::vector<float> channelMatrix; // Output-by-input channel gains (empty = default mapping)
+    std::wstring diagnosticLogPath;   // File every diagnostic message is appended to (empty = none)
+    int statsSeconds = 0;         // Processing stats report interval in seconds (0 = only at stop)
+    std::wstring glitchTracePath;     // Prefix of the trace files written after glitches (empty = none)
     bool autoStart = false;
     bool autoHide = false;
 };
@@ -99,12 +114,16 @@ void InitializeControls(HWND hWnd);
 void PopulateDeviceLists();
 void OnStartStop();
 void UpdateStatus(const wchar_t* status);
+void UpdateRunningStatus();
 void UpdateDiagnostics(const std::wstring& text);
 void AppendDiagnostics(const std::wstring& text);
 void AppendDiagnosticsImpl(const std::wstring& text);
 void ParseCommandLine(CommandLineParams& params);
 void ApplyCommandLineParams(const CommandLineParams& params);
 void SaveSettingsToBatchFile();
+void SaveTrace();
+std::string ToNarrowPath(const std::wstring& path);
+std::wstring ToWidePath(const std::string& path);
 void AddTrayIcon();
 void RemoveTrayIcon();
 void UpdateTrayTooltip();
@@ -201,6 +220,13 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
             continue;
         }
 
+        // Ctrl+T saves the flight recorder (the last few thousand audio callbacks) as a trace
+        if (msg.message == WM_KEYDOWN && msg.wParam == 'T' && (GetKeyState(VK_CONTROL) & 0x8000))
+        {
+            SaveTrace();
+            continue;
+        }
+
         if (!IsDialogMessage(g_hWnd, &msg))
         {
             TranslateMessage(&msg);
@@ -468,6 +494,7 @@ void OnStartStop()
             EnableWindow(g_hSpeexAgcCheck, FALSE);
             EnableWindow(g_hSpeexDereverbCheck, FALSE);
             UpdateStatus(L"Status: Running");
+            SetTimer(g_hWnd, IDT_STATUS_TIMER, 1000, NULL);
             UpdateTrayTooltip();
         }
         else
@@ -488,6 +515,7 @@ void OnStartStop()
         EnableWindow(g_hSpeexVadCheck, TRUE);
         EnableWindow(g_hSpeexAgcCheck, TRUE);
         EnableWindow(g_hSpeexDereverbCheck, TRUE);
+        KillTimer(g_hWnd, IDT_STATUS_TIMER);
         UpdateStatus(L"Status: Stopped");
         UpdateTrayTooltip();
     }
@@ -498,6 +526,17 @@ void UpdateStatus(const wchar_t* status)
     SetWindowText(g_hStatusText, status);
 }
 
+void UpdateRunningStatus()
+{
+    // Buffer level against the adaptive target, load and glitch counts, refreshed every second
+    ProcessingStatsSnapshot stats = g_audioEngine->GetStats();
+    wchar_t status[256];
+    swprintf_s(status, L"Status: Running | buffer %.1f ms (target %.1f) | DSP %.1f%% | %llu underruns, %llu dropped",
+               g_audioEngine->GetBufferLevelMs(), stats.bufferTargetMs, stats.dspLoad * 100.0,
+               (unsigned long long)stats.renderStarvations, (unsigned long long)stats.droppedFrames);
+    UpdateStatus(status);
+}
+
 void UpdateDiagnostics(const std::wstring& text)
 {
     SetWindowText(g_hDiagText, text.c_str());
@@ -592,6 +631,10 @@ void ParseCommandLine(CommandLineParams& params)
         {
             params.speexDereverb = true;
         }
+        else if (arg == L"--noise-per-channel")
+        {
+            params.noisePerChannel = true;
+        }
         else if ((arg == L"--rnnoise-vad") && i + 1 < argc)
         {
             params.rnnoiseVadThreshold = _wtoi(argv[++i]);
@@ -606,6 +649,90 @@ void ParseCommandLine(CommandLineParams& params)
             if (params.rnnoiseGracePeriod < 0) params.rnnoiseGracePeriod = 0;
             if (params.rnnoiseGracePeriod > 1000) params.rnnoiseGracePeriod = 1000;
         }
+        else if ((arg == L"--buffer-ms") && i + 1 < argc)
+        {
+            params.bufferMs = _wtoi(argv[++i]);
+            // Clamp to valid range
+            if (params.bufferMs < 0) params.bufferMs = 0;
+            if (params.bufferMs > 1000) params.bufferMs = 1000;
+        }
+        else if (arg == L"--split-threads")
+        {
+            params.splitThreads = true;
+        }
+        else if (arg == L"--no-drift-compensation")
+        {
+            params.noDriftCompensation = true;
+        }
+        else if (arg == L"--fixed-buffer")
+        {
+            params.fixedBuffer = true;
+        }
+        else if (arg == L"--dither")
+        {
+            params.dither = true;
+        }
+        else if ((arg == L"--input-channel") && i + 1 < argc)
+        {
+            params.inputChannel = _wtoi(argv[++i]);
+            if (params.inputChannel < 0) params.inputChannel = 0;
+        }
+        else if ((arg == L"--channel-matrix") && i + 1 < argc)
+        {
+            // Gains row by row (one row per output channel): rows separated by ';', gains by ','
+            params.channelMatrix.clear();
+            const wchar_t* text = argv[++i];
+            while (*text)
+            {
+                wchar_t* end = nullptr;
+                float gain = (float)wcstod(text, &end);
+                if (end == text)
+                    break;
+                params.channelMatrix.push_back(gain);
+                text = end;
+                while (*text == L',' || *text == L';' || *text == L' ')
+                    text++;
+            }
+        }
+        else if ((arg == L"--diag-log") && i + 1 < argc)
+        {
+            params.diagnosticLogPath = argv[++i];
+        }
+        else if ((arg == L"--stats") && i + 1 < argc)
+        {
+            params.statsSeconds = _wtoi(argv[++i]);
+            // Clamp to valid range
+            if (params.statsSeconds < 0) params.statsSeconds = 0;
+            if (params.statsSeconds > 3600) params.statsSeconds = 3600;
+        }
+        else if ((arg == L"--glitch-trace") && i + 1 < argc)
+        {
+            params.glitchTracePath = argv[++i];
+        }
+        else if ((arg == L"--resampler") && i + 1 < argc)
+        {
+            std::wstring quality = argv[++i];
+            std::transform(quality.begin(), quality.end(), quality.begin(), ::towlower);
+            if (quality == L"linear") params.resamplerQuality = (int)ResamplerQuality::Linear;
+            else if (quality == L"low") params.resamplerQuality = (int)ResamplerQuality::Low;
+            else if (quality == L"medium") params.resamplerQuality = (int)ResamplerQuality::Medium;
+            else if (quality == L"high") params.resamplerQuality = (int)ResamplerQuality::High;
+            else if (quality == L"speex") params.resamplerQuality = (int)ResamplerQuality::Speex;
+        }
+        else if ((arg == L"--target-buffer-ms") && i + 1 < argc)
+        {
+            params.targetBufferMs = _wtoi(argv[++i]);
+            // Clamp to valid range
+            if (params.targetBufferMs < 0) params.targetBufferMs = 0;
+            if (params.targetBufferMs > 1000) params.targetBufferMs = 1000;
+        }
+        else if ((arg == L"--catch-up-ms") && i + 1 < argc)
+        {
+            params.catchUpMs = _wtoi(argv[++i]);
+            // Clamp to valid range
+            if (params.catchUpMs < 0) params.catchUpMs = 0;
+            if (params.catchUpMs > 1000) params.catchUpMs = 1000;
+        }
         else if (arg == L"--autostart" || arg == L"-a")
         {
             params.autoStart = true;
@@ -725,10 +852,32 @@ void ApplyCommandLineParams(const CommandLineParams& params)
     if (params.speexDereverb)
         SendMessage(g_hSpeexDereverbCheck, BM_SETCHECK, BST_CHECKED, 0);
 
+    // No UI control for this one; GetNoiseConfigFromUI() picks it up from here
+    g_noiseConfig.perChannel = params.noisePerChannel;
+
     // Apply RNNoise settings
     SendMessage(g_hRnnoiseVadSlider, TBM_SETPOS, TRUE, params.rnnoiseVadThreshold);
     SendMessage(g_hRnnoiseGraceSlider, TBM_SETPOS, TRUE, params.rnnoiseGracePeriod);
 
+    // Apply engine options
+    AudioEngineOptions options = g_audioEngine->GetOptions();
+    if (params.bufferMs > 0)
+        options.maxBufferMs = (unsigned int)params.bufferMs;
+    options.splitThreads = params.splitThreads;
+    options.driftCompensation = !params.noDriftCompensation;
+    options.adaptiveBuffer = !params.fixedBuffer;
+    options.targetBufferMs = (unsigned int)params.targetBufferMs;
+    options.catchUpMs = (unsigned int)params.catchUpMs;
+    if (params.resamplerQuality >= 0)
+        options.resamplerQuality = (ResamplerQuality)params.resamplerQuality;
+    options.dither = params.dither;
+    options.inputChannel = params.inputChannel - 1;
+    options.channelMatrix = params.channelMatrix;
+    options.statsReportSeconds = (unsigned int)params.statsSeconds;
+    options.diagnosticLogPath = ToNarrowPath(params.diagnosticLogPath);
+    options.glitchTracePath = ToNarrowPath(params.glitchTracePath);
+    g_audioEngine->SetOptions(options);
+
     // Update controls visibility and displays
     UpdateSpeexControlsVisibility();
     UpdateSpeexLevelDisplay();
@@ -840,6 +989,50 @@ void SaveSettingsToBatchFile()
             if (SendMessage(g_hSpeexDereverbCheck, BM_GETCHECK, 0, 0) == BST_CHECKED)
                 cmdLine += L" --speex-dereverb";
         }
+        if (noiseType != NoiseReductionType::Off && g_noiseConfig.perChannel)
+            cmdLine += L" --noise-per-channel";
+
+        // Preserve custom engine buffering
+        AudioEngineOptions options = g_audioEngine->GetOptions();
+        if (options.maxBufferMs != AudioEngineOptions().maxBufferMs)
+            cmdLine += L" --buffer-ms " + std::to_wstring(options.maxBufferMs);
+        if (options.splitThreads)
+            cmdLine += L" --split-threads";
+        if (!options.driftCompensation)
+            cmdLine += L" --no-drift-compensation";
+        if (!options.adaptiveBuffer)
+            cmdLine += L" --fixed-buffer";
+        if (options.targetBufferMs > 0)
+            cmdLine += L" --target-buffer-ms " + std::to_wstring(options.targetBufferMs);
+        if (options.catchUpMs > 0)
+            cmdLine += L" --catch-up-ms " + std::to_wstring(options.catchUpMs);
+        if (options.resamplerQuality != AudioEngineOptions().resamplerQuality)
+        {
+            std::wstring quality = Resampler::GetQualityName(options.resamplerQuality);
+            std::transform(quality.begin(), quality.end(), quality.begin(), ::towlower);
+            cmdLine += L" --resampler " + quality;
+        }
+        if (options.dither)
+            cmdLine += L" --dither";
+        if (options.inputChannel >= 0)
+            cmdLine += L" --input-channel " + std::to_wstring(options.inputChannel + 1);
+        if (!options.channelMatrix.empty())
+        {
+            std::wstring gains;
+            for (size_t g = 0; g < options.channelMatrix.size(); g++)
+            {
+                if (g > 0)
+                    gains += L",";
+                gains += std::to_wstring(options.channelMatrix[g]);
+            }
+            cmdLine += L" --channel-matrix " + gains;
+        }
+        if (!options.diagnosticLogPath.empty())
+            cmdLine += L" --diag-log \"" + ToWidePath(options.diagnosticLogPath) + L"\"";
+        if (!options.glitchTracePath.empty())
+            cmdLine += L" --glitch-trace \"" + ToWidePath(options.glitchTracePath) + L"\"";
+        if (options.statsReportSeconds > 0)
+            cmdLine += L" --stats " + std::to_wstring(options.statsReportSeconds);
 
         cmdLine += L" --autostart";
         cmdLine += L" --autohide";  // Launch to system tray
@@ -868,6 +1061,57 @@ void SaveSettingsToBatchFile()
     }
 }
 
+void SaveTrace()
+{
+    OPENFILENAME ofn = {};
+    wchar_t fileName[MAX_PATH] = L"AudioRouter-trace.json";
+
+    ofn.lStructSize = sizeof(OPENFILENAME);
+    ofn.hwndOwner = g_hWnd;
+    ofn.lpstrFilter = L"Trace Files (*.json)\0*.json\0All Files (*.*)\0*.*\0";
+    ofn.lpstrFile = fileName;
+    ofn.nMaxFile = MAX_PATH;
+    ofn.lpstrDefExt = L"json";
+    ofn.Flags = OFN_OVERWRITEPROMPT;
+
+    if (GetSaveFileName(&ofn))
+    {
+        if (g_audioEngine->WriteTrace(ToNarrowPath(fileName)))
+            AppendDiagnostics(L"Trace written to " + std::wstring(fileName));
+        else
+            MessageBox(g_hWnd, L"Failed to save trace", L"Error", MB_OK | MB_ICONERROR);
+    }
+}
+
+std::string ToNarrowPath(const std::wstring& path)
+{
+    // The engine opens files by narrow (ANSI code page) path, like the file backends
+    if (path.empty())
+        return std::string();
+
+    int length = WideCharToMultiByte(CP_ACP, 0, path.c_str(), -1, NULL, 0, NULL, NULL);
+    if (length <= 0)
+        return std::string();
+
+    std::vector<char> narrow(length);
+    WideCharToMultiByte(CP_ACP, 0, path.c_str(), -1, narrow.data(), length, NULL, NULL);
+    return narrow.data();
+}
+
+std::wstring ToWidePath(const std::string& path)
+{
+    if (path.empty())
+        return std::wstring();
+
+    int length = MultiByteToWideChar(CP_ACP, 0, path.c_str(), -1, NULL, 0);
+    if (length <= 0)
+        return std::wstring();
+
+    std::vector<wchar_t> wide(length);
+    MultiByteToWideChar(CP_ACP, 0, path.c_str(), -1, wide.data(), length);
+    return wide.data();
+}
+
 void AddTrayIcon()
 {
     // Initialize NOTIFYICONDATA structure
@@ -1063,6 +1307,8 @@ NoiseReductionConfig GetNoiseConfigFromUI()
     config.rnnoise.vadGracePeriodMs = static_cast<float>(gracePos);
     config.rnnoise.attenuationFactor = 0.0f;        // Mute when below threshold
 
+    config.perChannel = g_noiseConfig.perChannel;
+
     return config;
 }
 
@@ -1142,6 +1388,11 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
         }
         break;
 
+    case WM_TIMER:
+        if (wParam == IDT_STATUS_TIMER && g_isRunning)
+            UpdateRunningStatus();
+        break;
+
     case WM_APPENDDIAG:
         // Thread-safe diagnostic text update from audio thread
         {
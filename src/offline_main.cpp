@@ -0,0 +1,469 @@
+// audiorouter-offline: runs WAV files through the live processing chain (conversion, noise
+// suppression, channel conversion, resampling) as fast as the machine allows.
+//
+//   audiorouter-offline [options] <input.wav> <output.wav>
+//   audiorouter-offline [options] <input-dir> <output-dir>
+//
+// A directory is processed file by file on a pool of threads, each with its own chain; a long
+// file can also be split into chunks processed at the same time (--chunks).
+
+#include "OfflineProcessor.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#else
+#include <dirent.h>
+#endif
+
+namespace
+{
+    struct Job
+    {
+        std::string inputPath;
+        std::string outputPath;
+        OfflineResult result;
+    };
+
+    std::mutex g_printMutex;
+
+    std::string Narrow(const std::wstring& text)
+    {
+        std::string result;
+        for (wchar_t c : text)
+            result += (c < 0x80) ? (char)c : '?';
+        return result;
+    }
+
+    void PrintUsage()
+    {
+        std::printf(
+            "Usage: audiorouter-offline [options] <input.wav> <output.wav>\n"
+            "       audiorouter-offline [options] <input-dir> <output-dir>\n"
+            "\n"
+            "Noise suppression:\n"
+            "  --rnnoise                 RNNoise\n"
+            "  --speex                   Speex preprocessor\n"
+            "  --speex-level <dB>        Speex suppression level (-1 to -50, default -25)\n"
+            "  --speex-vad, --speex-agc, --speex-dereverb\n"
+            "  --rnnoise-vad <0-100>     RNNoise VAD threshold (0 = off)\n"
+            "  --rnnoise-grace <ms>      RNNoise VAD grace period (default 200)\n"
+            "  --noise-per-channel       Denoise every channel separately\n"
+            "\n"
+            "Output:\n"
+            "  --rate <Hz>               Sample rate (default: the input's)\n"
+            "  --channels <n>            Channel count (default: the input's)\n"
+            "  --format <f32|s16|s24|s32>  Sample format (default: the input's)\n"
+            "  --resampler <linear|low|medium|high|speex>\n"
+            "  --dither                  TPDF dither for 16 and 24-bit output\n"
+            "\n"
+            "Processing:\n"
+            "  --period-ms <ms>          Packet size fed to the chain (default 10, like a capture period)\n"
+            "  --threads <n>             Files processed at once (default: one per core)\n"
+            "  --chunks <n>              Split each long file into n chunks processed at once\n"
+            "  --warmup-ms <ms>          Audio run ahead of each chunk and discarded (default 3000)\n"
+            "  --crossfade-ms <ms>       Crossfade between chunks (default 20)\n"
+            "  --verify                  Also process chunked files in one piece and report the difference\n"
+            "  --no-latency-compensation Keep the chain's delay in the output, as heard live\n"
+            "  --verbose                 Print how the chain is set up\n");
+    }
+
+    bool IsDirectory(const std::string& path)
+    {
+        struct stat info;
+        return stat(path.c_str(), &info) == 0 && (info.st_mode & S_IFMT) == S_IFDIR;
+    }
+
+    bool MakeDirectory(const std::string& path)
+    {
+#ifdef _WIN32
+        return _mkdir(path.c_str()) == 0 || IsDirectory(path);
+#else
+        return mkdir(path.c_str(), 0777) == 0 || IsDirectory(path);
+#endif
+    }
+
+    bool HasWavExtension(const std::string& name)
+    {
+        if (name.size() < 4)
+            return false;
+        std::string extension = name.substr(name.size() - 4);
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        return extension == ".wav";
+    }
+
+    // Names of the WAV files directly inside directory, sorted
+    std::vector<std::string> ListWavFiles(const std::string& directory)
+    {
+        std::vector<std::string> names;
+#ifdef _WIN32
+        WIN32_FIND_DATAA entry;
+        HANDLE find = FindFirstFileA((directory + "\\*").c_str(), &entry);
+        if (find != INVALID_HANDLE_VALUE)
+        {
+            do
+            {
+                if (!(entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && HasWavExtension(entry.cFileName))
+                    names.push_back(entry.cFileName);
+            } while (FindNextFileA(find, &entry));
+            FindClose(find);
+        }
+#else
+        if (DIR* dir = opendir(directory.c_str()))
+        {
+            while (dirent* entry = readdir(dir))
+            {
+                std::string name = entry->d_name;
+                if (HasWavExtension(name) && !IsDirectory(directory + "/" + name))
+                    names.push_back(name);
+            }
+            closedir(dir);
+        }
+#endif
+        std::sort(names.begin(), names.end());
+        return names;
+    }
+
+    bool ParseSampleFormat(const std::string& name, int* format)
+    {
+        if (name == "f32") *format = (int)SampleFormat::Float32;
+        else if (name == "s16") *format = (int)SampleFormat::PCM16;
+        else if (name == "s24") *format = (int)SampleFormat::PCM24;
+        else if (name == "s32") *format = (int)SampleFormat::PCM32;
+        else return false;
+        return true;
+    }
+
+    bool ParseResamplerQuality(const std::string& name, ResamplerQuality* quality)
+    {
+        if (name == "linear") *quality = ResamplerQuality::Linear;
+        else if (name == "low") *quality = ResamplerQuality::Low;
+        else if (name == "medium") *quality = ResamplerQuality::Medium;
+        else if (name == "high") *quality = ResamplerQuality::High;
+        else if (name == "speex") *quality = ResamplerQuality::Speex;
+        else return false;
+        return true;
+    }
+
+    int Clamp(int value, int low, int high)
+    {
+        return std::max(low, std::min(high, value));
+    }
+
+    double ToDecibels(double value)
+    {
+        return value > 0.0 ? 20.0 * std::log10(value) : -INFINITY;
+    }
+
+    // Difference between two WAV files of the same format, over the whole file and within
+    // windowFrames either side of each boundary (the crossfade, and the later chunk's state
+    // still settling)
+    struct Difference
+    {
+        double peak = 0.0;
+        double rms = 0.0;
+        double boundaryPeak = 0.0;
+        double boundaryRms = 0.0;
+    };
+
+    bool CompareFiles(const std::string& pathA, const std::string& pathB, const std::vector<uint64_t>& boundaries,
+                      uint64_t windowFrames, Difference& difference)
+    {
+        WavReader a;
+        WavReader b;
+        if (!a.Open(pathA) || !b.Open(pathB) || a.GetFormat() != b.GetFormat())
+            return false;
+
+        const AudioFormat format = a.GetFormat();
+        const unsigned int blockFrames = format.sampleRate;
+        std::vector<unsigned char> rawA((size_t)blockFrames * format.getBlockAlign());
+        std::vector<unsigned char> rawB(rawA.size());
+        std::vector<float> floatA((size_t)blockFrames * format.channels);
+        std::vector<float> floatB(floatA.size());
+        SampleConverter converter;
+        converter.Configure(format.sampleFormat);
+
+        double sum = 0.0;
+        double boundarySum = 0.0;
+        uint64_t samples = 0;
+        uint64_t boundarySamples = 0;
+        uint64_t frame = 0;
+        size_t nextBoundary = 0;
+        for (;;)
+        {
+            unsigned int frames = std::min(a.Read(rawA.data(), blockFrames), b.Read(rawB.data(), blockFrames));
+            if (frames == 0)
+                break;
+            converter.ToFloat(rawA.data(), floatA.data(), (size_t)frames * format.channels);
+            converter.ToFloat(rawB.data(), floatB.data(), (size_t)frames * format.channels);
+
+            for (unsigned int i = 0; i < frames; i++, frame++)
+            {
+                while (nextBoundary < boundaries.size() && frame >= boundaries[nextBoundary] + windowFrames)
+                    nextBoundary++;
+                // The window opens at the start of the crossfade
+                bool nearBoundary = nextBoundary < boundaries.size() && frame + windowFrames >= boundaries[nextBoundary];
+                for (unsigned int ch = 0; ch < format.channels; ch++)
+                {
+                    double error = std::fabs((double)floatA[(size_t)i * format.channels + ch] - floatB[(size_t)i * format.channels + ch]);
+                    difference.peak = std::max(difference.peak, error);
+                    sum += error * error;
+                    samples++;
+                    if (nearBoundary)
+                    {
+                        difference.boundaryPeak = std::max(difference.boundaryPeak, error);
+                        boundarySum += error * error;
+                        boundarySamples++;
+                    }
+                }
+            }
+        }
+        difference.rms = samples ? std::sqrt(sum / samples) : 0.0;
+        difference.boundaryRms = boundarySamples ? std::sqrt(boundarySum / boundarySamples) : 0.0;
+        return true;
+    }
+
+    // Process the job's input again in one piece and report how far the chunked output is from it
+    void VerifyChunks(const Job& job, const OfflineOptions& options)
+    {
+        if (!job.result.success || job.result.chunkBoundaries.empty())
+            return;
+
+        OfflineOptions sequential = options;
+        sequential.chunks = 1;
+        OfflineProcessor processor;
+        processor.SetOptions(sequential);
+        OfflineResult reference;
+        std::string referencePath = job.outputPath + ".sequential.wav";
+        bool processed = processor.ProcessFile(job.inputPath, referencePath, reference);
+
+        // Within a second of a boundary, including the crossfade before it
+        Difference difference;
+        bool compared = processed && CompareFiles(job.outputPath, referencePath, job.result.chunkBoundaries,
+                                                  job.result.outputFormat.sampleRate, difference);
+        std::remove(referencePath.c_str());
+
+        std::lock_guard<std::mutex> lock(g_printMutex);
+        if (!compared)
+        {
+            std::fprintf(stderr, "  verify %s: sequential run failed %s\n", job.inputPath.c_str(), reference.error.c_str());
+            return;
+        }
+        std::printf("  %zu chunks vs one piece (%.1fx realtime): within 1 s of a boundary peak %.1f dBFS, rms %.1f dBFS; "
+                    "whole file peak %.1f dBFS, rms %.1f dBFS\n",
+                    job.result.chunkBoundaries.size() + 1, reference.GetRealtimeFactor(),
+                    ToDecibels(difference.boundaryPeak), ToDecibels(difference.boundaryRms),
+                    ToDecibels(difference.peak), ToDecibels(difference.rms));
+    }
+
+    void PrintResult(const Job& job)
+    {
+        const OfflineResult& result = job.result;
+        std::lock_guard<std::mutex> lock(g_printMutex);
+        if (!result.success)
+        {
+            std::fprintf(stderr, "FAILED %s: %s\n", job.inputPath.c_str(), result.error.c_str());
+            return;
+        }
+        std::printf("%s: %.1f s of audio in %.3f s (%.1fx realtime, %.1f ms chain latency",
+                    job.inputPath.c_str(), result.GetAudioSeconds(), result.processingSeconds, result.GetRealtimeFactor(),
+                    result.latencyFrames * 1000.0 / result.outputFormat.sampleRate);
+        if (!result.chunkBoundaries.empty())
+            std::printf(", %zu chunks", result.chunkBoundaries.size() + 1);
+        std::printf(")\n");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    OfflineOptions options;
+    unsigned int threads = 0;
+    bool verbose = false;
+    bool verify = false;
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--rnnoise")
+            options.noiseConfig.type = NoiseReductionType::RNNoise;
+        else if (arg == "--speex")
+            options.noiseConfig.type = NoiseReductionType::Speex;
+        else if (arg == "--speex-level" && hasValue)
+            options.noiseConfig.speex.noiseSuppressionLevel = Clamp(std::atoi(argv[++i]), -50, -1);
+        else if (arg == "--speex-vad")
+            options.noiseConfig.speex.enableVAD = true;
+        else if (arg == "--speex-agc")
+            options.noiseConfig.speex.enableAGC = true;
+        else if (arg == "--speex-dereverb")
+            options.noiseConfig.speex.enableDereverb = true;
+        else if (arg == "--rnnoise-vad" && hasValue)
+            options.noiseConfig.rnnoise.vadThreshold = Clamp(std::atoi(argv[++i]), 0, 100) / 100.0f;
+        else if (arg == "--rnnoise-grace" && hasValue)
+            options.noiseConfig.rnnoise.vadGracePeriodMs = (float)Clamp(std::atoi(argv[++i]), 0, 1000);
+        else if (arg == "--noise-per-channel")
+            options.noiseConfig.perChannel = true;
+        else if (arg == "--rate" && hasValue)
+            options.outputRate = (unsigned int)Clamp(std::atoi(argv[++i]), 0, 768000);
+        else if (arg == "--channels" && hasValue)
+            options.outputChannels = (unsigned int)Clamp(std::atoi(argv[++i]), 0, 64);
+        else if (arg == "--format" && hasValue)
+        {
+            if (!ParseSampleFormat(argv[++i], &options.outputSampleFormat))
+            {
+                std::fprintf(stderr, "Unknown sample format: %s\n", argv[i]);
+                return 2;
+            }
+        }
+        else if (arg == "--resampler" && hasValue)
+        {
+            if (!ParseResamplerQuality(argv[++i], &options.resamplerQuality))
+            {
+                std::fprintf(stderr, "Unknown resampler: %s\n", argv[i]);
+                return 2;
+            }
+        }
+        else if (arg == "--dither")
+            options.dither = true;
+        else if (arg == "--period-ms" && hasValue)
+            options.periodMs = (unsigned int)Clamp(std::atoi(argv[++i]), 1, 1000);
+        else if (arg == "--threads" && hasValue)
+            threads = (unsigned int)Clamp(std::atoi(argv[++i]), 1, 256);
+        else if (arg == "--chunks" && hasValue)
+            options.chunks = (unsigned int)Clamp(std::atoi(argv[++i]), 1, 256);
+        else if (arg == "--warmup-ms" && hasValue)
+            options.warmupMs = (unsigned int)Clamp(std::atoi(argv[++i]), 0, 60000);
+        else if (arg == "--crossfade-ms" && hasValue)
+            options.crossfadeMs = (unsigned int)Clamp(std::atoi(argv[++i]), 0, 1000);
+        else if (arg == "--verify")
+            verify = true;
+        else if (arg == "--no-latency-compensation")
+            options.compensateLatency = false;
+        else if (arg == "--verbose" || arg == "-v")
+            verbose = true;
+        else if (arg == "--help" || arg == "-h")
+        {
+            PrintUsage();
+            return 0;
+        }
+        else if (!arg.empty() && arg[0] == '-')
+        {
+            std::fprintf(stderr, "Unknown option: %s\n", arg.c_str());
+            PrintUsage();
+            return 2;
+        }
+        else
+            paths.push_back(arg);
+    }
+
+    if (paths.size() != 2)
+    {
+        PrintUsage();
+        return 2;
+    }
+
+    std::vector<Job> jobs;
+    if (IsDirectory(paths[0]))
+    {
+        if (!MakeDirectory(paths[1]))
+        {
+            std::fprintf(stderr, "Cannot create output directory %s\n", paths[1].c_str());
+            return 1;
+        }
+        for (const std::string& name : ListWavFiles(paths[0]))
+        {
+            Job job;
+            job.inputPath = paths[0] + "/" + name;
+            job.outputPath = paths[1] + "/" + name;
+            jobs.push_back(job);
+        }
+        if (jobs.empty())
+        {
+            std::fprintf(stderr, "No .wav files in %s\n", paths[0].c_str());
+            return 1;
+        }
+    }
+    else
+    {
+        Job job;
+        job.inputPath = paths[0];
+        job.outputPath = IsDirectory(paths[1]) ? paths[1] + "/" + paths[0].substr(paths[0].find_last_of("/\\") + 1) : paths[1];
+        jobs.push_back(job);
+    }
+
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min(threads, (unsigned int)jobs.size());
+
+    // Every worker owns one chain and takes the next file until none are left
+    std::atomic<size_t> nextJob(0);
+    auto worker = [&]()
+    {
+        OfflineProcessor processor;
+        processor.SetOptions(options);
+        if (verbose)
+        {
+            processor.SetDiagnosticCallback([](const std::wstring& message)
+            {
+                std::lock_guard<std::mutex> lock(g_printMutex);
+                std::printf("  %s\n", Narrow(message).c_str());
+            });
+        }
+
+        for (size_t index = nextJob++; index < jobs.size(); index = nextJob++)
+        {
+            Job& job = jobs[index];
+            processor.ProcessFile(job.inputPath, job.outputPath, job.result);
+            PrintResult(job);
+            if (verify)
+                VerifyChunks(job, options);
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> pool;
+    for (unsigned int i = 1; i < threads; i++)
+        pool.emplace_back(worker);
+    worker();
+    for (std::thread& thread : pool)
+        thread.join();
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Realtime factor over the whole run: audio processed per second of wall clock time, so it
+    // includes the speedup from processing files in parallel
+    double audioSeconds = 0.0;
+    double inputFrames = 0.0;
+    size_t failed = 0;
+    for (const Job& job : jobs)
+    {
+        if (!job.result.success)
+        {
+            failed++;
+            continue;
+        }
+        audioSeconds += job.result.GetAudioSeconds();
+        inputFrames += (double)job.result.inputFrames;
+    }
+
+    std::printf("\n%zu file(s), %zu failed, %u thread(s)\n", jobs.size(), failed, threads);
+    if (wallSeconds > 0.0)
+    {
+        std::printf("%.1f s of audio in %.3f s: %.1fx realtime, %.0f frames/s\n",
+                    audioSeconds, wallSeconds, audioSeconds / wallSeconds, inputFrames / wallSeconds);
+    }
+    return failed == 0 ? 0 : 1;
+}
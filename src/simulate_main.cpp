@@ -0,0 +1,404 @@
+// audiorouter-simulate: runs the routing engine between simulated devices on a virtual clock,
+// faster than real time and the same way every time, and reports glitches, the latency
+// trajectory and CPU time per simulated hour.
+//
+//   audiorouter-simulate [options]
+//
+// Device timing trouble (odd packet sizes, clock skew, late and missed events, stalls, silent
+// packets) is set on the command line, so a field report can be replayed in seconds.
+
+#include "EngineSimulator.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace
+{
+    std::string Narrow(const std::wstring& text)
+    {
+        std::string result;
+        for (wchar_t c : text)
+            result += (c < 0x80) ? (char)c : '?';
+        return result;
+    }
+
+    void PrintUsage()
+    {
+        std::printf(
+            "Usage: audiorouter-simulate [options]\n"
+            "\n"
+            "Runs the engine between a simulated capture and render device on a virtual clock, as\n"
+            "fast as it can process the audio. The same options and seed give the same run.\n"
+            "Times take a unit: ms, s, m or h (seconds when none is given).\n"
+            "\n"
+            "Run:\n"
+            "  --duration <time>         Virtual time to simulate (default 1h)\n"
+            "  --sample <time>           Latency trajectory interval (default 10s)\n"
+            "  --seed <n>                Seeds the jitter, missed events and random trouble (default 1)\n"
+            "  --csv <path>              Write the latency trajectory as CSV\n"
+            "  --list <n>                Glitches listed with their times (default 20)\n"
+            "  --fail-on-glitch          Exit with 3 when anything glitched\n"
+            "  --verbose                 Print the engine's diagnostic messages\n"
+            "\n"
+            "Devices (c/r sets capture and render apart):\n"
+            "  --periods <c/r>           Period sizes in frames (default 480)\n"
+            "  --packet <frames>         Capture packet size (default: the period)\n"
+            "  --rates <in/out>          Device rates in Hz (default 48000)\n"
+            "  --channels <in/out>       Channel counts (default 2/2)\n"
+            "  --format <f32|s16|s24|s32>  Sample format of both devices (default f32)\n"
+            "  --capture-buffer <n>      Capture buffer in periods (default 4)\n"
+            "  --render-buffer <n>       Render buffer in periods (default 2)\n"
+            "  --skew-ppm <ppm>          Render clock off the capture clock by this much (default 0)\n"
+            "  --jitter-ms <c/r>         Signal each device event up to this late (default 0)\n"
+            "  --miss-rate <c/r>         Fraction of device events never signalled (default 0)\n"
+            "\n"
+            "Trouble:\n"
+            "  --stall <time>:<ms>       Hold the capture events for ms from time (repeatable)\n"
+            "  --render-stall <time>:<ms>  Same for the render events (split threads)\n"
+            "  --silence <time>:<ms>     Flag capture packets silent for ms from time (repeatable)\n"
+            "  --stalls-per-hour <n>     Random stalls of --stall-ms (default 50)\n"
+            "  --silence-per-hour <n>    Random silent bursts of --silence-ms (default 200)\n"
+            "  --stall-ms <ms>\n"
+            "  --silence-ms <ms>\n"
+            "\n"
+            "Engine:\n"
+            "  --noise <off|rnnoise|speex>  Noise suppression (default off)\n"
+            "  --resampler <linear|low|medium|high|speex>  (default medium)\n"
+            "  --split-threads           Capture and render on their own threads\n"
+            "  --no-drift-compensation   Fixed resampling ratio\n"
+            "  --no-adaptive-buffer      Fixed buffer target\n"
+            "  --target-ms <ms>          Buffer level target (default: adaptive / measured)\n"
+            "  --max-buffer-ms <ms>      Most audio queued between the devices (default 50)\n"
+            "  --catch-up-ms <ms>        Time-stretch when the buffer is this far over target (default off)\n");
+    }
+
+    // "a" or "a/b" -> (a, a) or (a, b)
+    bool ParsePair(const std::string& text, unsigned int* first, unsigned int* second)
+    {
+        char* end = nullptr;
+        long a = std::strtol(text.c_str(), &end, 10);
+        long b = a;
+        if (*end == '/')
+            b = std::strtol(end + 1, &end, 10);
+        if (*end != '\0' || a <= 0 || b <= 0)
+            return false;
+        *first = (unsigned int)a;
+        *second = (unsigned int)b;
+        return true;
+    }
+
+    bool ParseDoublePair(const std::string& text, double* first, double* second)
+    {
+        char* end = nullptr;
+        double a = std::strtod(text.c_str(), &end);
+        double b = a;
+        if (*end == '/')
+            b = std::strtod(end + 1, &end);
+        if (*end != '\0' || a < 0.0 || b < 0.0)
+            return false;
+        *first = a;
+        *second = b;
+        return true;
+    }
+
+    // "1.5", "90s", "250ms", "10m", "2h" -> seconds; stops at ':' so it can lead a window
+    bool ParseTime(const std::string& text, double* seconds)
+    {
+        char* end = nullptr;
+        double value = std::strtod(text.c_str(), &end);
+        std::string unit(end);
+        unit = unit.substr(0, unit.find(':'));
+        if (end == text.c_str() || value < 0.0)
+            return false;
+        if (unit.empty() || unit == "s") *seconds = value;
+        else if (unit == "ms") *seconds = value / 1000.0;
+        else if (unit == "m") *seconds = value * 60.0;
+        else if (unit == "h") *seconds = value * 3600.0;
+        else return false;
+        return true;
+    }
+
+    // "<time>:<ms>" -> window
+    bool ParseWindow(const std::string& text, SimulatedWindow* window)
+    {
+        size_t colon = text.find(':');
+        double startSeconds = 0.0;
+        if (colon == std::string::npos || !ParseTime(text, &startSeconds))
+            return false;
+        char* end = nullptr;
+        double lengthMs = std::strtod(text.c_str() + colon + 1, &end);
+        if (*end != '\0' || lengthMs <= 0.0)
+            return false;
+        window->startNs = (long long)(startSeconds * 1e9);
+        window->endNs = window->startNs + (long long)(lengthMs * 1e6);
+        return true;
+    }
+
+    bool ParseSampleFormat(const std::string& name, SampleFormat* format)
+    {
+        if (name == "f32") *format = SampleFormat::Float32;
+        else if (name == "s16") *format = SampleFormat::PCM16;
+        else if (name == "s24") *format = SampleFormat::PCM24;
+        else if (name == "s32") *format = SampleFormat::PCM32;
+        else return false;
+        return true;
+    }
+
+    bool ParseResamplerQuality(const std::string& name, ResamplerQuality* quality)
+    {
+        if (name == "linear") *quality = ResamplerQuality::Linear;
+        else if (name == "low") *quality = ResamplerQuality::Low;
+        else if (name == "medium") *quality = ResamplerQuality::Medium;
+        else if (name == "high") *quality = ResamplerQuality::High;
+        else if (name == "speex") *quality = ResamplerQuality::Speex;
+        else return false;
+        return true;
+    }
+
+    bool ParseNoiseType(const std::string& name, NoiseReductionType* type)
+    {
+        if (name == "off") *type = NoiseReductionType::Off;
+        else if (name == "rnnoise") *type = NoiseReductionType::RNNoise;
+        else if (name == "speex") *type = NoiseReductionType::Speex;
+        else return false;
+        return true;
+    }
+
+    // H:MM:SS.mmm
+    std::string FormatTime(double seconds)
+    {
+        long long ms = (long long)(seconds * 1000.0 + 0.5);
+        char text[32];
+        std::snprintf(text, sizeof(text), "%lld:%02lld:%02lld.%03lld", ms / 3600000, ms / 60000 % 60, ms / 1000 % 60, ms % 1000);
+        return text;
+    }
+
+    void PrintGlitches(const EngineSimulationResult& result, const SimulatedDeviceConfig& capture,
+                       const SimulatedDeviceConfig& render, unsigned int listCount)
+    {
+        const SimulationLog& log = result.log;
+        std::printf("Glitches: %llu underruns (%.1f ms of silence), %llu overflows (%.1f ms lost), %llu frames dropped by the engine\n",
+                    (unsigned long long)log.underruns, log.underrunFrames * 1000.0 / render.format.sampleRate,
+                    (unsigned long long)log.overflows, log.overflowFrames * 1000.0 / capture.format.sampleRate,
+                    (unsigned long long)result.stats.droppedFrames);
+
+        unsigned int listed = 0;
+        for (const SimulatedGlitch& glitch : log.glitches)
+        {
+            if (listed++ == listCount)
+                break;
+            const bool underrun = glitch.type == SimulatedGlitchType::Underrun;
+            const double ms = glitch.frames * 1000.0 / (underrun ? render.format.sampleRate : capture.format.sampleRate);
+            std::printf("  %s  %-16s %8.1f ms\n", FormatTime(glitch.timeNs / 1e9).c_str(),
+                        underrun ? "render underrun" : "capture overflow", ms);
+        }
+        const uint64_t total = log.underruns + log.overflows;
+        if (total > listed)
+            std::printf("  ... %llu more\n", (unsigned long long)(total - listed));
+    }
+
+    void PrintLatency(const EngineSimulationResult& result)
+    {
+        const std::vector<SimulationSample>& trajectory = result.trajectory;
+        if (trajectory.empty())
+            return;
+
+        double minMs = trajectory[0].latencyMs;
+        double maxMs = minMs;
+        double sumMs = 0.0;
+        for (const SimulationSample& sample : trajectory)
+        {
+            minMs = std::min(minMs, sample.latencyMs);
+            maxMs = std::max(maxMs, sample.latencyMs);
+            sumMs += sample.latencyMs;
+        }
+        std::printf("Latency: min %.2f, mean %.2f, max %.2f, end %.2f ms (buffer level + %.2f ms fixed)\n",
+                    minMs, sumMs / trajectory.size(), maxMs, trajectory.back().latencyMs, result.engine.GetAddedMs());
+    }
+
+    // About 30 rows of the trajectory
+    void PrintTrajectory(const std::vector<SimulationSample>& trajectory, double sampleSeconds)
+    {
+        const size_t step = std::max<size_t>(1, (trajectory.size() + 29) / 30);
+        std::printf("\nTrajectory (every %gs%s):\n", sampleSeconds * step, step > 1 ? "; --csv for every sample" : "");
+        std::printf("%14s %8s %8s %8s %8s %8s %10s %10s %8s\n", "time", "latency", "buffer", "render", "target", "drift",
+                    "underruns", "overflows", "dropped");
+        for (size_t i = step - 1; i < trajectory.size(); i += step)
+        {
+            const SimulationSample& sample = trajectory[i];
+            std::printf("%14s %8.2f %8.2f %8.2f %8.2f %+8.1f %10llu %10llu %8llu\n", FormatTime(sample.timeSeconds).c_str(),
+                        sample.latencyMs, sample.bufferLevelMs, sample.renderBufferMs, sample.bufferTargetMs, sample.driftPpm,
+                        (unsigned long long)sample.underruns, (unsigned long long)sample.overflows,
+                        (unsigned long long)sample.droppedFrames);
+        }
+    }
+
+    bool WriteCsv(const std::string& path, const std::vector<SimulationSample>& trajectory)
+    {
+        FILE* file = std::fopen(path.c_str(), "w");
+        if (!file)
+            return false;
+
+        std::fprintf(file, "time_s,latency_ms,buffer_level_ms,render_buffer_ms,buffer_target_ms,drift_ppm,underruns,overflows,dropped_frames\n");
+        for (const SimulationSample& sample : trajectory)
+        {
+            std::fprintf(file, "%.3f,%.3f,%.3f,%.3f,%.3f,%.2f,%llu,%llu,%llu\n", sample.timeSeconds, sample.latencyMs,
+                         sample.bufferLevelMs, sample.renderBufferMs, sample.bufferTargetMs, sample.driftPpm,
+                         (unsigned long long)sample.underruns, (unsigned long long)sample.overflows,
+                         (unsigned long long)sample.droppedFrames);
+        }
+        return std::fclose(file) == 0;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    EngineSimulationConfig config;
+    unsigned int inputRate = 48000, outputRate = 48000;
+    unsigned int inputChannels = 2, outputChannels = 2;
+    SampleFormat sampleFormat = SampleFormat::Float32;
+    std::string csvPath;
+    unsigned int listCount = 20;
+    bool failOnGlitch = false;
+    bool verbose = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        bool valid = true;
+
+        if (arg == "--duration" && hasValue)
+            valid = ParseTime(argv[++i], &config.durationSeconds) && config.durationSeconds > 0.0;
+        else if (arg == "--sample" && hasValue)
+            valid = ParseTime(argv[++i], &config.sampleSeconds) && config.sampleSeconds > 0.0;
+        else if (arg == "--seed" && hasValue)
+            config.seed = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--csv" && hasValue)
+            csvPath = argv[++i];
+        else if (arg == "--list" && hasValue)
+            listCount = (unsigned int)std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--fail-on-glitch")
+            failOnGlitch = true;
+        else if (arg == "--periods" && hasValue)
+            valid = ParsePair(argv[++i], &config.capture.periodFrames, &config.render.periodFrames);
+        else if (arg == "--packet" && hasValue)
+            config.capture.packetFrames = (unsigned int)std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--rates" && hasValue)
+            valid = ParsePair(argv[++i], &inputRate, &outputRate);
+        else if (arg == "--channels" && hasValue)
+            valid = ParsePair(argv[++i], &inputChannels, &outputChannels);
+        else if (arg == "--format" && hasValue)
+            valid = ParseSampleFormat(argv[++i], &sampleFormat);
+        else if (arg == "--capture-buffer" && hasValue)
+            config.capture.bufferPeriods = (unsigned int)std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--render-buffer" && hasValue)
+            config.render.bufferPeriods = (unsigned int)std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--skew-ppm" && hasValue)
+            config.render.clockSkewPpm = std::atof(argv[++i]);
+        else if (arg == "--jitter-ms" && hasValue)
+            valid = ParseDoublePair(argv[++i], &config.capture.jitterMs, &config.render.jitterMs);
+        else if (arg == "--miss-rate" && hasValue)
+            valid = ParseDoublePair(argv[++i], &config.capture.missedEventRate, &config.render.missedEventRate) &&
+                    config.capture.missedEventRate < 1.0 && config.render.missedEventRate < 1.0;
+        else if ((arg == "--stall" || arg == "--render-stall" || arg == "--silence") && hasValue)
+        {
+            SimulatedWindow window;
+            valid = ParseWindow(argv[++i], &window);
+            if (arg == "--stall")
+                config.capture.stalls.push_back(window);
+            else if (arg == "--render-stall")
+                config.render.stalls.push_back(window);
+            else
+                config.capture.silentBursts.push_back(window);
+        }
+        else if (arg == "--stalls-per-hour" && hasValue)
+            config.stallsPerHour = std::max(0.0, std::atof(argv[++i]));
+        else if (arg == "--silence-per-hour" && hasValue)
+            config.silentBurstsPerHour = std::max(0.0, std::atof(argv[++i]));
+        else if (arg == "--stall-ms" && hasValue)
+            config.stallMs = std::max(0.0, std::atof(argv[++i]));
+        else if (arg == "--silence-ms" && hasValue)
+            config.silentBurstMs = std::max(0.0, std::atof(argv[++i]));
+        else if (arg == "--noise" && hasValue)
+            valid = ParseNoiseType(argv[++i], &config.noiseConfig.type);
+        else if (arg == "--resampler" && hasValue)
+            valid = ParseResamplerQuality(argv[++i], &config.engineOptions.resamplerQuality);
+        else if (arg == "--split-threads")
+            config.engineOptions.splitThreads = true;
+        else if (arg == "--no-drift-compensation")
+            config.engineOptions.driftCompensation = false;
+        else if (arg == "--no-adaptive-buffer")
+            config.engineOptions.adaptiveBuffer = false;
+        else if (arg == "--target-ms" && hasValue)
+            config.engineOptions.targetBufferMs = (unsigned int)std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--max-buffer-ms" && hasValue)
+            config.engineOptions.maxBufferMs = (unsigned int)std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--catch-up-ms" && hasValue)
+            config.engineOptions.catchUpMs = (unsigned int)std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--verbose" || arg == "-v")
+            verbose = true;
+        else if (arg == "--help" || arg == "-h")
+        {
+            PrintUsage();
+            return 0;
+        }
+        else
+        {
+            std::fprintf(stderr, "Unknown option: %s\n", arg.c_str());
+            PrintUsage();
+            return 2;
+        }
+
+        if (!valid)
+        {
+            std::fprintf(stderr, "Invalid value for %s: %s\n", arg.c_str(), argv[i]);
+            return 2;
+        }
+    }
+
+    config.capture.format = AudioFormat(sampleFormat, inputRate, inputChannels);
+    config.render.format = AudioFormat(sampleFormat, outputRate, outputChannels);
+
+    EngineSimulator simulator;
+    if (verbose)
+        simulator.SetDiagnosticCallback([](const std::wstring& message) { std::printf("  %s\n", Narrow(message).c_str()); });
+
+    EngineSimulationResult result;
+    if (!simulator.Run(config, result))
+    {
+        std::fprintf(stderr, "Simulation failed: %s\n", result.error.c_str());
+        return 1;
+    }
+
+    const SimulationLog& log = result.log;
+    std::printf("Simulated %s in %.2f s (%.0fx real time), seed %llu\n", FormatTime(result.simulatedSeconds).c_str(),
+                result.wallSeconds, result.GetSpeedFactor(), (unsigned long long)config.seed);
+    std::printf("Events: %llu capture, %llu render, %llu missed; %llu silent packets\n",
+                (unsigned long long)log.captureEvents, (unsigned long long)log.renderEvents,
+                (unsigned long long)log.missedEvents, (unsigned long long)log.silentPackets);
+    PrintGlitches(result, config.capture, config.render, listCount);
+    PrintLatency(result);
+    std::printf("Drift: engine measured %+.1f ppm, device clocks differ by %+.1f ppm\n",
+                result.trajectory.empty() ? 0.0 : result.trajectory.back().driftPpm,
+                ((1.0 + config.capture.clockSkewPpm * 1e-6) / (1.0 + config.render.clockSkewPpm * 1e-6) - 1.0) * 1e6);
+
+    const TimingHistogram::Summary& callback = result.stats.stages[(int)ProcessingStage::Callback];
+    std::printf("CPU per simulated hour: %.2f s in engine callbacks (%.3f%% of a core), %.2f s for the whole simulation\n",
+                result.GetCallbackSecondsPerHour(), result.GetCallbackSecondsPerHour() / 36.0, result.GetCpuSecondsPerHour());
+    std::printf("Callback: p50 %.1f us, p99 %.1f us, max %.1f us over %llu calls\n", callback.p50Ns / 1000.0,
+                callback.p99Ns / 1000.0, callback.maxNs / 1000.0, (unsigned long long)callback.count);
+
+    PrintTrajectory(result.trajectory, config.sampleSeconds);
+
+    if (!csvPath.empty() && !WriteCsv(csvPath, result.trajectory))
+    {
+        std::fprintf(stderr, "Cannot write %s\n", csvPath.c_str());
+        return 1;
+    }
+
+    const bool glitched = log.underruns > 0 || log.overflows > 0 || result.stats.droppedFrames > 0;
+    return failOnGlitch && glitched ? 3 : 0;
+}
@@ -0,0 +1,132 @@
+// Adaptive buffer target: after an underrun it must not decay straight back to the level that
+// ran dry, or the underruns come back every few minutes
+#include "AdaptiveBufferTarget.h"
+#include "EngineSimulator.h"
+#include "TestCheck.h"
+#include <algorithm>
+
+namespace
+{
+    const unsigned int Rate = 48000;
+    const unsigned int MinFrames = 960;     // 20 ms
+    const unsigned int MaxFrames = 4800;
+
+    // Feed seconds of stream time in 10 ms steps; returns the lowest target seen
+    unsigned int Run(AdaptiveBufferTarget& target, double seconds)
+    {
+        unsigned int lowest = target.GetTargetFrames();
+        for (unsigned int step = 0; step < (unsigned int)(seconds * 100.0); step++)
+        {
+            target.Update(Rate / 100);
+            lowest = std::min(lowest, target.GetTargetFrames());
+        }
+        return lowest;
+    }
+
+    void CheckFloorAfterUnderrun()
+    {
+        std::printf("One underrun at the minimum\n");
+        AdaptiveBufferTarget target;
+        target.Configure(Rate, MinFrames, MaxFrames);
+        target.OnUnderrun();
+        CHECK(target.GetTargetFrames() > MinFrames);
+
+        // Held a margin above the level that ran dry for minutes...
+        const unsigned int floorFrames = target.GetFloorFrames();
+        CHECK(floorFrames > MinFrames);
+        CHECK(floorFrames < target.GetTargetFrames());
+        CHECK(Run(target, 240.0) == floorFrames);
+
+        // ...and never below that level itself afterwards
+        CHECK(Run(target, 3600.0) >= MinFrames);
+        CHECK(target.GetTargetFrames() == MinFrames);
+    }
+
+    void CheckRecurringUnderrunKeepsFloor()
+    {
+        std::printf("Underrun again at the level that ran dry before\n");
+        AdaptiveBufferTarget target;
+        target.Configure(Rate, MinFrames, MaxFrames);
+        target.OnUnderrun();
+        const unsigned int floorFrames = target.GetFloorFrames();
+        Run(target, 3600.0);
+        CHECK(target.GetTargetFrames() == MinFrames);
+
+        // That level is not enough: the margin stays
+        target.OnUnderrun();
+        CHECK(target.GetFloorFrames() == floorFrames);
+        CHECK(Run(target, 3600.0) == floorFrames);
+        CHECK(target.GetTargetFrames() == floorFrames);
+
+        // Until the next stream
+        target.Reset();
+        CHECK(target.GetTargetFrames() == MinFrames);
+        CHECK(target.GetFloorFrames() == MinFrames);
+    }
+
+    void CheckFloorBelowLaterUnderrun()
+    {
+        std::printf("Underrun while still above the floor\n");
+        AdaptiveBufferTarget target;
+        target.Configure(Rate, MinFrames, MaxFrames);
+        target.OnUnderrun();
+        const unsigned int firstFloor = target.GetFloorFrames();
+        Run(target, 40.0);
+
+        // Learned from the level that ran dry this time, which was higher
+        const unsigned int starved = target.GetTargetFrames();
+        target.OnUnderrun();
+        CHECK(target.GetFloorFrames() > firstFloor);
+        CHECK(Run(target, 3600.0) >= starved);
+    }
+
+    // On the simulated devices the render clock's skew makes a 20 ms level run dry every few
+    // minutes. After the first couple of underruns the target must settle above that level.
+    void CheckNoRecurringUnderruns()
+    {
+        std::printf("Split threads, render clock +100 ppm, 20 minutes\n");
+        EngineSimulationConfig config;
+        config.engineOptions.splitThreads = true;
+        config.render.clockSkewPpm = 100.0;
+        config.durationSeconds = 1200.0;
+        config.sampleSeconds = 60.0;
+
+        EngineSimulator simulator;
+        EngineSimulationResult result;
+        CHECK(simulator.Run(config, result));
+        CHECK(result.log.underruns <= 2);
+    }
+
+    // One thread, render serviced on capture events that come further apart than its period. An
+    // empty render buffer then does not mean it ran dry, and the target must stay where it started.
+    void CheckSingleThreadMismatchedPeriods(unsigned int catchUpMs, double seconds)
+    {
+        std::printf("One thread, 44.1 kHz 512-frame capture to 48 kHz 480-frame render, catch-up %u ms\n", catchUpMs);
+        EngineSimulationConfig config;
+        config.engineOptions.catchUpMs = catchUpMs;
+        config.capture.format.sampleRate = 44100;
+        config.capture.periodFrames = 512;
+        config.durationSeconds = seconds;
+        config.sampleSeconds = 60.0;
+
+        EngineSimulator simulator;
+        EngineSimulationResult result;
+        CHECK(simulator.Run(config, result));
+        CHECK(result.log.underruns == 0);
+        CHECK(result.stats.renderStarvations == 0);
+        CHECK(result.stats.droppedFrames == 0);
+        CHECK(result.stats.bufferTargetMs < 25.0);
+        CHECK_NEAR(result.trajectory.back().driftPpm, 0.0, 20.0);
+    }
+}
+
+int main()
+{
+    CheckFloorAfterUnderrun();
+    CheckRecurringUnderrunKeepsFloor();
+    CheckFloorBelowLaterUnderrun();
+    CheckNoRecurringUnderruns();
+    CheckSingleThreadMismatchedPeriods(0, 600.0);
+    CheckSingleThreadMismatchedPeriods(10, 120.0);
+    return TEST_RESULT();
+}
@@ -0,0 +1,159 @@
+// ChannelMixer: every kernel mixing by the matrix it was given, and the default layouts putting
+// the gains where their description says
+#include "ChannelMixer.h"
+#include "TestCheck.h"
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    // Frame counts that leave a remainder behind every vector width
+    const unsigned int FrameCounts[] = { 1, 3, 8, 37, 480 };
+
+    // Mixes frames of random input through matrix and compares against the sum written out in
+    // double. A sentinel past the end catches a kernel writing too far.
+    void CheckMix(const ChannelMatrix& matrix, unsigned int frames)
+    {
+        const unsigned int in = matrix.inputChannels;
+        const unsigned int out = matrix.outputChannels;
+        std::mt19937 random(in * 100 + out * 10 + frames);
+        std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+        std::vector<float> input((size_t)frames * in);
+        for (float& sample : input)
+            sample = value(random);
+
+        ChannelMixer mixer;
+        CHECK(mixer.Configure(matrix));
+        std::vector<float> output((size_t)frames * out + 4, 7.0f);
+        mixer.Process(input.data(), output.data(), frames);
+
+        double worst = 0.0;
+        for (unsigned int f = 0; f < frames; f++)
+        {
+            for (unsigned int o = 0; o < out; o++)
+            {
+                double expected = 0.0;
+                for (unsigned int i = 0; i < in; i++)
+                    expected += (double)matrix.at(o, i) * input[(size_t)f * in + i];
+                worst = std::max(worst, std::fabs(output[(size_t)f * out + o] - expected));
+            }
+        }
+        CHECK_NEAR(worst, 0.0, 1e-5);
+
+        bool isUntouched = true;
+        for (size_t i = (size_t)frames * out; i < output.size(); i++)
+            isUntouched = isUntouched && output[i] == 7.0f;
+        CHECK(isUntouched);
+    }
+
+    // Random gains at every layout up to eight channels each way: the fixed kernels and the
+    // generic one with every output padding
+    void CheckRandomMatrices()
+    {
+        std::printf("Random matrices, 1 to 8 channels in and out\n");
+        std::mt19937 random(3);
+        std::uniform_real_distribution<float> gain(-2.0f, 2.0f);
+        for (unsigned int in = 1; in <= 8; in++)
+        {
+            for (unsigned int out = 1; out <= 8; out++)
+            {
+                ChannelMatrix matrix(in, out);
+                for (float& value : matrix.gains)
+                    value = gain(random);
+                for (unsigned int frames : FrameCounts)
+                    CheckMix(matrix, frames);
+            }
+        }
+    }
+
+    void CheckKernelChoice()
+    {
+        std::printf("Kernel chosen for each layout\n");
+        const struct { unsigned int in, out; const wchar_t* name; } layouts[] = {
+            { 1, 2, L"1->2" }, { 2, 2, L"2->2" }, { 2, 1, L"2->1" }, { 6, 1, L"N->1" },
+            { 8, 1, L"N->1" }, { 9, 1, L"Generic" }, { 2, 6, L"Generic" }, { 6, 2, L"Generic" },
+        };
+        for (const auto& layout : layouts)
+        {
+            ChannelMatrix matrix(layout.in, layout.out);
+            matrix.gains.assign(matrix.gains.size(), 0.5f);
+            ChannelMixer mixer;
+            CHECK(mixer.Configure(matrix));
+            CHECK(std::wstring(mixer.GetKernelName()) == layout.name);
+            CHECK(!mixer.IsPassthrough());
+            CheckMix(matrix, 37);
+        }
+
+        // Identity copies; a matrix that does not match its channel counts is refused
+        ChannelMixer mixer;
+        CHECK(mixer.Configure(ChannelMatrix::createDefault(2, 2)));
+        CHECK(mixer.IsPassthrough());
+        ChannelMatrix broken(2, 2);
+        broken.gains.pop_back();
+        CHECK(!mixer.Configure(broken));
+        CHECK(!mixer.Configure(ChannelMatrix()));
+    }
+
+    // Known input through the default layouts gives known output
+    void CheckDefaultLayouts()
+    {
+        std::printf("Default layouts\n");
+        ChannelMixer mixer;
+        float output[8];
+
+        // Mono is copied to both sides
+        const float mono[] = { 0.25f };
+        CHECK(mixer.Configure(ChannelMatrix::createDefault(1, 2)));
+        mixer.Process(mono, output, 1);
+        CHECK(output[0] == 0.25f && output[1] == 0.25f);
+
+        // Stereo to mono averages
+        const float stereo[] = { 0.5f, -0.25f };
+        CHECK(mixer.Configure(ChannelMatrix::createDefault(2, 1)));
+        mixer.Process(stereo, output, 1);
+        CHECK_NEAR(output[0], 0.125, 1e-7);
+
+        // 5.1 to stereo: inputs 0, 2, 4 average on the left, 1, 3, 5 on the right
+        const float surround[] = { 0.3f, 0.6f, 0.3f, 0.0f, 0.6f, 0.3f };
+        CHECK(mixer.Configure(ChannelMatrix::createDefault(6, 2)));
+        mixer.Process(surround, output, 1);
+        CHECK_NEAR(output[0], 0.4, 1e-6);
+        CHECK_NEAR(output[1], 0.3, 1e-6);
+
+        // Three inputs on two outputs: the left gets two of them, the right only one
+        const float three[] = { 0.2f, 0.8f, 0.6f };
+        CHECK(mixer.Configure(ChannelMatrix::createDefault(3, 2)));
+        mixer.Process(three, output, 1);
+        CHECK_NEAR(output[0], 0.4, 1e-6);
+        CHECK_NEAR(output[1], 0.8, 1e-6);
+
+        // Stereo across six outputs repeats left, right, left, ...
+        CHECK(mixer.Configure(ChannelMatrix::createDefault(2, 6)));
+        mixer.Process(stereo, output, 1);
+        bool isRepeated = true;
+        for (unsigned int o = 0; o < 6; o++)
+            isRepeated = isRepeated && output[o] == stereo[o % 2];
+        CHECK(isRepeated);
+
+        // Picking the second input of four puts it, and only it, on every output
+        const float four[] = { 0.1f, 0.7f, -0.3f, 0.9f };
+        CHECK(mixer.Configure(ChannelMatrix::createPickInput(4, 2, 1)));
+        mixer.Process(four, output, 1);
+        CHECK(output[0] == 0.7f && output[1] == 0.7f);
+
+        // An input that does not exist picks silence
+        CHECK(mixer.Configure(ChannelMatrix::createPickInput(4, 2, 4)));
+        mixer.Process(four, output, 1);
+        CHECK(output[0] == 0.0f && output[1] == 0.0f);
+    }
+}
+
+int main()
+{
+    CheckRandomMatrices();
+    CheckKernelChoice();
+    CheckDefaultLayouts();
+    return TEST_RESULT();
+}
@@ -0,0 +1,81 @@
+// Drift the engine measures against the skew the simulated devices actually have
+#include "EngineSimulator.h"
+#include "TestCheck.h"
+
+namespace
+{
+    // Default devices at a fixed buffer target
+    EngineSimulationConfig MakeConfig(bool splitThreads)
+    {
+        EngineSimulationConfig config;
+        config.engineOptions.splitThreads = splitThreads;
+        config.engineOptions.adaptiveBuffer = false;
+        return config;
+    }
+
+    // A few simulated minutes: the estimate must settle on the skew and stay there, not swing
+    // about each time the device periods slip past each other
+    void CheckDriftEstimate(const char* name, EngineSimulationConfig config, double renderSkewPpm)
+    {
+        std::printf("%s, render clock %+.0f ppm\n", name, renderSkewPpm);
+
+        config.render.clockSkewPpm = renderSkewPpm;
+        config.durationSeconds = 300.0;
+        config.sampleSeconds = 5.0;
+
+        EngineSimulator simulator;
+        EngineSimulationResult result;
+        CHECK(simulator.Run(config, result));
+
+        // Positive drift = capture clock faster, so a fast render clock reads as negative drift
+        const double expectedPpm = -renderSkewPpm;
+        double sum = 0.0;
+        unsigned int count = 0;
+        for (const SimulationSample& sample : result.trajectory)
+        {
+            if (sample.timeSeconds < 180.0)
+                continue;
+            CHECK_NEAR(sample.driftPpm, expectedPpm, 20.0);
+            sum += sample.driftPpm;
+            count++;
+        }
+        CHECK(count > 0);
+        if (count > 0)
+            CHECK_NEAR(sum / count, expectedPpm, 5.0);
+    }
+}
+
+int main()
+{
+    for (bool splitThreads : { true, false })
+    {
+        for (double skewPpm : { 100.0, -60.0, 20.0 })
+            CheckDriftEstimate(splitThreads ? "Split threads" : "Single thread", MakeConfig(splitThreads), skewPpm);
+    }
+
+    // Rates and periods that do not line up: the render period slides through the capture events
+    EngineSimulationConfig mismatched = MakeConfig(false);
+    mismatched.capture.format.sampleRate = 44100;
+    mismatched.capture.periodFrames = 512;
+    for (double skewPpm : { 0.0, 100.0 })
+        CheckDriftEstimate("Single thread, 44.1 kHz/512 to 48 kHz/480", mismatched, skewPpm);
+
+    // Late events, and render periods three capture packets long: the render buffer is pre-filled
+    // well above the target, which must not read as drift while the level comes down
+    EngineSimulationConfig jittery = MakeConfig(true);
+    jittery.render.format.sampleRate = 16000;
+    jittery.capture.jitterMs = 3.0;
+    jittery.render.jitterMs = 3.0;
+    for (double skewPpm : { 0.0, -60.0 })
+        CheckDriftEstimate("Split threads, 48 kHz to 16 kHz, 3 ms jitter", jittery, skewPpm);
+
+    // With the adaptive target, which starts low and moves as the jitter makes the device run dry
+    EngineSimulationConfig adaptive = MakeConfig(true);
+    adaptive.engineOptions.adaptiveBuffer = true;
+    adaptive.capture.format.sampleRate = 44100;
+    adaptive.render.jitterMs = 2.0;
+    for (double skewPpm : { 0.0, 100.0 })
+        CheckDriftEstimate("Split threads, adaptive target, 44.1 kHz to 48 kHz, 2 ms jitter", adaptive, skewPpm);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,104 @@
+// Noise suppression through the rate bridge: whatever the call sizes, the audio must come out
+// delayed by the reported latency, with no silence inserted along the way
+#include "NoiseSuppress.h"
+#include "TestCheck.h"
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+    // Stands in for RNNoise: wants 48 kHz in 480-frame frames, and delays the audio by exactly one
+    // frame whatever size the calls come in
+    class DelayProcessor : public INoiseProcessor
+    {
+    public:
+        bool Initialize(unsigned int sampleRate, unsigned int channels) override
+        {
+            (void)sampleRate;
+            m_delay.assign(FrameSize * channels, 0.0f);
+            m_position = 0;
+            return true;
+        }
+
+        void Process(float* audioData, unsigned int frameCount, unsigned int channels) override
+        {
+            for (unsigned int i = 0; i < frameCount * channels; i++)
+            {
+                const float delayed = m_delay[m_position];
+                m_delay[m_position] = audioData[i];
+                audioData[i] = delayed;
+                m_position = (m_position + 1) % m_delay.size();
+            }
+        }
+
+        unsigned int GetLatencyFrames() const override { return FrameSize; }
+        const wchar_t* GetName() const override { return L"Delay"; }
+        unsigned int GetRequiredFrameSize() const override { return FrameSize; }
+        unsigned int GetRequiredSampleRate() const override { return 48000; }
+        void SetDiagnosticCallback(std::function<void(const std::wstring&)> callback) override { (void)callback; }
+
+    private:
+        static const unsigned int FrameSize = 480;
+        std::vector<float> m_delay;
+        size_t m_position = 0;
+    };
+
+    // A 44.1 kHz device with 441-frame periods whose calls now and then come in other sizes
+    void CheckMixedCallSizes()
+    {
+        const unsigned int rate = 44100;
+        const unsigned int period = 441;
+        const unsigned int callSizes[] = { 441, 441, 300, 582 };
+        const unsigned int rounds = 50;
+
+        NoiseReductionConfig config;
+        config.type = NoiseReductionType::RNNoise;
+        NoiseSuppress noiseSuppress;
+        CHECK(noiseSuppress.Initialize(config, std::unique_ptr<INoiseProcessor>(new DelayProcessor()), rate, 1));
+        noiseSuppress.SetCallFrameCount(period);
+        BufferArena arena;
+        noiseSuppress.ReserveBuffers(arena, 1024);
+        CHECK(arena.Allocate());
+
+        const unsigned int latency = noiseSuppress.GetLatencyFrames();
+        std::printf("Calls of 441/441/300/582 frames at 44.1 kHz, latency %u frames\n", latency);
+
+        std::vector<float> input;
+        std::vector<float> output;
+        for (unsigned int round = 0; round < rounds; round++)
+        {
+            for (unsigned int frames : callSizes)
+            {
+                std::vector<float> call(frames);
+                for (unsigned int i = 0; i < frames; i++)
+                    call[i] = 0.5f * (float)std::sin(2.0 * 3.141592653589793 * 200.0 * (input.size() + i) / rate);
+                input.insert(input.end(), call.begin(), call.end());
+                noiseSuppress.Process(call.data(), frames, 1);
+                output.insert(output.end(), call.begin(), call.end());
+            }
+        }
+
+        // Past the warm-up the tone never stops: any run of silence was inserted
+        const size_t warmUp = latency + 2 * period;
+        unsigned int longestSilence = 0;
+        unsigned int silence = 0;
+        for (size_t i = warmUp; i < output.size(); i++)
+        {
+            silence = (std::fabs(output[i]) < 1e-4f) ? silence + 1 : 0;
+            longestSilence = std::max(longestSilence, silence);
+        }
+        CHECK(longestSilence <= 2);
+
+        // And the tone comes out as it went in, as late as reported
+        double worstError = 0.0;
+        for (size_t i = warmUp; i < output.size(); i++)
+            worstError = std::max(worstError, (double)std::fabs(output[i] - input[i - latency]));
+        CHECK_NEAR(worstError, 0.0, 0.02);
+    }
+}
+
+int main()
+{
+    CheckMixedCallSizes();
+    return TEST_RESULT();
+}
@@ -0,0 +1,150 @@
+// Per-channel noise processing: each channel of an interleaved block must come out exactly as a
+// single-channel processor of its own would make it, on one thread or on the worker pool
+#include "PerChannelNoiseProcessor.h"
+#include "TestCheck.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace
+{
+    const unsigned int SampleRate = 48000;
+    const unsigned int MaxCallFrames = 1024;
+
+    // Sizes the engine hands the processor, with a few odd ones
+    const unsigned int CallSizes[] = { 480, 441, 1, 97, 1024, 300 };
+
+    // Stands in for a denoiser: a one-pole smoother behind a short delay, so its output depends
+    // on everything it has been given, and any audio or state from another channel shows.
+    // Refuses anything but mono, as a wrapped instance only ever sees one channel.
+    class SmoothingProcessor : public INoiseProcessor
+    {
+    public:
+        bool Initialize(unsigned int sampleRate, unsigned int channels) override
+        {
+            (void)sampleRate;
+            if (channels != 1)
+                return false;
+            m_delay.assign(Delay, 0.0f);
+            m_position = 0;
+            m_smoothed = 0.0f;
+            return true;
+        }
+
+        void Process(float* audioData, unsigned int frameCount, unsigned int channels) override
+        {
+            for (unsigned int i = 0; i < frameCount * channels; i++)
+            {
+                m_smoothed += 0.3f * (audioData[i] - m_smoothed);
+                audioData[i] = m_delay[m_position];
+                m_delay[m_position] = m_smoothed;
+                m_position = (m_position + 1) % Delay;
+            }
+        }
+
+        unsigned int GetLatencyFrames() const override { return Delay; }
+        const wchar_t* GetName() const override { return L"Smoothing"; }
+        unsigned int GetRequiredFrameSize() const override { return 480; }
+        unsigned int GetRequiredSampleRate() const override { return SampleRate; }
+        void SetDiagnosticCallback(std::function<void(const std::wstring&)> callback) override { (void)callback; }
+
+    private:
+        static const unsigned int Delay = 37;
+        std::vector<float> m_delay;
+        unsigned int m_position = 0;
+        float m_smoothed = 0.0f;
+    };
+
+    std::unique_ptr<INoiseProcessor> CreateSmoothing()
+    {
+        return std::unique_ptr<INoiseProcessor>(new SmoothingProcessor());
+    }
+
+    // Channels of different noise, so one channel's audio in another would not go unnoticed
+    std::vector<float> MakeNoise(unsigned int frames, unsigned int channels)
+    {
+        std::mt19937 random(channels);
+        std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+        std::vector<float> noise((size_t)frames * channels);
+        for (float& sample : noise)
+            sample = value(random);
+        return noise;
+    }
+
+    // maxWorkers as SetMaxWorkers() takes it (0 = as many as the channels and cores allow)
+    void CheckMatchesSingleChannel(unsigned int channels, unsigned int maxWorkers)
+    {
+        const unsigned int totalFrames = SampleRate;
+        const std::vector<float> input = MakeNoise(totalFrames, channels);
+
+        PerChannelNoiseProcessor processor(CreateSmoothing);
+        processor.SetMaxWorkers(maxWorkers);
+        CHECK(processor.Initialize(SampleRate, channels));
+        BufferArena arena;
+        processor.ReserveBuffers(arena, MaxCallFrames);
+        CHECK(arena.Allocate());
+        std::printf("%u channels, %u workers running\n", channels, processor.GetWorkerCount());
+        CHECK(processor.GetLatencyFrames() == SmoothingProcessor().GetLatencyFrames());
+        if (maxWorkers > 0)
+            CHECK(processor.GetWorkerCount() <= maxWorkers);
+        if (channels <= PerChannelNoiseProcessor::ParallelThreshold)
+            CHECK(processor.GetWorkerCount() == 0);
+
+        std::vector<float> output = input;
+        unsigned int position = 0;
+        for (unsigned int call = 0; position < totalFrames; call++)
+        {
+            const unsigned int frames = std::min(CallSizes[call % 6], totalFrames - position);
+            processor.Process(output.data() + (size_t)position * channels, frames, channels);
+            position += frames;
+        }
+
+        // The same channel through a processor of its own, in one call
+        bool isSame = true;
+        for (unsigned int ch = 0; ch < channels; ch++)
+        {
+            std::vector<float> plane(totalFrames);
+            for (unsigned int i = 0; i < totalFrames; i++)
+                plane[i] = input[(size_t)i * channels + ch];
+            SmoothingProcessor single;
+            CHECK(single.Initialize(SampleRate, 1));
+            single.Process(plane.data(), totalFrames, 1);
+            for (unsigned int i = 0; i < totalFrames; i++)
+                isSame = isSame && output[(size_t)i * channels + ch] == plane[i];
+        }
+        CHECK(isSame);
+    }
+
+    // Blocks the processor cannot take are left as they are
+    void CheckRefusedBlocks()
+    {
+        std::printf("Blocks that do not fit\n");
+        const unsigned int channels = 2;
+        PerChannelNoiseProcessor processor(CreateSmoothing);
+        CHECK(!processor.Initialize(SampleRate, 0));
+        CHECK(processor.Initialize(SampleRate, channels));
+        BufferArena arena;
+        processor.ReserveBuffers(arena, MaxCallFrames);
+        CHECK(arena.Allocate());
+
+        // Larger than reserved, or with a different channel count
+        std::vector<float> block = MakeNoise(MaxCallFrames + 1, channels);
+        const std::vector<float> original = block;
+        processor.Process(block.data(), MaxCallFrames + 1, channels);
+        CHECK(block == original);
+        processor.Process(block.data(), MaxCallFrames / 2, channels + 1);
+        CHECK(block == original);
+    }
+}
+
+int main()
+{
+    CheckMatchesSingleChannel(1, 0);
+    CheckMatchesSingleChannel(2, 0);
+    CheckMatchesSingleChannel(3, 0);
+    CheckMatchesSingleChannel(6, 0);
+    CheckMatchesSingleChannel(6, 1);
+    CheckMatchesSingleChannel(8, 3);
+    CheckRefusedBlocks();
+    return TEST_RESULT();
+}
@@ -0,0 +1,210 @@
+// Resampler: which polyphase table is in use, how much comes out, whether a tone comes out at
+// its frequency, and that the SIMD kernels compute what the scalar ones do
+#include "Resampler.h"
+#include "TestCheck.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace
+{
+    const double Pi = 3.14159265358979323846;
+    const double ToneHz = 1000.0;
+
+    // Sizes the capture side hands the engine, with a few odd ones
+    const unsigned int CallSizes[] = { 480, 441, 512, 1, 97, 1024, 3000, 256 };
+
+    // Runs seconds of a mono tone through in calls of CallSizes, with the ratio trimmed by
+    // trimPpm. Checks every call against GetMaxOutputFrames(); returns all output.
+    std::vector<float> Convert(Resampler& resampler, unsigned int inputRate, double seconds, double trimPpm)
+    {
+        const unsigned int totalFrames = (unsigned int)(inputRate * seconds);
+        std::vector<float> input(totalFrames);
+        for (unsigned int i = 0; i < totalFrames; i++)
+            input[i] = 0.5f * (float)std::sin(2.0 * Pi * ToneHz * i / inputRate);
+
+        resampler.SetRatioAdjustment(trimPpm);
+        std::vector<float> output;
+        std::vector<float> block;
+        unsigned int position = 0;
+        bool isWithinBound = true;
+        for (unsigned int call = 0; position < totalFrames; call++)
+        {
+            const unsigned int frames = std::min(CallSizes[call % 8], totalFrames - position);
+            const unsigned int maxFrames = resampler.GetMaxOutputFrames(frames);
+            block.assign(maxFrames + 64, 0.0f);
+            const unsigned int produced = resampler.Process(input.data() + position, frames, block.data());
+            isWithinBound = isWithinBound && produced <= maxFrames;
+            output.insert(output.end(), block.begin(), block.begin() + produced);
+            position += frames;
+        }
+        CHECK(isWithinBound);
+        return output;
+    }
+
+    // Frequency from the rising zero crossings between from and the end, interpolated to
+    // fractions of a frame
+    double MeasureFrequency(const std::vector<float>& samples, size_t from, unsigned int rate)
+    {
+        double first = -1.0;
+        double last = -1.0;
+        unsigned int crossings = 0;
+        for (size_t i = from + 1; i < samples.size(); i++)
+        {
+            if (samples[i - 1] < 0.0f && samples[i] >= 0.0f)
+            {
+                const double at = (i - 1) + samples[i - 1] / (double)(samples[i - 1] - samples[i]);
+                if (first < 0.0)
+                    first = at;
+                else
+                    crossings++;
+                last = at;
+            }
+        }
+        return crossings > 0 ? crossings * rate / (last - first) : 0.0;
+    }
+
+    double MeasureAmplitude(const std::vector<float>& samples, size_t from)
+    {
+        double sum = 0.0;
+        for (size_t i = from; i < samples.size(); i++)
+            sum += (double)samples[i] * samples[i];
+        return std::sqrt(2.0 * sum / (samples.size() - from));
+    }
+
+    void CheckTableChoice()
+    {
+        std::printf("Exact rows up to a ratio denominator of 1024, interpolated past it or when trimmed\n");
+        Resampler resampler;
+        CHECK(resampler.Configure(44100, 48000, 1));            // 147/160
+        CHECK(resampler.IsUsingDirectTable());
+        CHECK(resampler.Configure(48000, 44100, 1));            // 160/147
+        CHECK(resampler.IsUsingDirectTable());
+        CHECK(resampler.Configure(1023, 1024, 1));              // 1023/1024
+        CHECK(resampler.IsUsingDirectTable());
+        CHECK(resampler.Configure(1024, 1025, 1));              // 1024/1025
+        CHECK(!resampler.IsUsingDirectTable());
+        CHECK(resampler.Configure(44100, 47999, 1));
+        CHECK(!resampler.IsUsingDirectTable());
+
+        // Trimming leaves the exact rows, and coming back to the plain ratio returns to them
+        CHECK(resampler.Configure(44100, 48000, 1, true));
+        resampler.SetRatioAdjustment(5.0);
+        CHECK(!resampler.IsUsingDirectTable());
+        resampler.SetRatioAdjustment(0.0);
+        CHECK(resampler.IsUsingDirectTable());
+
+        // Equal rates copy unless asked to stay steerable
+        CHECK(resampler.Configure(48000, 48000, 1));
+        CHECK(resampler.IsPassthrough());
+        CHECK(resampler.Configure(48000, 48000, 1, true));
+        CHECK(!resampler.IsPassthrough());
+    }
+
+    // The tone must come out at its frequency and level, as many frames as the ratio says
+    void CheckConversion(unsigned int inputRate, unsigned int outputRate, double trimPpm)
+    {
+        std::printf("%u Hz to %u Hz, trimmed %+.0f ppm\n", inputRate, outputRate, trimPpm);
+        const double seconds = 4.0;
+        Resampler resampler;
+        CHECK(resampler.Configure(inputRate, outputRate, 1, true));
+        std::vector<float> output = Convert(resampler, inputRate, seconds, trimPpm);
+
+        // Trimming consumes input faster: fewer frames, so the tone plays higher
+        const double trim = 1.0 + trimPpm * 1e-6;
+        const double expectedFrames = inputRate * seconds * outputRate / inputRate / trim - resampler.GetLatencyFrames();
+        CHECK_NEAR((double)output.size(), expectedFrames, 3.0);
+
+        const size_t settled = outputRate / 10;
+        CHECK_NEAR(MeasureFrequency(output, settled, outputRate), ToneHz * trim, ToneHz * 2e-5);
+        CHECK_NEAR(MeasureAmplitude(output, settled), 0.5, 0.005);
+    }
+
+    // Ratio trimmed back and forth between calls, as drift compensation does, at a large
+    // downsampling factor where the filter is longest
+    void CheckMaxOutputWhileTrimming()
+    {
+        std::printf("Output bound while the ratio changes between calls\n");
+        const unsigned int rates[][2] = { { 44100, 48000 }, { 48000, 8000 }, { 8000, 48000 }, { 44100, 47999 } };
+        const double trims[] = { 0.0, 1000.0, -1000.0, 0.0, 250.0 };
+        std::vector<float> input(4000, 0.25f);
+        std::vector<float> output;
+        for (const auto& rate : rates)
+        {
+            Resampler resampler;
+            CHECK(resampler.Configure(rate[0], rate[1], 1, true));
+            bool isWithinBound = true;
+            for (unsigned int call = 0; call < 400; call++)
+            {
+                resampler.SetRatioAdjustment(trims[call % 5]);
+                const unsigned int frames = CallSizes[call % 8];
+                const unsigned int maxFrames = resampler.GetMaxOutputFrames(frames);
+                output.assign(maxFrames + 64, 0.0f);
+                isWithinBound = isWithinBound && resampler.Process(input.data(), frames, output.data()) <= maxFrames;
+            }
+            CHECK(isWithinBound);
+        }
+    }
+
+    void CheckKernelsAgree()
+    {
+        std::printf("SIMD kernels against the scalar ones\n");
+        std::mt19937 random(7);
+        std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+        const unsigned int taps = 64;
+
+        // Coefficient rows are aligned; the samples start anywhere
+        alignas(32) float coeffs0[taps];
+        alignas(32) float coeffs1[taps];
+        std::vector<float> samples(taps + 8);
+        for (unsigned int i = 0; i < taps; i++)
+        {
+            coeffs0[i] = value(random);
+            coeffs1[i] = value(random);
+        }
+        for (float& sample : samples)
+            sample = value(random);
+
+        const CpuFeatures& cpu = GetCpuFeatures();
+        (void)cpu;
+        for (unsigned int offset = 0; offset < 8; offset++)
+        {
+            for (unsigned int length = 8; length <= taps; length += 8)
+            {
+                const float* s = samples.data() + offset;
+                const float frac = 0.37f;
+                const float dot = ResamplerKernels::DotProductScalar(s, coeffs0, length);
+                const float interpolated = ResamplerKernels::InterpolatedDotProductScalar(s, coeffs0, coeffs1, frac, length);
+                (void)dot;
+                (void)interpolated;
+#ifdef AUDIOROUTER_X86
+                if (cpu.hasSse2)
+                {
+                    CHECK_NEAR(ResamplerKernels::DotProductSse(s, coeffs0, length), dot, 1e-5);
+                    CHECK_NEAR(ResamplerKernels::InterpolatedDotProductSse(s, coeffs0, coeffs1, frac, length), interpolated, 1e-5);
+                }
+#endif
+#ifdef AUDIOROUTER_HAVE_AVX2
+                if (cpu.hasAvx2 && cpu.hasFma)
+                {
+                    CHECK_NEAR(ResamplerKernels::DotProductAvx2(s, coeffs0, length), dot, 1e-5);
+                    CHECK_NEAR(ResamplerKernels::InterpolatedDotProductAvx2(s, coeffs0, coeffs1, frac, length), interpolated, 1e-5);
+                }
+#endif
+            }
+        }
+    }
+}
+
+int main()
+{
+    CheckTableChoice();
+    CheckConversion(44100, 48000, 0.0);
+    CheckConversion(48000, 44100, 0.0);
+    CheckConversion(44100, 48000, 500.0);
+    CheckConversion(44100, 47999, 0.0);
+    CheckConversion(48000, 44100, -300.0);
+    CheckMaxOutputWhileTrimming();
+    CheckKernelsAgree();
+    return TEST_RESULT();
+}
@@ -0,0 +1,279 @@
+// SampleConverter: every format coming back from float as it went in, saturating at its range
+// instead of wrapping, and the SIMD kernels encoding and decoding what the scalar ones do
+#include "SampleConverter.h"
+#include "TestCheck.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace
+{
+    // Largest float the PCM32 kernels write for full scale: INT32_MAX itself is not a float
+    const int32_t MaxPcm32 = 2147483520;
+
+    const size_t BytesPerSample[] = { 4, 2, 3, 4 };
+
+    size_t GetBytesPerSample(SampleFormat format)
+    {
+        return BytesPerSample[(int)format];
+    }
+
+    const char* GetFormatName(SampleFormat format)
+    {
+        switch (format)
+        {
+        case SampleFormat::Float32: return "Float32";
+        case SampleFormat::PCM16: return "PCM16";
+        case SampleFormat::PCM24: return "PCM24";
+        case SampleFormat::PCM32: return "PCM32";
+        }
+        return "?";
+    }
+
+    // Sample i of a buffer in format, sign extended
+    int32_t ReadCode(SampleFormat format, const std::vector<uint8_t>& data, size_t i)
+    {
+        switch (format)
+        {
+        case SampleFormat::PCM16:
+        {
+            int16_t value;
+            std::memcpy(&value, data.data() + i * 2, 2);
+            return value;
+        }
+        case SampleFormat::PCM24:
+        {
+            const uint8_t* bytes = data.data() + i * 3;
+            return (int32_t)(((uint32_t)bytes[0] << 8) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 24)) >> 8;
+        }
+        default:
+        {
+            int32_t value;
+            std::memcpy(&value, data.data() + i * 4, 4);
+            return value;
+        }
+        }
+    }
+
+    void WriteCode(SampleFormat format, std::vector<uint8_t>& data, size_t i, int32_t code)
+    {
+        switch (format)
+        {
+        case SampleFormat::PCM16:
+        {
+            const int16_t value = (int16_t)code;
+            std::memcpy(data.data() + i * 2, &value, 2);
+            break;
+        }
+        case SampleFormat::PCM24:
+            data[i * 3] = (uint8_t)code;
+            data[i * 3 + 1] = (uint8_t)(code >> 8);
+            data[i * 3 + 2] = (uint8_t)(code >> 16);
+            break;
+        default:
+            std::memcpy(data.data() + i * 4, &code, 4);
+            break;
+        }
+    }
+
+    // Integer codes across the whole range, the extremes included, in a count that leaves a
+    // remainder behind every vector width
+    std::vector<int32_t> MakeCodes(SampleFormat format)
+    {
+        const int bits = format == SampleFormat::PCM16 ? 16 : format == SampleFormat::PCM24 ? 24 : 32;
+        const int64_t minCode = -((int64_t)1 << (bits - 1));
+        const int64_t maxCode = ((int64_t)1 << (bits - 1)) - 1;
+        std::vector<int32_t> codes;
+        for (int64_t code = minCode; code <= maxCode; code += (maxCode - minCode) / 4001)
+            codes.push_back((int32_t)code);
+        for (int32_t code : { -1, 0, 1, 2, -2, 255, -256 })
+            codes.push_back(code);
+        codes.push_back((int32_t)maxCode);
+        codes.push_back((int32_t)minCode);
+        return codes;
+    }
+
+    // Integer -> float -> integer gives back the code: exactly up to 24 bits, and to float
+    // precision (128 near full scale) for PCM32
+    void CheckIntegerRoundTrip(SampleFormat format)
+    {
+        std::printf("%s: integer codes through float and back\n", GetFormatName(format));
+        SampleConverter converter;
+        converter.Configure(format);
+
+        const std::vector<int32_t> codes = MakeCodes(format);
+        std::vector<uint8_t> input(codes.size() * GetBytesPerSample(format));
+        for (size_t i = 0; i < codes.size(); i++)
+            WriteCode(format, input, i, codes[i]);
+
+        std::vector<float> samples(codes.size());
+        std::vector<uint8_t> output(input.size());
+        converter.ToFloat(input.data(), samples.data(), codes.size());
+        converter.FromFloat(samples.data(), output.data(), codes.size());
+
+        const double scale = format == SampleFormat::PCM16 ? 32768.0 : format == SampleFormat::PCM24 ? 8388608.0 : 2147483648.0;
+        const double tolerance = format == SampleFormat::PCM32 ? 128.0 : 0.0;
+        bool isScaled = true;
+        bool isRoundTrip = true;
+        for (size_t i = 0; i < codes.size(); i++)
+        {
+            isScaled = isScaled && std::fabs(samples[i] * scale - codes[i]) <= tolerance;
+            isRoundTrip = isRoundTrip && std::fabs((double)ReadCode(format, output, i) - codes[i]) <= tolerance;
+        }
+        CHECK(isScaled);
+        CHECK(isRoundTrip);
+        CHECK(samples[codes.size() - 1] == -1.0f);
+    }
+
+    // Float -> integer -> float lands within half a step of where it started
+    void CheckFloatRoundTrip(SampleFormat format)
+    {
+        std::printf("%s: float through the format and back\n", GetFormatName(format));
+        SampleConverter converter;
+        converter.Configure(format);
+
+        std::mt19937 random(11);
+        std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+        std::vector<float> input(4003);
+        for (float& sample : input)
+            sample = value(random);
+
+        std::vector<uint8_t> encoded(input.size() * GetBytesPerSample(format));
+        std::vector<float> output(input.size());
+        converter.FromFloat(input.data(), encoded.data(), input.size());
+        converter.ToFloat(encoded.data(), output.data(), input.size());
+
+        const double halfStep = format == SampleFormat::Float32 ? 0.0 :
+            format == SampleFormat::PCM16 ? 0.5 / 32768.0 :
+            format == SampleFormat::PCM24 ? 0.5 / 8388608.0 : 1e-7;
+        double worst = 0.0;
+        for (size_t i = 0; i < input.size(); i++)
+            worst = std::max(worst, std::fabs((double)output[i] - input[i]));
+        CHECK_NEAR(worst, 0.0, halfStep);
+    }
+
+    // Out of range saturates to the end of the range rather than wrapping; NaN goes to the bottom
+    void CheckClipping(SampleFormat format, bool dither)
+    {
+        std::printf("%s: clipping%s\n", GetFormatName(format), dither ? ", dithered" : "");
+        SampleConverter converter;
+        converter.Configure(format, dither);
+
+        const int32_t maxCode = format == SampleFormat::PCM16 ? 32767 : format == SampleFormat::PCM24 ? 8388607 : MaxPcm32;
+        const int32_t minCode = format == SampleFormat::PCM16 ? -32768 : format == SampleFormat::PCM24 ? -8388608 : INT32_MIN;
+        const float input[] = { 1.0f, 1.0001f, 2.0f, 1e30f, std::numeric_limits<float>::infinity(),
+                                -1.0001f, -2.0f, -1e30f, -std::numeric_limits<float>::infinity(),
+                                std::numeric_limits<float>::quiet_NaN() };
+        const int32_t expected[] = { maxCode, maxCode, maxCode, maxCode, maxCode,
+                                     minCode, minCode, minCode, minCode, minCode };
+        const size_t count = sizeof(input) / sizeof(input[0]);
+
+        // Repeated so the vector loops see every value, not only the scalar tail
+        std::vector<float> samples;
+        for (unsigned int repeat = 0; repeat < 5; repeat++)
+            samples.insert(samples.end(), input, input + count);
+        std::vector<uint8_t> output(samples.size() * GetBytesPerSample(format));
+        converter.FromFloat(samples.data(), output.data(), samples.size());
+
+        bool isSaturated = true;
+        for (size_t i = 0; i < samples.size(); i++)
+            isSaturated = isSaturated && ReadCode(format, output, i) == expected[i % count];
+        CHECK(isSaturated);
+
+        // Full scale negative is representable exactly (dither may move it up a step)
+        const float minusOne = -1.0f;
+        converter.FromFloat(&minusOne, output.data(), 1);
+        CHECK_NEAR(ReadCode(format, output, 0), minCode, dither ? 1.0 : 0.0);
+    }
+
+    // Float devices take what they are given, out of range included: the device clips
+    void CheckFloatPassthrough()
+    {
+        std::printf("Float32: copied unchanged\n");
+        SampleConverter converter;
+        converter.Configure(SampleFormat::Float32);
+        const float input[] = { 0.0f, -0.5f, 1.0f, 2.0f, -3.5f, 1e-30f, 0.123456789f };
+        float encoded[7];
+        float output[7];
+        converter.FromFloat(input, encoded, 7);
+        converter.ToFloat(encoded, output, 7);
+        CHECK(std::memcmp(input, encoded, sizeof(input)) == 0);
+        CHECK(std::memcmp(input, output, sizeof(input)) == 0);
+    }
+
+    typedef SampleConvertKernels::ToFloatFn ToFloatFn;
+    typedef SampleConvertKernels::FromFloatFn FromFloatFn;
+
+    // Every length up to a few vectors, so each kernel's tail handling is covered
+    void CheckKernelAgrees(SampleFormat format, ToFloatFn toFloat, FromFloatFn fromFloat,
+                           ToFloatFn scalarToFloat, FromFloatFn scalarFromFloat)
+    {
+        std::mt19937 random(5);
+        std::uniform_real_distribution<float> value(-1.2f, 1.2f);
+        const size_t bytes = GetBytesPerSample(format);
+        bool isSame = true;
+        for (size_t length = 0; length <= 40; length++)
+        {
+            std::vector<float> input(length);
+            for (float& sample : input)
+                sample = value(random);
+
+            // A sentinel byte past the end catches a kernel writing too far
+            std::vector<uint8_t> expected(length * bytes + 1, 0xA5);
+            std::vector<uint8_t> actual(length * bytes + 1, 0xA5);
+            scalarFromFloat(input.data(), expected.data(), length, nullptr);
+            fromFloat(input.data(), actual.data(), length, nullptr);
+            isSame = isSame && expected == actual;
+
+            std::vector<float> expectedFloat(length + 1, 7.0f);
+            std::vector<float> actualFloat(length + 1, 7.0f);
+            scalarToFloat(expected.data(), expectedFloat.data(), length);
+            toFloat(expected.data(), actualFloat.data(), length);
+            isSame = isSame && expectedFloat == actualFloat;
+        }
+        CHECK(isSame);
+    }
+
+    void CheckKernelsAgree()
+    {
+        std::printf("SIMD kernels against the scalar ones\n");
+        using namespace SampleConvertKernels;
+        const CpuFeatures& cpu = GetCpuFeatures();
+        (void)cpu;
+#ifdef AUDIOROUTER_X86
+        if (cpu.hasSse2)
+        {
+            CheckKernelAgrees(SampleFormat::PCM16, Pcm16ToFloatSse2, FloatToPcm16Sse2, Pcm16ToFloatScalar, FloatToPcm16Scalar);
+            CheckKernelAgrees(SampleFormat::PCM24, Pcm24ToFloatSse2, FloatToPcm24Sse2, Pcm24ToFloatScalar, FloatToPcm24Scalar);
+            CheckKernelAgrees(SampleFormat::PCM32, Pcm32ToFloatSse2, FloatToPcm32Sse2, Pcm32ToFloatScalar, FloatToPcm32Scalar);
+        }
+#endif
+#ifdef AUDIOROUTER_HAVE_AVX2
+        if (cpu.hasAvx2)
+        {
+            CheckKernelAgrees(SampleFormat::PCM16, Pcm16ToFloatAvx2, FloatToPcm16Avx2, Pcm16ToFloatScalar, FloatToPcm16Scalar);
+            CheckKernelAgrees(SampleFormat::PCM24, Pcm24ToFloatAvx2, FloatToPcm24Avx2, Pcm24ToFloatScalar, FloatToPcm24Scalar);
+            CheckKernelAgrees(SampleFormat::PCM32, Pcm32ToFloatAvx2, FloatToPcm32Avx2, Pcm32ToFloatScalar, FloatToPcm32Scalar);
+        }
+#endif
+    }
+}
+
+int main()
+{
+    for (SampleFormat format : { SampleFormat::PCM16, SampleFormat::PCM24, SampleFormat::PCM32 })
+    {
+        CheckIntegerRoundTrip(format);
+        CheckFloatRoundTrip(format);
+        CheckClipping(format, false);
+        if (format != SampleFormat::PCM32)
+            CheckClipping(format, true);
+    }
+    CheckFloatRoundTrip(SampleFormat::Float32);
+    CheckFloatPassthrough();
+    CheckKernelsAgree();
+    return TEST_RESULT();
+}
@@ -0,0 +1,183 @@
+// Capture->render queue: spans across the wrap, the full and empty boundaries, and frames
+// coming out in order while a producer and a consumer thread run against each other
+#include "SpscRingBuffer.h"
+#include "TestCheck.h"
+#include <thread>
+#include <vector>
+
+namespace
+{
+    const unsigned int Channels = 2;
+
+    // Frame n carries n in its first channel and -n in its second
+    void FillFrames(float* data, size_t frames, size_t first)
+    {
+        for (size_t i = 0; i < frames; i++)
+        {
+            data[i * Channels] = (float)(first + i);
+            data[i * Channels + 1] = -(float)(first + i);
+        }
+    }
+
+    bool AreFrames(const float* data, size_t frames, size_t first)
+    {
+        for (size_t i = 0; i < frames; i++)
+        {
+            if (data[i * Channels] != (float)(first + i) || data[i * Channels + 1] != -(float)(first + i))
+                return false;
+        }
+        return true;
+    }
+
+    void CheckCapacity()
+    {
+        std::printf("Capacity rounded up to a power of two\n");
+        SpscRingBuffer ring;
+        ring.Reset(1000, Channels);
+        CHECK(ring.GetCapacityFrames() == 1024);
+        CHECK(ring.GetChannels() == Channels);
+        CHECK(ring.GetReadAvailable() == 0);
+        CHECK(ring.GetWriteAvailable() == 1024);
+
+        ring.Reset(64, Channels);
+        CHECK(ring.GetCapacityFrames() == 64);
+    }
+
+    void CheckFullAndEmpty()
+    {
+        std::printf("Full and empty\n");
+        SpscRingBuffer ring;
+        ring.Reset(64, Channels);
+        std::vector<float> frames(100 * Channels);
+        FillFrames(frames.data(), 100, 0);
+
+        // Empty: nothing to read or skip
+        SpscRingBuffer::Span first, second;
+        CHECK(ring.GetReadSpans(10, &first, &second) == 0);
+        CHECK(first.frames == 0 && second.frames == 0);
+        CHECK(ring.Skip(10) == 0);
+
+        // Only the capacity goes in, and nothing more once full
+        CHECK(ring.Write(frames.data(), 100) == 64);
+        CHECK(ring.GetReadAvailable() == 64);
+        CHECK(ring.GetWriteAvailable() == 0);
+        CHECK(ring.GetWriteSpans(1, &first, &second) == 0);
+        CHECK(ring.Write(frames.data(), 1) == 0);
+        CHECK(ring.WriteSilence(1) == 0);
+
+        // And all of it comes out, then nothing
+        std::vector<float> out(100 * Channels);
+        CHECK(ring.Read(out.data(), 100) == 64);
+        CHECK(AreFrames(out.data(), 64, 0));
+        CHECK(ring.GetReadAvailable() == 0);
+        CHECK(ring.GetWriteAvailable() == 64);
+        CHECK(ring.Read(out.data(), 1) == 0);
+    }
+
+    void CheckWrappedSpans()
+    {
+        std::printf("Spans across the wrap\n");
+        SpscRingBuffer ring;
+        ring.Reset(64, Channels);
+        std::vector<float> frames(64 * Channels);
+        std::vector<float> out(64 * Channels);
+
+        // Move both indices to 50 frames in
+        FillFrames(frames.data(), 50, 0);
+        CHECK(ring.Write(frames.data(), 50) == 50);
+        CHECK(ring.Skip(50) == 50);
+
+        // 30 frames from 50: 14 up to the end, 16 from the start
+        SpscRingBuffer::Span first, second;
+        CHECK(ring.GetWriteSpans(30, &first, &second) == 30);
+        CHECK(first.frames == 14);
+        CHECK(second.frames == 16);
+        FillFrames(first.data, first.frames, 1000);
+        FillFrames(second.data, second.frames, 1000 + first.frames);
+        CHECK(ring.GetReadAvailable() == 0);
+        ring.CommitWrite(30);
+        CHECK(ring.GetReadAvailable() == 30);
+
+        // Read back in the same two pieces
+        CHECK(ring.GetReadSpans(64, &first, &second) == 30);
+        CHECK(first.frames == 14);
+        CHECK(second.frames == 16);
+        CHECK(AreFrames(first.data, first.frames, 1000));
+        CHECK(AreFrames(second.data, second.frames, 1014));
+
+        // Skipping across the wrap lands where a read would have
+        CHECK(ring.Skip(20) == 20);
+        CHECK(ring.Read(out.data(), 64) == 10);
+        CHECK(AreFrames(out.data(), 10, 1020));
+
+        // Up to the end exactly: one span, then the next starts at the beginning
+        FillFrames(frames.data(), 64, 0);
+        CHECK(ring.Write(frames.data(), 48) == 48);
+        CHECK(ring.GetReadSpans(48, &first, &second) == 48);
+        CHECK(first.frames == 48 && second.frames == 0);
+        ring.CommitRead(48);
+        CHECK(ring.GetWriteSpans(64, &first, &second) == 64);
+        CHECK(first.frames == 64 && second.frames == 0);
+
+        // Silence across the wrap
+        CHECK(ring.Write(frames.data(), 60) == 60);
+        CHECK(ring.Skip(60) == 60);
+        CHECK(ring.WriteSilence(10) == 10);
+        CHECK(ring.Read(out.data(), 10) == 10);
+        bool isSilent = true;
+        for (size_t i = 0; i < 10 * Channels; i++)
+            isSilent = isSilent && out[i] == 0.0f;
+        CHECK(isSilent);
+    }
+
+    // Odd-sized writes and reads on two threads: every frame arrives once and in order
+    void CheckTwoThreads()
+    {
+        std::printf("Producer and consumer threads\n");
+        const size_t totalFrames = 2000000;
+        SpscRingBuffer ring;
+        ring.Reset(1000, Channels);
+
+        std::thread producer([&ring, totalFrames]()
+        {
+            std::vector<float> frames(97 * Channels);
+            size_t written = 0;
+            while (written < totalFrames)
+            {
+                size_t count = 1 + written % 97;
+                if (count > totalFrames - written)
+                    count = totalFrames - written;
+                FillFrames(frames.data(), count, written);
+                written += ring.Write(frames.data(), count);
+                if (ring.GetWriteAvailable() == 0)
+                    std::this_thread::yield();
+            }
+        });
+
+        std::vector<float> out(113 * Channels);
+        size_t read = 0;
+        bool inOrder = true;
+        while (read < totalFrames)
+        {
+            size_t count = ring.Read(out.data(), 1 + read % 113);
+            inOrder = inOrder && AreFrames(out.data(), count, read);
+            read += count;
+            if (count == 0)
+                std::this_thread::yield();
+        }
+        producer.join();
+
+        CHECK(inOrder);
+        CHECK(read == totalFrames);
+        CHECK(ring.GetReadAvailable() == 0);
+    }
+}
+
+int main()
+{
+    CheckCapacity();
+    CheckFullAndEmpty();
+    CheckWrappedSpans();
+    CheckTwoThreads();
+    return TEST_RESULT();
+}
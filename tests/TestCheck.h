@@ -0,0 +1,40 @@
+#pragma once
+
+// Minimal checks for the regression tests. Each test is its own program that runs its cases
+// from main() and returns TEST_RESULT(): non-zero when any check failed, which CTest reports.
+
+#include <cmath>
+#include <cstdio>
+
+namespace TestCheck
+{
+    inline unsigned int& Failures()
+    {
+        static unsigned int failures = 0;
+        return failures;
+    }
+
+    inline void Fail(const char* file, int line, const char* what)
+    {
+        std::printf("%s:%d: FAILED: %s\n", file, line, what);
+        Failures()++;
+    }
+}
+
+#define CHECK(condition) \
+    do { if (!(condition)) TestCheck::Fail(__FILE__, __LINE__, #condition); } while (0)
+
+// Tolerance inclusive; a NaN never passes
+#define CHECK_NEAR(actual, expected, tolerance) \
+    do { \
+        const double checkActual = (actual), checkExpected = (expected); \
+        if (!(std::fabs(checkActual - checkExpected) <= (tolerance))) \
+        { \
+            std::printf("    %s = %.3f, expected %.3f +- %.3f\n", #actual, checkActual, checkExpected, (double)(tolerance)); \
+            TestCheck::Fail(__FILE__, __LINE__, #actual " near " #expected); \
+        } \
+    } while (0)
+
+#define TEST_RESULT() \
+    (std::printf(TestCheck::Failures() == 0 ? "All checks passed\n" : "%u checks failed\n", TestCheck::Failures()), \
+     TestCheck::Failures() == 0 ? 0 : 1)
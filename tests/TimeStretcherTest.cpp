@@ -0,0 +1,173 @@
+// TimeStretcher: normal speed is an exact delayed copy, and other speeds make as much output as
+// the speed says while a tone keeps its pitch and level and has no clicks at the splices
+#include "TimeStretcher.h"
+#include "TestCheck.h"
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+    const double Pi = 3.14159265358979323846;
+    const unsigned int SampleRate = 48000;
+    const unsigned int Channels = 2;
+
+    // A low voice: the pitch period fits within the search range
+    const double ToneHz = 200.0;
+    const double Amplitude = 0.5;
+
+    // Sizes the engine hands the stretcher, with a few odd ones
+    const unsigned int CallSizes[] = { 480, 441, 512, 1, 97, 1024, 256 };
+    const unsigned int MaxCallFrames = 1024;
+
+    // Tone on the left, the same tone inverted on the right, so crossed channels show up
+    std::vector<float> MakeTone(unsigned int frames)
+    {
+        std::vector<float> tone((size_t)frames * Channels);
+        for (unsigned int i = 0; i < frames; i++)
+        {
+            tone[(size_t)i * Channels] = (float)(Amplitude * std::sin(2.0 * Pi * ToneHz * i / SampleRate));
+            tone[(size_t)i * Channels + 1] = -tone[(size_t)i * Channels];
+        }
+        return tone;
+    }
+
+    // Runs input through at speed in calls of CallSizes. Checks every call against
+    // GetMaxOutputFrames(); returns all output.
+    std::vector<float> Stretch(TimeStretcher& stretcher, const std::vector<float>& input, double speed)
+    {
+        BufferArena arena;
+        stretcher.ReserveBuffers(arena, MaxCallFrames);
+        CHECK(arena.Allocate());
+        stretcher.SetSpeed(speed);
+
+        const unsigned int totalFrames = (unsigned int)(input.size() / Channels);
+        std::vector<float> output;
+        std::vector<float> block;
+        unsigned int position = 0;
+        bool isWithinBound = true;
+        for (unsigned int call = 0; position < totalFrames; call++)
+        {
+            const unsigned int frames = std::min(CallSizes[call % 7], totalFrames - position);
+            const unsigned int maxFrames = stretcher.GetMaxOutputFrames(frames);
+            block.assign((size_t)maxFrames * Channels, 0.0f);
+            const unsigned int produced = stretcher.Process(input.data() + (size_t)position * Channels, frames, block.data());
+            isWithinBound = isWithinBound && produced <= maxFrames;
+            output.insert(output.end(), block.begin(), block.begin() + (size_t)produced * Channels);
+            position += frames;
+        }
+        CHECK(isWithinBound);
+        return output;
+    }
+
+    // Frequency of the left channel from its rising zero crossings from frame from on
+    double MeasureFrequency(const std::vector<float>& samples, size_t from)
+    {
+        double first = -1.0;
+        double last = -1.0;
+        unsigned int crossings = 0;
+        for (size_t i = from + 1; i < samples.size() / Channels; i++)
+        {
+            const float previous = samples[(i - 1) * Channels];
+            const float current = samples[i * Channels];
+            if (previous < 0.0f && current >= 0.0f)
+            {
+                const double at = (i - 1) + previous / (double)(previous - current);
+                if (first < 0.0)
+                    first = at;
+                else
+                    crossings++;
+                last = at;
+            }
+        }
+        return crossings > 0 ? crossings * SampleRate / (last - first) : 0.0;
+    }
+
+    void CheckSpeedLimits()
+    {
+        std::printf("Speed clamped to its range\n");
+        TimeStretcher stretcher;
+        CHECK(!stretcher.Configure(0, Channels));
+        CHECK(stretcher.Configure(SampleRate, Channels));
+        CHECK(stretcher.GetSpeed() == 1.0);
+        stretcher.SetSpeed(2.0);
+        CHECK(stretcher.GetSpeed() == TimeStretcher::MaxSpeed);
+        stretcher.SetSpeed(0.5);
+        CHECK(stretcher.GetSpeed() == TimeStretcher::MinSpeed);
+        stretcher.Reset();
+        CHECK(stretcher.GetSpeed() == 1.0);
+    }
+
+    // Speed 1.0 takes every window at its natural continuation: the input comes out unchanged,
+    // behind the look-ahead of silence the stream starts with
+    void CheckNormalSpeed()
+    {
+        std::printf("Normal speed: a delayed copy\n");
+        TimeStretcher stretcher;
+        CHECK(stretcher.Configure(SampleRate, Channels));
+        const unsigned int latency = stretcher.GetLatencyFrames();
+        const unsigned int totalFrames = SampleRate * 2;
+        const std::vector<float> input = MakeTone(totalFrames);
+        const std::vector<float> output = Stretch(stretcher, input, 1.0);
+
+        // Output keeps pace with input, to within the hop being put together
+        const unsigned int hopFrames = SampleRate * 5 / 1000;
+        const unsigned int outputFrames = (unsigned int)(output.size() / Channels);
+        CHECK_NEAR(outputFrames, totalFrames, hopFrames);
+
+        double worst = 0.0;
+        for (size_t i = 0; i < output.size(); i++)
+        {
+            const float expected = i < (size_t)latency * Channels ? 0.0f : input[i - (size_t)latency * Channels];
+            worst = std::max(worst, (double)std::fabs(output[i] - expected));
+        }
+        CHECK_NEAR(worst, 0.0, 1e-6);
+    }
+
+    // Output length follows the speed; the tone keeps its frequency and level; no sample steps
+    // further from the last than the tone's own steepest slope allows
+    void CheckSpeed(double speed)
+    {
+        std::printf("Speed %.2f\n", speed);
+        TimeStretcher stretcher;
+        CHECK(stretcher.Configure(SampleRate, Channels));
+        const unsigned int totalFrames = SampleRate * 4;
+        const std::vector<float> input = MakeTone(totalFrames);
+        const std::vector<float> output = Stretch(stretcher, input, speed);
+
+        // Output ends within a hop of where the speed puts it
+        const unsigned int hopFrames = SampleRate * 5 / 1000;
+        const unsigned int outputFrames = (unsigned int)(output.size() / Channels);
+        CHECK_NEAR(outputFrames, totalFrames / speed, hopFrames);
+
+        // Past the silence the stream starts with
+        const size_t settled = SampleRate / 10;
+        CHECK_NEAR(MeasureFrequency(output, settled), ToneHz, ToneHz * 1e-3);
+
+        const double maxStep = 2.0 * Pi * ToneHz / SampleRate * Amplitude;
+        double worstStep = 0.0;
+        double peak = 0.0;
+        double trough = 0.0;
+        bool isMirrored = true;
+        for (size_t i = settled; i < outputFrames; i++)
+        {
+            const float left = output[i * Channels];
+            worstStep = std::max(worstStep, (double)std::fabs(left - output[(i - 1) * Channels]));
+            peak = std::max(peak, (double)left);
+            trough = std::min(trough, (double)left);
+            isMirrored = isMirrored && output[i * Channels + 1] == -left;
+        }
+        CHECK_NEAR(worstStep, maxStep, maxStep * 0.05);
+        CHECK_NEAR(peak, Amplitude, Amplitude * 0.02);
+        CHECK_NEAR(trough, -Amplitude, Amplitude * 0.02);
+        CHECK(isMirrored);
+    }
+}
+
+int main()
+{
+    CheckSpeedLimits();
+    CheckNormalSpeed();
+    for (double speed : { 0.9, 0.95, 1.02, 1.05, 1.1 })
+        CheckSpeed(speed);
+    return TEST_RESULT();
+}